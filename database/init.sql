@@ -23,10 +23,29 @@ CREATE TABLE IF NOT EXISTS messages (
     msg_type TINYINT,
     status TINYINT DEFAULT 0,
     send_time TIMESTAMP DEFAULT CURRENT_TIMESTAMP,
+    INDEX idx_conversation (sender_id, receiver_id, msg_id),  -- 按会话增量拉取历史
+    INDEX idx_receiver (receiver_id, sender_id, msg_id),      -- 按发送方统计未读数
     FOREIGN KEY (sender_id) REFERENCES users(user_id),
     FOREIGN KEY (receiver_id) REFERENCES users(user_id)
 );
 
+-- 创建聊天记录检索表（倒排索引），由后台写线程在消息存储后批量写入
+-- 每个词为发送方和接收方各一行，token是TextTokenizer的64位词编码
+CREATE TABLE IF NOT EXISTS message_tokens (
+    token BIGINT UNSIGNED NOT NULL,
+    user_id BIGINT NOT NULL,
+    msg_id BIGINT NOT NULL,
+    PRIMARY KEY (token, user_id, msg_id)
+);
+
+-- 创建已读标记表（每个会话已读到的最后一条消息，用于计算未读数）
+CREATE TABLE IF NOT EXISTS read_markers (
+    user_id BIGINT,
+    peer_id BIGINT,
+    last_read_msg_id BIGINT NOT NULL DEFAULT 0,
+    PRIMARY KEY (user_id, peer_id)
+);
+
 -- 创建好友关系表
 CREATE TABLE IF NOT EXISTS friendships (
     user_id BIGINT,
@@ -56,4 +75,51 @@ CREATE TABLE IF NOT EXISTS group_members (
     PRIMARY KEY (group_id, user_id),
     FOREIGN KEY (group_id) REFERENCES chat_groups(group_id),
     FOREIGN KEY (user_id) REFERENCES users(user_id)
-); 
\ No newline at end of file
+);
+
+-- 创建群消息表
+CREATE TABLE IF NOT EXISTS group_messages (
+    msg_id BIGINT PRIMARY KEY AUTO_INCREMENT,
+    group_id BIGINT,
+    sender_id BIGINT,
+    content TEXT,
+    msg_type TINYINT,
+    send_time TIMESTAMP DEFAULT CURRENT_TIMESTAMP,
+    FOREIGN KEY (group_id) REFERENCES chat_groups(group_id),
+    FOREIGN KEY (sender_id) REFERENCES users(user_id)
+);
+
+-- 创建群离线消息表（成员尚未确认收到的群消息，确认后删除）
+CREATE TABLE IF NOT EXISTS group_offline_messages (
+    user_id BIGINT,
+    msg_id BIGINT,
+    PRIMARY KEY (user_id, msg_id),
+    FOREIGN KEY (user_id) REFERENCES users(user_id),
+    FOREIGN KEY (msg_id) REFERENCES group_messages(msg_id)
+);
+
+-- 创建内容库表（文件内容按SHA-256保存在uploads/blobs/ab/cd/<hash>，相同内容只存一份）
+CREATE TABLE IF NOT EXISTS blobs (
+    hash CHAR(64) PRIMARY KEY,
+    size BIGINT NOT NULL,
+    ref_count INT NOT NULL DEFAULT 0,
+    released_at TIMESTAMP NULL DEFAULT NULL,
+    created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,
+    INDEX idx_released (ref_count, released_at)
+);
+
+-- 创建文件传输表（上传中的内容保存在uploads/files/<file_id>.part，完成后移入内容库）
+CREATE TABLE IF NOT EXISTS file_transfers (
+    file_id BIGINT PRIMARY KEY AUTO_INCREMENT,
+    uploader_id BIGINT,
+    receiver_id BIGINT,
+    file_name VARCHAR(255) NOT NULL,
+    file_size BIGINT NOT NULL,
+    msg_type TINYINT,
+    complete TINYINT DEFAULT 0,
+    blob_hash CHAR(64) NULL,
+    created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,
+    INDEX idx_created (created_at),
+    FOREIGN KEY (uploader_id) REFERENCES users(user_id),
+    FOREIGN KEY (receiver_id) REFERENCES users(user_id)
+);
@@ -0,0 +1,25 @@
+#!/bin/bash
+
+# 生成本地测试用的自签名TLS证书（ECDSA P-256），仅用于开发环境
+# 服务器: config/server_config.json 中设置 "tls.enabled": true
+# 客户端: 运行前设置 QQ_TLS_CA=config/certs/server.crt
+
+PROJECT_ROOT=$(pwd)
+CERT_DIR="${PROJECT_ROOT}/config/certs"
+
+mkdir -p "$CERT_DIR"
+
+openssl req -x509 -newkey ec -pkeyopt ec_paramgen_curve:prime256v1 \
+    -nodes -days 365 \
+    -subj "/CN=localhost" \
+    -addext "subjectAltName=DNS:localhost,IP:127.0.0.1" \
+    -keyout "${CERT_DIR}/server.key" \
+    -out "${CERT_DIR}/server.crt"
+
+if [ $? -eq 0 ]; then
+    chmod 600 "${CERT_DIR}/server.key"
+    echo "证书已生成: ${CERT_DIR}/server.crt"
+else
+    echo "证书生成失败"
+    exit 1
+fi
@@ -1,11 +1,16 @@
 #include "AvatarUploader.h"
+#include "ContentStore.h"
 #include <filesystem>
 #include <fstream>
 #include <sstream>
 
 namespace fs = std::filesystem;
 
-AvatarInfo AvatarUploader::processAvatar(const std::string& filePath) {
+namespace {
+    const char* const AVATAR_DIR = "uploads/avatars";
+}
+
+AvatarUploader::AvatarInfo AvatarUploader::processAvatar(const std::string& filePath) {
     AvatarInfo info;
     
     // 验证文件
@@ -22,22 +27,35 @@ AvatarInfo AvatarUploader::processAvatar(const std::string& filePath) {
     // 创建缩略图
     cv::Mat thumbnail = createThumbnail(original);
     
-    // 生成文件路径
-    std::string filename = fs::path(filePath).filename().string();
-    std::string timestamp = std::to_string(std::time(nullptr));
-    
-    info.originalPath = "uploads/avatars/original_" + timestamp + "_" + filename;
-    info.thumbnailPath = "uploads/avatars/thumb_" + timestamp + "_" + filename;
-    info.mimeType = getMimeType(filePath);
-    info.size = fs::file_size(filePath);
-    
-    // 保存图片
-    cv::imwrite(info.originalPath, original);
-    cv::imwrite(info.thumbnailPath, thumbnail);
+    // 按编码后的内容保存，多次上传同一张图片或多个用户使用同一张图片时不会重复占用空间
+    // JPEG保持原格式，其他格式统一编码为PNG
+    bool jpeg = getMimeType(filePath) == "image/jpeg";
+    std::string extension = jpeg ? ".jpg" : ".png";
+    info.mimeType = jpeg ? "image/jpeg" : "image/png";
+    info.originalHash = storeImage(original, extension);
+    info.thumbnailHash = storeImage(thumbnail, extension);
+
+    ContentStore store(AVATAR_DIR);
+    info.originalPath = store.pathFor(info.originalHash);
+    info.thumbnailPath = store.pathFor(info.thumbnailHash);
+    info.size = fs::file_size(info.originalPath);
     
     return info;
 }
 
+std::string AvatarUploader::storeImage(const cv::Mat& image, const std::string& extension) {
+    std::vector<unsigned char> encoded;
+    if (!cv::imencode(extension, image, encoded)) {
+        throw std::runtime_error("Failed to encode image");
+    }
+
+    std::string hash = ContentStore(AVATAR_DIR).put(encoded.data(), encoded.size());
+    if (hash.empty()) {
+        throw std::runtime_error("Failed to save image");
+    }
+    return hash;
+}
+
 cv::Mat AvatarUploader::createThumbnail(const cv::Mat& original) {
     cv::Mat thumbnail;
     double scale = std::min(
@@ -7,7 +7,10 @@ public:
     static const int MAX_SIZE = 1024 * 1024;  // 1MB
     static const int THUMBNAIL_SIZE = 128;     // 缩略图尺寸
 
+    // 头像按内容保存在uploads/avatars下（见ContentStore），相同图片只存一份
     struct AvatarInfo {
+        std::string originalHash;
+        std::string thumbnailHash;
         std::string originalPath;
         std::string thumbnailPath;
         std::string mimeType;
@@ -20,6 +23,8 @@ public:
 
 private:
     static cv::Mat createThumbnail(const cv::Mat& original);
+    // 编码后存入内容库，返回哈希，失败时抛出异常
+    static std::string storeImage(const cv::Mat& image, const std::string& extension);
     static std::string getMimeType(const std::string& filePath);
     static bool validateImage(const std::string& filePath);
 }; 
\ No newline at end of file
@@ -0,0 +1,142 @@
+#include "ContentStore.h"
+#include "HexCodec.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <unistd.h>
+
+ContentStore::Hasher::Hasher()
+    : ctx_(EVP_MD_CTX_new()) {
+    EVP_DigestInit_ex(ctx_, EVP_sha256(), nullptr);
+}
+
+ContentStore::Hasher::~Hasher() {
+    EVP_MD_CTX_free(ctx_);
+}
+
+void ContentStore::Hasher::update(const void* data, size_t length) {
+    EVP_DigestUpdate(ctx_, data, length);
+}
+
+std::string ContentStore::Hasher::finish() {
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int length = 0;
+    EVP_DigestFinal_ex(ctx_, digest, &length);
+    EVP_DigestInit_ex(ctx_, EVP_sha256(), nullptr);
+
+    return HexCodec::encode(digest, length);
+}
+
+ContentStore::ContentStore(const std::string& root)
+    : root_(root) {
+}
+
+std::string ContentStore::pathFor(const std::string& hash) const {
+    return root_ + "/" + hash.substr(0, 2) + "/" + hash.substr(2, 2) + "/" + hash;
+}
+
+bool ContentStore::contains(const std::string& hash) const {
+    return isValidHash(hash) && ::access(pathFor(hash).c_str(), F_OK) == 0;
+}
+
+bool ContentStore::adopt(const std::string& sourcePath, const std::string& hash) {
+    if (!isValidHash(hash) || !prepareDirectory(hash)) {
+        return false;
+    }
+    if (contains(hash)) {
+        std::remove(sourcePath.c_str());
+        return true;
+    }
+    return std::rename(sourcePath.c_str(), pathFor(hash).c_str()) == 0;
+}
+
+std::string ContentStore::put(const void* data, size_t length) {
+    Hasher hasher;
+    hasher.update(data, length);
+    std::string hash = hasher.finish();
+    if (contains(hash)) {
+        return hash;
+    }
+    if (!prepareDirectory(hash)) {
+        return "";
+    }
+
+    // 先写临时文件再改名，库中不会出现写了一半的文件
+    std::string tempPath = pathFor(hash) + ".tmp";
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    out.write(static_cast<const char*>(data), length);
+    out.close();
+    if (!out || std::rename(tempPath.c_str(), pathFor(hash).c_str()) != 0) {
+        std::remove(tempPath.c_str());
+        return "";
+    }
+    return hash;
+}
+
+bool ContentStore::remove(const std::string& hash) {
+    return isValidHash(hash) && std::remove(pathFor(hash).c_str()) == 0;
+}
+
+std::string ContentStore::hashFile(const std::string& path,
+                                   const std::function<bool(uint64_t)>& progress) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return "";
+    }
+
+    Hasher hasher;
+    std::vector<char> buffer(1024 * 1024);
+    uint64_t hashed = 0;
+    while (in) {
+        in.read(buffer.data(), buffer.size());
+        if (in.gcount() > 0) {
+            hasher.update(buffer.data(), static_cast<size_t>(in.gcount()));
+            hashed += static_cast<uint64_t>(in.gcount());
+            if (progress && !progress(hashed)) {
+                return "";
+            }
+        }
+    }
+    if (in.bad()) {
+        return "";
+    }
+    return hasher.finish();
+}
+
+std::string ContentStore::hashRange(const std::string& path, const std::string& salt,
+                                    uint64_t offset, uint64_t length) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in || !in.seekg(static_cast<std::streamoff>(offset))) {
+        return "";
+    }
+
+    std::vector<char> buffer(static_cast<size_t>(length));
+    in.read(buffer.data(), static_cast<std::streamsize>(length));
+    if (static_cast<uint64_t>(in.gcount()) != length) {
+        return "";
+    }
+
+    Hasher hasher;
+    hasher.update(salt.data(), salt.size());
+    hasher.update(buffer.data(), buffer.size());
+    return hasher.finish();
+}
+
+bool ContentStore::isValidHash(const std::string& hash) {
+    if (hash.size() != HASH_LENGTH) {
+        return false;
+    }
+    for (char c : hash) {
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ContentStore::prepareDirectory(const std::string& hash) const {
+    std::error_code error;
+    std::filesystem::create_directories(root_ + "/" + hash.substr(0, 2) + "/" + hash.substr(2, 2), error);
+    return !error;
+}
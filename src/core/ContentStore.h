@@ -0,0 +1,56 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <openssl/evp.h>
+
+// 按内容寻址的文件库
+// 文件以内容的SHA-256（十六进制）命名，按哈希前两级分目录（root/ab/cd/abcd...），
+// 每级最多256个子目录，单个目录下的文件数不会随总量增长。相同内容只保存一份
+class ContentStore {
+public:
+    static constexpr size_t HASH_LENGTH = 64;  // 十六进制哈希的长度
+
+    // 增量计算SHA-256，用于边接收边校验
+    class Hasher {
+    public:
+        Hasher();
+        ~Hasher();
+        Hasher(const Hasher&) = delete;
+        Hasher& operator=(const Hasher&) = delete;
+
+        void update(const void* data, size_t length);
+        std::string finish();  // 返回十六进制哈希，之后可以重新开始计算
+
+    private:
+        EVP_MD_CTX* ctx_;
+    };
+
+    explicit ContentStore(const std::string& root);
+
+    std::string pathFor(const std::string& hash) const;
+    bool contains(const std::string& hash) const;
+
+    // 把已算好哈希的文件移入库中（同一文件系统内改名）；内容已存在时删除源文件
+    bool adopt(const std::string& sourcePath, const std::string& hash);
+
+    // 写入一段数据并返回其哈希，内容已存在时不再写入；失败返回空串
+    std::string put(const void* data, size_t length);
+
+    bool remove(const std::string& hash);
+
+    // 计算文件的SHA-256，失败返回空串；progress收到已读取的字节数，返回false时中止并返回空串
+    static std::string hashFile(const std::string& path,
+                                const std::function<bool(uint64_t)>& progress = nullptr);
+    // 计算salt与文件中一段内容拼接后的SHA-256，用于证明持有文件而不只是知道哈希
+    static std::string hashRange(const std::string& path, const std::string& salt,
+                                 uint64_t offset, uint64_t length);
+    static bool isValidHash(const std::string& hash);
+
+private:
+    std::string root_;
+
+    bool prepareDirectory(const std::string& hash) const;
+};
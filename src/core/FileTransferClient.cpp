@@ -0,0 +1,245 @@
+#include "FileTransferClient.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+FileTransferClient::FileTransferClient(const std::string& host, int port)
+    : socket_(io_context_)
+    , host_(host)
+    , port_(port)
+    , buffer_(FileTransfer::CHUNK_SIZE)
+    , cancelled_(false)
+    , messageId_(0)
+    , transferred_(0)
+    , elapsed_(0) {
+}
+
+bool FileTransferClient::upload(int64_t fileId, const std::string& ticket, const std::string& path,
+                                const Progress& progress) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || ::fstat(fd, &st) != 0) {
+        if (fd >= 0) ::close(fd);
+        return fail("无法打开文件: " + path);
+    }
+    uint64_t size = static_cast<uint64_t>(st.st_size);
+
+    FileTransfer::TransferReply reply;
+    if (!open(fileId, ticket, FileTransfer::UPLOAD, 0, reply)) {
+        ::close(fd);
+        return false;
+    }
+    if (reply.fileSize != size) {
+        ::close(fd);
+        close();
+        return fail("文件在上传过程中被修改");
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t acked = reply.offset;  // 服务器已按顺序写入的位置
+    uint64_t next = reply.offset;   // 下一个要发送的位置
+    const uint64_t window = static_cast<uint64_t>(FileTransfer::WINDOW_CHUNKS) * FileTransfer::CHUNK_SIZE;
+    bool done = false;
+    try {
+        while (!done) {
+            // 窗口内尽量多发，填满后阻塞等待确认
+            while (next < size && next - acked < window) {
+                uint32_t length = static_cast<uint32_t>(std::min<uint64_t>(FileTransfer::CHUNK_SIZE, size - next));
+                if (::pread(fd, buffer_.data(), length, static_cast<off_t>(next)) != static_cast<ssize_t>(length)) {
+                    ::close(fd);
+                    close();
+                    return fail("读取文件失败");
+                }
+                FileTransfer::ChunkHeader header{next, length, FileTransfer::checksum(buffer_.data(), length)};
+                std::vector<boost::asio::const_buffer> buffers = {
+                    boost::asio::buffer(&header, sizeof(header)),
+                    boost::asio::buffer(buffer_.data(), length)
+                };
+                boost::asio::write(socket_, buffers);
+                next += length;
+                transferred_ += length;
+            }
+
+            // 先阻塞读一个确认，再取走已经到达的其余确认
+            do {
+                FileTransfer::ChunkAck ack;
+                boost::asio::read(socket_, boost::asio::buffer(&ack, sizeof(ack)));
+                if (ack.type == FileTransfer::DONE) {
+                    messageId_ = static_cast<int64_t>(ack.offset);
+                    acked = size;
+                    done = true;
+                    break;
+                }
+                // NAK同时确认了之前的数据，从缺口处回退重发
+                acked = std::max(acked, std::min(ack.offset, size));
+                if (ack.type == FileTransfer::NAK && acked < next) {
+                    next = acked;
+                }
+            } while (socket_.available() >= sizeof(FileTransfer::ChunkAck));
+
+            if (progress && !progress(acked, size)) {
+                cancelled_ = true;
+                ::close(fd);
+                close();
+                return fail("已取消");
+            }
+        }
+    } catch (const boost::system::system_error& e) {
+        ::close(fd);
+        close();
+        return fail("上传中断: " + std::string(e.what()));
+    }
+
+    ::close(fd);
+    close();
+    elapsed_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+bool FileTransferClient::download(int64_t fileId, const std::string& ticket, const std::string& path,
+                                  const Progress& progress) {
+    std::string partPath = path + ".part";
+    int fd = ::open(partPath.c_str(), O_WRONLY | O_CREAT, 0644);
+    struct stat st;
+    if (fd < 0 || ::fstat(fd, &st) != 0) {
+        if (fd >= 0) ::close(fd);
+        return fail("无法写入文件: " + partPath);
+    }
+
+    // 本地已有的部分按块边界对齐后请求服务器跳过
+    uint64_t local = static_cast<uint64_t>(st.st_size);
+    FileTransfer::TransferReply reply;
+    if (!open(fileId, ticket, FileTransfer::DOWNLOAD, local - local % FileTransfer::CHUNK_SIZE, reply)) {
+        ::close(fd);
+        return false;
+    }
+
+    uint64_t size = reply.fileSize;
+    uint64_t expected = reply.offset;  // 下一个按顺序写入的位置
+    if (::ftruncate(fd, static_cast<off_t>(expected)) != 0) {
+        ::close(fd);
+        close();
+        return fail("写入文件失败");
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    uint32_t unacked = 0;
+    bool nakPending = false;
+    try {
+        while (expected < size) {
+            FileTransfer::ChunkHeader header;
+            boost::asio::read(socket_, boost::asio::buffer(&header, sizeof(header)));
+            if (header.length == 0 || header.length > FileTransfer::CHUNK_SIZE ||
+                header.offset > size || header.length > size - header.offset) {
+                ::close(fd);
+                close();
+                return fail("服务器发送的数据块越界");
+            }
+            boost::asio::read(socket_, boost::asio::buffer(buffer_.data(), header.length));
+            transferred_ += header.length;
+
+            FileTransfer::ChunkAck ack{};
+            if (header.offset == expected &&
+                FileTransfer::checksum(buffer_.data(), header.length) == header.crc) {
+                if (::pwrite(fd, buffer_.data(), header.length, static_cast<off_t>(expected)) !=
+                    static_cast<ssize_t>(header.length)) {
+                    ::close(fd);
+                    close();
+                    return fail("写入文件失败");
+                }
+                expected += header.length;
+                nakPending = false;
+                if (++unacked >= FileTransfer::ACK_INTERVAL && expected < size) {
+                    unacked = 0;
+                    ack.type = FileTransfer::ACK;
+                }
+            } else if (header.offset == expected || (header.offset > expected && !nakPending)) {
+                // 校验失败或中间缺块，要求从expected处重发，之后到达的块都丢弃
+                ack.type = FileTransfer::NAK;
+                nakPending = true;
+            }
+            if (ack.type != 0) {
+                ack.offset = expected;
+                boost::asio::write(socket_, boost::asio::buffer(&ack, sizeof(ack)));
+            }
+
+            if (progress && !progress(expected, size)) {
+                cancelled_ = true;
+                ::close(fd);
+                close();
+                return fail("已取消");
+            }
+        }
+
+        FileTransfer::ChunkAck done{};
+        done.type = FileTransfer::DONE;
+        done.offset = size;
+        boost::asio::write(socket_, boost::asio::buffer(&done, sizeof(done)));
+    } catch (const boost::system::system_error& e) {
+        ::close(fd);
+        close();
+        return fail("下载中断: " + std::string(e.what()));
+    }
+
+    ::close(fd);
+    close();
+    elapsed_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (std::rename(partPath.c_str(), path.c_str()) != 0) {
+        return fail("保存文件失败: " + path);
+    }
+    return true;
+}
+
+bool FileTransferClient::open(int64_t fileId, const std::string& ticket, FileTransfer::Direction direction,
+                              uint64_t offset, FileTransfer::TransferReply& reply) {
+    if (ticket.size() != FileTransfer::TICKET_LENGTH) {
+        return fail("票据格式错误");
+    }
+
+    try {
+        boost::asio::ip::tcp::resolver resolver(io_context_);
+        boost::asio::connect(socket_, resolver.resolve(host_, std::to_string(port_)));
+        socket_.set_option(boost::asio::ip::tcp::no_delay(true));
+        socket_.set_option(boost::asio::socket_base::keep_alive(true));
+        socket_.set_option(boost::asio::socket_base::send_buffer_size(4 * 1024 * 1024));
+        socket_.set_option(boost::asio::socket_base::receive_buffer_size(4 * 1024 * 1024));
+
+        FileTransfer::TransferHello hello{};
+        hello.magic = FileTransfer::MAGIC;
+        hello.version = FileTransfer::VERSION;
+        hello.direction = direction;
+        hello.fileId = fileId;
+        std::memcpy(hello.ticket, ticket.data(), FileTransfer::TICKET_LENGTH);
+        hello.offset = offset;
+        boost::asio::write(socket_, boost::asio::buffer(&hello, sizeof(hello)));
+        boost::asio::read(socket_, boost::asio::buffer(&reply, sizeof(reply)));
+    } catch (const boost::system::system_error& e) {
+        close();
+        return fail("连接文件传输服务失败: " + std::string(e.what()));
+    }
+
+    if (reply.status != FileTransfer::STATUS_OK) {
+        close();
+        return fail(reply.status == FileTransfer::STATUS_BAD_TICKET ? "票据无效或已过期" : "服务器读写文件失败");
+    }
+    if (reply.chunkSize != FileTransfer::CHUNK_SIZE || reply.offset > reply.fileSize) {
+        close();
+        return fail("服务器的传输参数不匹配");
+    }
+    return true;
+}
+
+bool FileTransferClient::fail(const std::string& error) {
+    error_ = error;
+    return false;
+}
+
+void FileTransferClient::close() {
+    boost::system::error_code ignored;
+    socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored);
+    socket_.close(ignored);
+}
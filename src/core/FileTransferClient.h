@@ -0,0 +1,46 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <string>
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include "FileTransferProtocol.h"
+
+// 文件传输端口的客户端，同步读写，在界面线程之外的工作线程中使用
+// 票据由聊天连接上的FILE_UPLOAD_REQUEST/FILE_DOWNLOAD_REQUEST取得。
+// 上传从服务器确认的位置续传；下载先写入path.part，下次从其中完整的块之后续传，收齐后改名
+class FileTransferClient {
+public:
+    // 参数为已确认的字节数和文件总字节数，返回false取消传输（已传的部分保留，可以续传）
+    using Progress = std::function<bool(uint64_t done, uint64_t total)>;
+
+    FileTransferClient(const std::string& host, int port);
+
+    bool upload(int64_t fileId, const std::string& ticket, const std::string& path, const Progress& progress);
+    bool download(int64_t fileId, const std::string& ticket, const std::string& path, const Progress& progress);
+
+    const std::string& lastError() const { return error_; }
+    bool cancelled() const { return cancelled_; }
+    int64_t messageId() const { return messageId_; }            // 上传完成后服务器存储的文件消息ID
+    uint64_t transferredBytes() const { return transferred_; }  // 本次实际传输的字节数（不含续传跳过的部分）
+    double elapsedSeconds() const { return elapsed_; }
+
+private:
+    boost::asio::io_context io_context_;
+    boost::asio::ip::tcp::socket socket_;
+    std::string host_;
+    int port_;
+    std::vector<char> buffer_;
+
+    std::string error_;
+    bool cancelled_;
+    int64_t messageId_;
+    uint64_t transferred_;
+    double elapsed_;
+
+    bool open(int64_t fileId, const std::string& ticket, FileTransfer::Direction direction,
+              uint64_t offset, FileTransfer::TransferReply& reply);
+    bool fail(const std::string& error);
+    void close();
+};
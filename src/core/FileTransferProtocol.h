@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <zlib.h>
+
+// 文件传输协议
+// 文件不走聊天连接的JSON帧，由聊天连接上的FILE_UPLOAD_REQUEST/FILE_DOWNLOAD_REQUEST
+// 取得一次性票据后，另开一条TCP连接按固定大小的块传输：
+//   客户端 -> TransferHello，服务器 -> TransferReply（offset为从哪里续传）
+//   数据方 -> 连续发送ChunkHeader + 数据，最多WINDOW_CHUNKS个块未确认
+//   接收方 -> ChunkAck：ACK为累计确认，NAK要求从offset处重发，DONE表示文件完整
+// 每块带CRC32，接收方只按顺序写入校验通过的块，断线后从已确认的位置续传。
+// 与聊天帧一样按主机字节序编码
+namespace FileTransfer {
+
+static constexpr uint32_t MAGIC = 0x54465151;        // "QQFT"
+static constexpr uint16_t VERSION = 1;
+static constexpr uint32_t CHUNK_SIZE = 256 * 1024;   // 固定块大小，最后一块可以更短
+static constexpr uint32_t WINDOW_CHUNKS = 16;        // 未确认的块数上限（4MB在途）
+static constexpr uint32_t ACK_INTERVAL = 4;          // 接收方每收齐几块发一次累计确认
+static constexpr size_t TICKET_LENGTH = 32;          // 票据为16字节随机数的十六进制
+
+enum Direction : uint16_t {
+    UPLOAD = 1,
+    DOWNLOAD = 2
+};
+
+enum ReplyStatus : uint32_t {
+    STATUS_OK = 0,
+    STATUS_BAD_TICKET = 1,
+    STATUS_IO_ERROR = 2
+};
+
+enum AckType : uint32_t {
+    ACK = 1,   // offset之前的数据已全部写入
+    NAK = 2,   // offset处的块缺失或校验失败，从这里重发
+    DONE = 3   // 文件已完整接收；上传时offset为服务器存储的消息ID
+};
+
+#pragma pack(push, 1)
+struct TransferHello {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t direction;
+    int64_t fileId;
+    char ticket[TICKET_LENGTH];
+    uint64_t offset;  // 下载时客户端已有的字节数，上传时忽略
+};
+
+struct TransferReply {
+    uint32_t status;
+    uint32_t chunkSize;
+    uint64_t fileSize;
+    uint64_t offset;  // 传输从这里开始，为chunkSize的整数倍
+};
+
+struct ChunkHeader {
+    uint64_t offset;
+    uint32_t length;
+    uint32_t crc;
+};
+
+struct ChunkAck {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t offset;
+};
+#pragma pack(pop)
+
+inline uint32_t checksum(const char* data, size_t length) {
+    return static_cast<uint32_t>(crc32(0L, reinterpret_cast<const Bytef*>(data),
+                                       static_cast<uInt>(length)));
+}
+
+}  // namespace FileTransfer
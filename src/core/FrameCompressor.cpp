@@ -0,0 +1,134 @@
+#include "FrameCompressor.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+FrameCompressor::FrameCompressor()
+    : deflateReady_(false)
+    , inflateReady_(false)
+    , bytesIn_(0)
+    , bytesOut_(0)
+    , compressMicros_(0) {
+    std::memset(&deflate_, 0, sizeof(deflate_));
+    std::memset(&inflate_, 0, sizeof(inflate_));
+
+    // 负的windowBits表示raw deflate，不带zlib头和校验和，帧本身已有长度和（加密时的）认证
+    deflateReady_ = deflateInit2(&deflate_, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8,
+                                 Z_DEFAULT_STRATEGY) == Z_OK;
+    inflateReady_ = inflateInit2(&inflate_, -15) == Z_OK;
+}
+
+FrameCompressor::~FrameCompressor() {
+    if (deflateReady_) {
+        deflateEnd(&deflate_);
+    }
+    if (inflateReady_) {
+        inflateEnd(&inflate_);
+    }
+}
+
+size_t FrameCompressor::bound(size_t length) {
+    return deflateReady_ ? deflateBound(&deflate_, length) : length;
+}
+
+size_t FrameCompressor::compress(const char* data, size_t length, char* out) {
+    if (!deflateReady_ || length < MIN_COMPRESS_SIZE) {
+        return 0;
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+
+    // 每帧独立压缩：重置状态后重新载入字典，接收方可以单独解压任意一帧
+    const std::string& dict = dictionary();
+    deflateReset(&deflate_);
+    deflateSetDictionary(&deflate_, reinterpret_cast<const Bytef*>(dict.data()), dict.size());
+
+    deflate_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    deflate_.avail_in = static_cast<uInt>(length);
+    deflate_.next_out = reinterpret_cast<Bytef*>(out);
+    deflate_.avail_out = static_cast<uInt>(deflateBound(&deflate_, length));
+
+    int result = deflate(&deflate_, Z_FINISH);
+    size_t compressed = deflate_.total_out;
+
+    compressMicros_ += std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - begin).count();
+
+    if (result != Z_STREAM_END || compressed >= length) {
+        return 0;  // 压缩失败或没有变小，发送原文
+    }
+
+    bytesIn_ += length;
+    bytesOut_ += compressed;
+    return compressed;
+}
+
+bool FrameCompressor::decompress(const char* data, size_t length, std::string& out) {
+    if (!inflateReady_) {
+        return false;
+    }
+
+    const std::string& dict = dictionary();
+    inflateReset(&inflate_);
+    inflateSetDictionary(&inflate_, reinterpret_cast<const Bytef*>(dict.data()), dict.size());
+
+    inflate_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    inflate_.avail_in = static_cast<uInt>(length);
+
+    // 先按4倍估计输出大小，不够时再扩大
+    out.resize(std::max<size_t>(length * 4, 256));
+    size_t produced = 0;
+    while (true) {
+        inflate_.next_out = reinterpret_cast<Bytef*>(&out[produced]);
+        inflate_.avail_out = static_cast<uInt>(out.size() - produced);
+
+        int result = inflate(&inflate_, Z_NO_FLUSH);
+        produced = out.size() - inflate_.avail_out;
+
+        if (result == Z_STREAM_END) {
+            out.resize(produced);
+            return true;
+        }
+        if (result != Z_OK && result != Z_BUF_ERROR) {
+            return false;
+        }
+        if (inflate_.avail_out == 0) {
+            if (out.size() >= MAX_FRAME_SIZE) {
+                return false;  // 解压后过大，视为异常数据
+            }
+            out.resize(std::min(out.size() * 2, MAX_FRAME_SIZE));
+        } else if (inflate_.avail_in == 0) {
+            return false;  // 数据不完整
+        }
+    }
+}
+
+const std::string& FrameCompressor::dictionary() {
+    // deflate优先匹配距离近的内容，出现越频繁的片段放得越靠后
+    static const std::string dict =
+        "{\"content\":\"{\\\"updates\\\":[{\\\"online\\\":true,\\\"userId\\\":"
+        "{\\\"online\\\":false,\\\"userId\\\":"
+        "{\"content\":\"{\\\"friends\\\":[{\\\"id\\\":"
+        ",\\\"nickname\\\":\\\"\",\\\"online\\\":false,\\\"unread\\\":0,\\\"username\\\":\\\""
+        "{\"content\":\"{\\\"messages\\\":[{\\\"content\\\":\\\""
+        "{\"content\":\"{\\\"messageIds\\\":["
+        "{\"content\":\"{\\\"error\\\":\\\"\",\\\"success\\\":false}\\n\","
+        "{\"content\":\"{\\\"success\\\":true,\\\"userId\\\":"
+        "{\"content\":\"{\\n   \\\"type\\\" : \\\"heartbeat\\\"\\n}\\n\","
+        "\\\",\\\"messageId\\\":0,\\\"receiverId\\\":0,\\\"senderId\\\":0,\\\"timestamp\\\":"
+        ",\\\"type\\\":19}"
+        "{\"content\":\"{\\\"messageId\\\":"
+        ",\\\"receiverId\\\":"
+        ",\\\"timestamp\\\":"
+        "}\\n\",\"messageId\":0,\"receiverId\":"
+        ",\"senderId\":0,\"timestamp\":"
+        ",\"type\":"
+        "}\n"
+        "{\"content\":\""
+        "\",\"messageId\":"
+        ",\"receiverId\":"
+        ",\"senderId\":"
+        ",\"timestamp\":17"
+        ",\"type\":19}\n";
+    return dict;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <zlib.h>
+
+// 帧正文压缩（raw deflate + 预置字典）
+// 字典由各类消息的JSON结构整理而成，小的聊天帧也能压缩；压缩后的帧在长度头最高位置1。
+// 每个连接各持有一个实例，z_stream在帧之间只重置不重新分配
+class FrameCompressor {
+public:
+    // 协商用的算法名，字典内容变化时必须同时修改
+    static constexpr const char* NAME = "deflate-v1";
+
+    static constexpr uint32_t COMPRESSED_FLAG = 0x80000000u;  // 长度头最高位
+    static constexpr size_t MIN_COMPRESS_SIZE = 96;            // 小于该长度的帧不压缩
+    static constexpr size_t MAX_FRAME_SIZE = 16 * 1024 * 1024; // 解压后的上限
+
+    FrameCompressor();
+    ~FrameCompressor();
+
+    FrameCompressor(const FrameCompressor&) = delete;
+    FrameCompressor& operator=(const FrameCompressor&) = delete;
+
+    // 压缩结果的最大长度
+    size_t bound(size_t length);
+
+    // 压缩到out（容量至少bound(length)），返回压缩后长度；
+    // 返回0表示不值得压缩，调用方应发送原文
+    size_t compress(const char* data, size_t length, char* out);
+
+    // 解压一帧，out的容量在多次调用间复用
+    bool decompress(const char* data, size_t length, std::string& out);
+
+    // 统计：压缩前后的字节数和压缩耗时
+    uint64_t bytesIn() const { return bytesIn_; }
+    uint64_t bytesOut() const { return bytesOut_; }
+    uint64_t compressMicros() const { return compressMicros_; }
+
+private:
+    z_stream deflate_;
+    z_stream inflate_;
+    bool deflateReady_;
+    bool inflateReady_;
+
+    uint64_t bytesIn_;
+    uint64_t bytesOut_;
+    uint64_t compressMicros_;
+
+    static const std::string& dictionary();
+};
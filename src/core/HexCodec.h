@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+// 十六进制编解码，密钥、令牌、票据和内容哈希共用（输出小写）
+class HexCodec {
+public:
+    static std::string encode(const unsigned char* data, size_t length);
+    static std::string encode(const std::string& bytes) {
+        return encode(reinterpret_cast<const unsigned char*>(bytes.data()), bytes.size());
+    }
+
+    // 长度为奇数或含非十六进制字符时返回false，大小写均可
+    static bool decode(const std::string& hex, std::string& bytes);
+};
@@ -7,7 +7,8 @@ Message::Message(int64_t senderId, int64_t receiverId,
     , receiverId_(receiverId)
     , type_(type)
     , content_(content)
-    , timestamp_(std::time(nullptr)) {
+    , timestamp_(std::time(nullptr))
+    , requestId_(0) {
 }
 
 Json::Value Message::toJson() const {
@@ -18,6 +19,9 @@ Json::Value Message::toJson() const {
     root["type"] = static_cast<int>(type_);
     root["content"] = content_;
     root["timestamp"] = Json::Value::Int64(timestamp_);
+    if (requestId_ != 0) {
+        root["requestId"] = Json::Value::UInt64(requestId_);
+    }
     return root;
 }
 
@@ -29,5 +33,6 @@ Message Message::fromJson(const Json::Value& json) {
     msg.type_ = static_cast<MessageType>(json["type"].asInt());
     msg.content_ = json["content"].asString();
     msg.timestamp_ = json["timestamp"].asInt64();
+    msg.requestId_ = json["requestId"].asUInt64();
     return msg;
 } 
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include <string>
 #include <ctime>
+#include <cstdint>
 #include <json/json.h>
 
 enum class MessageType {
@@ -26,7 +27,19 @@ enum class MessageType {
     FRIEND_REQUEST,          // 好友请求
     FRIEND_REQUEST_NOTIFICATION,  // 好友请求通知
     FRIEND_REQUEST_RESPONSE,      // 好友请求响应
-    FRIEND_RESPONSE              // 好友请求响应
+    FRIEND_RESPONSE,             // 好友请求响应
+    CHAT_ACK,                    // 服务器确认聊天消息已存储
+    DELIVERY_ACK,                // 客户端确认聊天消息已送达
+    GROUP_CHAT,                  // 群聊消息（receiverId为群ID）
+    PRESENCE,                    // 好友在线状态批量推送
+    KEY_EXCHANGE,                // 传输加密密钥交换（明文，连接建立后的第一条消息）
+    RESUME,                      // 断线重连后凭令牌恢复登录，应答为LOGIN_RESPONSE
+    SEARCH_MESSAGES,             // 在服务器上搜索聊天记录
+    SEARCH_RESULTS,              // 聊天记录搜索结果
+    FILE_UPLOAD_REQUEST,         // 申请上传文件（或续传），应答为FILE_TRANSFER_RESPONSE
+    FILE_DOWNLOAD_REQUEST,       // 申请下载文件，应答为FILE_TRANSFER_RESPONSE
+    FILE_TRANSFER_RESPONSE,      // 文件ID和传输端口的票据
+    MARK_READ                    // 已读到某个会话的哪条消息，服务器据此计算未读数，无应答
 };
 
 class Message {
@@ -37,6 +50,7 @@ private:
     MessageType type_;
     std::string content_;
     std::time_t timestamp_;
+    uint64_t requestId_;  // 请求与应答的关联ID，0表示不需要关联
 
 public:
     Message() = default;
@@ -49,6 +63,14 @@ public:
     MessageType getType() const { return type_; }
     const std::string& getContent() const { return content_; }
     std::time_t getTimestamp() const { return timestamp_; }
+    uint64_t getRequestId() const { return requestId_; }
+
+    // Setters（消息ID和时间以服务器存储为准）
+    void setMessageId(int64_t id) { messageId_ = id; }
+    void setTimestamp(std::time_t timestamp) { timestamp_ = timestamp; }
+
+    // 服务器在应答中原样带回请求的ID
+    void setRequestId(uint64_t requestId) { requestId_ = requestId; }
 
     // 序列化和反序列化
     Json::Value toJson() const;
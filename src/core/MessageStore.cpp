@@ -0,0 +1,384 @@
+#include "MessageStore.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace {
+    const char LOG_MAGIC[8] = {'Q', 'Q', 'M', 'S', 'G', 'L', 'O', 'G'};
+    const char INDEX_MAGIC[8] = {'Q', 'Q', 'C', 'O', 'N', 'V', 'I', 'X'};
+    const uint32_t FORMAT_VERSION = 1;
+    const size_t END_OFFSET = 16;  // 文件头中已提交末尾的位置
+}
+
+MessageStore::MessageStore()
+    : fd_(-1)
+    , base_(nullptr)
+    , capacity_(0)
+    , end_(0)
+    , messageCount_(0) {
+}
+
+MessageStore::~MessageStore() {
+    close();
+}
+
+bool MessageStore::open(const std::string& directory) {
+    close();
+
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    logPath_ = directory + "/messages.log";
+    indexPath_ = directory + "/conversations.idx";
+
+    fd_ = ::open(logPath_.c_str(), O_RDWR | O_CREAT, 0600);
+    if (fd_ < 0) {
+        std::cerr << "无法打开本地消息库: " << logPath_ << std::endl;
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd_, &st) != 0) {
+        close();
+        return false;
+    }
+
+    size_t size = static_cast<size_t>(st.st_size);
+    bool created = size < FILE_HEADER_SIZE;
+    if (created) {
+        // 新文件：预留初始空间并写入文件头
+        size = MIN_CAPACITY;
+        if (ftruncate(fd_, size) != 0) {
+            close();
+            return false;
+        }
+    }
+    if (!map(size)) {
+        close();
+        return false;
+    }
+
+    if (created) {
+        std::memcpy(base_, LOG_MAGIC, sizeof(LOG_MAGIC));
+        std::memcpy(base_ + sizeof(LOG_MAGIC), &FORMAT_VERSION, sizeof(FORMAT_VERSION));
+        setEnd(FILE_HEADER_SIZE);
+    } else {
+        uint32_t version = 0;
+        std::memcpy(&version, base_ + sizeof(LOG_MAGIC), sizeof(version));
+        std::memcpy(&end_, base_ + END_OFFSET, sizeof(end_));
+        if (std::memcmp(base_, LOG_MAGIC, sizeof(LOG_MAGIC)) != 0 || version != FORMAT_VERSION ||
+            end_ < FILE_HEADER_SIZE || end_ > capacity_) {
+            std::cerr << "本地消息库格式不正确: " << logPath_ << std::endl;
+            close();
+            return false;
+        }
+    }
+
+    // 先载入检查点时的会话索引，再回放之后追加的记录；索引缺失或过期时从头回放
+    uint64_t checkpoint = FILE_HEADER_SIZE;
+    if (!loadIndex(checkpoint)) {
+        conversations_.clear();
+        messageCount_ = 0;
+        checkpoint = FILE_HEADER_SIZE;
+    }
+    replay(checkpoint);
+    return true;
+}
+
+void MessageStore::close() {
+    if (base_) {
+        flush();
+        munmap(base_, capacity_);
+        base_ = nullptr;
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    capacity_ = 0;
+    end_ = 0;
+    messageCount_ = 0;
+    conversations_.clear();
+}
+
+bool MessageStore::append(const Message& msg, int64_t peerId) {
+    if (!base_ || msg.getMessageId() <= 0) {
+        return false;  // 只保存服务器已确认的消息
+    }
+
+    Conversation& conversation = conversations_[peerId];
+    if (isDuplicate(conversation, msg.getMessageId())) {
+        return false;
+    }
+
+    const std::string& content = msg.getContent();
+    size_t size = recordSize(content.size());
+    if (!reserve(size)) {
+        return false;
+    }
+
+    RecordHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.length = static_cast<uint32_t>(size);
+    header.type = static_cast<uint32_t>(msg.getType());
+    header.messageId = msg.getMessageId();
+    header.senderId = msg.getSenderId();
+    header.receiverId = msg.getReceiverId();
+    header.peerId = peerId;
+    header.timestamp = static_cast<int64_t>(msg.getTimestamp());
+    header.prevOffset = conversation.headOffset;
+    header.contentLength = static_cast<uint32_t>(content.size());
+
+    // 先写完整条记录再推进文件头中的末尾，中途崩溃只会丢掉这条未提交的记录
+    char* out = base_ + end_;
+    std::memcpy(out, &header, sizeof(header));
+    std::memcpy(out + sizeof(header), content.data(), content.size());
+    std::memset(out + sizeof(header) + content.size(), 0, size - sizeof(header) - content.size());
+
+    uint64_t offset = end_;
+    indexRecord(offset, header);
+    setEnd(offset + size);
+    return true;
+}
+
+std::vector<Message> MessageStore::load(int64_t peerId, size_t limit) const {
+    std::vector<Message> messages;
+    auto it = conversations_.find(peerId);
+    if (!base_ || it == conversations_.end()) {
+        return messages;
+    }
+
+    // 补拉的历史可能晚于实时消息写入，追加顺序不等于ID顺序，最新的消息可能在链表深处。
+    // 沿链表走完这个会话的全部记录，只读头部，用大小为limit的小顶堆按ID留下最新的几条
+    using Candidate = std::pair<int64_t, uint64_t>;  // 消息ID，记录位置
+    std::vector<Candidate> heap;
+    heap.reserve(std::min<size_t>(limit, it->second.count));
+    for (uint64_t offset = it->second.headOffset; offset != 0 && limit > 0; ) {
+        const RecordHeader* header = record(offset);
+        if (heap.size() < limit) {
+            heap.emplace_back(header->messageId, offset);
+            std::push_heap(heap.begin(), heap.end(), std::greater<Candidate>());
+        } else if (header->messageId > heap.front().first) {
+            std::pop_heap(heap.begin(), heap.end(), std::greater<Candidate>());
+            heap.back() = Candidate(header->messageId, offset);
+            std::push_heap(heap.begin(), heap.end(), std::greater<Candidate>());
+        }
+        offset = header->prevOffset;
+    }
+
+    // 按消息ID升序解码入选的记录
+    std::sort(heap.begin(), heap.end());
+    messages.reserve(heap.size());
+    for (const auto& candidate : heap) {
+        messages.push_back(toMessage(record(candidate.second)));
+    }
+    return messages;
+}
+
+uint64_t MessageStore::read(uint64_t offset, Message& msg, int64_t& peerId) const {
+    if (!base_ || offset < FILE_HEADER_SIZE || offset + sizeof(RecordHeader) > end_) {
+        return 0;
+    }
+    const RecordHeader* header = record(offset);
+    msg = toMessage(header);
+    peerId = header->peerId;
+    return offset + header->length;
+}
+
+int64_t MessageStore::syncedId(int64_t peerId) const {
+    auto it = conversations_.find(peerId);
+    return it == conversations_.end() ? 0 : it->second.syncedId;
+}
+
+void MessageStore::markSynced(int64_t peerId, int64_t upToId, bool complete) {
+    Conversation& conversation = conversations_[peerId];
+    conversation.syncedId = std::max(conversation.syncedId, upToId);
+    if (complete) {
+        // 服务器上已没有更新的消息，本地已有的消息之前不会再有空缺
+        conversation.syncedId = std::max(conversation.syncedId, conversation.lastMessageId);
+        conversation.liveSince = 0;
+    }
+}
+
+bool MessageStore::flush() {
+    if (!base_) {
+        return false;
+    }
+
+    // 日志先落盘，索引的检查点才不会超过磁盘上的日志
+    msync(base_, end_, MS_SYNC);
+
+    std::string tempPath = indexPath_ + ".tmp";
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        return false;
+    }
+
+    uint32_t reserved = 0;
+    uint64_t count = messageCount_;
+    uint64_t conversationCount = conversations_.size();
+    out.write(INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    out.write(reinterpret_cast<const char*>(&FORMAT_VERSION), sizeof(FORMAT_VERSION));
+    out.write(reinterpret_cast<const char*>(&reserved), sizeof(reserved));
+    out.write(reinterpret_cast<const char*>(&end_), sizeof(end_));
+    out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    out.write(reinterpret_cast<const char*>(&conversationCount), sizeof(conversationCount));
+    for (const auto& entry : conversations_) {
+        out.write(reinterpret_cast<const char*>(&entry.first), sizeof(entry.first));
+        out.write(reinterpret_cast<const char*>(&entry.second), sizeof(entry.second));
+    }
+    out.close();
+    if (!out) {
+        return false;
+    }
+
+    // 先写临时文件再改名，索引文件不会出现写了一半的状态
+    return std::rename(tempPath.c_str(), indexPath_.c_str()) == 0;
+}
+
+bool MessageStore::map(size_t capacity) {
+    void* address = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (address == MAP_FAILED) {
+        std::cerr << "映射本地消息库失败: " << logPath_ << std::endl;
+        return false;
+    }
+    base_ = static_cast<char*>(address);
+    capacity_ = capacity;
+    return true;
+}
+
+bool MessageStore::reserve(size_t extra) {
+    if (end_ + extra <= capacity_) {
+        return true;
+    }
+
+    // 容量按倍数增长，重新映射的次数与消息数成对数关系
+    size_t capacity = std::max(capacity_ * 2, static_cast<size_t>(end_ + extra));
+    capacity = (capacity + MIN_CAPACITY - 1) / MIN_CAPACITY * MIN_CAPACITY;
+    if (ftruncate(fd_, capacity) != 0) {
+        std::cerr << "扩展本地消息库失败: " << logPath_ << std::endl;
+        return false;
+    }
+
+    munmap(base_, capacity_);
+    base_ = nullptr;
+    return map(capacity);
+}
+
+bool MessageStore::loadIndex(uint64_t& checkpoint) {
+    std::ifstream in(indexPath_, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+
+    char magic[sizeof(INDEX_MAGIC)];
+    uint32_t version = 0;
+    uint32_t reserved = 0;
+    uint64_t count = 0;
+    uint64_t conversationCount = 0;
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char*>(&version), sizeof(version));
+    in.read(reinterpret_cast<char*>(&reserved), sizeof(reserved));
+    in.read(reinterpret_cast<char*>(&checkpoint), sizeof(checkpoint));
+    in.read(reinterpret_cast<char*>(&count), sizeof(count));
+    in.read(reinterpret_cast<char*>(&conversationCount), sizeof(conversationCount));
+    if (!in || std::memcmp(magic, INDEX_MAGIC, sizeof(magic)) != 0 || version != FORMAT_VERSION ||
+        checkpoint < FILE_HEADER_SIZE || checkpoint > end_) {
+        return false;
+    }
+
+    conversations_.clear();
+    conversations_.reserve(conversationCount);
+    for (uint64_t i = 0; i < conversationCount; ++i) {
+        int64_t peerId = 0;
+        Conversation conversation;
+        in.read(reinterpret_cast<char*>(&peerId), sizeof(peerId));
+        in.read(reinterpret_cast<char*>(&conversation), sizeof(conversation));
+        if (!in || conversation.headOffset >= checkpoint) {
+            return false;
+        }
+        conversations_[peerId] = conversation;
+    }
+    messageCount_ = count;
+    return true;
+}
+
+void MessageStore::replay(uint64_t from) {
+    uint64_t offset = from;
+    while (offset + sizeof(RecordHeader) <= end_) {
+        const RecordHeader* header = record(offset);
+        if (header->length != recordSize(header->contentLength) || header->length > end_ - offset) {
+            // 记录损坏，丢弃之后的内容
+            std::cerr << "本地消息库在" << offset << "处损坏，已截断" << std::endl;
+            break;
+        }
+        indexRecord(offset, *header);
+        offset += header->length;
+    }
+    if (offset != end_) {
+        setEnd(offset);
+    }
+}
+
+void MessageStore::indexRecord(uint64_t offset, const RecordHeader& header) {
+    Conversation& conversation = conversations_[header.peerId];
+    conversation.headOffset = offset;
+    ++conversation.count;
+    conversation.lastMessageId = std::max(conversation.lastMessageId, header.messageId);
+    if (conversation.liveSince == 0) {
+        conversation.liveSince = offset;
+    }
+    ++messageCount_;
+}
+
+bool MessageStore::isDuplicate(const Conversation& conversation, int64_t messageId) const {
+    if (messageId <= conversation.syncedId) {
+        return true;
+    }
+    if (messageId > conversation.lastMessageId) {
+        return false;  // 按顺序到达的新消息，最常见的情况
+    }
+
+    // 只有上次同步完成后追加的记录可能与之重复（重连后重发、补拉到已实时收到的消息）
+    uint64_t offset = conversation.headOffset;
+    while (conversation.liveSince != 0 && offset >= conversation.liveSince) {
+        const RecordHeader* header = record(offset);
+        if (header->messageId == messageId) {
+            return true;
+        }
+        if (header->prevOffset == 0) {
+            break;
+        }
+        offset = header->prevOffset;
+    }
+    return false;
+}
+
+const MessageStore::RecordHeader* MessageStore::record(uint64_t offset) const {
+    return reinterpret_cast<const RecordHeader*>(base_ + offset);
+}
+
+Message MessageStore::toMessage(const RecordHeader* header) {
+    Message msg(header->senderId, header->receiverId,
+                std::string(reinterpret_cast<const char*>(header + 1), header->contentLength),
+                static_cast<MessageType>(header->type));
+    msg.setMessageId(header->messageId);
+    msg.setTimestamp(static_cast<std::time_t>(header->timestamp));
+    return msg;
+}
+
+void MessageStore::setEnd(uint64_t end) {
+    end_ = end;
+    std::memcpy(base_ + END_OFFSET, &end_, sizeof(end_));
+}
+
+size_t MessageStore::recordSize(size_t contentLength) {
+    return (sizeof(RecordHeader) + contentLength + 7) & ~static_cast<size_t>(7);
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <unordered_map>
+#include "Message.h"
+
+// 客户端本地消息库（每个账号一份）
+// messages.log是只追加的内存映射日志，每条记录带有同一会话上一条记录的位置，
+// 按会话从最新一条往回走即可取出历史，不需要扫描整个文件。
+// conversations.idx保存每个会话的链表头和同步进度，打开时只需回放检查点之后追加的记录
+class MessageStore {
+public:
+    static constexpr size_t FILE_HEADER_SIZE = 64;
+    static constexpr size_t MIN_CAPACITY = 1 << 20;  // 日志文件的初始映射大小
+
+    MessageStore();
+    ~MessageStore();
+
+    MessageStore(const MessageStore&) = delete;
+    MessageStore& operator=(const MessageStore&) = delete;
+
+    // 打开（不存在时创建）目录下的消息库
+    bool open(const std::string& directory);
+    void close();
+    bool isOpen() const { return base_ != nullptr; }
+
+    // 追加一条已由服务器分配ID的消息，peerId是会话对方；重复的消息返回false
+    bool append(const Message& msg, int64_t peerId);
+
+    // 按消息ID升序取出会话中最新的limit条消息
+    std::vector<Message> load(int64_t peerId, size_t limit) const;
+
+    // 读取offset处的记录，返回下一条记录的位置，没有记录时返回0
+    // 从FILE_HEADER_SIZE开始依次读取即可按追加顺序遍历整个日志
+    uint64_t read(uint64_t offset, Message& msg, int64_t& peerId) const;
+
+    // 已提交数据的末尾，也是下一条记录的位置
+    uint64_t endOffset() const { return end_; }
+
+    // 服务器已返回的连续历史截止的消息ID，增量同步从这里开始
+    int64_t syncedId(int64_t peerId) const;
+
+    // 记录同步进度；complete表示服务器已没有更新的消息
+    void markSynced(int64_t peerId, int64_t upToId, bool complete);
+
+    // 保存会话索引，下次打开时不必回放整个日志
+    bool flush();
+
+    size_t messageCount() const { return messageCount_; }
+    size_t conversationCount() const { return conversations_.size(); }
+
+private:
+    // 日志中每条记录的头部，后面紧跟内容，整条记录按8字节对齐
+    struct RecordHeader {
+        uint32_t length;        // 整条记录的长度（含头部和填充）
+        uint32_t type;
+        int64_t messageId;
+        int64_t senderId;
+        int64_t receiverId;
+        int64_t peerId;         // 所属会话
+        int64_t timestamp;
+        uint64_t prevOffset;    // 同一会话上一条记录的位置，0表示没有
+        uint32_t contentLength;
+        uint32_t reserved;
+    };
+
+    // 会话索引
+    struct Conversation {
+        uint64_t headOffset;    // 最新一条记录的位置
+        uint64_t count;
+        int64_t lastMessageId;  // 已存储的最大消息ID
+        int64_t syncedId;       // 不大于该ID的消息都已在本地
+        uint64_t liveSince;     // 上次同步完成后第一条实时追加的记录，0表示没有
+    };
+
+    std::string logPath_;
+    std::string indexPath_;
+    int fd_;
+    char* base_;
+    size_t capacity_;
+    uint64_t end_;              // 已提交数据的末尾
+    size_t messageCount_;
+    std::unordered_map<int64_t, Conversation> conversations_;
+
+    bool map(size_t capacity);
+    bool reserve(size_t extra);
+    bool loadIndex(uint64_t& checkpoint);
+    void replay(uint64_t from);
+    void indexRecord(uint64_t offset, const RecordHeader& header);
+    bool isDuplicate(const Conversation& conversation, int64_t messageId) const;
+    const RecordHeader* record(uint64_t offset) const;
+    static Message toMessage(const RecordHeader* header);
+    void setEnd(uint64_t end);
+
+    static size_t recordSize(size_t contentLength);
+};
@@ -2,127 +2,457 @@
 #include <iostream>
 #include <thread>
 #include <json/json.h>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <stdexcept>
+
+NetworkManager::NetworkManager()
+    : socket_(io_context_)
+    , isConnected_(false)
+    , frameCompressed_(false)
+    , shouldStop_(false)
+    , encryptionEnabled_(true)
+    , outboxHead_(nullptr)
+    , flushScheduled_(false)
+    , writing_(false)
+    , compressionEnabled_(false)
+    , tlsSession_(nullptr)
+    , heartbeatTimer_(io_context_)
+    , reconnectTimer_(io_context_)
+    , connectTimer_(io_context_)
+    , reconnecting_(false)
+    , reconnectAttempt_(0)
+    , random_(std::random_device{}())
+    , lastSeenMessageId_(0)
+    , userId_(0)
+    , nextRequestId_(1)
+    , notifyPending_(false) {
+    if (const char* caFile = std::getenv("QQ_TLS_CA")) {
+        enableTls(caFile);
+    }
+}
+
+NetworkManager::~NetworkManager() {
+    disconnect();
+    if (tlsSession_) {
+        SSL_SESSION_free(tlsSession_);
+    }
+}
+
+bool NetworkManager::enableTls(const std::string& caFile) {
+    try {
+        auto context = std::make_unique<boost::asio::ssl::context>(boost::asio::ssl::context::tls_client);
+        context->set_options(boost::asio::ssl::context::default_workarounds |
+                             boost::asio::ssl::context::no_sslv2 |
+                             boost::asio::ssl::context::no_sslv3 |
+                             boost::asio::ssl::context::no_tlsv1 |
+                             boost::asio::ssl::context::no_tlsv1_1);
+        context->load_verify_file(caFile);
+        context->set_verify_mode(boost::asio::ssl::verify_peer);
+
+        // 客户端只保留最近一次的会话，由回调接管
+        SSL_CTX* ctx = context->native_handle();
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(ctx, &NetworkManager::onNewTlsSession);
+
+        tlsContext_ = std::move(context);
+        return true;
+    } catch (const boost::system::system_error& e) {
+        std::cerr << "加载CA证书失败: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+void NetworkManager::startTls(const std::string& host, ConnectCallback done) {
+    tls_ = std::make_unique<boost::asio::ssl::stream<boost::asio::ip::tcp::socket&>>(socket_, *tlsContext_);
+    SSL* ssl = tls_->native_handle();
+    SSL_set_app_data(ssl, this);
+    if (tlsSession_) {
+        SSL_set_session(ssl, tlsSession_);
+    }
+    tls_->set_verify_callback(boost::asio::ssl::host_name_verification(host));
+
+    auto self = shared_from_this();
+    tls_->async_handshake(boost::asio::ssl::stream_base::client,
+        [this, self, done](const boost::system::error_code& ec) {
+            if (ec) {
+                std::cerr << "TLS握手失败: " << ec.message() << std::endl;
+                done(false);
+                return;
+            }
+            SSL* ssl = tls_->native_handle();
+            std::cout << "TLS已连接: " << SSL_get_version(ssl) << " " << SSL_get_cipher_name(ssl)
+                      << (SSL_session_reused(ssl) ? "（会话恢复）" : "") << std::endl;
+            done(true);
+        });
+}
+
+int NetworkManager::onNewTlsSession(SSL* ssl, SSL_SESSION* session) {
+    auto* self = static_cast<NetworkManager*>(SSL_get_app_data(ssl));
+    if (!self) {
+        return 0;
+    }
+    if (self->tlsSession_) {
+        SSL_SESSION_free(self->tlsSession_);
+    }
+    self->tlsSession_ = session;
+    return 1;  // 接管会话的引用
+}
 
 bool NetworkManager::connect(const std::string& host, int port) {
     try {
-        if (isConnected_) {
+        if (ioThread_.joinable()) {
             std::cout << "已有连接，断开重连..." << std::endl;
             disconnect();
         }
 
         shouldStop_ = false;
-        socket_ = boost::asio::ip::tcp::socket(io_context_);
-        
-        boost::asio::ip::tcp::endpoint endpoint(
+        io_context_.restart();
+        host_ = host;
+        endpoint_ = boost::asio::ip::tcp::endpoint(
             boost::asio::ip::address::from_string(host), port);
-        
-        std::cout << "尝试连接服务器: " << host << ":" << port << std::endl;
-        socket_.connect(endpoint);
-        
-        // 设置socket选项
-        boost::asio::socket_base::keep_alive option(true);
-        socket_.set_option(option);
-        
-        isConnected_ = true;
-        std::cout << "连接成功，开始接收消息" << std::endl;
-        
-        startReceiving();
-        
-        // 启动IO服务线程，捕获endpoint
-        std::thread([this, endpoint]() {
-            try {
-                std::cout << "IO服务线程启动" << std::endl;
-                
-                // 上次心跳时间
-                auto lastHeartbeat = std::chrono::steady_clock::now();
-                
-                while (!shouldStop_) {
-                    try {
-                        if (!isConnected_) {
-                            std::cout << "检测到连接断开，尝试重新连接..." << std::endl;
-                            socket_ = boost::asio::ip::tcp::socket(io_context_);
-                            socket_.connect(endpoint);
-                            isConnected_ = true;
-                            startReceiving();
-                        }
-                        
-                        size_t ops = io_context_.poll();
-                        if (ops > 0) {
-                            std::cout << "处理了 " << ops << " 个IO操作" << std::endl;
-                        }
-                        
-                        // 每30秒发送一次心跳包
-                        auto now = std::chrono::steady_clock::now();
-                        if (isConnected_ && 
-                            std::chrono::duration_cast<std::chrono::seconds>(now - lastHeartbeat).count() >= 30) {
-                            Json::Value heartbeat;
-                            heartbeat["type"] = "heartbeat";
-                            Message msg(0, 0, heartbeat.toStyledString(), MessageType::HEARTBEAT);
-                            sendMessage(msg);
-                            lastHeartbeat = now;
-                        }
-                        
-                        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-                    } catch (const boost::system::system_error& e) {
-                        std::cerr << "IO循环异常: " << e.what() << std::endl;
-                        isConnected_ = false;
-                        std::this_thread::sleep_for(std::chrono::seconds(1));
-                    }
-                }
-                std::cout << "IO服务线程正常退出" << std::endl;
-            } catch (const std::exception& e) {
-                std::cerr << "IO服务线程异常退出: " << e.what() << std::endl;
-            }
-        }).detach();
-        
-        return true;
     }
     catch (const boost::system::system_error& e) {
         std::cerr << "连接失败: " << e.what() << std::endl;
         return false;
     }
+
+    // 工作守卫保证没有挂起的操作时run()也不会返回，IO线程只在有事件时被唤醒
+    workGuard_.emplace(io_context_.get_executor());
+    ioThread_ = std::thread([this]() {
+        std::cout << "IO服务线程启动" << std::endl;
+        while (true) {
+            try {
+                io_context_.run();
+                break;
+            } catch (const std::exception& e) {
+                std::cerr << "IO循环异常: " << e.what() << std::endl;
+            }
+        }
+        std::cout << "IO服务线程正常退出" << std::endl;
+    });
+
+    // 连接在IO线程上异步建立，调用方等待结果，最长CONNECT_TIMEOUT_MS
+    std::cout << "尝试连接服务器: " << host << ":" << port << std::endl;
+    auto opened = std::make_shared<std::promise<bool>>();
+    std::future<bool> result = opened->get_future();
+    auto self = shared_from_this();
+    boost::asio::post(io_context_, [this, self, opened]() {
+        openConnection([this, opened](bool success) {
+            if (success) {
+                std::cout << "连接成功，开始接收消息" << std::endl;
+                startReceiving();
+                scheduleHeartbeat();
+            }
+            opened->set_value(success);
+        });
+    });
+    if (!result.get()) {
+        disconnect();
+        return false;
+    }
+    return true;
+}
+
+void NetworkManager::openConnection(ConnectCallback done) {
+    compressionEnabled_ = false;  // 新连接登录后重新协商
+    cipher_.reset();
+    tls_.reset();
+    socket_ = boost::asio::ip::tcp::socket(io_context_);
+
+    // 期限到时关闭socket，挂起的连接或握手操作随之以错误结束
+    auto self = shared_from_this();
+    connectTimer_.expires_after(std::chrono::milliseconds(CONNECT_TIMEOUT_MS));
+    connectTimer_.async_wait([this, self](const boost::system::error_code& error) {
+        if (!error && !isConnected_) {
+            std::cerr << "连接超时" << std::endl;
+            boost::system::error_code ec;
+            socket_.close(ec);
+        }
+    });
+
+    socket_.async_connect(endpoint_, [this, self, done](const boost::system::error_code& error) {
+        if (error) {
+            std::cerr << "连接失败: " << error.message() << std::endl;
+            finishConnect(false, done);
+            return;
+        }
+
+        // 设置socket选项
+        boost::system::error_code ec;
+        socket_.set_option(boost::asio::socket_base::keep_alive(true), ec);
+
+        auto handshakeDone = [this, self, done](bool success) {
+            if (!success) {
+                std::cerr << "加密握手失败" << std::endl;
+            }
+            finishConnect(success, done);
+        };
+        if (tlsContext_) {
+            startTls(host_, handshakeDone);
+        } else if (encryptionEnabled_) {
+            performKeyExchange(handshakeDone);
+        } else {
+            handshakeDone(true);
+        }
+    });
+}
+
+void NetworkManager::finishConnect(bool success, const ConnectCallback& done) {
+    connectTimer_.cancel();
+    if (success && !shouldStop_) {
+        isConnected_ = true;
+    } else {
+        success = false;
+        closeSocket();  // 失败的TLS流在下一次尝试开始时释放
+    }
+    done(success);
+}
+
+void NetworkManager::closeSocket() {
+    isConnected_ = false;
+    boost::system::error_code ec;
+    socket_.close(ec);
+}
+
+void NetworkManager::connectionLost() {
+    closeSocket();
+    failAllRequests("连接已断开");
+    scheduleReconnect();
+}
+
+void NetworkManager::scheduleReconnect() {
+    if (shouldStop_ || reconnecting_) {
+        return;
+    }
+
+    // 延迟后再重连，旧socket上被取消的异步操作先完成回调
+    // 指数退避加全抖动：在[0, min(上限, 基数*2^n)]中均匀取值，服务器重启后客户端不会同时涌入
+    int shift = std::min(reconnectAttempt_, 16);
+    int64_t ceiling = std::min<int64_t>(RECONNECT_MAX_DELAY_MS, static_cast<int64_t>(RECONNECT_BASE_DELAY_MS) << shift);
+    std::uniform_int_distribution<int64_t> jitter(0, ceiling);
+    auto delay = std::chrono::milliseconds(jitter(random_));
+    ++reconnectAttempt_;
+
+    reconnecting_ = true;
+    reconnectTimer_.expires_after(delay);
+    auto self = shared_from_this();
+    reconnectTimer_.async_wait([this, self](const boost::system::error_code& error) {
+        if (error || shouldStop_) {
+            reconnecting_ = false;
+            return;
+        }
+
+        std::cout << "检测到连接断开，第 " << reconnectAttempt_ << " 次尝试重新连接..." << std::endl;
+        openConnection([this](bool success) {
+            reconnecting_ = false;
+            if (shouldStop_) {
+                return;
+            }
+            if (success) {
+                reconnectAttempt_ = 0;
+                startReceiving();
+                resumeSession();
+            } else {
+                scheduleReconnect();
+            }
+        });
+    });
+}
+
+void NetworkManager::scheduleHeartbeat() {
+    heartbeatTimer_.expires_after(std::chrono::seconds(HEARTBEAT_INTERVAL));
+    auto self = shared_from_this();
+    heartbeatTimer_.async_wait([this, self](const boost::system::error_code& error) {
+        if (error) {
+            return;  // 定时器被取消，连接已关闭
+        }
+
+        if (isConnected_) {
+            Json::Value heartbeat;
+            heartbeat["type"] = "heartbeat";
+            Message msg(0, 0, heartbeat.toStyledString(), MessageType::HEARTBEAT);
+            sendMessage(msg);
+        }
+        scheduleHeartbeat();
+    });
 }
 
 bool NetworkManager::disconnect() {
     shouldStop_ = true;
-    if (isConnected_) {
-        try {
-            socket_.close();
-        } catch (const std::exception& e) {
-            std::cerr << "关闭socket异常: " << e.what() << std::endl;
+    workGuard_.reset();
+    if (ioThread_.joinable()) {
+        // 在IO线程上关闭socket并取消定时器，挂起的操作结束后run()返回
+        boost::asio::post(io_context_, [this]() {
+            closeSocket();
+            heartbeatTimer_.cancel();
+            reconnectTimer_.cancel();
+            connectTimer_.cancel();
+        });
+        if (ioThread_.get_id() == std::this_thread::get_id()) {
+            ioThread_.detach();
+        } else {
+            ioThread_.join();
         }
-        isConnected_ = false;
+    } else {
+        closeSocket();
     }
-    io_context_.stop();
+    failPendingSends();
+    failAllRequests("连接已关闭");
     return true;
 }
 
-void NetworkManager::sendMessage(const Message& msg) {
+void NetworkManager::setMessageCallback(std::function<void()> callback) {
+    std::lock_guard<std::mutex> lock(receiveMutex_);
+    messageCallback_ = std::move(callback);
+    // 设置回调之前已经到达的消息也要通知一次
+    if (messageCallback_ && !receivedMessages_.empty()) {
+        notifyPending_ = true;
+        messageCallback_();
+    }
+}
+
+std::future<bool> NetworkManager::sendMessage(const Message& msg) {
+    auto* pending = new PendingSend;
+    std::future<bool> result = pending->done.get_future();
     if (!isConnected_) {
         std::cerr << "未连接到服务器" << std::endl;
-        return;
+        pending->done.set_value(false);
+        delete pending;
+        return result;
     }
 
-    try {
-        // 序列化消息
-        Json::Value jsonMsg = msg.toJson();
-        Json::FastWriter writer;
-        std::string message = writer.write(jsonMsg);
+    // 序列化在调用线程完成，压缩、加密和写出都交给IO线程
+    Json::FastWriter writer;
+    pending->payload = writer.write(msg.toJson());
+    pending->quiet = msg.getType() == MessageType::HEARTBEAT;  // 不打印心跳包日志
+
+    // 无锁入栈，IO线程一次取走全部
+    pending->next = outboxHead_.load(std::memory_order_relaxed);
+    while (!outboxHead_.compare_exchange_weak(pending->next, pending,
+                                              std::memory_order_release, std::memory_order_relaxed)) {
+    }
+
+    // 已有待执行的取出操作时不再重复投递
+    if (!flushScheduled_.exchange(true, std::memory_order_acq_rel)) {
+        auto self = shared_from_this();
+        boost::asio::post(io_context_, [this, self]() { flushOutbox(); });
+    }
+    return result;
+}
+
+void NetworkManager::flushOutbox() {
+    flushScheduled_.store(false, std::memory_order_release);
+    takeOutbox();
+    doWrite();
+}
 
-        // 发送消息长度
-        uint32_t messageLength = message.length();
-        boost::asio::write(socket_, boost::asio::buffer(&messageLength, sizeof(messageLength)));
+void NetworkManager::takeOutbox() {
+    PendingSend* head = outboxHead_.exchange(nullptr, std::memory_order_acquire);
 
-        // 发送消息内容
-        boost::asio::write(socket_, boost::asio::buffer(message));
-        
-        if (msg.getType() != MessageType::HEARTBEAT) {  // 不打印心跳包日志
-            std::cout << "消息发送成功，长度: " << messageLength << std::endl;
+    // 栈中为逆序，翻转后按提交顺序排入发送队列
+    PendingSend* ordered = nullptr;
+    while (head) {
+        PendingSend* next = head->next;
+        head->next = ordered;
+        ordered = head;
+        head = next;
+    }
+    while (ordered) {
+        PendingSend* next = ordered->next;
+        pendingSends_.emplace_back(ordered);
+        ordered = next;
+    }
+}
+
+void NetworkManager::doWrite() {
+    if (writing_ || pendingSends_.empty()) {
+        return;
+    }
+    if (!isConnected_) {
+        failPendingSends();
+        return;
+    }
+
+    // 把队列中的多条消息合并到一个缓冲区，一次异步写出
+    sendBuffer_.clear();
+    while (!pendingSends_.empty() && writingSends_.size() < MAX_WRITE_BATCH) {
+        std::unique_ptr<PendingSend> pending = std::move(pendingSends_.front());
+        pendingSends_.pop_front();
+        if (!appendFrame(pending->payload, sendBuffer_)) {
+            std::cerr << "消息加密失败" << std::endl;
+            pending->done.set_value(false);
+            continue;
         }
-    } catch (const boost::system::system_error& e) {
-        std::cerr << "发送消息失败: " << e.what() << std::endl;
-        isConnected_ = false;
+        writingSends_.push_back(std::move(pending));
+    }
+    if (writingSends_.empty()) {
+        return;
+    }
+
+    writing_ = true;
+    auto self = shared_from_this();
+    asyncWriteAll(boost::asio::buffer(sendBuffer_),
+        [this, self](const boost::system::error_code& error, size_t bytes_transferred) {
+            writing_ = false;
+            bool quiet = true;
+            for (auto& pending : writingSends_) {
+                quiet = quiet && pending->quiet;
+                pending->done.set_value(!error);
+            }
+            size_t count = writingSends_.size();
+            writingSends_.clear();
+
+            if (error) {
+                if (error != boost::asio::error::operation_aborted) {
+                    std::cerr << "发送消息失败: " << error.message() << std::endl;
+                    connectionLost();
+                }
+                failPendingSends();
+                return;
+            }
+            if (!quiet) {
+                std::cout << "消息发送成功，帧数: " << count << "，字节数: " << bytes_transferred << std::endl;
+            }
+            doWrite();
+        });
+}
+
+void NetworkManager::failPendingSends() {
+    takeOutbox();
+    for (auto& pending : pendingSends_) {
+        pending->done.set_value(false);
+    }
+    pendingSends_.clear();
+}
+
+bool NetworkManager::appendFrame(const std::string& message, std::vector<char>& out) {
+    bool encrypted = cipher_ && cipher_->isActive();
+    size_t tagSize = encrypted ? TransportCipher::TAG_SIZE : 0;
+
+    // 长度头和正文直接写入发送缓冲区，压缩和加密都在缓冲区中进行
+    size_t capacity = compressionEnabled_ ? std::max(message.length(), compressor_.bound(message.length()))
+                                          : message.length();
+    size_t offset = out.size();
+    out.resize(offset + sizeof(uint32_t) + capacity + tagSize);
+    char* body = out.data() + offset + sizeof(uint32_t);
+    size_t bodyLength = compressionEnabled_ ? compressor_.compress(message.data(), message.length(), body) : 0;
+    uint32_t flag = bodyLength > 0 ? FrameCompressor::COMPRESSED_FLAG : 0;
+    if (bodyLength == 0) {
+        bodyLength = message.length();
+        std::memcpy(body, message.data(), bodyLength);
+    }
+    if (encrypted && !cipher_->seal(reinterpret_cast<unsigned char*>(body), bodyLength)) {
+        out.resize(offset);
+        return false;
     }
+
+    uint32_t messageLength = static_cast<uint32_t>(bodyLength + tagSize);
+    uint32_t header = messageLength | flag;
+    std::memcpy(out.data() + offset, &header, sizeof(header));
+    out.resize(offset + sizeof(uint32_t) + messageLength);
+    return true;
 }
 
 void NetworkManager::startReceiving() {
@@ -135,28 +465,74 @@ void NetworkManager::startReceiving() {
     
     try {
         auto self = shared_from_this();  // 确保NetworkManager在异步操作期间存活
-        boost::asio::async_read(socket_,
-            boost::asio::buffer(&messageLength_, sizeof(messageLength_)),
+        asyncReadAll(boost::asio::buffer(&messageLength_, sizeof(messageLength_)),
             [this, self](const boost::system::error_code& error, size_t bytes_transferred) {
                 if (!error) {
+                    frameCompressed_ = (messageLength_ & FrameCompressor::COMPRESSED_FLAG) != 0;
+                    messageLength_ &= ~FrameCompressor::COMPRESSED_FLAG;
+                    if (messageLength_ > FrameCompressor::MAX_FRAME_SIZE) {
+                        std::cerr << "消息长度超出限制，断开连接" << std::endl;
+                        connectionLost();
+                        return;
+                    }
                     std::cout << "收到消息头，长度: " << messageLength_ << std::endl;
                     messageBuffer_.resize(messageLength_);
                     
-                    boost::asio::async_read(socket_,
-                        boost::asio::buffer(messageBuffer_),
+                    asyncReadAll(boost::asio::buffer(messageBuffer_),
                         [this, self](const boost::system::error_code& error, size_t bytes_transferred) {
                             if (!error) {
-                                std::string jsonStr(messageBuffer_.begin(), messageBuffer_.end());
+                                if (cipher_ && cipher_->isActive()) {
+                                    if (!cipher_->open(reinterpret_cast<unsigned char*>(messageBuffer_.data()),
+                                                       messageBuffer_.size())) {
+                                        std::cerr << "消息解密失败，断开连接" << std::endl;
+                                        connectionLost();
+                                        return;
+                                    }
+                                    messageBuffer_.resize(messageBuffer_.size() - TransportCipher::TAG_SIZE);
+                                }
+                                std::string jsonStr;
+                                if (frameCompressed_) {
+                                    if (!compressor_.decompress(messageBuffer_.data(), messageBuffer_.size(),
+                                                                inflateBuffer_)) {
+                                        std::cerr << "消息解压失败，断开连接" << std::endl;
+                                        connectionLost();
+                                        return;
+                                    }
+                                    jsonStr = inflateBuffer_;
+                                } else {
+                                    jsonStr.assign(messageBuffer_.begin(), messageBuffer_.end());
+                                }
                                 std::cout << "收到完整消息: " << jsonStr << std::endl;
                                 
                                 Json::Value root;
                                 Json::Reader reader;
                                 if (reader.parse(jsonStr, root)) {
                                     Message msg = Message::fromJson(root);
-                                    {
-                                        std::lock_guard<std::mutex> lock(receiveMutex_);
-                                        receivedMessages_.push(msg);
-                                        std::cout << "消息已加入队列" << std::endl;
+                                    // 自己上传的文件由服务器直接回显，不在本用户按序送达的消息中，
+                                    // 不计入恢复位置也不确认，否则恢复时会跳过ID更小的未送达消息
+                                    bool ownEcho = needsDeliveryAck(msg.getType()) && userId_ != 0 &&
+                                                   msg.getSenderId() == userId_ &&
+                                                   msg.getReceiverId() != userId_;
+                                    if (!ownEcho) {
+                                        trackSessionState(msg);
+                                    }
+                                    // 请求的应答直接交给等待方，其余消息进入接收队列
+                                    if (!completeRequest(msg)) {
+                                        bool duplicate = false;
+                                        if (!ownEcho && needsDeliveryAck(msg.getType()) && msg.getMessageId() > 0) {
+                                            // 重复消息也要确认，否则服务器会继续重传
+                                            sendDeliveryAck(msg.getMessageId());
+                                            duplicate = !markSeen(msg.getMessageId());
+                                        } else if (msg.getType() == MessageType::GROUP_CHAT && msg.getMessageId() > 0) {
+                                            // 群消息用负数记录，避免与私聊消息ID冲突
+                                            sendDeliveryAck(msg.getMessageId(), true);
+                                            duplicate = !markSeen(-msg.getMessageId());
+                                        }
+                                        if (duplicate) {
+                                            std::cout << "丢弃重复消息: " << msg.getMessageId() << std::endl;
+                                        } else {
+                                            enqueueReceived(msg);
+                                        }
                                     }
                                 }
                                 if (isConnected_) {
@@ -166,13 +542,13 @@ void NetworkManager::startReceiving() {
                             } else if (error != boost::asio::error::operation_aborted) {
                                 std::cerr << "接收消息内容失败: " << error.message() 
                                         << " (" << error.value() << ")" << std::endl;
-                                isConnected_ = false;
+                                connectionLost();
                             }
                         });
                 } else if (error != boost::asio::error::operation_aborted) {
                     std::cerr << "接收消息长度失败: " << error.message() 
                             << " (" << error.value() << ")" << std::endl;
-                    isConnected_ = false;
+                    connectionLost();
                 }
             });
     } catch (const std::exception& e) {
@@ -193,5 +569,303 @@ Message NetworkManager::getNextMessage() {
     }
     Message msg = receivedMessages_.front();
     receivedMessages_.pop();
+    if (receivedMessages_.empty()) {
+        notifyPending_ = false;
+    }
     return msg;
-} 
\ No newline at end of file
+}
+
+bool NetworkManager::waitForMessage(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(receiveMutex_);
+    return receiveCond_.wait_for(lock, timeout, [this]() { return !receivedMessages_.empty(); });
+}
+
+std::future<Message> NetworkManager::request(Message msg, std::chrono::milliseconds timeout) {
+    PendingRequest pending;
+    std::future<Message> result = pending.response.get_future();
+    sendRequest(std::move(msg), timeout, std::move(pending));
+    return result;
+}
+
+void NetworkManager::request(Message msg, std::chrono::milliseconds timeout, RequestCallback done) {
+    PendingRequest pending;
+    pending.callback = std::move(done);
+    sendRequest(std::move(msg), timeout, std::move(pending));
+}
+
+void NetworkManager::sendRequest(Message msg, std::chrono::milliseconds timeout, PendingRequest pending) {
+    uint64_t requestId = nextRequestId_.fetch_add(1, std::memory_order_relaxed);
+    msg.setRequestId(requestId);
+
+    {
+        std::lock_guard<std::mutex> lock(requestMutex_);
+        // 超时定时器在IO线程触发；应答先到时由completeRequest取消
+        pending.timeout = std::make_unique<boost::asio::steady_timer>(io_context_, timeout);
+        auto self = shared_from_this();
+        pending.timeout->async_wait([this, self, requestId](const boost::system::error_code& error) {
+            if (!error) {
+                failRequest(requestId, "服务器响应超时");
+            }
+        });
+        pendingRequests_[requestId] = std::move(pending);
+    }
+
+    std::future<bool> sent = sendMessage(msg);
+    if (sent.wait_for(std::chrono::seconds(0)) == std::future_status::ready && !sent.get()) {
+        failRequest(requestId, "未连接到服务器");
+    }
+}
+
+bool NetworkManager::completeRequest(const Message& msg) {
+    if (msg.getRequestId() == 0) {
+        return false;
+    }
+
+    // 取出后在锁外完成，回调中可以再发起请求
+    PendingRequest pending;
+    {
+        std::lock_guard<std::mutex> lock(requestMutex_);
+        auto it = pendingRequests_.find(msg.getRequestId());
+        if (it == pendingRequests_.end()) {
+            return false;  // 已超时的请求，应答按普通消息分发
+        }
+        pending = std::move(it->second);
+        pendingRequests_.erase(it);
+    }
+    pending.timeout->cancel();
+    if (pending.callback) {
+        pending.callback(&msg, "");
+    } else {
+        pending.response.set_value(msg);
+    }
+    return true;
+}
+
+void NetworkManager::failRequest(uint64_t requestId, const std::string& reason) {
+    PendingRequest pending;
+    {
+        std::lock_guard<std::mutex> lock(requestMutex_);
+        auto it = pendingRequests_.find(requestId);
+        if (it == pendingRequests_.end()) {
+            return;
+        }
+        pending = std::move(it->second);
+        pendingRequests_.erase(it);
+    }
+    pending.timeout->cancel();
+    if (pending.callback) {
+        pending.callback(nullptr, reason);
+    } else {
+        pending.response.set_exception(std::make_exception_ptr(std::runtime_error(reason)));
+    }
+}
+
+void NetworkManager::failAllRequests(const std::string& reason) {
+    std::unordered_map<uint64_t, PendingRequest> failed;
+    {
+        std::lock_guard<std::mutex> lock(requestMutex_);
+        failed.swap(pendingRequests_);
+    }
+    for (auto& entry : failed) {
+        entry.second.timeout->cancel();
+        if (entry.second.callback) {
+            entry.second.callback(nullptr, reason);
+        } else {
+            entry.second.response.set_exception(std::make_exception_ptr(std::runtime_error(reason)));
+        }
+    }
+}
+
+void NetworkManager::subscribe(MessageType type, std::function<void(const Message&)> handler) {
+    subscribers_[type].push_back(std::move(handler));
+}
+
+size_t NetworkManager::dispatchMessages() {
+    size_t count = 0;
+    while (hasMessage()) {
+        Message msg = getNextMessage();
+        auto it = subscribers_.find(msg.getType());
+        if (it == subscribers_.end()) {
+            std::cout << "没有订阅者，忽略消息，类型: " << static_cast<int>(msg.getType()) << std::endl;
+            continue;
+        }
+        for (const auto& handler : it->second) {
+            handler(msg);
+        }
+        ++count;
+    }
+    return count;
+}
+
+bool NetworkManager::markSeen(int64_t messageId) {
+    if (!seenMessageIds_.insert(messageId).second) {
+        return false;
+    }
+
+    seenOrder_.push_back(messageId);
+    if (seenOrder_.size() > MAX_SEEN_IDS) {
+        seenMessageIds_.erase(seenOrder_.front());
+        seenOrder_.pop_front();
+    }
+    return true;
+}
+
+void NetworkManager::sendDeliveryAck(int64_t messageId, bool group) {
+    Json::Value ack;
+    Json::Value ids(Json::arrayValue);
+    ids.append(Json::Value::Int64(messageId));
+    ack[group ? "groupMessageIds" : "messageIds"] = ids;
+
+    Message msg(0, 0, ack.toStyledString(), MessageType::DELIVERY_ACK);
+    sendMessage(msg);
+}
+
+bool NetworkManager::needsDeliveryAck(MessageType type) {
+    // 文件和图片消息与聊天消息存在同一张表里，同样按消息ID确认和补发
+    return type == MessageType::CHAT || type == MessageType::FILE || type == MessageType::IMAGE;
+}
+
+void NetworkManager::trackSessionState(const Message& msg) {
+    if (needsDeliveryAck(msg.getType()) && msg.getMessageId() > lastSeenMessageId_) {
+        lastSeenMessageId_ = msg.getMessageId();  // 消息ID按存储顺序递增
+        return;
+    }
+    if (msg.getType() != MessageType::LOGIN_RESPONSE) {
+        return;
+    }
+
+    Json::Value response;
+    Json::Reader reader;
+    if (!reader.parse(msg.getContent(), response)) {
+        return;
+    }
+    if (!response["success"].asBool()) {
+        resumeToken_.clear();
+        return;
+    }
+
+    // 登录和会话恢复都会下发新令牌
+    resumeToken_ = response["resumeToken"].asString();
+    userId_ = response["userId"].asInt64();
+    if (response["compression"].asString() == FrameCompressor::NAME) {
+        compressionEnabled_ = true;
+        std::cout << "帧压缩已启用: " << FrameCompressor::NAME << std::endl;
+    }
+}
+
+void NetworkManager::resumeSession() {
+    if (resumeToken_.empty()) {
+        return;
+    }
+
+    // 凭令牌恢复登录状态，服务器只补发比lastMessageId更新的消息；
+    // 应答中的新令牌和压缩协商结果已由trackSessionState记录
+    Json::Value request;
+    request["token"] = resumeToken_;
+    request["lastMessageId"] = Json::Value::Int64(lastSeenMessageId_);
+    request["compression"] = FrameCompressor::NAME;
+    auto self = shared_from_this();
+    this->request(Message(0, 0, request.toStyledString(), MessageType::RESUME),
+                  std::chrono::milliseconds(RESUME_TIMEOUT_MS),
+                  [this, self](const Message* response, const std::string& error) {
+        if (!response) {
+            // 没有应答：连接已断开时重连后会再次恢复；仍连着但服务器不应答则断开重连
+            std::cerr << "会话恢复未完成: " << error << std::endl;
+            if (!shouldStop_ && isConnected_) {
+                connectionLost();
+            }
+            return;
+        }
+
+        Json::Value result;
+        Json::Reader reader;
+        if (reader.parse(response->getContent(), result) && result["success"].asBool()) {
+            std::cout << "会话已恢复" << std::endl;
+            return;
+        }
+
+        // 令牌失效（过期或服务器重启换了密钥），只能重新登录；交给界面处理
+        std::cerr << "会话恢复失败，需要重新登录: " << result["error"].asString() << std::endl;
+        resumeToken_.clear();
+        Json::Value expired;
+        expired["success"] = false;
+        expired["sessionExpired"] = true;
+        expired["error"] = result["error"].asString();
+        enqueueReceived(Message(0, 0, expired.toStyledString(), MessageType::LOGIN_RESPONSE));
+    });
+    std::cout << "已发送会话恢复请求，最后收到的消息: " << lastSeenMessageId_ << std::endl;
+}
+
+void NetworkManager::enqueueReceived(const Message& msg) {
+    std::lock_guard<std::mutex> lock(receiveMutex_);
+    receivedMessages_.push(msg);
+    std::cout << "消息已加入队列" << std::endl;
+    // 队列由空变为非空时通知界面一次，界面取空队列前不再重复通知
+    if (messageCallback_ && !notifyPending_) {
+        notifyPending_ = true;
+        messageCallback_();
+    }
+    receiveCond_.notify_all();
+}
+
+void NetworkManager::performKeyExchange(ConnectCallback done) {
+    // 交换过程中的缓冲区和新密钥，异步操作期间保持存活
+    struct Exchange {
+        std::unique_ptr<TransportCipher> cipher = std::make_unique<TransportCipher>();
+        std::vector<char> frame;
+        uint32_t length = 0;
+        std::string payload;
+    };
+    auto exchange = std::make_shared<Exchange>();
+    std::string publicKey = exchange->cipher->generateKeyPair();
+    if (publicKey.empty()) {
+        done(false);
+        return;
+    }
+
+    // 密钥交换消息本身以明文发送，此时还没有开始接收，连接上也没有其他写操作
+    cipher_.reset();
+    Json::Value request;
+    request["publicKey"] = publicKey;
+    Json::FastWriter writer;
+    appendFrame(writer.write(Message(0, 0, request.toStyledString(), MessageType::KEY_EXCHANGE).toJson()),
+                exchange->frame);
+
+    auto self = shared_from_this();
+    asyncWriteAll(boost::asio::buffer(exchange->frame),
+        [this, self, exchange, done](const boost::system::error_code& error, size_t) {
+        if (error) {
+            done(false);
+            return;
+        }
+        asyncReadAll(boost::asio::buffer(&exchange->length, sizeof(exchange->length)),
+            [this, self, exchange, done](const boost::system::error_code& error, size_t) {
+            if (error || exchange->length == 0 || exchange->length > 4096) {
+                done(false);
+                return;
+            }
+            exchange->payload.resize(exchange->length);
+            asyncReadAll(boost::asio::buffer(&exchange->payload[0], exchange->length),
+                [this, self, exchange, done](const boost::system::error_code& error, size_t) {
+                Json::Value root;
+                Json::Reader reader;
+                if (error || !reader.parse(exchange->payload, root)) {
+                    done(false);
+                    return;
+                }
+                Message response = Message::fromJson(root);
+                Json::Value content;
+                if (response.getType() != MessageType::KEY_EXCHANGE ||
+                    !reader.parse(response.getContent(), content) ||
+                    !exchange->cipher->deriveKeys(content["publicKey"].asString(), false)) {
+                    done(false);
+                    return;
+                }
+
+                cipher_ = std::move(exchange->cipher);
+                std::cout << "传输加密已启用" << std::endl;
+                done(true);
+            });
+        });
+    });
+}
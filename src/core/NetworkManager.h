@@ -1,39 +1,204 @@
 #pragma once
 
 #include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
 #include <string>
 #include <queue>
+#include <deque>
+#include <unordered_set>
+#include <unordered_map>
+#include <vector>
 #include <mutex>
 #include <memory>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <optional>
+#include <random>
+#include <thread>
 #include "Message.h"
+#include "TransportCipher.h"
+#include "FrameCompressor.h"
 
 class NetworkManager : public std::enable_shared_from_this<NetworkManager> {
 private:
     boost::asio::io_context io_context_;
     boost::asio::ip::tcp::socket socket_;
-    std::queue<Message> messageQueue_;
-    std::mutex queueMutex_;
-    bool isConnected_;
+    std::atomic<bool> isConnected_;
     std::queue<Message> receivedMessages_;
     std::mutex receiveMutex_;
+    std::condition_variable receiveCond_;
     uint32_t messageLength_;
     std::vector<char> messageBuffer_;
-    bool shouldStop_;
+    bool frameCompressed_;  // 当前读取的帧是否经过压缩
+    std::atomic<bool> shouldStop_;
+
+    // 最近收到的聊天消息ID，用于丢弃服务器重传造成的重复消息
+    std::unordered_set<int64_t> seenMessageIds_;
+    std::deque<int64_t> seenOrder_;
+    static constexpr size_t MAX_SEEN_IDS = 4096;
+
+    // 传输加密，每次连接重新协商
+    bool encryptionEnabled_;
+    std::unique_ptr<TransportCipher> cipher_;
+
+    // 待发送的消息，调用线程入栈，IO线程取出后负责压缩、加密和写出
+    struct PendingSend {
+        std::string payload;
+        std::promise<bool> done;
+        bool quiet = false;
+        PendingSend* next = nullptr;
+    };
+    std::atomic<PendingSend*> outboxHead_;           // 无锁栈，多个线程并发入栈
+    std::atomic<bool> flushScheduled_;               // 已向IO线程投递取出操作
+    std::deque<std::unique_ptr<PendingSend>> pendingSends_;  // 以下仅在IO线程访问
+    std::vector<std::unique_ptr<PendingSend>> writingSends_;
+    std::vector<char> sendBuffer_;  // 本批的长度头 + 正文 + 认证标签，容量复用
+    bool writing_;
+    static constexpr size_t MAX_WRITE_BATCH = 64;  // 单次写出合并的最大消息数
+
+    // 帧压缩，登录响应确认服务器支持后才压缩发出的帧
+    FrameCompressor compressor_;
+    bool compressionEnabled_;
+    std::string inflateBuffer_;
+
+    // TLS传输（可选），启用后不再进行自定义密钥交换
+    std::unique_ptr<boost::asio::ssl::context> tlsContext_;
+    std::unique_ptr<boost::asio::ssl::stream<boost::asio::ip::tcp::socket&>> tls_;
+    SSL_SESSION* tlsSession_;  // 服务器下发的会话票据，重连时用于会话恢复
+
+    // IO线程阻塞在io_context_.run()中，心跳和重连都由定时器驱动
+    std::thread ioThread_;
+    std::optional<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> workGuard_;
+    boost::asio::steady_timer heartbeatTimer_;
+    boost::asio::steady_timer reconnectTimer_;
+    boost::asio::steady_timer connectTimer_;  // 连接和加密握手的期限，disconnect时取消
+    bool reconnecting_;  // 以下仅在IO线程访问
+    int reconnectAttempt_;
+    std::mt19937_64 random_;
+    std::string resumeToken_;    // 登录成功后服务器下发，重连时用于恢复会话
+    int64_t lastSeenMessageId_;  // 收到的最新聊天消息ID，恢复会话时只补发更新的消息
+    int64_t userId_;             // 登录应答中的用户ID，用于识别服务器回显的自己发出的文件消息
+    std::string host_;
+    boost::asio::ip::tcp::endpoint endpoint_;
 
 public:
-    NetworkManager() : socket_(io_context_), isConnected_(false), shouldStop_(false) {}
-    ~NetworkManager() { disconnect(); }
+    // 请求完成时的回调：response为空表示失败，error为原因
+    using RequestCallback = std::function<void(const Message* response, const std::string& error)>;
+
+private:
+    // 等待应答的请求，收到requestId相同的消息时完成，不进入接收队列
+    struct PendingRequest {
+        std::promise<Message> response;
+        RequestCallback callback;  // 设置时代替promise
+        std::unique_ptr<boost::asio::steady_timer> timeout;
+    };
+    std::unordered_map<uint64_t, PendingRequest> pendingRequests_;
+    std::mutex requestMutex_;
+    std::atomic<uint64_t> nextRequestId_;
+
+    // 按消息类型分发的订阅者，仅在界面线程访问
+    std::unordered_map<MessageType, std::vector<std::function<void(const Message&)>>> subscribers_;
+
+    // 收到消息时通知界面线程，在IO线程中调用
+    std::function<void()> messageCallback_;
+    bool notifyPending_;  // 已通知但界面尚未取空队列，受receiveMutex_保护
+
+    static constexpr int HEARTBEAT_INTERVAL = 30;  // 秒
+    static constexpr int RECONNECT_BASE_DELAY_MS = 500;   // 重连退避基数
+    static constexpr int RECONNECT_MAX_DELAY_MS = 30000;  // 重连退避上限
+    static constexpr int RESUME_TIMEOUT_MS = 5000;        // 会话恢复等待应答的时间
+    static constexpr int CONNECT_TIMEOUT_MS = 10000;      // 建立连接（含加密握手）的期限
+
+public:
+    // 设置了环境变量QQ_TLS_CA时使用其中的CA证书启用TLS
+    NetworkManager();
+    ~NetworkManager();
 
     bool connect(const std::string& host, int port);
     bool disconnect();
     bool isConnected() const { return isConnected_; }
-    void sendMessage(const Message& msg);
+    const std::string& getHost() const { return host_; }  // 文件传输连接同一台服务器
+    void setEncryptionEnabled(bool enabled) { encryptionEnabled_ = enabled; }
+
+    // 使用TLS连接，caFile为校验服务器证书的CA（测试时即自签名证书本身）
+    bool enableTls(const std::string& caFile);
+    // 入队后立即返回，不阻塞调用线程；future在消息写出（true）或失败（false）后就绪
+    std::future<bool> sendMessage(const Message& msg);
     void startReceiving();
     bool hasMessage();
     Message getNextMessage();
 
+    // 等待消息到达，超时返回false
+    bool waitForMessage(std::chrono::milliseconds timeout);
+
+    // 发送请求并等待应答：分配requestId，服务器应答带回同一ID时future就绪；
+    // 超时或连接断开时future抛出std::runtime_error。多个请求可以同时在途
+    std::future<Message> request(Message msg, std::chrono::milliseconds timeout);
+    // 回调版本，供不能阻塞等待的IO线程使用；回调在IO线程执行，
+    // 连接被disconnect关闭时在调用disconnect的线程执行
+    void request(Message msg, std::chrono::milliseconds timeout, RequestCallback done);
+
+    // 订阅某类不属于任何请求的消息（推送、通知等），回调在dispatchMessages中执行
+    void subscribe(MessageType type, std::function<void(const Message&)> handler);
+    // 清空全部订阅（界面退回登录页时），不能在订阅回调中调用
+    void unsubscribeAll() { subscribers_.clear(); }
+
+    // 在界面线程调用：取出接收队列中的全部消息分发给订阅者，返回分发的消息数
+    size_t dispatchMessages();
+
+    // 接收队列由空变为非空时调用callback（在IO线程中），界面取空队列后才会再次通知
+    void setMessageCallback(std::function<void()> callback);
+
 private:
-    void handleSend(const boost::system::error_code& error, size_t bytes_transferred);
     void handleReceive(const boost::system::error_code& error, size_t bytes_transferred);
-    void processMessageQueue();
+    void flushOutbox();
+    void takeOutbox();
+    void doWrite();
+    void failPendingSends();
+    bool appendFrame(const std::string& message, std::vector<char>& out);
+    bool markSeen(int64_t messageId);
+    // group为true时确认的是群消息（群消息ID与私聊消息ID各自编号）
+    void sendDeliveryAck(int64_t messageId, bool group = false);
+    // 连接和握手全部异步进行，IO线程不会阻塞；完成或失败时在IO线程调用done
+    using ConnectCallback = std::function<void(bool success)>;
+    void performKeyExchange(ConnectCallback done);
+    void openConnection(ConnectCallback done);
+    void finishConnect(bool success, const ConnectCallback& done);
+    void closeSocket();
+    void connectionLost();
+    void scheduleReconnect();
+    void scheduleHeartbeat();
+    void sendRequest(Message msg, std::chrono::milliseconds timeout, PendingRequest pending);
+    bool completeRequest(const Message& msg);
+    void failRequest(uint64_t requestId, const std::string& reason);
+    void failAllRequests(const std::string& reason);
+    // 在IO线程上记录最新消息ID，并从登录应答中取出恢复令牌和压缩协商结果
+    void trackSessionState(const Message& msg);
+    static bool needsDeliveryAck(MessageType type);
+    void resumeSession();
+    // 把消息放入接收队列并按需通知界面，在IO线程调用
+    void enqueueReceived(const Message& msg);
+    void startTls(const std::string& host, ConnectCallback done);
+    static int onNewTlsSession(SSL* ssl, SSL_SESSION* session);
+
+    template <typename Buffers, typename Handler>
+    void asyncWriteAll(const Buffers& buffers, Handler&& handler) {
+        if (tls_) {
+            boost::asio::async_write(*tls_, buffers, std::forward<Handler>(handler));
+        } else {
+            boost::asio::async_write(socket_, buffers, std::forward<Handler>(handler));
+        }
+    }
+
+    template <typename Buffers, typename Handler>
+    void asyncReadAll(const Buffers& buffers, Handler&& handler) {
+        if (tls_) {
+            boost::asio::async_read(*tls_, buffers, std::forward<Handler>(handler));
+        } else {
+            boost::asio::async_read(socket_, buffers, std::forward<Handler>(handler));
+        }
+    }
 }; 
\ No newline at end of file
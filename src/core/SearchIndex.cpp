@@ -0,0 +1,329 @@
+#include "SearchIndex.h"
+#include "TextTokenizer.h"
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+
+namespace {
+    const char INDEX_MAGIC[8] = {'Q', 'Q', 'S', 'R', 'C', 'H', 'I', 'X'};
+    const uint32_t FORMAT_VERSION = 1;
+}
+
+SearchIndex::SearchIndex()
+    : indexedEnd_(MessageStore::FILE_HEADER_SIZE)
+    , documentCount_(0) {
+}
+
+bool SearchIndex::open(const std::string& path, const MessageStore& store) {
+    path_ = path;
+    if (!load(store)) {
+        clear();
+    }
+    update(store);
+    return true;
+}
+
+void SearchIndex::update(const MessageStore& store) {
+    if (indexedEnd_ > store.endOffset()) {
+        // 日志被截断过，已索引的位置不再可信
+        clear();
+    }
+
+    Message msg;
+    int64_t peerId = 0;
+    uint64_t offset = indexedEnd_;
+    while (offset < store.endOffset()) {
+        uint64_t next = store.read(offset, msg, peerId);
+        if (next == 0) {
+            break;
+        }
+        // 文件消息的正文是JSON描述，与服务器一致不参与检索
+        if (msg.getType() != MessageType::FILE && msg.getType() != MessageType::IMAGE) {
+            addDocument(offset, msg.getContent());
+        }
+        offset = next;
+    }
+    indexedEnd_ = offset;
+}
+
+std::vector<uint64_t> SearchIndex::search(const std::string& query, size_t limit, const MessageStore& store) const {
+    std::vector<uint64_t> results;
+    std::vector<uint64_t> tokens;
+    TextTokenizer::tokenize(query, true, tokens);
+    std::sort(tokens.begin(), tokens.end());
+    tokens.erase(std::unique(tokens.begin(), tokens.end()), tokens.end());
+    if (tokens.empty() || limit == 0) {
+        return results;
+    }
+
+    // 任何一个词没有出现过就不可能命中
+    std::vector<const PostingList*> lists;
+    for (uint64_t token : tokens) {
+        auto it = postings_.find(token);
+        if (it == postings_.end()) {
+            return results;
+        }
+        lists.push_back(&it->second);
+    }
+    std::sort(lists.begin(), lists.end(), [](const PostingList* a, const PostingList* b) {
+        return a->count < b->count;
+    });
+
+    // 原文核对用的查询词：按空白切开，每个都要出现在消息里
+    std::vector<std::string> terms = TextTokenizer::splitTerms(query);
+
+    // 以最短的倒排表为主，从最新的块往前处理，凑够limit条就停止，不必解码整张表
+    const PostingList* lead = lists[0];
+    std::vector<uint64_t> block;
+    Message msg;
+    int64_t peerId = 0;
+    for (size_t b = lead->skips.size() + 1; b-- > 0 && results.size() < limit;) {
+        size_t position = (b == 0) ? 0 : lead->skips[b - 1].position;
+        uint64_t value = (b == 0) ? 0 : lead->skips[b - 1].base;
+        size_t end = (b < lead->skips.size()) ? lead->skips[b].position : lead->bytes.size();
+        block.clear();
+        while (position < end) {
+            value += readVarint(lead->bytes, position);
+            block.push_back(value);
+        }
+
+        // 其余的表借助跳表直接定位到块内的候选文档号
+        std::vector<Cursor> cursors;
+        for (size_t i = 1; i < lists.size(); ++i) {
+            cursors.emplace_back(lists[i]);
+        }
+        size_t kept = 0;
+        for (uint64_t candidate : block) {
+            bool matched = true;
+            for (auto& cursor : cursors) {
+                if (!cursor.seek(candidate) || cursor.value != candidate) {
+                    matched = false;
+                    break;
+                }
+            }
+            if (matched) {
+                block[kept++] = candidate;
+            }
+        }
+        block.resize(kept);
+
+        // 双字词只说明相邻的两字都出现过，最新的在前逐条回到原文核对
+        for (auto it = block.rbegin(); it != block.rend() && results.size() < limit; ++it) {
+            uint64_t offset = *it * 8;
+            if (store.read(offset, msg, peerId) == 0) {
+                continue;
+            }
+            bool found = TextTokenizer::containsTerms(msg.getContent(), terms);
+            if (found) {
+                results.push_back(offset);
+            }
+        }
+    }
+    return results;
+}
+
+bool SearchIndex::save() const {
+    if (path_.empty()) {
+        return false;
+    }
+
+    std::string tempPath = path_ + ".tmp";
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        return false;
+    }
+
+    uint32_t reserved = 0;
+    uint64_t documentCount = documentCount_;
+    uint64_t tokenCount = postings_.size();
+    out.write(INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    out.write(reinterpret_cast<const char*>(&FORMAT_VERSION), sizeof(FORMAT_VERSION));
+    out.write(reinterpret_cast<const char*>(&reserved), sizeof(reserved));
+    out.write(reinterpret_cast<const char*>(&indexedEnd_), sizeof(indexedEnd_));
+    out.write(reinterpret_cast<const char*>(&documentCount), sizeof(documentCount));
+    out.write(reinterpret_cast<const char*>(&tokenCount), sizeof(tokenCount));
+    for (const auto& entry : postings_) {
+        const PostingList& list = entry.second;
+        uint32_t byteCount = static_cast<uint32_t>(list.bytes.size());
+        uint32_t skipCount = static_cast<uint32_t>(list.skips.size());
+        out.write(reinterpret_cast<const char*>(&entry.first), sizeof(entry.first));
+        out.write(reinterpret_cast<const char*>(&list.last), sizeof(list.last));
+        out.write(reinterpret_cast<const char*>(&list.count), sizeof(list.count));
+        out.write(reinterpret_cast<const char*>(&byteCount), sizeof(byteCount));
+        out.write(reinterpret_cast<const char*>(list.bytes.data()), byteCount);
+        out.write(reinterpret_cast<const char*>(&skipCount), sizeof(skipCount));
+        out.write(reinterpret_cast<const char*>(list.skips.data()), skipCount * sizeof(Skip));
+    }
+    out.close();
+    if (!out) {
+        return false;
+    }
+
+    // 先写临时文件再改名，索引文件不会出现写了一半的状态
+    return std::rename(tempPath.c_str(), path_.c_str()) == 0;
+}
+
+size_t SearchIndex::postingBytes() const {
+    size_t total = 0;
+    for (const auto& entry : postings_) {
+        total += entry.second.bytes.size() + entry.second.skips.size() * sizeof(Skip);
+    }
+    return total;
+}
+
+SearchIndex::Cursor::Cursor(const PostingList* list)
+    : list(list)
+    , position(0)
+    , value(0)
+    , valid(true) {
+    next();
+}
+
+bool SearchIndex::Cursor::next() {
+    if (position >= list->bytes.size()) {
+        valid = false;
+        return false;
+    }
+    value += readVarint(list->bytes, position);
+    return true;
+}
+
+bool SearchIndex::Cursor::seek(uint64_t target) {
+    if (!valid) {
+        return false;
+    }
+    if (value >= target) {
+        return true;
+    }
+
+    // 跳到最后一个base小于target的块，块内再逐个解码
+    auto it = std::lower_bound(list->skips.begin(), list->skips.end(), target,
+        [](const Skip& skip, uint64_t bound) { return skip.base < bound; });
+    if (it != list->skips.begin()) {
+        --it;
+        if (it->position > position) {
+            position = it->position;
+            value = it->base;
+        }
+    }
+    while (value < target) {
+        if (!next()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SearchIndex::load(const MessageStore& store) {
+    // 整个文件一次读入内存再解析，避免逐个倒排表小块读取
+    std::ifstream in(path_, std::ios::binary | std::ios::ate);
+    if (!in) {
+        return false;
+    }
+    std::vector<char> data(static_cast<size_t>(in.tellg()));
+    in.seekg(0);
+    if (!in.read(data.data(), data.size())) {
+        return false;
+    }
+
+    size_t pos = 0;
+    auto take = [&](void* out, size_t length) {
+        if (length > data.size() - pos) {
+            return false;
+        }
+        std::memcpy(out, data.data() + pos, length);
+        pos += length;
+        return true;
+    };
+
+    char magic[sizeof(INDEX_MAGIC)];
+    uint32_t version = 0;
+    uint32_t reserved = 0;
+    uint64_t indexedEnd = 0;
+    uint64_t documentCount = 0;
+    uint64_t tokenCount = 0;
+    if (!take(magic, sizeof(magic)) || !take(&version, sizeof(version)) ||
+        !take(&reserved, sizeof(reserved)) || !take(&indexedEnd, sizeof(indexedEnd)) ||
+        !take(&documentCount, sizeof(documentCount)) || !take(&tokenCount, sizeof(tokenCount)) ||
+        std::memcmp(magic, INDEX_MAGIC, sizeof(magic)) != 0 || version != FORMAT_VERSION ||
+        indexedEnd < MessageStore::FILE_HEADER_SIZE || indexedEnd > store.endOffset()) {
+        return false;
+    }
+
+    clear();
+    postings_.reserve(tokenCount);
+    for (uint64_t i = 0; i < tokenCount; ++i) {
+        uint64_t token = 0;
+        uint32_t byteCount = 0;
+        uint32_t skipCount = 0;
+        if (!take(&token, sizeof(token))) {
+            return false;
+        }
+
+        PostingList& list = postings_[token];
+        if (!take(&list.last, sizeof(list.last)) || !take(&list.count, sizeof(list.count)) ||
+            !take(&byteCount, sizeof(byteCount)) || byteCount > data.size() - pos) {
+            return false;
+        }
+        list.bytes.assign(data.begin() + pos, data.begin() + pos + byteCount);
+        pos += byteCount;
+        if (!take(&skipCount, sizeof(skipCount)) || skipCount > (data.size() - pos) / sizeof(Skip)) {
+            return false;
+        }
+        list.skips.resize(skipCount);
+        take(list.skips.data(), skipCount * sizeof(Skip));
+    }
+
+    indexedEnd_ = indexedEnd;
+    documentCount_ = documentCount;
+    return true;
+}
+
+void SearchIndex::clear() {
+    postings_.clear();
+    indexedEnd_ = MessageStore::FILE_HEADER_SIZE;
+    documentCount_ = 0;
+}
+
+void SearchIndex::addDocument(uint64_t offset, const std::string& text) {
+    tokens_.clear();
+    TextTokenizer::tokenize(text, false, tokens_);
+    std::sort(tokens_.begin(), tokens_.end());
+    tokens_.erase(std::unique(tokens_.begin(), tokens_.end()), tokens_.end());
+
+    // 记录按8字节对齐，文档号取位置/8，差值更小，varint更短
+    uint64_t document = offset / 8;
+    for (const auto& token : tokens_) {
+        PostingList& list = postings_[token];
+        if (list.count > 0 && list.count % SKIP_INTERVAL == 0) {
+            list.skips.push_back(Skip{list.last, static_cast<uint32_t>(list.bytes.size())});
+        }
+        appendVarint(list.bytes, document - list.last);
+        list.last = document;
+        ++list.count;
+    }
+    ++documentCount_;
+}
+
+void SearchIndex::appendVarint(std::vector<uint8_t>& bytes, uint64_t value) {
+    while (value >= 0x80) {
+        bytes.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    bytes.push_back(static_cast<uint8_t>(value));
+}
+
+uint64_t SearchIndex::readVarint(const std::vector<uint8_t>& bytes, size_t& position) {
+    uint64_t value = 0;
+    int shift = 0;
+    while (position < bytes.size()) {
+        uint8_t byte = bytes[position++];
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            break;
+        }
+        shift += 7;
+    }
+    return value;
+}
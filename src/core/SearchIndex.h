@@ -0,0 +1,78 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <unordered_map>
+#include "MessageStore.h"
+
+// 本地消息全文检索（倒排索引）
+// 文档是MessageStore日志中的记录，以记录位置作为文档号，日志只追加，文档号天然递增，
+// 倒排表只需在末尾追加与上一个文档号的差值（varint编码）。分词见TextTokenizer，
+// 命中的消息最后都回到原文核对，双字词误配和单词哈希冲突不会产生错误结果
+class SearchIndex {
+public:
+    static constexpr size_t SKIP_INTERVAL = 128;  // 每隔多少个文档号记一个跳表项
+
+    SearchIndex();
+
+    SearchIndex(const SearchIndex&) = delete;
+    SearchIndex& operator=(const SearchIndex&) = delete;
+
+    // 载入path处保存的索引并补上之后追加到消息库的记录；文件缺失或与消息库不符时重建
+    bool open(const std::string& path, const MessageStore& store);
+
+    // 索引消息库中上次更新之后追加的记录
+    void update(const MessageStore& store);
+
+    // 返回包含查询中所有词的消息在日志中的位置，最新的在前，最多limit条
+    std::vector<uint64_t> search(const std::string& query, size_t limit, const MessageStore& store) const;
+
+    // 保存索引，下次打开只需补上之后追加的记录
+    bool save() const;
+
+    // 统计：已索引的消息数、词数、倒排表占用的字节数
+    size_t documentCount() const { return documentCount_; }
+    size_t tokenCount() const { return postings_.size(); }
+    size_t postingBytes() const;
+
+private:
+    // 跳表项：第k项是第k+1块（每块SKIP_INTERVAL个文档号）的起点，前一个文档号为base
+    struct Skip {
+        uint64_t base;
+        uint32_t position;
+    };
+
+    struct PostingList {
+        std::vector<uint8_t> bytes;  // 文档号差值的varint序列
+        std::vector<Skip> skips;
+        uint64_t last;               // 最后一个文档号
+        uint32_t count;
+    };
+
+    // 顺序读取倒排表，seek借助跳表跳过不可能命中的块
+    struct Cursor {
+        const PostingList* list;
+        size_t position;
+        uint64_t value;
+        bool valid;
+
+        explicit Cursor(const PostingList* list);
+        bool next();
+        bool seek(uint64_t target);
+    };
+
+    std::string path_;
+    std::unordered_map<uint64_t, PostingList> postings_;
+    uint64_t indexedEnd_;     // 已索引到的日志位置
+    size_t documentCount_;
+    std::vector<uint64_t> tokens_;  // 切分时复用的缓冲
+
+    bool load(const MessageStore& store);
+    void clear();
+    void addDocument(uint64_t offset, const std::string& text);
+
+    static void appendVarint(std::vector<uint8_t>& bytes, uint64_t value);
+    static uint64_t readVarint(const std::vector<uint8_t>& bytes, size_t& position);
+};
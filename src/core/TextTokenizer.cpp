@@ -0,0 +1,162 @@
+#include "TextTokenizer.h"
+
+namespace {
+    // 词编码：高2位区分类型，其余位是码点或单词哈希
+    const uint64_t UNIGRAM_TOKEN = 1ULL << 62;
+    const uint64_t BIGRAM_TOKEN = 2ULL << 62;
+    const uint64_t WORD_TOKEN = 3ULL << 62;
+    const uint64_t TOKEN_MASK = (1ULL << 62) - 1;
+    const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+    const uint64_t FNV_PRIME = 1099511628211ULL;
+
+    // 解码一个UTF-8字符，返回字节数；非法字节按单字节处理，码点记为0
+    size_t decodeChar(const std::string& text, size_t pos, uint32_t& codepoint) {
+        unsigned char lead = static_cast<unsigned char>(text[pos]);
+        size_t length;
+        if (lead < 0x80) {
+            codepoint = lead;
+            return 1;
+        } else if ((lead & 0xE0) == 0xC0) {
+            codepoint = lead & 0x1F;
+            length = 2;
+        } else if ((lead & 0xF0) == 0xE0) {
+            codepoint = lead & 0x0F;
+            length = 3;
+        } else if ((lead & 0xF8) == 0xF0) {
+            codepoint = lead & 0x07;
+            length = 4;
+        } else {
+            codepoint = 0;
+            return 1;
+        }
+        if (pos + length > text.size()) {
+            codepoint = 0;
+            return text.size() - pos;
+        }
+        for (size_t i = 1; i < length; ++i) {
+            codepoint = (codepoint << 6) | (static_cast<unsigned char>(text[pos + i]) & 0x3F);
+        }
+        return length;
+    }
+
+    // 中日韩文字：没有空格分词，按字切分
+    bool isCjk(uint32_t c) {
+        return (c >= 0x4E00 && c <= 0x9FFF) ||    // 基本汉字
+               (c >= 0x3400 && c <= 0x4DBF) ||    // 扩展A
+               (c >= 0xF900 && c <= 0xFAFF) ||    // 兼容汉字
+               (c >= 0x20000 && c <= 0x2FFFF) ||  // 扩展B及之后
+               (c >= 0x3040 && c <= 0x30FF) ||    // 平假名、片假名
+               (c >= 0xAC00 && c <= 0xD7AF);      // 韩文音节
+    }
+
+    // 标点、全角符号和表情等非ASCII分隔符
+    bool isSeparator(uint32_t c) {
+        return c == 0 ||
+               (c >= 0x2000 && c <= 0x206F) ||    // 通用标点
+               (c >= 0x3000 && c <= 0x303F) ||    // 中文标点
+               (c >= 0xFE30 && c <= 0xFE4F) ||    // 竖排标点
+               (c >= 0xFF00 && c <= 0xFFEF) ||    // 全角符号
+               (c >= 0x2600 && c <= 0x27BF) ||    // 杂项符号
+               (c >= 0x1F000 && c <= 0x1FAFF);    // 表情
+    }
+
+    std::string toLowerAscii(std::string text) {
+        for (auto& c : text) {
+            if (c >= 'A' && c <= 'Z') {
+                c = static_cast<char>(c - 'A' + 'a');
+            }
+        }
+        return text;
+    }
+}
+
+void TextTokenizer::tokenize(const std::string& text, bool forQuery, std::vector<uint64_t>& tokens) {
+    uint64_t hash = FNV_OFFSET;  // 当前单词的哈希
+    size_t wordLength = 0;
+    uint32_t previous = 0;       // 连续中日韩片段中的上一个字
+    size_t runLength = 0;
+
+    auto flushWord = [&]() {
+        if (wordLength > 0) {
+            tokens.push_back(WORD_TOKEN | (hash & TOKEN_MASK));
+            hash = FNV_OFFSET;
+            wordLength = 0;
+        }
+    };
+    auto flushRun = [&]() {
+        // 查询时只有单字的片段没有双字词可用
+        if (forQuery && runLength == 1) {
+            tokens.push_back(UNIGRAM_TOKEN | previous);
+        }
+        runLength = 0;
+    };
+    auto addByte = [&](unsigned char byte) {
+        hash = (hash ^ byte) * FNV_PRIME;
+        ++wordLength;
+    };
+
+    size_t pos = 0;
+    while (pos < text.size()) {
+        uint32_t codepoint = 0;
+        size_t length = decodeChar(text, pos, codepoint);
+        if (codepoint < 0x80) {
+            char c = static_cast<char>(codepoint);
+            flushRun();
+            if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z')) {
+                addByte(c);
+            } else if (c >= 'A' && c <= 'Z') {
+                addByte(c - 'A' + 'a');
+            } else {
+                flushWord();
+            }
+        } else if (isCjk(codepoint)) {
+            flushWord();
+            if (!forQuery) {
+                tokens.push_back(UNIGRAM_TOKEN | codepoint);
+            }
+            if (runLength > 0) {
+                tokens.push_back(BIGRAM_TOKEN | (static_cast<uint64_t>(previous) << 21) | codepoint);
+            }
+            previous = codepoint;
+            ++runLength;
+        } else if (isSeparator(codepoint)) {
+            flushWord();
+            flushRun();
+        } else {
+            // 其他文字（带重音的拉丁字母、西里尔字母等）按单词处理
+            flushRun();
+            for (size_t i = 0; i < length; ++i) {
+                addByte(static_cast<unsigned char>(text[pos + i]));
+            }
+        }
+        pos += length;
+    }
+    flushWord();
+    flushRun();
+}
+
+std::vector<std::string> TextTokenizer::splitTerms(const std::string& query) {
+    std::vector<std::string> terms;
+    size_t start = 0;
+    while (start < query.size()) {
+        size_t end = query.find_first_of(" \t", start);
+        if (end == std::string::npos) {
+            end = query.size();
+        }
+        if (end > start) {
+            terms.push_back(toLowerAscii(query.substr(start, end - start)));
+        }
+        start = end + 1;
+    }
+    return terms;
+}
+
+bool TextTokenizer::containsTerms(const std::string& text, const std::vector<std::string>& terms) {
+    std::string lower = toLowerAscii(text);
+    for (const auto& term : terms) {
+        if (lower.find(term) == std::string::npos) {
+            return false;
+        }
+    }
+    return true;
+}
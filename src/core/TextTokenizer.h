@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// 全文检索的分词，客户端本地索引和服务器的索引表共用，保证两边切出的词一致
+// 英文和数字按单词切分并转小写，中日韩文字索引单字和相邻两字，查询时两字及以上的片段只用双字词。
+// 词编码成64位整数（单词取哈希），命中后需用containsTerms回到原文核对
+class TextTokenizer {
+public:
+    // 切分文本；forQuery为true时中日韩片段只取双字词（单字片段除外）
+    static void tokenize(const std::string& text, bool forQuery, std::vector<uint64_t>& tokens);
+
+    // 把查询按空白切成需要逐个在原文中出现的词（已转小写）
+    static std::vector<std::string> splitTerms(const std::string& query);
+
+    // 原文（不区分英文大小写）是否包含所有查询词
+    static bool containsTerms(const std::string& text, const std::vector<std::string>& terms);
+};
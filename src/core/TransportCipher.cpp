@@ -0,0 +1,160 @@
+#include "TransportCipher.h"
+#include "HexCodec.h"
+#include <openssl/kdf.h>
+#include <openssl/crypto.h>
+
+TransportCipher::TransportCipher()
+    : keyPair_(nullptr)
+    , sealCtx_(nullptr)
+    , openCtx_(nullptr)
+    , sealCounter_(0)
+    , openCounter_(0)
+    , active_(false) {
+}
+
+TransportCipher::~TransportCipher() {
+    EVP_PKEY_free(keyPair_);
+    EVP_CIPHER_CTX_free(sealCtx_);
+    EVP_CIPHER_CTX_free(openCtx_);
+}
+
+std::string TransportCipher::generateKeyPair() {
+    EVP_PKEY_free(keyPair_);
+    keyPair_ = nullptr;
+
+    EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_X25519, nullptr);
+    if (!ctx) {
+        return "";
+    }
+    bool ok = EVP_PKEY_keygen_init(ctx) == 1 && EVP_PKEY_keygen(ctx, &keyPair_) == 1;
+    EVP_PKEY_CTX_free(ctx);
+    if (!ok) {
+        return "";
+    }
+
+    unsigned char publicKey[PUBLIC_KEY_SIZE];
+    size_t length = sizeof(publicKey);
+    if (EVP_PKEY_get_raw_public_key(keyPair_, publicKey, &length) != 1) {
+        return "";
+    }
+    localPublicKey_.assign(reinterpret_cast<char*>(publicKey), length);
+    return HexCodec::encode(localPublicKey_);
+}
+
+bool TransportCipher::deriveKeys(const std::string& peerPublicKeyHex, bool isServer) {
+    std::string peerPublicKey;
+    if (!keyPair_ || !HexCodec::decode(peerPublicKeyHex, peerPublicKey) || peerPublicKey.size() != PUBLIC_KEY_SIZE) {
+        return false;
+    }
+
+    EVP_PKEY* peer = EVP_PKEY_new_raw_public_key(EVP_PKEY_X25519, nullptr,
+        reinterpret_cast<const unsigned char*>(peerPublicKey.data()), peerPublicKey.size());
+    if (!peer) {
+        return false;
+    }
+
+    unsigned char secret[32];
+    size_t secretLength = sizeof(secret);
+    EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new(keyPair_, nullptr);
+    bool ok = ctx &&
+              EVP_PKEY_derive_init(ctx) == 1 &&
+              EVP_PKEY_derive_set_peer(ctx, peer) == 1 &&
+              EVP_PKEY_derive(ctx, secret, &secretLength) == 1;
+    EVP_PKEY_CTX_free(ctx);
+    EVP_PKEY_free(peer);
+    if (!ok) {
+        return false;
+    }
+
+    // 双方公钥作为盐绑定本次握手，两个方向使用不同的密钥
+    const std::string& clientKey = isServer ? peerPublicKey : localPublicKey_;
+    const std::string& serverKey = isServer ? localPublicKey_ : peerPublicKey;
+    std::string salt = clientKey + serverKey;
+
+    unsigned char clientToServer[KEY_SIZE];
+    unsigned char serverToClient[KEY_SIZE];
+    ok = hkdf(secret, secretLength, salt, "qq transport c2s", clientToServer, KEY_SIZE) &&
+         hkdf(secret, secretLength, salt, "qq transport s2c", serverToClient, KEY_SIZE);
+    OPENSSL_cleanse(secret, sizeof(secret));
+
+    EVP_CIPHER_CTX_free(sealCtx_);
+    EVP_CIPHER_CTX_free(openCtx_);
+    sealCtx_ = EVP_CIPHER_CTX_new();
+    openCtx_ = EVP_CIPHER_CTX_new();
+    ok = ok && sealCtx_ && openCtx_ &&
+         EVP_EncryptInit_ex(sealCtx_, EVP_aes_256_gcm(), nullptr,
+                            isServer ? serverToClient : clientToServer, nullptr) == 1 &&
+         EVP_DecryptInit_ex(openCtx_, EVP_aes_256_gcm(), nullptr,
+                            isServer ? clientToServer : serverToClient, nullptr) == 1;
+    OPENSSL_cleanse(clientToServer, sizeof(clientToServer));
+    OPENSSL_cleanse(serverToClient, sizeof(serverToClient));
+
+    // 临时私钥用完即弃
+    EVP_PKEY_free(keyPair_);
+    keyPair_ = nullptr;
+
+    sealCounter_ = 0;
+    openCounter_ = 0;
+    active_ = ok;
+    return ok;
+}
+
+bool TransportCipher::seal(unsigned char* data, size_t length) {
+    if (!active_) {
+        return false;
+    }
+
+    unsigned char nonce[NONCE_SIZE];
+    makeNonce(sealCounter_++, nonce);
+
+    int outLength = 0;
+    return EVP_EncryptInit_ex(sealCtx_, nullptr, nullptr, nullptr, nonce) == 1 &&
+           EVP_EncryptUpdate(sealCtx_, data, &outLength, data, static_cast<int>(length)) == 1 &&
+           EVP_EncryptFinal_ex(sealCtx_, data + outLength, &outLength) == 1 &&
+           EVP_CIPHER_CTX_ctrl(sealCtx_, EVP_CTRL_GCM_GET_TAG, TAG_SIZE, data + length) == 1;
+}
+
+bool TransportCipher::open(unsigned char* data, size_t length) {
+    if (!active_ || length < TAG_SIZE) {
+        return false;
+    }
+
+    unsigned char nonce[NONCE_SIZE];
+    makeNonce(openCounter_++, nonce);
+
+    size_t textLength = length - TAG_SIZE;
+    int outLength = 0;
+    return EVP_DecryptInit_ex(openCtx_, nullptr, nullptr, nullptr, nonce) == 1 &&
+           EVP_CIPHER_CTX_ctrl(openCtx_, EVP_CTRL_GCM_SET_TAG, TAG_SIZE, data + textLength) == 1 &&
+           EVP_DecryptUpdate(openCtx_, data, &outLength, data, static_cast<int>(textLength)) == 1 &&
+           EVP_DecryptFinal_ex(openCtx_, data + outLength, &outLength) == 1;
+}
+
+void TransportCipher::makeNonce(uint64_t counter, unsigned char* nonce) {
+    // 前4字节为0，后8字节为大端计数器
+    for (size_t i = 0; i < 4; ++i) {
+        nonce[i] = 0;
+    }
+    for (size_t i = 0; i < 8; ++i) {
+        nonce[NONCE_SIZE - 1 - i] = static_cast<unsigned char>(counter >> (8 * i));
+    }
+}
+
+bool TransportCipher::hkdf(const unsigned char* secret, size_t secretLength,
+                           const std::string& salt, const std::string& info,
+                           unsigned char* out, size_t outLength) {
+    EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, nullptr);
+    if (!ctx) {
+        return false;
+    }
+    bool ok = EVP_PKEY_derive_init(ctx) == 1 &&
+              EVP_PKEY_CTX_set_hkdf_md(ctx, EVP_sha256()) == 1 &&
+              EVP_PKEY_CTX_set1_hkdf_salt(ctx, reinterpret_cast<const unsigned char*>(salt.data()),
+                                          static_cast<int>(salt.size())) == 1 &&
+              EVP_PKEY_CTX_set1_hkdf_key(ctx, secret, static_cast<int>(secretLength)) == 1 &&
+              EVP_PKEY_CTX_add1_hkdf_info(ctx, reinterpret_cast<const unsigned char*>(info.data()),
+                                          static_cast<int>(info.size())) == 1 &&
+              EVP_PKEY_derive(ctx, out, &outLength) == 1;
+    EVP_PKEY_CTX_free(ctx);
+    return ok;
+}
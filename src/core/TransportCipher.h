@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <openssl/evp.h>
+
+// 传输层加密
+// 连接建立后双方用X25519交换公钥，经HKDF-SHA256派生收发两个方向的AES-256-GCM密钥。
+// 之后每帧正文原地加密，末尾附加16字节认证标签；nonce为各方向独立递增的计数器。
+// 加解密上下文在派生密钥时创建一次，之后每帧只重设nonce，不再分配
+class TransportCipher {
+public:
+    static constexpr size_t KEY_SIZE = 32;
+    static constexpr size_t PUBLIC_KEY_SIZE = 32;
+    static constexpr size_t TAG_SIZE = 16;
+    static constexpr size_t NONCE_SIZE = 12;
+
+    TransportCipher();
+    ~TransportCipher();
+
+    TransportCipher(const TransportCipher&) = delete;
+    TransportCipher& operator=(const TransportCipher&) = delete;
+
+    // 生成本端的临时密钥对，返回公钥（十六进制）
+    std::string generateKeyPair();
+
+    // 用对方公钥派生会话密钥，成功后进入加密状态
+    bool deriveKeys(const std::string& peerPublicKeyHex, bool isServer);
+
+    bool isActive() const { return active_; }
+
+    // 原地加密data[0, length)，标签写到data + length，调用方保证后面留有TAG_SIZE字节
+    bool seal(unsigned char* data, size_t length);
+
+    // 原地解密data[0, length)（含末尾标签），成功后明文长度为length - TAG_SIZE
+    bool open(unsigned char* data, size_t length);
+
+private:
+    EVP_PKEY* keyPair_;
+    EVP_CIPHER_CTX* sealCtx_;
+    EVP_CIPHER_CTX* openCtx_;
+    uint64_t sealCounter_;
+    uint64_t openCounter_;
+    bool active_;
+    std::string localPublicKey_;
+
+    static void makeNonce(uint64_t counter, unsigned char* nonce);
+    static bool hkdf(const unsigned char* secret, size_t secretLength,
+                     const std::string& salt, const std::string& info,
+                     unsigned char* out, size_t outLength);
+};
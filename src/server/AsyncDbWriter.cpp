@@ -0,0 +1,171 @@
+#include "AsyncDbWriter.h"
+#include "DatabaseManager.h"
+#include "Logger.h"
+#include "../core/TextTokenizer.h"
+#include <algorithm>
+#include <sstream>
+
+AsyncDbWriter::~AsyncDbWriter() {
+    stop();
+}
+
+bool AsyncDbWriter::start(const std::string& host,
+                          const std::string& database,
+                          const std::string& user,
+                          const std::string& password) {
+    conn_ = mysql_init(nullptr);
+    if (!conn_) {
+        LOG_ERROR("后台写连接初始化失败");
+        return false;
+    }
+
+    if (!mysql_real_connect(conn_, host.c_str(), user.c_str(),
+                           password.c_str(), database.c_str(), 0, nullptr, 0)) {
+        LOG_ERROR("后台写连接失败: " + std::string(mysql_error(conn_)));
+        mysql_close(conn_);
+        conn_ = nullptr;
+        return false;
+    }
+
+    stopping_ = false;
+    worker_ = std::thread([this]() { run(); });
+    LOG_INFO("后台数据库写线程已启动");
+    return true;
+}
+
+void AsyncDbWriter::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+
+    if (conn_) {
+        mysql_close(conn_);
+        conn_ = nullptr;
+    }
+}
+
+void AsyncDbWriter::enqueue(const std::string& sql) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        statements_.push_back(sql);
+    }
+    cv_.notify_one();
+}
+
+void AsyncDbWriter::updateUserStatus(int64_t userId, bool online) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pendingStatus_[userId] = online;
+    }
+    cv_.notify_one();
+}
+
+void AsyncDbWriter::indexMessage(const Message& msg) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pendingIndex_.push_back(IndexJob{msg.getMessageId(), msg.getSenderId(),
+                                         msg.getReceiverId(), msg.getContent()});
+    }
+    cv_.notify_one();
+}
+
+void AsyncDbWriter::run() {
+    while (true) {
+        std::vector<std::string> statements;
+        std::unordered_map<int64_t, bool> statuses;
+        std::vector<IndexJob> indexJobs;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] {
+                return stopping_ || !statements_.empty() || !pendingStatus_.empty() ||
+                       !pendingIndex_.empty();
+            });
+
+            // 停止前先写完剩余的数据
+            if (stopping_ && statements_.empty() && pendingStatus_.empty() && pendingIndex_.empty()) {
+                break;
+            }
+
+            statements.swap(statements_);
+            statuses.swap(pendingStatus_);
+            indexJobs.swap(pendingIndex_);
+        }
+
+        for (const auto& sql : statements) {
+            execute(sql);
+        }
+
+        // 在线和离线各合并成一条UPDATE
+        if (!statuses.empty()) {
+            std::stringstream online, offline;
+            for (const auto& pair : statuses) {
+                std::stringstream& ss = pair.second ? online : offline;
+                ss << (ss.tellp() > 0 ? ", " : "") << pair.first;
+            }
+            if (online.tellp() > 0) {
+                execute("UPDATE users SET status = 1 WHERE user_id IN (" + online.str() + ")");
+            }
+            if (offline.tellp() > 0) {
+                execute("UPDATE users SET status = 0 WHERE user_id IN (" + offline.str() + ")");
+            }
+        }
+
+        if (!indexJobs.empty()) {
+            writeTokens(indexJobs);
+        }
+    }
+
+    mysql_thread_end();
+    LOG_INFO("后台数据库写线程已退出");
+}
+
+void AsyncDbWriter::writeTokens(const std::vector<IndexJob>& jobs) {
+    // 每个词为发送方和接收方各写一行，搜索时按(token, user_id)直接定位
+    std::stringstream ss;
+    size_t rows = 0;
+    auto flush = [&]() {
+        if (rows > 0) {
+            execute(ss.str());
+            ss.str("");
+            rows = 0;
+        }
+    };
+
+    std::vector<uint64_t> tokens;
+    for (const auto& job : jobs) {
+        tokens.clear();
+        TextTokenizer::tokenize(job.content, false, tokens);
+        std::sort(tokens.begin(), tokens.end());
+        tokens.erase(std::unique(tokens.begin(), tokens.end()), tokens.end());
+
+        for (uint64_t token : tokens) {
+            for (int64_t userId : {job.senderId, job.receiverId}) {
+                ss << (rows == 0 ? "INSERT IGNORE INTO message_tokens (token, user_id, msg_id) VALUES " : ", ")
+                   << "(" << token << ", " << userId << ", " << job.messageId << ")";
+                if (++rows >= MAX_TOKEN_ROWS) {
+                    flush();
+                }
+            }
+        }
+    }
+    flush();
+}
+
+bool AsyncDbWriter::execute(const std::string& sql) {
+    if (mysql_ping(conn_) != 0) {
+        LOG_ERROR("后台写连接已断开: " + std::string(mysql_error(conn_)));
+        return false;
+    }
+
+    if (mysql_query(conn_, sql.c_str()) != 0) {
+        LOG_ERROR("后台" + DatabaseManager::statementType(sql) + "失败: " + std::string(mysql_error(conn_)));
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#ifdef __linux__
+    #include <mysql/mysql.h>
+#else
+    #include <mysql.h>
+#endif
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "../core/Message.h"
+
+// 后台数据库写线程
+// 使用独立的数据库连接执行不需要等待结果的写操作，避免阻塞IO线程
+class AsyncDbWriter {
+private:
+    MYSQL* conn_;
+    std::thread worker_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool stopping_;
+
+    std::vector<std::string> statements_;
+    // 用户在线状态只保留最后一次变化，同一批次合并成一条UPDATE
+    std::unordered_map<int64_t, bool> pendingStatus_;
+
+    // 待写入检索表的消息，分词在写线程上进行，同一批次合并成多行INSERT
+    struct IndexJob {
+        int64_t messageId;
+        int64_t senderId;
+        int64_t receiverId;
+        std::string content;
+    };
+    std::vector<IndexJob> pendingIndex_;
+
+    static constexpr size_t MAX_TOKEN_ROWS = 2000;  // 每条INSERT写入检索表的最大行数
+
+    AsyncDbWriter() : conn_(nullptr), stopping_(false) {}
+    ~AsyncDbWriter();
+
+public:
+    static AsyncDbWriter& getInstance() {
+        static AsyncDbWriter instance;
+        return instance;
+    }
+
+    bool start(const std::string& host,
+               const std::string& database,
+               const std::string& user,
+               const std::string& password);
+    void stop();
+
+    // 提交一条写语句
+    void enqueue(const std::string& sql);
+
+    // 提交用户在线状态变化
+    void updateUserStatus(int64_t userId, bool online);
+
+    // 把已存储的私聊消息写入检索表（message_tokens）
+    void indexMessage(const Message& msg);
+
+private:
+    void run();
+    bool execute(const std::string& sql);
+    void writeTokens(const std::vector<IndexJob>& jobs);
+};
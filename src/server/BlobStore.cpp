@@ -0,0 +1,334 @@
+#include "BlobStore.h"
+#include "DatabaseManager.h"
+#include "FileTransferManager.h"
+#include "Config.h"
+#include "Logger.h"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <sstream>
+#include <vector>
+
+namespace {
+    const char* const BLOB_DIR = "uploads/blobs";
+    const char* const PART_DIR = "uploads/files";
+}
+
+BlobStore::BlobStore()
+    : store_(BLOB_DIR)
+    , conn_(nullptr)
+    , stopping_(false)
+    , ingested_(0)
+    , dedupedFiles_(0)
+    , dedupedBytes_(0)
+    , skippedBytes_(0)
+    , uploadedBytes_(0)
+    , uploadMillis_(0) {
+}
+
+BlobStore::~BlobStore() {
+    stop();
+}
+
+bool BlobStore::start(const std::string& host,
+                      const std::string& database,
+                      const std::string& user,
+                      const std::string& password) {
+    conn_ = mysql_init(nullptr);
+    if (!conn_) {
+        LOG_ERROR("内容库回收连接初始化失败");
+        return false;
+    }
+
+    if (!mysql_real_connect(conn_, host.c_str(), user.c_str(),
+                           password.c_str(), database.c_str(), 0, nullptr, 0)) {
+        LOG_ERROR("内容库回收连接失败: " + std::string(mysql_error(conn_)));
+        mysql_close(conn_);
+        conn_ = nullptr;
+        return false;
+    }
+
+    stopping_ = false;
+    worker_ = std::thread([this]() { run(); });
+    LOG_INFO("内容库回收线程已启动");
+    return true;
+}
+
+void BlobStore::stop() {
+    {
+        std::lock_guard<std::mutex> lock(workerMutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+
+    if (conn_) {
+        mysql_close(conn_);
+        conn_ = nullptr;
+    }
+}
+
+bool BlobStore::exists(const std::string& hash, uint64_t size) {
+    if (!ContentStore::isValidHash(hash)) {
+        return false;
+    }
+
+    MYSQL_RES* result = DatabaseManager::getInstance().executeQueryWithResult(
+        "SELECT size FROM blobs WHERE hash = '" + hash + "'");
+    if (!result) {
+        return false;
+    }
+    MYSQL_ROW row = mysql_fetch_row(result);
+    bool found = row && row[0] && std::stoull(row[0]) == size;
+    mysql_free_result(result);
+    return found && store_.contains(hash);
+}
+
+bool BlobStore::addRef(const std::string& hash) {
+    if (!ContentStore::isValidHash(hash)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    DatabaseManager& db = DatabaseManager::getInstance();
+    if (!db.executeQuery("UPDATE blobs SET ref_count = ref_count + 1, released_at = NULL "
+                         "WHERE hash = '" + hash + "'") ||
+        db.getAffectedRows() != 1) {
+        return false;
+    }
+    if (!store_.contains(hash)) {
+        // 有记录但文件丢失，撤回引用，调用方按普通上传处理
+        LOG_ERROR("内容库文件丢失: " + hash);
+        db.executeQuery(releaseQuery(hash));
+        return false;
+    }
+    return true;
+}
+
+void BlobStore::release(const std::string& hash) {
+    if (ContentStore::isValidHash(hash)) {
+        DatabaseManager::getInstance().executeQuery(releaseQuery(hash));
+    }
+}
+
+bool BlobStore::ingest(const std::string& partPath, const std::string& hash, uint64_t size) {
+    if (!ContentStore::isValidHash(hash)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    DatabaseManager& db = DatabaseManager::getInstance();
+    bool known = db.executeQuery("UPDATE blobs SET ref_count = ref_count + 1, released_at = NULL "
+                                 "WHERE hash = '" + hash + "'") &&
+                 db.getAffectedRows() == 1;
+    if (known && store_.contains(hash)) {
+        std::remove(partPath.c_str());
+        dedupedFiles_ += 1;
+        dedupedBytes_ += size;
+        LOG_INFO("上传的内容已在内容库中，合并为一份: " + hash + "，" + std::to_string(size) + "字节");
+        return true;
+    }
+
+    if (!store_.adopt(partPath, hash)) {
+        LOG_ERROR("文件移入内容库失败: " + partPath);
+        if (known) {
+            db.executeQuery(releaseQuery(hash));
+        }
+        return false;
+    }
+
+    if (!known) {
+        std::stringstream ss;
+        ss << "INSERT INTO blobs (hash, size, ref_count) VALUES ('" << hash << "', " << size << ", 1) "
+           << "ON DUPLICATE KEY UPDATE ref_count = ref_count + 1, released_at = NULL";
+        if (!db.executeQuery(ss.str())) {
+            // 文件已在库中但没有记录，回收线程不会删除它，下次相同内容上传时再登记
+            return false;
+        }
+    }
+    ingested_ += 1;
+    return true;
+}
+
+void BlobStore::recordUpload(uint64_t bytes, double seconds) {
+    uploadedBytes_ += bytes;
+    uploadMillis_ += static_cast<uint64_t>(seconds * 1000);
+}
+
+void BlobStore::recordSkippedUpload(uint64_t bytes) {
+    dedupedFiles_ += 1;
+    dedupedBytes_ += bytes;
+    skippedBytes_ += bytes;
+}
+
+void BlobStore::run() {
+    while (true) {
+        collect();
+
+        std::unique_lock<std::mutex> lock(workerMutex_);
+        cv_.wait_for(lock, std::chrono::seconds(Config::getInstance().getBlobGcInterval()),
+                     [this] { return stopping_; });
+        if (stopping_) {
+            break;
+        }
+    }
+
+    mysql_thread_end();
+    LOG_INFO("内容库回收线程已退出");
+}
+
+void BlobStore::collect() {
+    int retentionDays = Config::getInstance().getFileRetentionDays();
+    if (retentionDays > 0) {
+        expireFiles(retentionDays);
+    }
+    removeReleased(Config::getInstance().getBlobGcGrace());
+    removeStaleParts();
+    logStats();
+}
+
+void BlobStore::expireFiles(int retentionDays) {
+    // 超过保留期的文件删除记录并释放对内容的引用，会话中的文件消息保留，但不能再下载
+    std::stringstream ss;
+    ss << "SELECT file_id, blob_hash FROM file_transfers "
+       << "WHERE created_at < NOW() - INTERVAL " << retentionDays << " DAY LIMIT " << MAX_GC_BATCH;
+    MYSQL_RES* result = query(ss.str());
+    if (!result) {
+        return;
+    }
+
+    std::vector<std::pair<int64_t, std::string>> files;
+    MYSQL_ROW row;
+    while ((row = mysql_fetch_row(result))) {
+        files.emplace_back(std::stoll(row[0]), row[1] ? row[1] : "");
+    }
+    mysql_free_result(result);
+
+    FileTransferManager& manager = FileTransferManager::getInstance();
+    for (const auto& file : files) {
+        if (!execute("DELETE FROM file_transfers WHERE file_id = " + std::to_string(file.first)) ||
+            mysql_affected_rows(conn_) != 1) {
+            continue;
+        }
+        manager.evict(file.first);
+
+        FileTransferManager::FileInfo info;
+        info.fileId = file.first;
+        info.blobHash = file.second;
+        if (ContentStore::isValidHash(info.blobHash)) {
+            execute(releaseQuery(info.blobHash));
+        } else {
+            std::remove(manager.filePath(info).c_str());
+        }
+        std::remove(manager.partPath(info.fileId).c_str());
+    }
+    if (!files.empty()) {
+        LOG_INFO("删除过期文件" + std::to_string(files.size()) + "个");
+    }
+}
+
+void BlobStore::removeReleased(int graceSeconds) {
+    std::stringstream ss;
+    ss << "SELECT hash, size FROM blobs WHERE ref_count <= 0 "
+       << "AND released_at < NOW() - INTERVAL " << graceSeconds << " SECOND LIMIT " << MAX_GC_BATCH;
+    MYSQL_RES* result = query(ss.str());
+    if (!result) {
+        return;
+    }
+
+    std::vector<std::pair<std::string, uint64_t>> candidates;
+    MYSQL_ROW row;
+    while ((row = mysql_fetch_row(result))) {
+        candidates.emplace_back(row[0], std::stoull(row[1]));
+    }
+    mysql_free_result(result);
+
+    // 删除前再检查一次引用数，查询之后被重新引用的内容保留
+    size_t removed = 0;
+    uint64_t freed = 0;
+    for (const auto& candidate : candidates) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (execute("DELETE FROM blobs WHERE hash = '" + candidate.first + "' AND ref_count <= 0") &&
+            mysql_affected_rows(conn_) == 1) {
+            store_.remove(candidate.first);
+            ++removed;
+            freed += candidate.second;
+        }
+    }
+    if (removed > 0) {
+        LOG_INFO("内容库回收" + std::to_string(removed) + "份内容，释放" + std::to_string(freed) + "字节");
+    }
+}
+
+void BlobStore::removeStaleParts() {
+    std::error_code error;
+    auto now = std::filesystem::file_time_type::clock::now();
+    for (const auto& entry : std::filesystem::directory_iterator(PART_DIR, error)) {
+        if (entry.path().extension() != ".part") {
+            continue;
+        }
+        auto modified = entry.last_write_time(error);
+        if (!error && now - modified > std::chrono::seconds(STALE_PART_AGE)) {
+            LOG_INFO("删除放弃的上传: " + entry.path().string());
+            std::filesystem::remove(entry.path(), error);
+        }
+    }
+}
+
+void BlobStore::logStats() {
+    // 内容被引用n次时，去重节省了n-1份的空间
+    MYSQL_RES* result = query("SELECT COUNT(*), COALESCE(SUM(size), 0), "
+                              "COALESCE(SUM(size * GREATEST(ref_count - 1, 0)), 0) "
+                              "FROM blobs WHERE ref_count > 0");
+    if (!result) {
+        return;
+    }
+    MYSQL_ROW row = mysql_fetch_row(result);
+    if (row && row[0] && row[1] && row[2]) {
+        LOG_INFO("内容库: " + std::string(row[0]) + "份内容，占用" + row[1] + "字节，去重节省" +
+                 row[2] + "字节");
+    }
+    mysql_free_result(result);
+
+    // 按实际上传的平均速度估算秒传节省的时间
+    uint64_t skipped = skippedBytes_;
+    uint64_t uploaded = uploadedBytes_;
+    uint64_t millis = uploadMillis_;
+    if (dedupedFiles_ > 0) {
+        std::string saved = skipped > 0 && uploaded > 0 && millis > 0
+            ? "，约节省上传时间" + std::to_string(skipped * millis / uploaded / 1000) + "秒"
+            : "";
+        LOG_INFO("本次运行新存入" + std::to_string(ingested_) + "份内容，重复内容" +
+                 std::to_string(dedupedFiles_) + "个（" + std::to_string(dedupedBytes_) +
+                 "字节），其中秒传跳过" + std::to_string(skipped) + "字节" + saved);
+    }
+}
+
+bool BlobStore::execute(const std::string& sql) {
+    if (mysql_ping(conn_) != 0) {
+        LOG_ERROR("内容库回收连接已断开: " + std::string(mysql_error(conn_)));
+        return false;
+    }
+
+    if (mysql_query(conn_, sql.c_str()) != 0) {
+        LOG_ERROR("内容库回收失败: " + std::string(mysql_error(conn_)) + "\nSQL: " + sql);
+        return false;
+    }
+    return true;
+}
+
+MYSQL_RES* BlobStore::query(const std::string& sql) {
+    if (!execute(sql)) {
+        return nullptr;
+    }
+    return mysql_store_result(conn_);
+}
+
+std::string BlobStore::releaseQuery(const std::string& hash) {
+    // MySQL按顺序执行赋值，released_at看到的是减一之后的引用数
+    return "UPDATE blobs SET ref_count = GREATEST(ref_count - 1, 0), "
+           "released_at = IF(ref_count = 0, NOW(), released_at) WHERE hash = '" + hash + "'";
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#ifdef __linux__
+    #include <mysql/mysql.h>
+#else
+    #include <mysql.h>
+#endif
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+#include "../core/ContentStore.h"
+
+// 聊天文件的内容库
+// 上传完成的文件按SHA-256移入uploads/blobs，blobs表记录每份内容被多少个文件引用；
+// 相同内容再次上传时只增加引用，客户端证明持有文件后可以不传输（秒传）。
+// 引用归零的内容保留一段时间后由后台线程删除，回收线程使用独立的数据库连接
+class BlobStore {
+private:
+    ContentStore store_;
+    // 登记内容与回收删除互斥，避免刚删除数据库记录、还没删除文件时又被引用
+    std::mutex mutex_;
+
+    // 回收线程
+    MYSQL* conn_;
+    std::thread worker_;
+    std::mutex workerMutex_;
+    std::condition_variable cv_;
+    bool stopping_;
+
+    // 本次运行的统计
+    std::atomic<uint64_t> ingested_;       // 上传后新存入的内容数
+    std::atomic<uint64_t> dedupedFiles_;   // 内容已存在的文件数（上传后合并或秒传）
+    std::atomic<uint64_t> dedupedBytes_;
+    std::atomic<uint64_t> skippedBytes_;   // 秒传跳过的上传字节数
+    std::atomic<uint64_t> uploadedBytes_;  // 实际经传输端口收到的字节数
+    std::atomic<uint64_t> uploadMillis_;
+
+    static constexpr int MAX_GC_BATCH = 1000;          // 每轮最多处理的记录数
+    static constexpr long STALE_PART_AGE = 7 * 86400;  // 超过该时间未写入的.part视为放弃的上传
+
+    BlobStore();
+    ~BlobStore();
+
+public:
+    static BlobStore& getInstance() {
+        static BlobStore instance;
+        return instance;
+    }
+
+    bool start(const std::string& host,
+               const std::string& database,
+               const std::string& user,
+               const std::string& password);
+    void stop();
+
+    std::string pathFor(const std::string& hash) const { return store_.pathFor(hash); }
+
+    // 内容库中是否有该哈希且大小一致的内容
+    bool exists(const std::string& hash, uint64_t size);
+
+    // 为已有内容增加一个引用，内容不存在（或已被回收）时返回false
+    bool addRef(const std::string& hash);
+    void release(const std::string& hash);
+
+    // 把上传完成的.part存入内容库并引用一次，内容已存在时删除.part
+    bool ingest(const std::string& partPath, const std::string& hash, uint64_t size);
+
+    void recordUpload(uint64_t bytes, double seconds);
+    void recordSkippedUpload(uint64_t bytes);
+
+private:
+    void run();
+    void collect();
+    void expireFiles(int retentionDays);
+    void removeReleased(int graceSeconds);
+    void removeStaleParts();
+    void logStats();
+
+    bool execute(const std::string& sql);
+    MYSQL_RES* query(const std::string& sql);
+
+    static std::string releaseQuery(const std::string& hash);
+};
@@ -41,6 +41,58 @@ uint16_t Config::getServerPort() const {
     return root_["server"]["port"].asUInt();
 }
 
+uint16_t Config::getFileTransferPort() const {
+    return root_["server"].get("file_port", getServerPort() + 1).asUInt();
+}
+
+uint64_t Config::getMaxFileSize() const {
+    return root_["server"].get("max_file_size", Json::Value::UInt64(4ULL << 30)).asUInt64();
+}
+
+int Config::getFileRetentionDays() const {
+    return root_["server"].get("file_retention_days", 0).asInt();
+}
+
+int Config::getBlobGcInterval() const {
+    return root_["server"].get("blob_gc_interval", 600).asInt();
+}
+
+int Config::getBlobGcGrace() const {
+    return root_["server"].get("blob_gc_grace", 3600).asInt();
+}
+
 std::string Config::getLogFile() const {
     return root_["log"]["file"].asString();
-} 
\ No newline at end of file
+}
+
+bool Config::getRequireEncryption() const {
+    return root_["security"]["require_encryption"].asBool();
+}
+
+std::string Config::getResumeSecret() const {
+    return root_["security"]["resume_secret"].asString();
+}
+
+long Config::getResumeTokenTtl() const {
+    return root_["security"].get("resume_token_ttl", 86400).asInt();
+}
+
+bool Config::getTlsEnabled() const {
+    return root_["tls"]["enabled"].asBool();
+}
+
+std::string Config::getTlsCertFile() const {
+    return root_["tls"]["cert_file"].asString();
+}
+
+std::string Config::getTlsKeyFile() const {
+    return root_["tls"]["key_file"].asString();
+}
+
+long Config::getTlsSessionCacheSize() const {
+    return root_["tls"].get("session_cache_size", 20480).asInt();
+}
+
+long Config::getTlsSessionTimeout() const {
+    return root_["tls"].get("session_timeout", 7200).asInt();
+}
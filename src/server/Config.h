@@ -22,5 +22,20 @@ public:
     std::string getDbUser() const;
     std::string getDbPassword() const;
     uint16_t getServerPort() const;
+    uint16_t getFileTransferPort() const;  // 文件传输端口，默认为聊天端口+1
+    uint64_t getMaxFileSize() const;
+    int getFileRetentionDays() const;  // 文件保留天数，0表示永久保留
+    int getBlobGcInterval() const;     // 内容库回收的间隔（秒）
+    int getBlobGcGrace() const;        // 引用归零后保留的时间（秒），期间再次上传可以直接复用
     std::string getLogFile() const;
+    bool getRequireEncryption() const;
+    std::string getResumeSecret() const;
+    long getResumeTokenTtl() const;
+
+    // TLS
+    bool getTlsEnabled() const;
+    std::string getTlsCertFile() const;
+    std::string getTlsKeyFile() const;
+    long getTlsSessionCacheSize() const;
+    long getTlsSessionTimeout() const;
 }; 
\ No newline at end of file
@@ -0,0 +1,89 @@
+#include "CryptoWorkerPool.h"
+#include "PasswordHasher.h"
+#include "Logger.h"
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <iomanip>
+
+void CryptoWorkerPool::start(size_t threadCount) {
+    if (threadCount == 0) {
+        // 留一个核给IO线程
+        size_t cores = std::thread::hardware_concurrency();
+        threadCount = cores > 1 ? cores - 1 : 1;
+    }
+    threadCount = std::min(threadCount, MAX_WORKERS);
+
+    for (size_t i = 0; i < threadCount; ++i) {
+        workers_.emplace_back(&CryptoWorkerPool::run, this);
+    }
+    LOG_INFO("密码哈希线程池已启动，线程数: " + std::to_string(threadCount));
+
+    benchmark();
+}
+
+void CryptoWorkerPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+
+    for (auto& worker : workers_) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    workers_.clear();
+}
+
+bool CryptoWorkerPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_ || tasks_.size() >= MAX_PENDING_TASKS) {
+            LOG_WARNING("密码哈希队列已满，拒绝请求");
+            return false;
+        }
+        tasks_.push_back(std::move(task));
+    }
+    cv_.notify_one();
+    return true;
+}
+
+void CryptoWorkerPool::run() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this]() { return stopping_ || !tasks_.empty(); });
+            if (stopping_ && tasks_.empty()) {
+                return;
+            }
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+
+        try {
+            task();
+        } catch (const std::exception& e) {
+            LOG_ERROR("密码哈希任务异常: " + std::string(e.what()));
+        }
+    }
+}
+
+void CryptoWorkerPool::benchmark() {
+    // 启动时测一次哈希耗时，估算当前参数下每秒可处理的登录数；
+    // 测的就是不存在用户所用的固定哈希，避免第一次这样的登录多算一次
+    auto begin = std::chrono::steady_clock::now();
+    PasswordHasher::dummyHash();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    if (seconds <= 0) {
+        return;
+    }
+
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(1)
+       << "密码哈希耗时 " << seconds * 1000 << " ms，估计每秒可处理 "
+       << workers_.size() / seconds << " 次登录";
+    LOG_INFO(ss.str());
+}
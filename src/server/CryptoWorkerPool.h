@@ -0,0 +1,44 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// 密码哈希工作线程池
+// 登录和注册的哈希计算在这里执行，不占用IO线程；等待队列有上限，
+// 登录风暴时新请求直接被拒绝，聊天消息的处理不受影响
+class CryptoWorkerPool {
+private:
+    static CryptoWorkerPool instance_;
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::function<void()>> tasks_;
+    bool stopping_;
+
+    static constexpr size_t MAX_PENDING_TASKS = 64;  // 等待队列上限
+    static constexpr size_t MAX_WORKERS = 4;         // scrypt每次约16MB内存，限制并发数
+
+    CryptoWorkerPool() : stopping_(false) {}
+
+public:
+    static CryptoWorkerPool& getInstance() {
+        static CryptoWorkerPool instance;
+        return instance;
+    }
+
+    // 启动工作线程，threadCount为0时按CPU核数选择
+    void start(size_t threadCount = 0);
+    void stop();
+
+    // 提交任务，队列已满时返回false，调用方应让客户端稍后重试
+    bool submit(std::function<void()> task);
+
+private:
+    void run();
+    void benchmark();
+};
@@ -3,7 +3,6 @@
 #include <sstream>
 #include <iostream>
 #include <iomanip>
-#include <openssl/evp.h>
 
 DatabaseManager::~DatabaseManager() {
     if (conn_) {
@@ -45,103 +44,34 @@ bool DatabaseManager::storeMessage(const Message& msg) {
     return executeQuery(ss.str());
 }
 
-bool DatabaseManager::authenticateUser(const std::string& username,
-                                     const std::string& password,
-                                     int64_t& userId) {
-    LOG_INFO("验证用户登录 - 用户名: " + username);
-    
-    // 对密码进行哈希
-    std::string passwordHash = hashPassword(password);
-    LOG_INFO("密码哈希值: " + passwordHash);
-
-    // 转义用户名以防SQL注入
-    char escaped_username[username.length() * 2 + 1];
-    mysql_real_escape_string(conn_, escaped_username, username.c_str(), username.length());
-
+bool DatabaseManager::getPasswordHash(const std::string& username,
+                                      int64_t& userId,
+                                      std::string& passwordHash) {
     std::stringstream ss;
     ss << "SELECT user_id, password_hash FROM users WHERE username = '" 
-       << escaped_username << "'";
+       << escapeString(username) << "'";
     
-    LOG_INFO("执行SQL: " + ss.str());
-    
-    MYSQL_RES* result = nullptr;
-    if (mysql_query(conn_, ss.str().c_str()) != 0) {
-        LOG_ERROR("认证查询失败: " + std::string(mysql_error(conn_)));
-        return false;
-    }
-
-    result = mysql_store_result(conn_);
+    MYSQL_RES* result = executeQueryWithResult(ss.str());
     if (!result) {
-        LOG_ERROR("获取认证结果失败: " + std::string(mysql_error(conn_)));
+        LOG_ERROR("认证查询失败");
         return false;
     }
 
     MYSQL_ROW row = mysql_fetch_row(result);
-    if (row) {
-        std::string storedHash = row[1];
-        LOG_INFO("数据库中的密码哈希: " + storedHash);
-        
-        if (storedHash == passwordHash) {
-            userId = std::stoll(row[0]);
-            mysql_free_result(result);
-            LOG_INFO("密码验证成功，用户ID: " + std::to_string(userId));
-            return true;
-        } else {
-            LOG_WARNING("密码不匹配");
-        }
+    bool found = (row && row[1]);
+    if (found) {
+        userId = std::stoll(row[0]);
+        passwordHash = row[1];
     } else {
         LOG_WARNING("用户名不存在: " + username);
     }
 
     mysql_free_result(result);
-    return false;
+    return found;
 }
 
-std::string DatabaseManager::hashPassword(const std::string& password) {
-    unsigned char hash[EVP_MAX_MD_SIZE];
-    unsigned int hashLen;
-
-    // 使用新的EVP接口
-    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
-    if (!ctx) {
-        LOG_ERROR("创建EVP上下文失败");
-        return "";
-    }
-
-    if (EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr) != 1) {
-        LOG_ERROR("初始化SHA256失败");
-        EVP_MD_CTX_free(ctx);
-        return "";
-    }
-
-    if (EVP_DigestUpdate(ctx, password.c_str(), password.length()) != 1) {
-        LOG_ERROR("更新哈希数据失败");
-        EVP_MD_CTX_free(ctx);
-        return "";
-    }
-
-    if (EVP_DigestFinal_ex(ctx, hash, &hashLen) != 1) {
-        LOG_ERROR("生成最终哈希失败");
-        EVP_MD_CTX_free(ctx);
-        return "";
-    }
-
-    EVP_MD_CTX_free(ctx);
-
-    // 转换为十六进制字符串
-    std::stringstream ss;
-    for(unsigned int i = 0; i < hashLen; i++) {
-        ss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(hash[i]);
-    }
-    
-    std::string result = ss.str();
-    LOG_INFO("生成密码哈希: " + result);
-    return result;
-}
 
 bool DatabaseManager::executeQuery(const std::string& query) {
-    LOG_INFO("执行SQL: " + query);
-    
     if (!conn_) {
         LOG_ERROR("数据库连接初始化");
         return false;
@@ -157,11 +87,10 @@ bool DatabaseManager::executeQuery(const std::string& query) {
     }
     
     if (mysql_query(conn_, query.c_str()) != 0) {
-        LOG_ERROR("执行查询失败: " + std::string(mysql_error(conn_)) + "\nSQL: " + query);
+        LOG_ERROR("执行" + statementType(query) + "失败: " + std::string(mysql_error(conn_)));
         return false;
     }
     
-    LOG_INFO("SQL执行成功");
     return true;
 }
 
@@ -178,13 +107,17 @@ bool DatabaseManager::updateUserStatus(int64_t userId, bool online) {
     return false;
 }
 
-std::vector<Message> DatabaseManager::getOfflineMessages(int64_t userId) {
+std::vector<Message> DatabaseManager::getOfflineMessages(int64_t userId, int64_t afterMessageId, int limit) {
     std::vector<Message> messages;
     std::stringstream ss;
     
-    ss << "SELECT msg_id, sender_id, receiver_id, content, msg_type, send_time "
+    ss << "SELECT msg_id, sender_id, receiver_id, content, msg_type, UNIX_TIMESTAMP(send_time) "
        << "FROM messages WHERE receiver_id = " << userId
-       << " AND status = 0 ORDER BY send_time ASC";
+       << " AND status = 0 AND msg_id > " << afterMessageId
+       << " ORDER BY msg_id ASC";
+    if (limit > 0) {
+        ss << " LIMIT " << limit;
+    }
 
     if (mysql_query(conn_, ss.str().c_str()) != 0) {
         LOG_ERROR("获取离线消息失败: " + std::string(mysql_error(conn_)));
@@ -198,24 +131,91 @@ std::vector<Message> DatabaseManager::getOfflineMessages(int64_t userId) {
     }
 
     MYSQL_ROW row;
-    int messageCount = 0;
     while ((row = mysql_fetch_row(result))) {
         // 构造Message对象并添加到vector中
         Message msg(
             std::stoll(row[1]),  // sender_id
             std::stoll(row[2]),  // receiver_id
-            row[3],              // content
+            row[3] ? row[3] : "",  // content
             static_cast<MessageType>(std::stoi(row[4]))  // msg_type
         );
+        msg.setMessageId(std::stoll(row[0]));
+        if (row[5]) {
+            msg.setTimestamp(static_cast<std::time_t>(std::stoll(row[5])));
+        }
         messages.push_back(msg);
-        messageCount++;
     }
 
     mysql_free_result(result);
-    LOG_INFO("获取到 " + std::to_string(messageCount) + " 条离线消息");
+    LOG_INFO("获取到 " + std::to_string(messages.size()) + " 条离线消息");
     return messages;
 }
 
+std::unordered_map<int64_t, int> DatabaseManager::getUnreadCounts(int64_t userId) {
+    std::unordered_map<int64_t, int> counts;
+    std::stringstream ss;
+    ss << "SELECT m.sender_id, COUNT(*) FROM messages m "
+       << "LEFT JOIN read_markers r ON r.user_id = " << userId << " AND r.peer_id = m.sender_id "
+       << "WHERE m.receiver_id = " << userId
+       << " AND m.msg_id > COALESCE(r.last_read_msg_id, 0) GROUP BY m.sender_id";
+
+    MYSQL_RES* result = executeQueryWithResult(ss.str());
+    if (!result) {
+        return counts;
+    }
+
+    MYSQL_ROW row;
+    while ((row = mysql_fetch_row(result))) {
+        if (row[0]) {
+            counts[std::stoll(row[0])] = std::stoi(row[1]);
+        }
+    }
+
+    mysql_free_result(result);
+    return counts;
+}
+
+bool DatabaseManager::markMessagesDelivered(int64_t receiverId, const std::vector<int64_t>& messageIds) {
+    if (messageIds.empty()) {
+        return true;
+    }
+
+    // 一次更新一批确认，限定接收方防止客户端确认他人的消息
+    std::stringstream ss;
+    ss << "UPDATE messages SET status = 1 WHERE receiver_id = " << receiverId
+       << " AND msg_id IN (";
+    for (size_t i = 0; i < messageIds.size(); ++i) {
+        if (i > 0) ss << ", ";
+        ss << messageIds[i];
+    }
+    ss << ")";
+
+    return executeQuery(ss.str());
+}
+
+bool DatabaseManager::markMessagesDeliveredUpTo(int64_t receiverId, int64_t lastMessageId) {
+    std::stringstream ss;
+    ss << "UPDATE messages SET status = 1 WHERE receiver_id = " << receiverId
+       << " AND status = 0 AND msg_id <= " << lastMessageId;
+    return executeQuery(ss.str());
+}
+
+std::string DatabaseManager::escapeString(const std::string& value) {
+    std::string escaped(value.length() * 2 + 1, '\0');
+    unsigned long length = mysql_real_escape_string(conn_, &escaped[0], value.c_str(), value.length());
+    escaped.resize(length);
+    return escaped;
+}
+
+std::string DatabaseManager::statementType(const std::string& query) {
+    size_t begin = query.find_first_not_of(" \t\r\n");
+    if (begin == std::string::npos) {
+        return "";
+    }
+    size_t end = query.find_first_of(" \t\r\n", begin);
+    return query.substr(begin, end == std::string::npos ? std::string::npos : end - begin);
+}
+
 MYSQL_RES* DatabaseManager::executeQueryWithResult(const std::string& query) {
     if (mysql_query(conn_, query.c_str()) != 0) {
         LOG_ERROR("执行查询失败: " + std::string(mysql_error(conn_)));
@@ -228,5 +228,20 @@ MYSQL_RES* DatabaseManager::executeQueryWithResult(const std::string& query) {
         return nullptr;
     }
     
+    return result;
+}
+
+MYSQL_RES* DatabaseManager::executeQueryStreaming(const std::string& query) {
+    if (mysql_query(conn_, query.c_str()) != 0) {
+        LOG_ERROR("执行查询失败: " + std::string(mysql_error(conn_)));
+        return nullptr;
+    }
+
+    MYSQL_RES* result = mysql_use_result(conn_);
+    if (!result) {
+        LOG_ERROR("读取结果集失败: " + std::string(mysql_error(conn_)));
+        return nullptr;
+    }
+
     return result;
 } 
\ No newline at end of file
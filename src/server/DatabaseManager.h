@@ -9,6 +9,7 @@
 #include <string>
 #include <memory>
 #include <vector>
+#include <unordered_map>
 #include "../core/Message.h"
 #include "UserManager.h"
 #include "Logger.h"
@@ -38,18 +39,34 @@ public:
                    const std::string& password);
 
     bool storeMessage(const Message& msg);
-    bool authenticateUser(const std::string& username, 
-                         const std::string& password,
-                         int64_t& userId);
+    // 读取用户的密码哈希，校验在CryptoWorkerPool中进行
+    bool getPasswordHash(const std::string& username,
+                         int64_t& userId,
+                         std::string& passwordHash);
     bool updateUserStatus(int64_t userId, bool online);
-    std::vector<Message> getOfflineMessages(int64_t userId);
+
+    // 获取未确认送达的消息（status = 0），afterMessageId之后最多limit条，limit为0表示不限
+    std::vector<Message> getOfflineMessages(int64_t userId, int64_t afterMessageId = 0, int limit = 0);
+
+    // 按发送方统计未读消息数：ID大于该会话已读标记的收到的消息
+    std::unordered_map<int64_t, int> getUnreadCounts(int64_t userId);
+
+    // 将接收方已确认的消息标记为已送达
+    bool markMessagesDelivered(int64_t receiverId, const std::vector<int64_t>& messageIds);
+    // 会话恢复时客户端报告的最后一条消息及之前的消息都标记为已送达
+    bool markMessagesDeliveredUpTo(int64_t receiverId, int64_t lastMessageId);
+
     bool executeQuery(const std::string& query);
+    int64_t getLastInsertId() { return static_cast<int64_t>(mysql_insert_id(conn_)); }
+    uint64_t getAffectedRows() { return static_cast<uint64_t>(mysql_affected_rows(conn_)); }
+    std::string escapeString(const std::string& value);
+    // SQL的语句类型（INSERT、UPDATE等），日志只记录这一部分，SQL中可能带有密码哈希
+    static std::string statementType(const std::string& query);
 
     MYSQL_RES* executeQueryWithResult(const std::string& query);
+    // 逐行读取结果（mysql_use_result），用于大结果集，读完前不能执行其他查询
+    MYSQL_RES* executeQueryStreaming(const std::string& query);
     std::string getLastError() const { return mysql_error(conn_); }
 
     MYSQL* getConnection() { return conn_; }
-
-private:
-    std::string hashPassword(const std::string& password);
 }; 
\ No newline at end of file
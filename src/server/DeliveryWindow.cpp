@@ -0,0 +1,42 @@
+#include "DeliveryWindow.h"
+
+bool DeliveryWindow::track(int64_t messageId) {
+    if (full()) {
+        return false;
+    }
+
+    // 首次使用时才分配环形缓冲区
+    if (ring_.empty()) {
+        ring_.assign(CAPACITY, 0);
+    }
+
+    slot(nextSeq_++) = messageId;
+    if (messageId > lastTrackedId_) {
+        lastTrackedId_ = messageId;
+    }
+    return true;
+}
+
+bool DeliveryWindow::ack(int64_t messageId) {
+    // 确认通常按发送顺序到达，从最早的未确认序号开始查找
+    for (uint32_t seq = ackedSeq_; seq != nextSeq_; ++seq) {
+        if (slot(seq) == messageId) {
+            slot(seq) = 0;
+
+            // 推进窗口左边界，跳过所有已确认的槽位
+            while (ackedSeq_ != nextSeq_ && slot(ackedSeq_) == 0) {
+                ++ackedSeq_;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void DeliveryWindow::clear() {
+    ring_.clear();
+    ring_.shrink_to_fit();
+    nextSeq_ = 0;
+    ackedSeq_ = 0;
+    lastTrackedId_ = 0;
+}
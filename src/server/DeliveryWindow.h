@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// 单个会话的未确认消息窗口
+// 以序号环记录已发出但客户端尚未确认的消息ID，消息正文保存在数据库中，
+// 需要重传时按ID重新读取，因此每个连接只占用少量内存
+class DeliveryWindow {
+public:
+    static constexpr uint32_t CAPACITY = 256;  // 必须是2的幂
+
+    // 登记一条已发送未确认的消息，窗口已满时返回false
+    bool track(int64_t messageId);
+
+    // 确认一条消息，返回该消息是否在窗口内
+    bool ack(int64_t messageId);
+
+    bool full() const { return inFlight() >= CAPACITY; }
+    bool empty() const { return inFlight() == 0; }
+    uint32_t inFlight() const { return nextSeq_ - ackedSeq_; }
+    uint32_t available() const { return CAPACITY - inFlight(); }
+
+    // 最近一次登记的消息ID，用于从数据库续取积压消息
+    int64_t lastTrackedId() const { return lastTrackedId_; }
+
+    void clear();
+
+private:
+    std::vector<int64_t> ring_;  // 0表示该槽位已确认
+    uint32_t nextSeq_ = 0;       // 下一个写入的序号
+    uint32_t ackedSeq_ = 0;      // 最早一个未确认的序号
+    int64_t lastTrackedId_ = 0;
+
+    int64_t& slot(uint32_t seq) { return ring_[seq & (CAPACITY - 1)]; }
+};
@@ -0,0 +1,217 @@
+#include "FileTransferManager.h"
+#include "DatabaseManager.h"
+#include "MessageManager.h"
+#include "BlobStore.h"
+#include "Server.h"
+#include "Logger.h"
+#include "../core/HexCodec.h"
+#include <openssl/rand.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <sstream>
+
+namespace {
+    const char* const FILE_DIR = "uploads/files";
+}
+
+bool FileTransferManager::createFile(FileInfo& info) {
+    std::stringstream ss;
+    ss << "INSERT INTO file_transfers (uploader_id, receiver_id, file_name, file_size, msg_type, "
+       << "complete, blob_hash) VALUES ("
+       << info.uploaderId << ", "
+       << info.receiverId << ", '"
+       << DatabaseManager::getInstance().escapeString(info.fileName) << "', "
+       << info.fileSize << ", "
+       << static_cast<int>(info.type) << ", "
+       << (info.complete ? 1 : 0) << ", ";
+    if (info.blobHash.empty()) {
+        ss << "NULL)";
+    } else {
+        ss << "'" << DatabaseManager::getInstance().escapeString(info.blobHash) << "')";
+    }
+    if (!DatabaseManager::getInstance().executeQuery(ss.str())) {
+        LOG_ERROR("登记文件失败: " + info.fileName);
+        return false;
+    }
+
+    info.fileId = DatabaseManager::getInstance().getLastInsertId();
+
+    std::error_code error;
+    std::filesystem::create_directories(FILE_DIR, error);
+    cacheFile(info);
+    LOG_INFO("登记文件 " + std::to_string(info.fileId) + ": " + info.fileName +
+             "，" + std::to_string(info.fileSize) + "字节");
+    return true;
+}
+
+bool FileTransferManager::getFile(int64_t fileId, FileInfo& info) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = files_.find(fileId);
+        if (it != files_.end()) {
+            info = it->second;
+            return true;
+        }
+    }
+
+    std::stringstream ss;
+    ss << "SELECT file_id, uploader_id, receiver_id, file_name, file_size, msg_type, complete, blob_hash "
+       << "FROM file_transfers WHERE file_id = " << fileId;
+    MYSQL_RES* result = DatabaseManager::getInstance().executeQueryWithResult(ss.str());
+    if (!result) {
+        return false;
+    }
+
+    MYSQL_ROW row = mysql_fetch_row(result);
+    bool found = row != nullptr;
+    if (found) {
+        info.fileId = std::stoll(row[0]);
+        info.uploaderId = row[1] ? std::stoll(row[1]) : 0;
+        info.receiverId = row[2] ? std::stoll(row[2]) : 0;
+        info.fileName = row[3] ? row[3] : "";
+        info.fileSize = std::stoull(row[4]);
+        info.type = static_cast<MessageType>(std::stoi(row[5]));
+        info.complete = row[6] && std::stoi(row[6]) != 0;
+        info.blobHash = row[7] ? row[7] : "";
+    }
+    mysql_free_result(result);
+
+    if (found) {
+        cacheFile(info);
+    }
+    return found;
+}
+
+std::string FileTransferManager::issueTicket(int64_t fileId, int64_t userId,
+                                             FileTransfer::Direction direction) {
+    unsigned char bytes[FileTransfer::TICKET_LENGTH / 2];
+    if (RAND_bytes(bytes, sizeof(bytes)) != 1) {
+        LOG_ERROR("生成文件传输票据失败");
+        return "";
+    }
+
+    std::string ticket = HexCodec::encode(bytes, sizeof(bytes));
+
+    std::time_t now = std::time(nullptr);
+    std::lock_guard<std::mutex> lock(mutex_);
+    pruneTickets(now);
+    tickets_[ticket] = Ticket{fileId, userId, direction, now + TICKET_TTL};
+    return ticket;
+}
+
+bool FileTransferManager::redeemTicket(const std::string& ticket, int64_t fileId,
+                                       FileTransfer::Direction direction, int64_t& userId) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = tickets_.find(ticket);
+    if (it == tickets_.end()) {
+        return false;
+    }
+    const Ticket& entry = it->second;
+    if (entry.expires < std::time(nullptr)) {
+        tickets_.erase(it);
+        return false;
+    }
+    if (entry.fileId != fileId || entry.direction != direction) {
+        return false;
+    }
+    userId = entry.userId;
+    // 票据只能使用一次，续传时客户端在聊天连接上重新申请
+    tickets_.erase(it);
+    return true;
+}
+
+uint64_t FileTransferManager::confirmedOffset(const FileInfo& info) const {
+    if (info.complete) {
+        return info.fileSize;
+    }
+
+    // 最后一块可能只写了一部分，从最后一个完整的块边界续传
+    struct stat st;
+    if (::stat(partPath(info.fileId).c_str(), &st) != 0) {
+        return 0;
+    }
+    uint64_t size = std::min<uint64_t>(static_cast<uint64_t>(st.st_size), info.fileSize);
+    if (size == info.fileSize) {
+        return size;
+    }
+    return size - size % FileTransfer::CHUNK_SIZE;
+}
+
+int64_t FileTransferManager::completeUpload(FileInfo& info, const std::string& hash) {
+    if (!BlobStore::getInstance().ingest(partPath(info.fileId), hash, info.fileSize)) {
+        LOG_ERROR("文件存入内容库失败: " + std::to_string(info.fileId));
+        return 0;
+    }
+
+    std::stringstream ss;
+    ss << "UPDATE file_transfers SET complete = 1, blob_hash = '" << hash
+       << "' WHERE file_id = " << info.fileId;
+    DatabaseManager::getInstance().executeQuery(ss.str());
+    info.complete = true;
+    info.blobHash = hash;
+    cacheFile(info);
+    return publishFile(info);
+}
+
+int64_t FileTransferManager::publishFile(const FileInfo& info) {
+    // 文件以一条消息的形式出现在会话中，正文只是文件的描述，接收方凭fileId下载
+    Json::Value content;
+    content["fileId"] = Json::Value::Int64(info.fileId);
+    content["fileName"] = info.fileName;
+    content["fileSize"] = Json::Value::UInt64(info.fileSize);
+    Json::FastWriter writer;
+    Message msg(info.uploaderId, info.receiverId, writer.write(content), info.type);
+    if (!MessageManager::getInstance().storeMessage(msg)) {
+        return 0;
+    }
+
+    auto receiverSession = Server::getInstance().getSession(info.receiverId);
+    if (receiverSession && receiverSession->isAlive()) {
+        receiverSession->deliverChat(msg);
+    }
+    // 上传方收到的只是回显，不经过发送窗口；客户端不确认它，也不计入会话恢复的位置
+    auto uploaderSession = Server::getInstance().getSession(info.uploaderId);
+    if (uploaderSession && uploaderSession->isAlive()) {
+        uploaderSession->sendMessage(msg);
+    }
+
+    LOG_INFO("文件 " + std::to_string(info.fileId) + " 已发送，消息ID: " +
+             std::to_string(msg.getMessageId()));
+    return msg.getMessageId();
+}
+
+void FileTransferManager::evict(int64_t fileId) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    files_.erase(fileId);
+}
+
+std::string FileTransferManager::partPath(int64_t fileId) const {
+    return std::string(FILE_DIR) + "/" + std::to_string(fileId) + ".part";
+}
+
+std::string FileTransferManager::filePath(const FileInfo& info) const {
+    if (!info.blobHash.empty()) {
+        return BlobStore::getInstance().pathFor(info.blobHash);
+    }
+    return std::string(FILE_DIR) + "/" + std::to_string(info.fileId);
+}
+
+void FileTransferManager::cacheFile(const FileInfo& info) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (files_.size() >= MAX_CACHED_FILES && files_.find(info.fileId) == files_.end()) {
+        files_.clear();  // 元数据随时可以从数据库重新读取
+    }
+    files_[info.fileId] = info;
+}
+
+void FileTransferManager::pruneTickets(std::time_t now) {
+    for (auto it = tickets_.begin(); it != tickets_.end();) {
+        if (it->second.expires < now) {
+            it = tickets_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <string>
+#include <mutex>
+#include <ctime>
+#include <cstdint>
+#include <unordered_map>
+#include "../core/Message.h"
+#include "../core/FileTransferProtocol.h"
+
+// 文件传输的元数据和票据
+// 聊天连接上的请求通过权限检查后登记文件并签发票据，客户端凭票据连接传输端口；
+// 文件内容按块写入uploads/files/<fileId>.part，收齐后按哈希移入内容库（BlobStore），
+// 并作为FILE/IMAGE消息发给接收方
+class FileTransferManager {
+public:
+    struct FileInfo {
+        int64_t fileId = 0;
+        int64_t uploaderId = 0;
+        int64_t receiverId = 0;
+        std::string fileName;
+        uint64_t fileSize = 0;
+        MessageType type = MessageType::FILE;
+        bool complete = false;
+        std::string blobHash;  // 内容库中的SHA-256，为空表示旧版保存在uploads/files/<fileId>
+    };
+
+    static constexpr long TICKET_TTL = 600;          // 票据有效期（秒），有效期内可多次用于续传
+    static constexpr size_t MAX_CACHED_FILES = 4096;  // 元数据缓存上限
+
+    static FileTransferManager& getInstance() {
+        static FileTransferManager instance;
+        return instance;
+    }
+
+    // 登记新文件，成功后写回数据库分配的fileId；秒传时info已带有blobHash并标记完成
+    bool createFile(FileInfo& info);
+
+    // 按ID查找文件，先查缓存再查数据库
+    bool getFile(int64_t fileId, FileInfo& info);
+
+    // 为用户签发访问某个文件的票据（十六进制），失败时返回空串
+    std::string issueTicket(int64_t fileId, int64_t userId, FileTransfer::Direction direction);
+
+    // 校验票据，有效时取出签发给的用户并作废该票据
+    bool redeemTicket(const std::string& ticket, int64_t fileId,
+                      FileTransfer::Direction direction, int64_t& userId);
+
+    // 已收到并可以续传的字节数：.part文件的大小按块大小向下取整
+    uint64_t confirmedOffset(const FileInfo& info) const;
+
+    // 上传收齐：按内容哈希存入内容库，存储文件消息并投递给接收方，返回消息ID（失败为0）
+    int64_t completeUpload(FileInfo& info, const std::string& hash);
+
+    // 存储文件消息并投递给接收方和上传者的其他连接，返回消息ID（失败为0）
+    int64_t publishFile(const FileInfo& info);
+
+    // 文件记录被删除后从缓存中移除
+    void evict(int64_t fileId);
+
+    std::string partPath(int64_t fileId) const;
+    std::string filePath(const FileInfo& info) const;
+
+private:
+    struct Ticket {
+        int64_t fileId;
+        int64_t userId;
+        FileTransfer::Direction direction;
+        std::time_t expires;
+    };
+
+    std::mutex mutex_;
+    std::unordered_map<std::string, Ticket> tickets_;
+    std::unordered_map<int64_t, FileInfo> files_;
+
+    FileTransferManager() {}
+
+    void cacheFile(const FileInfo& info);
+    void pruneTickets(std::time_t now);
+};
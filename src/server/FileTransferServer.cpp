@@ -0,0 +1,54 @@
+#include "FileTransferServer.h"
+#include "Logger.h"
+
+FileTransferServer::FileTransferServer(boost::asio::io_context& io_context, uint16_t port)
+    : io_context_(io_context)
+    , acceptor_(io_context, boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), port))
+    , diskPool_(DISK_THREADS) {
+}
+
+void FileTransferServer::start() {
+    LOG_INFO("文件传输服务启动在端口: " + std::to_string(acceptor_.local_endpoint().port()));
+    startAccept();
+}
+
+void FileTransferServer::startAccept() {
+    auto session = std::make_shared<FileTransferSession>(boost::asio::ip::tcp::socket(io_context_), *this);
+    acceptor_.async_accept(session->socket_,
+        [this, session](const boost::system::error_code& error) {
+            if (error) {
+                LOG_ERROR("接受文件传输连接失败: " + error.message());
+                return;
+            }
+
+            // 大块数据传输，放大内核缓冲区减少窗口等待
+            boost::system::error_code ignored;
+            session->socket_.set_option(boost::asio::socket_base::receive_buffer_size(4 * 1024 * 1024), ignored);
+            session->socket_.set_option(boost::asio::socket_base::send_buffer_size(4 * 1024 * 1024), ignored);
+            session->start();
+            startAccept();
+        });
+}
+
+void FileTransferServer::claimUpload(int64_t fileId, const std::shared_ptr<FileTransferSession>& session) {
+    auto it = uploads_.find(fileId);
+    if (it != uploads_.end()) {
+        auto previous = it->second.lock();
+        if (previous && previous != session) {
+            LOG_INFO("文件 " + std::to_string(fileId) + " 有新的上传连接，关闭旧连接");
+            previous->close();
+        }
+    }
+    uploads_[fileId] = session;
+}
+
+void FileTransferServer::releaseUpload(int64_t fileId, const FileTransferSession* session) {
+    auto it = uploads_.find(fileId);
+    if (it == uploads_.end()) {
+        return;
+    }
+    auto current = it->second.lock();
+    if (!current || current.get() == session) {
+        uploads_.erase(it);
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <unordered_map>
+#include <memory>
+#include "FileTransferSession.h"
+
+// 文件传输端口，与聊天服务共用io_context，只接受凭票据建立的传输连接
+class FileTransferServer {
+private:
+    boost::asio::io_context& io_context_;
+    boost::asio::ip::tcp::acceptor acceptor_;
+
+    // 正在上传的文件到其连接，仅在IO线程访问
+    std::unordered_map<int64_t, std::weak_ptr<FileTransferSession>> uploads_;
+
+    // 文件块的读写和上传完成时的落盘在这里执行，不占用IO线程
+    boost::asio::thread_pool diskPool_;
+
+    static constexpr size_t DISK_THREADS = 4;
+
+public:
+    FileTransferServer(boost::asio::io_context& io_context, uint16_t port);
+
+    void start();
+
+    boost::asio::thread_pool& diskPool() { return diskPool_; }
+
+    // 登记文件的上传连接，同一文件已有的连接会被关闭，避免两条连接同时写入
+    void claimUpload(int64_t fileId, const std::shared_ptr<FileTransferSession>& session);
+
+    // 仅当登记的连接就是session时才移除
+    void releaseUpload(int64_t fileId, const FileTransferSession* session);
+
+private:
+    void startAccept();
+};
@@ -0,0 +1,450 @@
+#include "FileTransferSession.h"
+#include "FileTransferServer.h"
+#include "BlobStore.h"
+#include "Logger.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+FileTransferSession::FileTransferSession(boost::asio::ip::tcp::socket socket, FileTransferServer& server)
+    : socket_(std::move(socket))
+    , server_(server)
+    , idleTimer_(socket_.get_executor())
+    , closed_(false)
+    , userId_(0)
+    , fd_(-1)
+    , writing_(false)
+    , closeAfterWrite_(false)
+    , expectedOffset_(0)
+    , unackedChunks_(0)
+    , nakPending_(false)
+    , hashedOffset_(0)
+    , sendOffset_(0)
+    , peerAcked_(0)
+    , startOffset_(0) {
+}
+
+FileTransferSession::~FileTransferSession() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+void FileTransferSession::start() {
+    touch();
+    readHello();
+}
+
+void FileTransferSession::close() {
+    if (closed_) {
+        return;
+    }
+    closed_ = true;
+    idleTimer_.cancel();
+    boost::system::error_code ignored;
+    socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored);
+    socket_.close(ignored);
+    if (hello_.direction == FileTransfer::UPLOAD && file_.fileId != 0) {
+        server_.releaseUpload(file_.fileId, this);
+    }
+}
+
+void FileTransferSession::runOnDisk(std::function<bool()> work, std::function<void(bool)> done) {
+    auto self(shared_from_this());
+    boost::asio::post(server_.diskPool(), [this, self, work = std::move(work), done = std::move(done)]() {
+        bool ok = work();
+        boost::asio::post(socket_.get_executor(), [this, self, ok, done]() {
+            if (!closed_) {
+                done(ok);
+            }
+        });
+    });
+}
+
+void FileTransferSession::touch() {
+    // 每次读到数据都重新计时，对方停止发送超过IDLE_TIMEOUT就断开
+    auto self(shared_from_this());
+    idleTimer_.expires_after(std::chrono::seconds(IDLE_TIMEOUT));
+    idleTimer_.async_wait([this, self](const boost::system::error_code& error) {
+        if (!error && !closed_) {
+            LOG_WARNING("文件传输连接空闲超时");
+            close();
+        }
+    });
+}
+
+void FileTransferSession::readHello() {
+    auto self(shared_from_this());
+    std::memset(&hello_, 0, sizeof(hello_));
+    boost::asio::async_read(socket_, boost::asio::buffer(&hello_, sizeof(hello_)),
+        [this, self](const boost::system::error_code& error, size_t) {
+            if (error) {
+                close();
+                return;
+            }
+            touch();
+            handleHello();
+        });
+}
+
+void FileTransferSession::handleHello() {
+    if (hello_.magic != FileTransfer::MAGIC || hello_.version != FileTransfer::VERSION) {
+        LOG_WARNING("文件传输握手格式错误");
+        close();
+        return;
+    }
+
+    auto direction = static_cast<FileTransfer::Direction>(hello_.direction);
+    std::string ticket(hello_.ticket, FileTransfer::TICKET_LENGTH);
+    if ((direction != FileTransfer::UPLOAD && direction != FileTransfer::DOWNLOAD) ||
+        !FileTransferManager::getInstance().redeemTicket(ticket, hello_.fileId, direction, userId_) ||
+        !FileTransferManager::getInstance().getFile(hello_.fileId, file_)) {
+        LOG_WARNING("文件传输票据无效，文件: " + std::to_string(hello_.fileId));
+        file_.fileId = 0;
+        sendReply(FileTransfer::STATUS_BAD_TICKET, 0);
+        closeAfterWrite_ = true;
+        return;
+    }
+
+    chunkBuffer_.resize(FileTransfer::CHUNK_SIZE);
+    startTime_ = std::chrono::steady_clock::now();
+    if (direction == FileTransfer::UPLOAD) {
+        startUpload();
+    } else {
+        startDownload();
+    }
+}
+
+void FileTransferSession::sendReply(FileTransfer::ReplyStatus status, uint64_t offset) {
+    FileTransfer::TransferReply reply{};
+    reply.status = status;
+    reply.chunkSize = FileTransfer::CHUNK_SIZE;
+    reply.fileSize = file_.fileSize;
+    reply.offset = offset;
+    controlQueue_.emplace_back(reinterpret_cast<const char*>(&reply), sizeof(reply));
+    pump();
+}
+
+void FileTransferSession::sendAck(FileTransfer::AckType type, uint64_t offset) {
+    FileTransfer::ChunkAck ack{};
+    ack.type = type;
+    ack.offset = offset;
+    controlQueue_.emplace_back(reinterpret_cast<const char*>(&ack), sizeof(ack));
+    pump();
+}
+
+void FileTransferSession::pump() {
+    if (writing_ || closed_) {
+        return;
+    }
+
+    auto self(shared_from_this());
+    auto onWritten = [this, self](const boost::system::error_code& error, size_t) {
+        writing_ = false;
+        if (error) {
+            close();
+            return;
+        }
+        pump();
+    };
+
+    // 控制消息优先，下载时在窗口允许的范围内继续发送数据块
+    if (!controlQueue_.empty()) {
+        writingControl_.swap(controlQueue_.front());
+        controlQueue_.pop_front();
+        writing_ = true;
+        boost::asio::async_write(socket_, boost::asio::buffer(writingControl_), onWritten);
+        return;
+    }
+
+    if (closeAfterWrite_) {
+        close();
+        return;
+    }
+
+    if (hello_.direction != FileTransfer::DOWNLOAD || fd_ < 0 ||
+        sendOffset_ >= file_.fileSize ||
+        sendOffset_ - peerAcked_ >= static_cast<uint64_t>(FileTransfer::WINDOW_CHUNKS) * FileTransfer::CHUNK_SIZE) {
+        return;
+    }
+
+    uint32_t length = static_cast<uint32_t>(
+        std::min<uint64_t>(FileTransfer::CHUNK_SIZE, file_.fileSize - sendOffset_));
+    uint64_t offset = sendOffset_;
+    sendOffset_ += length;
+
+    // 读盘期间writing_保持为true，新的控制消息在队列中等待这一块发出
+    writing_ = true;
+    int fd = fd_;
+    runOnDisk([this, fd, offset, length]() {
+        if (::pread(fd, chunkBuffer_.data(), length, static_cast<off_t>(offset)) !=
+            static_cast<ssize_t>(length)) {
+            return false;
+        }
+        chunkHeader_.offset = offset;
+        chunkHeader_.length = length;
+        chunkHeader_.crc = FileTransfer::checksum(chunkBuffer_.data(), length);
+        return true;
+    }, [this, length, onWritten](bool ok) {
+        if (!ok) {
+            LOG_ERROR("读取文件失败: " + std::to_string(file_.fileId));
+            close();
+            return;
+        }
+        std::vector<boost::asio::const_buffer> buffers = {
+            boost::asio::buffer(&chunkHeader_, sizeof(chunkHeader_)),
+            boost::asio::buffer(chunkBuffer_.data(), length)
+        };
+        boost::asio::async_write(socket_, buffers, onWritten);
+    });
+}
+
+void FileTransferSession::startUpload() {
+    if (userId_ != file_.uploaderId) {
+        sendReply(FileTransfer::STATUS_BAD_TICKET, 0);
+        closeAfterWrite_ = true;
+        return;
+    }
+    if (file_.complete) {
+        // 已经上传完成的文件不再接收数据
+        sendReply(FileTransfer::STATUS_OK, file_.fileSize);
+        sendAck(FileTransfer::DONE, 0);
+        closeAfterWrite_ = true;
+        return;
+    }
+
+    // 同一文件只保留最新的上传连接，断线重连时旧连接可能还没有被发现断开；
+    // 旧连接可能还有一块在磁盘线程上写入，写的是同一位置的相同内容，不影响续传
+    server_.claimUpload(file_.fileId, shared_from_this());
+
+    fd_ = ::open(FileTransferManager::getInstance().partPath(file_.fileId).c_str(), O_RDWR | O_CREAT, 0644);
+    expectedOffset_ = FileTransferManager::getInstance().confirmedOffset(file_);
+    if (fd_ < 0 || ::ftruncate(fd_, static_cast<off_t>(expectedOffset_)) != 0) {
+        LOG_ERROR("打开上传文件失败: " + std::to_string(file_.fileId));
+        sendReply(FileTransfer::STATUS_IO_ERROR, 0);
+        closeAfterWrite_ = true;
+        return;
+    }
+    hashReceived();
+}
+
+void FileTransferSession::hashReceived() {
+    // 续传时先补算已收到部分的哈希，每次只读一块，连接关闭后不再继续
+    if (hashedOffset_ < expectedOffset_) {
+        uint32_t length = static_cast<uint32_t>(
+            std::min<uint64_t>(FileTransfer::CHUNK_SIZE, expectedOffset_ - hashedOffset_));
+        uint64_t offset = hashedOffset_;
+        int fd = fd_;
+        runOnDisk([this, fd, offset, length]() {
+            if (::pread(fd, chunkBuffer_.data(), length, static_cast<off_t>(offset)) !=
+                static_cast<ssize_t>(length)) {
+                return false;
+            }
+            hasher_.update(chunkBuffer_.data(), length);
+            return true;
+        }, [this, length](bool ok) {
+            if (!ok) {
+                LOG_ERROR("读取已上传的部分失败: " + std::to_string(file_.fileId));
+                sendReply(FileTransfer::STATUS_IO_ERROR, 0);
+                closeAfterWrite_ = true;
+                return;
+            }
+            hashedOffset_ += length;
+            hashReceived();
+        });
+        return;
+    }
+
+    startOffset_ = expectedOffset_;
+    LOG_INFO("开始接收文件 " + std::to_string(file_.fileId) + "，从 " +
+             std::to_string(expectedOffset_) + " 字节续传");
+    sendReply(FileTransfer::STATUS_OK, expectedOffset_);
+    if (expectedOffset_ == file_.fileSize) {
+        finishUpload();
+        return;
+    }
+    readChunkHeader();
+}
+
+void FileTransferSession::readChunkHeader() {
+    auto self(shared_from_this());
+    boost::asio::async_read(socket_, boost::asio::buffer(&chunkHeader_, sizeof(chunkHeader_)),
+        [this, self](const boost::system::error_code& error, size_t) {
+            if (error) {
+                close();
+                return;
+            }
+            if (chunkHeader_.length == 0 || chunkHeader_.length > FileTransfer::CHUNK_SIZE ||
+                chunkHeader_.offset > file_.fileSize ||
+                chunkHeader_.length > file_.fileSize - chunkHeader_.offset) {
+                LOG_WARNING("文件块越界，关闭连接");
+                close();
+                return;
+            }
+            boost::asio::async_read(socket_, boost::asio::buffer(chunkBuffer_.data(), chunkHeader_.length),
+                [this, self](const boost::system::error_code& error, size_t) {
+                    if (error) {
+                        close();
+                        return;
+                    }
+                    touch();
+                    handleChunk();
+                });
+        });
+}
+
+void FileTransferSession::handleChunk() {
+    if (chunkHeader_.offset == expectedOffset_) {
+        if (FileTransfer::checksum(chunkBuffer_.data(), chunkHeader_.length) != chunkHeader_.crc) {
+            // 重发的块也可能再次出错，按顺序等待的块校验失败时总是要求重发
+            LOG_WARNING("文件块校验失败，位置: " + std::to_string(chunkHeader_.offset));
+            sendAck(FileTransfer::NAK, expectedOffset_);
+            nakPending_ = true;
+        } else {
+            // 写盘和累计哈希完成后才读取下一块
+            uint32_t length = chunkHeader_.length;
+            uint64_t offset = chunkHeader_.offset;
+            int fd = fd_;
+            runOnDisk([this, fd, offset, length]() {
+                if (::pwrite(fd, chunkBuffer_.data(), length, static_cast<off_t>(offset)) !=
+                    static_cast<ssize_t>(length)) {
+                    return false;
+                }
+                hasher_.update(chunkBuffer_.data(), length);
+                return true;
+            }, [this, length](bool ok) {
+                if (!ok) {
+                    LOG_ERROR("写入文件失败: " + std::to_string(file_.fileId));
+                    close();
+                    return;
+                }
+                expectedOffset_ += length;
+                nakPending_ = false;
+                if (expectedOffset_ == file_.fileSize) {
+                    finishUpload();
+                    return;
+                }
+                if (++unackedChunks_ >= FileTransfer::ACK_INTERVAL) {
+                    unackedChunks_ = 0;
+                    sendAck(FileTransfer::ACK, expectedOffset_);
+                }
+                readChunkHeader();
+            });
+            return;
+        }
+    } else if (chunkHeader_.offset > expectedOffset_ && !nakPending_) {
+        // 中间缺了块，之后到达的块都丢弃，等发送方从缺口处重发（回退N）
+        sendAck(FileTransfer::NAK, expectedOffset_);
+        nakPending_ = true;
+    }
+    // 位置小于expectedOffset_的是重发造成的重复块，直接丢弃
+    readChunkHeader();
+}
+
+void FileTransferSession::finishUpload() {
+    // 落盘后再公布文件，接收方下载时不会读到缺失的数据。大文件落盘可能要几秒以上，
+    // 在磁盘线程上进行；期间对方不再发送数据，停掉空闲计时
+    idleTimer_.cancel();
+    int fd = fd_;
+    fd_ = -1;
+    std::string hash = hasher_.finish();
+    runOnDisk([fd]() {
+        bool synced = ::fdatasync(fd) == 0;
+        ::close(fd);
+        return synced;
+    }, [this, hash](bool synced) {
+        if (!synced) {
+            // 不公布文件，客户端重连后从.part续传并重新完成
+            LOG_ERROR("上传的文件落盘失败: " + std::to_string(file_.fileId));
+            close();
+            return;
+        }
+
+        uint64_t received = expectedOffset_ - startOffset_;
+        BlobStore::getInstance().recordUpload(received, logThroughput("接收", received));
+        int64_t messageId = FileTransferManager::getInstance().completeUpload(file_, hash);
+        if (messageId == 0) {
+            close();
+            return;
+        }
+        sendAck(FileTransfer::DONE, static_cast<uint64_t>(messageId));
+        closeAfterWrite_ = true;
+    });
+}
+
+void FileTransferSession::startDownload() {
+    if (!file_.complete || (userId_ != file_.receiverId && userId_ != file_.uploaderId)) {
+        sendReply(FileTransfer::STATUS_BAD_TICKET, 0);
+        closeAfterWrite_ = true;
+        return;
+    }
+
+    fd_ = ::open(FileTransferManager::getInstance().filePath(file_).c_str(), O_RDONLY);
+    if (fd_ < 0) {
+        LOG_ERROR("打开下载文件失败: " + std::to_string(file_.fileId));
+        sendReply(FileTransfer::STATUS_IO_ERROR, 0);
+        closeAfterWrite_ = true;
+        return;
+    }
+
+    // 客户端已有的部分按块边界对齐后跳过
+    uint64_t offset = std::min<uint64_t>(hello_.offset, file_.fileSize);
+    if (offset < file_.fileSize) {
+        offset -= offset % FileTransfer::CHUNK_SIZE;
+    }
+    sendOffset_ = offset;
+    peerAcked_ = offset;
+    startOffset_ = offset;
+    LOG_INFO("开始发送文件 " + std::to_string(file_.fileId) + "，从 " + std::to_string(offset) + " 字节");
+    sendReply(FileTransfer::STATUS_OK, offset);
+    readPeerAck();
+}
+
+void FileTransferSession::readPeerAck() {
+    auto self(shared_from_this());
+    boost::asio::async_read(socket_, boost::asio::buffer(&peerAck_, sizeof(peerAck_)),
+        [this, self](const boost::system::error_code& error, size_t) {
+            if (error) {
+                close();
+                return;
+            }
+            touch();
+            handlePeerAck();
+        });
+}
+
+void FileTransferSession::handlePeerAck() {
+    uint64_t offset = std::min<uint64_t>(peerAck_.offset, file_.fileSize);
+    switch (peerAck_.type) {
+        case FileTransfer::ACK:
+            peerAcked_ = std::max(peerAcked_, offset);
+            break;
+        case FileTransfer::NAK:
+            // NAK同时确认了offset之前的数据，从offset处重发
+            peerAcked_ = std::max(peerAcked_, offset);
+            if (peerAcked_ < sendOffset_) {
+                sendOffset_ = peerAcked_;
+            }
+            break;
+        case FileTransfer::DONE:
+            logThroughput("发送", file_.fileSize - startOffset_);
+            close();
+            return;
+        default:
+            LOG_WARNING("未知的文件传输确认类型");
+            close();
+            return;
+    }
+    pump();
+    readPeerAck();
+}
+
+double FileTransferSession::logThroughput(const std::string& what, uint64_t bytes) {
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime_).count();
+    double mbps = seconds > 0 ? bytes / seconds / (1024 * 1024) : 0;
+    LOG_INFO("文件 " + std::to_string(file_.fileId) + " " + what + "完成: " +
+             std::to_string(bytes) + "字节，" + std::to_string(static_cast<int>(seconds * 1000)) +
+             "毫秒，" + std::to_string(static_cast<int>(mbps)) + "MB/s");
+    return seconds;
+}
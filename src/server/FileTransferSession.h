@@ -0,0 +1,90 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../core/FileTransferProtocol.h"
+#include "../core/ContentStore.h"
+#include "FileTransferManager.h"
+
+class FileTransferServer;
+
+// 传输端口上的一条连接，只传一个文件的一个方向
+// 上传：按顺序写入校验通过的块并累计内容哈希，每ACK_INTERVAL块回一次累计确认，缺块或校验失败时回NAK；
+// 下载：最多WINDOW_CHUNKS块在途，收到NAK时从该位置重发。
+// 任何时候只在内存中保留一个块，文件直接在磁盘上读写；读写在传输服务的磁盘线程上执行，
+// 同一连接同时最多只有一个磁盘操作，完成前不会再读写chunkBuffer_
+class FileTransferSession : public std::enable_shared_from_this<FileTransferSession> {
+public:
+    boost::asio::ip::tcp::socket socket_;
+
+    FileTransferSession(boost::asio::ip::tcp::socket socket, FileTransferServer& server);
+    ~FileTransferSession();
+
+    void start();
+    void close();
+
+private:
+    FileTransferServer& server_;
+    boost::asio::steady_timer idleTimer_;
+    bool closed_;
+
+    FileTransfer::TransferHello hello_;
+    int64_t userId_;  // 票据签发给的用户
+    FileTransferManager::FileInfo file_;
+    int fd_;
+
+    // 控制消息（应答、确认）的待写队列；数据块和控制消息共用一个写出状态
+    std::deque<std::string> controlQueue_;
+    std::string writingControl_;
+    bool writing_;
+    bool closeAfterWrite_;  // 写完队列中的控制消息后关闭连接
+
+    FileTransfer::ChunkHeader chunkHeader_;
+    std::vector<char> chunkBuffer_;  // 当前块的数据，只占一块的内存
+
+    // 上传
+    uint64_t expectedOffset_;  // 下一个按顺序写入的位置
+    uint32_t unackedChunks_;   // 上次确认之后写入的块数
+    bool nakPending_;          // 已要求重发，等待expectedOffset_处的块
+    ContentStore::Hasher hasher_;  // 已写入部分的SHA-256，收齐后据此存入内容库
+    uint64_t hashedOffset_;        // 续传时已补算哈希的位置
+
+    // 下载
+    FileTransfer::ChunkAck peerAck_;
+    uint64_t sendOffset_;      // 下一个要发送的位置
+    uint64_t peerAcked_;       // 对方确认收到的位置
+
+    // 统计
+    uint64_t startOffset_;
+    std::chrono::steady_clock::time_point startTime_;
+
+    static constexpr int IDLE_TIMEOUT = 60;  // 秒，期间没有读到任何数据则断开
+
+    // work在磁盘线程上执行，结果回到IO线程交给done；连接已关闭时不再调用done
+    void runOnDisk(std::function<bool()> work, std::function<void(bool)> done);
+
+    void touch();
+    void readHello();
+    void handleHello();
+    void sendReply(FileTransfer::ReplyStatus status, uint64_t offset);
+    void sendAck(FileTransfer::AckType type, uint64_t offset);
+    void pump();
+
+    void startUpload();
+    void hashReceived();
+    void readChunkHeader();
+    void handleChunk();
+    void finishUpload();
+
+    void startDownload();
+    void readPeerAck();
+    void handlePeerAck();
+
+    // 返回本次传输的秒数
+    double logThroughput(const std::string& what, uint64_t bytes);
+};
@@ -0,0 +1,13 @@
+#include "Frame.h"
+
+Frame::Frame(const std::string& payload) {
+    uint32_t length = payload.length();
+    data_.reserve(sizeof(length) + payload.length());
+    data_.append(reinterpret_cast<const char*>(&length), sizeof(length));
+    data_.append(payload);
+}
+
+FramePtr Frame::encode(const Message& msg) {
+    Json::FastWriter writer;
+    return std::make_shared<const Frame>(writer.write(msg.toJson()));
+}
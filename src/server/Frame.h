@@ -0,0 +1,23 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include "../core/Message.h"
+
+// 编码完成的消息帧（4字节长度头 + JSON正文）
+// 创建后不可修改，发给多个接收者时只序列化一次，各会话共享同一份数据
+class Frame {
+private:
+    std::string data_;
+
+public:
+    explicit Frame(const std::string& payload);
+
+    static std::shared_ptr<const Frame> encode(const Message& msg);
+
+    const std::string& data() const { return data_; }
+    size_t size() const { return data_.size(); }
+    size_t payloadSize() const { return data_.size() - sizeof(uint32_t); }
+};
+
+using FramePtr = std::shared_ptr<const Frame>;
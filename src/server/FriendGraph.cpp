@@ -0,0 +1,239 @@
+#include "FriendGraph.h"
+#include "DatabaseManager.h"
+#include "Logger.h"
+#include <algorithm>
+#include <mutex>
+#include <sstream>
+#include <iomanip>
+
+bool FriendGraph::load() {
+    LOG_INFO("加载好友关系图");
+
+    // 按 (user_id, friend_id) 排序流式读取，边读边构建CSR，不需要先把结果集整体放进内存
+    MYSQL_RES* result = DatabaseManager::getInstance().executeQueryStreaming(
+        "SELECT user_id, friend_id FROM friendships WHERE status = 1 "
+        "ORDER BY user_id, friend_id");
+    if (!result) {
+        return false;
+    }
+
+    std::vector<uint32_t> offsets{0};
+    std::vector<uint32_t> neighbours;
+    bool overflow = false;
+
+    MYSQL_ROW row;
+    while ((row = mysql_fetch_row(result))) {
+        if (overflow) {
+            continue;  // 读完剩余行，连接才能继续使用
+        }
+
+        int64_t userId = std::stoll(row[0]);
+        int64_t friendId = std::stoll(row[1]);
+        if (!fitsIndex(userId) || !fitsIndex(friendId) || neighbours.size() >= UINT32_MAX) {
+            overflow = true;
+            continue;
+        }
+
+        // offsets[userId] 为该用户区间的起点，中间没有好友的用户区间为空
+        while (offsets.size() <= static_cast<size_t>(userId)) {
+            offsets.push_back(static_cast<uint32_t>(neighbours.size()));
+        }
+        neighbours.push_back(static_cast<uint32_t>(friendId));
+    }
+    mysql_free_result(result);
+
+    if (overflow) {
+        LOG_WARNING("用户ID超出32位范围，好友关系检查改为查询数据库");
+        return false;
+    }
+
+    offsets.push_back(static_cast<uint32_t>(neighbours.size()));
+    offsets.shrink_to_fit();
+    neighbours.shrink_to_fit();
+
+    std::unique_lock<std::shared_mutex> lock(graphMutex_);
+    offsets_.swap(offsets);
+    neighbours_.swap(neighbours);
+    addedEdges_.clear();
+    removedEdges_.clear();
+    loaded_ = true;
+    logMemoryUsage();
+    return true;
+}
+
+bool FriendGraph::isLoaded() const {
+    std::shared_lock<std::shared_mutex> lock(graphMutex_);
+    return loaded_;
+}
+
+bool FriendGraph::lookup(int64_t userId1, int64_t userId2, bool& areFriends) const {
+    if (!fitsIndex(userId1) || !fitsIndex(userId2)) {
+        return false;
+    }
+
+    std::shared_lock<std::shared_mutex> lock(graphMutex_);
+    if (!loaded_) {
+        return false;
+    }
+
+    uint64_t key = edgeKey(userId1, userId2);
+    if (addedEdges_.count(key)) {
+        areFriends = true;
+    } else if (removedEdges_.count(key)) {
+        areFriends = false;
+    } else {
+        areFriends = inBase(static_cast<uint32_t>(userId1), static_cast<uint32_t>(userId2));
+    }
+    return true;
+}
+
+bool FriendGraph::friendsOf(int64_t userId, std::vector<int64_t>& friends) const {
+    if (!fitsIndex(userId)) {
+        return false;
+    }
+
+    std::shared_lock<std::shared_mutex> lock(graphMutex_);
+    if (!loaded_) {
+        return false;
+    }
+
+    uint32_t from = static_cast<uint32_t>(userId);
+    if (static_cast<size_t>(from) + 1 < offsets_.size()) {
+        for (uint32_t i = offsets_[from]; i < offsets_[from + 1]; ++i) {
+            if (!removedEdges_.count(edgeKey(from, neighbours_[i]))) {
+                friends.push_back(neighbours_[i]);
+            }
+        }
+    }
+    // 增量最多COMPACT_THRESHOLD条，直接遍历
+    for (uint64_t key : addedEdges_) {
+        if ((key >> 32) == from) {
+            friends.push_back(static_cast<uint32_t>(key));
+        }
+    }
+    return true;
+}
+
+void FriendGraph::addFriendship(int64_t userId1, int64_t userId2) {
+    std::unique_lock<std::shared_mutex> lock(graphMutex_);
+    if (!loaded_) {
+        return;
+    }
+    addEdge(userId1, userId2);
+    addEdge(userId2, userId1);
+    if (addedEdges_.size() + removedEdges_.size() >= COMPACT_THRESHOLD) {
+        compact();
+    }
+}
+
+void FriendGraph::removeFriendship(int64_t userId1, int64_t userId2) {
+    std::unique_lock<std::shared_mutex> lock(graphMutex_);
+    if (!loaded_) {
+        return;
+    }
+    removeEdge(userId1, userId2);
+    removeEdge(userId2, userId1);
+    if (addedEdges_.size() + removedEdges_.size() >= COMPACT_THRESHOLD) {
+        compact();
+    }
+}
+
+bool FriendGraph::inBase(uint32_t from, uint32_t to) const {
+    if (static_cast<size_t>(from) + 1 >= offsets_.size()) {
+        return false;
+    }
+    auto begin = neighbours_.begin() + offsets_[from];
+    auto end = neighbours_.begin() + offsets_[from + 1];
+    return std::binary_search(begin, end, to);
+}
+
+void FriendGraph::addEdge(int64_t from, int64_t to) {
+    if (!fitsIndex(from) || !fitsIndex(to)) {
+        return;  // 查询这类用户时不会走关系图
+    }
+    uint64_t key = edgeKey(from, to);
+    if (inBase(static_cast<uint32_t>(from), static_cast<uint32_t>(to))) {
+        removedEdges_.erase(key);
+    } else {
+        addedEdges_.insert(key);
+    }
+}
+
+void FriendGraph::removeEdge(int64_t from, int64_t to) {
+    if (!fitsIndex(from) || !fitsIndex(to)) {
+        return;
+    }
+    uint64_t key = edgeKey(from, to);
+    if (inBase(static_cast<uint32_t>(from), static_cast<uint32_t>(to))) {
+        removedEdges_.insert(key);
+    } else {
+        addedEdges_.erase(key);
+    }
+}
+
+void FriendGraph::compact() {
+    // 新增的边按 (用户, 好友) 排序后与原有区间逐行归并
+    std::vector<uint64_t> added(addedEdges_.begin(), addedEdges_.end());
+    std::sort(added.begin(), added.end());
+
+    size_t rowCount = offsets_.size() - 1;
+    if (!added.empty()) {
+        rowCount = std::max(rowCount, static_cast<size_t>(added.back() >> 32) + 1);
+    }
+
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> neighbours;
+    offsets.reserve(rowCount + 1);
+    neighbours.reserve(neighbours_.size() + added.size() - removedEdges_.size());
+
+    auto next = added.begin();
+    std::vector<uint32_t> kept;
+    for (size_t u = 0; u < rowCount; ++u) {
+        offsets.push_back(static_cast<uint32_t>(neighbours.size()));
+
+        kept.clear();
+        if (u + 1 < offsets_.size()) {
+            for (uint32_t i = offsets_[u]; i < offsets_[u + 1]; ++i) {
+                if (!removedEdges_.count(edgeKey(u, neighbours_[i]))) {
+                    kept.push_back(neighbours_[i]);
+                }
+            }
+        }
+
+        auto rowEnd = next;
+        while (rowEnd != added.end() && (*rowEnd >> 32) == u) {
+            ++rowEnd;
+        }
+
+        size_t start = neighbours.size();
+        neighbours.insert(neighbours.end(), kept.begin(), kept.end());
+        for (auto it = next; it != rowEnd; ++it) {
+            neighbours.push_back(static_cast<uint32_t>(*it));
+        }
+        std::inplace_merge(neighbours.begin() + start,
+                           neighbours.begin() + start + kept.size(),
+                           neighbours.end());
+        next = rowEnd;
+    }
+    offsets.push_back(static_cast<uint32_t>(neighbours.size()));
+
+    offsets_.swap(offsets);
+    neighbours_.swap(neighbours);
+    addedEdges_.clear();
+    removedEdges_.clear();
+    logMemoryUsage();
+}
+
+void FriendGraph::logMemoryUsage() const {
+    size_t edges = neighbours_.size();
+    size_t bytes = (offsets_.capacity() + neighbours_.capacity()) * sizeof(uint32_t);
+
+    std::stringstream ss;
+    ss << "好友关系图: " << (offsets_.size() - 1) << " 个用户, " << edges << " 条边, "
+       << bytes / 1024 << " KB";
+    if (edges > 0) {
+        ss << ", 每条边 " << std::fixed << std::setprecision(2)
+           << static_cast<double>(bytes) / edges << " 字节";
+    }
+    LOG_INFO(ss.str());
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <vector>
+#include <unordered_set>
+#include <shared_mutex>
+#include <cstdint>
+
+// 内存中的好友关系图（压缩稀疏行格式）
+// offsets_[u]..offsets_[u+1] 是用户u的好友在neighbours_中的区间，区间内有序，
+// 查询用二分查找。运行期的增删先记录在增量集合中，积累到一定数量后合并回CSR
+class FriendGraph {
+private:
+    static FriendGraph instance_;
+    mutable std::shared_mutex graphMutex_;
+
+    std::vector<uint32_t> offsets_;
+    std::vector<uint32_t> neighbours_;
+
+    // 尚未合并的增量，键为 (用户ID << 32) | 好友ID
+    std::unordered_set<uint64_t> addedEdges_;
+    std::unordered_set<uint64_t> removedEdges_;
+
+    bool loaded_;
+
+    static constexpr size_t COMPACT_THRESHOLD = 4096;  // 增量达到该数量时合并
+
+    FriendGraph() : loaded_(false) {}
+
+public:
+    static FriendGraph& getInstance() {
+        static FriendGraph instance;
+        return instance;
+    }
+
+    // 从friendships表流式加载全部好友关系
+    bool load();
+
+    bool isLoaded() const;
+
+    // 查询userId1的好友中是否有userId2，关系图无法回答（未加载或ID超出32位）时返回false
+    bool lookup(int64_t userId1, int64_t userId2, bool& areFriends) const;
+
+    // 列出userId的全部好友，关系图无法回答时返回false
+    bool friendsOf(int64_t userId, std::vector<int64_t>& friends) const;
+
+    // 双向添加或删除好友关系
+    void addFriendship(int64_t userId1, int64_t userId2);
+    void removeFriendship(int64_t userId1, int64_t userId2);
+
+private:
+    static bool fitsIndex(int64_t userId) { return userId >= 0 && userId <= UINT32_MAX; }
+    static uint64_t edgeKey(int64_t from, int64_t to) {
+        return (static_cast<uint64_t>(from) << 32) | static_cast<uint32_t>(to);
+    }
+
+    bool inBase(uint32_t from, uint32_t to) const;
+    void addEdge(int64_t from, int64_t to);
+    void removeEdge(int64_t from, int64_t to);
+
+    // 把增量合并进CSR（调用方持有写锁）
+    void compact();
+    void logMemoryUsage() const;
+};
@@ -1,14 +1,140 @@
 #include "FriendManager.h"
+#include "UserManager.h"
+#include "FriendGraph.h"
 
-std::vector<std::shared_ptr<User>> FriendManager::getFriendList(int64_t userId) {
-    std::lock_guard<std::mutex> lock(friendsMutex_);
-    
-    // 如果缓存中没有，从数据库加载
-    if (friendsMap_.find(userId) == friendsMap_.end()) {
-        loadFriendList(userId);
+void FriendManager::FriendList::add(int64_t userId, const std::string& username,
+                                     const std::string& nickname) {
+    FriendRecord record;
+    record.userId = userId;
+    record.usernameOffset = static_cast<uint32_t>(names.size());
+    record.usernameLength = static_cast<uint32_t>(username.size());
+    names += username;
+    if (nickname == username) {
+        // 昵称与用户名相同时共用同一段字符
+        record.nicknameOffset = record.usernameOffset;
+        record.nicknameLength = record.usernameLength;
+    } else {
+        record.nicknameOffset = static_cast<uint32_t>(names.size());
+        record.nicknameLength = static_cast<uint32_t>(nickname.size());
+        names += nickname;
+    }
+    records.push_back(record);
+}
+
+bool FriendManager::FriendList::contains(int64_t userId) const {
+    for (const auto& record : records) {
+        if (record.userId == userId) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void FriendManager::FriendList::updateVersion() {
+    // 每条记录单独做FNV-1a哈希再混合，各记录的结果相加，与记录顺序无关
+    uint64_t sum = records.size();
+    for (const auto& record : records) {
+        uint64_t h = 14695981039346656037ULL;
+        auto mix = [&h](const char* data, size_t length) {
+            for (size_t i = 0; i < length; ++i) {
+                h = (h ^ static_cast<unsigned char>(data[i])) * 1099511628211ULL;
+            }
+        };
+        mix(reinterpret_cast<const char*>(&record.userId), sizeof(record.userId));
+        std::string_view name = username(record);
+        std::string_view nick = nickname(record);
+        mix(name.data(), name.size());
+        mix("", 1);
+        mix(nick.data(), nick.size());
+
+        // splitmix64收尾，避免相加时低位相互抵消
+        h ^= h >> 30; h *= 0xbf58476d1ce4e5b9ULL;
+        h ^= h >> 27; h *= 0x94d049bb133111ebULL;
+        h ^= h >> 31;
+        sum += h;
+    }
+    version = sum == 0 ? 1 : sum;  // 0表示客户端没有缓存的版本
+}
+
+FriendManager::FriendListPtr FriendManager::getCachedFriendList(int64_t userId) {
+    Shard& shard = shardFor(userId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.entries.find(userId);
+    if (it == shard.entries.end() ||
+        std::chrono::steady_clock::now() - it->second.loadedAt >= std::chrono::seconds(CACHE_TTL_SECONDS)) {
+        return nullptr;
+    }
+    return it->second.friends;
+}
+
+FriendManager::FriendListPtr FriendManager::getFriendList(int64_t userId) {
+    Shard& shard = shardFor(userId);
+    std::unique_lock<std::mutex> lock(shard.mutex);
+
+    auto it = shard.entries.find(userId);
+    if (it != shard.entries.end()) {
+        auto age = std::chrono::steady_clock::now() - it->second.loadedAt;
+        if (age < std::chrono::seconds(CACHE_TTL_SECONDS)) {
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second.lruPos);
+            return it->second.friends;
+        }
+        // 已过期，重新加载
+        shard.lru.erase(it->second.lruPos);
+        shard.entries.erase(it);
+    }
+
+    // 已有线程在加载同一用户，等待它的结果
+    auto loading = shard.loading.find(userId);
+    if (loading != shard.loading.end()) {
+        std::shared_future<FriendListPtr> future = loading->second;
+        lock.unlock();
+        return future.get();
+    }
+
+    std::promise<FriendListPtr> promise;
+    shard.loading[userId] = promise.get_future().share();
+    lock.unlock();
+
+    // 查询数据库时不持有分片锁；加载抛出异常时按加载失败处理，
+    // 保证loading中的条目被移除，等待同一用户的线程也能拿到结果
+    FriendListPtr friends;
+    try {
+        friends = loadFriendList(userId);
+    } catch (const std::exception& e) {
+        LOG_ERROR("加载好友列表异常 - 用户" + std::to_string(userId) + ": " + e.what());
+    }
+
+    lock.lock();
+    shard.loading.erase(userId);
+    if (shard.staleLoads.erase(userId) == 0 && friends) {
+        insertEntry(shard, userId, friends);
+    }
+    lock.unlock();
+
+    if (!friends) {
+        auto empty = std::make_shared<FriendList>();
+        empty->updateVersion();
+        friends = empty;
+    }
+    promise.set_value(friends);
+    return friends;
+}
+
+void FriendManager::insertEntry(Shard& shard, int64_t userId, FriendListPtr friends) {
+    auto it = shard.entries.find(userId);
+    if (it != shard.entries.end()) {
+        shard.lru.erase(it->second.lruPos);
+        shard.entries.erase(it);
+    }
+
+    shard.lru.push_front(userId);
+    shard.entries[userId] = CacheEntry{friends, std::chrono::steady_clock::now(), shard.lru.begin()};
+
+    // 超出容量时淘汰最久未使用的条目
+    while (shard.entries.size() > MAX_ENTRIES_PER_SHARD) {
+        shard.entries.erase(shard.lru.back());
+        shard.lru.pop_back();
     }
-    
-    return friendsMap_[userId];
 }
 
 bool FriendManager::sendFriendRequest(int64_t fromUserId, int64_t toUserId) {
@@ -39,24 +165,42 @@ bool FriendManager::handleFriendRequest(int64_t fromUserId, int64_t toUserId, bo
     LOG_INFO("处理好友请求: " + std::to_string(fromUserId) + " -> " + 
              std::to_string(toUserId) + (accept ? " 接受" : " 拒绝"));
     
+    // 只能处理发给自己、尚未处理的请求（status = 0），没有这样的请求时不建立任何关系
     std::stringstream ss;
     ss << "UPDATE friendships SET status = " << (accept ? "1" : "2")
        << " WHERE user_id = " << fromUserId 
-       << " AND friend_id = " << toUserId;
+       << " AND friend_id = " << toUserId
+       << " AND status = 0";
        
-    bool success = DatabaseManager::getInstance().executeQuery(ss.str());
+    bool success = DatabaseManager::getInstance().executeQuery(ss.str()) &&
+                   DatabaseManager::getInstance().getAffectedRows() == 1;
+    if (!success) {
+        LOG_WARNING("没有待处理的好友请求: " + std::to_string(fromUserId) + " -> " +
+                    std::to_string(toUserId));
+        return false;
+    }
     
-    if (success && accept) {
-        // 如果接受，创建双向好友关系
+    if (accept) {
+        // 如果接受，创建双向好友关系（对方也发过请求时直接更新状态）
         ss.str("");
         ss << "INSERT INTO friendships (user_id, friend_id, status) VALUES ("
-           << toUserId << ", " << fromUserId << ", 1)";
+           << toUserId << ", " << fromUserId << ", 1) "
+           << "ON DUPLICATE KEY UPDATE status = 1";
         success = DatabaseManager::getInstance().executeQuery(ss.str());
         
         if (success) {
-            // 更新缓存
-            updateFriendCache(fromUserId);
-            updateFriendCache(toUserId);
+            FriendGraph::getInstance().addFriendship(fromUserId, toUserId);
+
+            // 增量更新双方已缓存的好友列表
+            auto fromUser = UserManager::getInstance().getUser(fromUserId);
+            auto toUser = UserManager::getInstance().getUser(toUserId);
+            if (fromUser && toUser) {
+                addToCache(fromUserId, *toUser);
+                addToCache(toUserId, *fromUser);
+            } else {
+                removeFromCache(fromUserId, toUserId);
+                removeFromCache(toUserId, fromUserId);
+            }
         }
     }
     
@@ -64,6 +208,11 @@ bool FriendManager::handleFriendRequest(int64_t fromUserId, int64_t toUserId, bo
 }
 
 bool FriendManager::areFriends(int64_t userId1, int64_t userId2) {
+    bool friends = false;
+    if (FriendGraph::getInstance().lookup(userId1, userId2, friends)) {
+        return friends;
+    }
+
     std::stringstream ss;
     ss << "SELECT COUNT(*) FROM friendships WHERE "
        << "user_id = " << userId1 
@@ -80,64 +229,106 @@ bool FriendManager::areFriends(int64_t userId1, int64_t userId2) {
     return areFriends;
 }
 
-void FriendManager::loadFriendList(int64_t userId) {
+bool FriendManager::removeFriend(int64_t userId1, int64_t userId2) {
+    LOG_INFO("删除好友: " + std::to_string(userId1) + " <-> " + std::to_string(userId2));
+
+    std::stringstream ss;
+    ss << "DELETE FROM friendships WHERE "
+       << "(user_id = " << userId1 << " AND friend_id = " << userId2 << ") OR "
+       << "(user_id = " << userId2 << " AND friend_id = " << userId1 << ")";
+
+    if (!DatabaseManager::getInstance().executeQuery(ss.str())) {
+        LOG_ERROR("删除好友失败");
+        return false;
+    }
+
+    FriendGraph::getInstance().removeFriendship(userId1, userId2);
+    removeFromCache(userId1, userId2);
+    removeFromCache(userId2, userId1);
+    return true;
+}
+
+FriendManager::FriendListPtr FriendManager::loadFriendList(int64_t userId) {
     LOG_INFO("加载用户 " + std::to_string(userId) + " 的好友列表");
     
     std::stringstream ss;
-    ss << "SELECT u.user_id, u.username, u.nickname, u.status "
+    ss << "SELECT u.user_id, u.username, u.nickname "
        << "FROM users u INNER JOIN friendships f ON u.user_id = f.friend_id "
        << "WHERE f.user_id = " << userId << " AND f.status = 1";
        
     MYSQL_RES* result = DatabaseManager::getInstance().executeQueryWithResult(ss.str());
-    if (!result) return;
+    if (!result) return nullptr;
     
-    std::vector<std::shared_ptr<User>> friends;
+    auto friends = std::make_shared<FriendList>();
+    friends->records.reserve(mysql_num_rows(result));
     MYSQL_ROW row;
     while ((row = mysql_fetch_row(result))) {
-        auto friend_ = std::make_shared<User>();
-        friend_->setUserId(std::stoll(row[0]));
-        friend_->setUsername(row[1]);
-        friend_->setNickname(row[2] ? row[2] : row[1]);
-        friend_->setOnline(std::stoi(row[3]) == 1);
-        friends.push_back(friend_);
+        std::string username = row[1] ? row[1] : "";
+        friends->add(std::stoll(row[0]), username, row[2] ? row[2] : username);
     }
+    friends->updateVersion();
     
     mysql_free_result(result);
-    friendsMap_[userId] = friends;
     
-    LOG_INFO("加载了 " + std::to_string(friends.size()) + " 个好友");
+    LOG_INFO("加载了 " + std::to_string(friends->records.size()) + " 个好友");
+    return friends;
 }
 
-void FriendManager::updateFriendCache(int64_t userId) {
-    LOG_INFO("更新用户 " + std::to_string(userId) + " 的好友缓存");
-    
-    std::lock_guard<std::mutex> lock(friendsMutex_);
-    
-    // 从数据库重新加载好友列表
-    std::stringstream ss;
-    ss << "SELECT u.user_id, u.username, u.nickname, u.status "
-       << "FROM users u INNER JOIN friendships f ON u.user_id = f.friend_id "
-       << "WHERE f.user_id = " << userId << " AND f.status = 1";
-       
-    MYSQL_RES* result = DatabaseManager::getInstance().executeQueryWithResult(ss.str());
-    if (!result) {
-        LOG_ERROR("更新好友缓存失败");
+void FriendManager::addToCache(int64_t userId, const User& friend_) {
+    Shard& shard = shardFor(userId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    if (shard.loading.count(userId)) {
+        shard.staleLoads.insert(userId);
         return;
     }
-    
-    std::vector<std::shared_ptr<User>> friends;
-    MYSQL_ROW row;
-    while ((row = mysql_fetch_row(result))) {
-        auto friend_ = std::make_shared<User>();
-        friend_->setUserId(std::stoll(row[0]));
-        friend_->setUsername(row[1]);
-        friend_->setNickname(row[2] ? row[2] : row[1]);
-        friend_->setOnline(std::stoi(row[3]) == 1);
-        friends.push_back(friend_);
+
+    auto it = shard.entries.find(userId);
+    if (it == shard.entries.end()) {
+        return;
     }
-    
-    mysql_free_result(result);
-    friendsMap_[userId] = friends;
-    
-    LOG_INFO("好友缓存更新完成，共 " + std::to_string(friends.size()) + " 个好友");
-} 
\ No newline at end of file
+
+    if (it->second.friends->contains(friend_.getUserId())) {
+        return;
+    }
+
+    // 复制快照后追加，正在使用旧快照的调用方不受影响
+    auto friends = std::make_shared<FriendList>(*it->second.friends);
+    friends->add(friend_.getUserId(), friend_.getUsername(),
+                 friend_.getNickname().empty() ? friend_.getUsername() : friend_.getNickname());
+    friends->updateVersion();
+    it->second.friends = friends;
+    LOG_INFO("好友缓存增量更新: " + std::to_string(userId) + " + " + std::to_string(friend_.getUserId()));
+}
+
+void FriendManager::removeFromCache(int64_t userId, int64_t friendId) {
+    Shard& shard = shardFor(userId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    if (shard.loading.count(userId)) {
+        shard.staleLoads.insert(userId);
+        return;
+    }
+
+    auto it = shard.entries.find(userId);
+    if (it == shard.entries.end()) {
+        return;
+    }
+
+    if (!it->second.friends->contains(friendId)) {
+        return;
+    }
+
+    // 字符串池整体复制，被删除好友的名字留在池中，直到下次重新加载
+    auto friends = std::make_shared<FriendList>();
+    friends->names = it->second.friends->names;
+    friends->records.reserve(it->second.friends->records.size());
+    for (const auto& record : it->second.friends->records) {
+        if (record.userId != friendId) {
+            friends->records.push_back(record);
+        }
+    }
+    friends->updateVersion();
+    it->second.friends = friends;
+    LOG_INFO("好友缓存增量更新: " + std::to_string(userId) + " - " + std::to_string(friendId));
+}
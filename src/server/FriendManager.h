@@ -1,20 +1,77 @@
 #pragma once
 
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
+#include <list>
+#include <array>
 #include <memory>
 #include <mutex>
+#include <future>
+#include <chrono>
+#include <atomic>
+#include <string_view>
 #include "../core/User.h"
 #include "DatabaseManager.h"
 #include "Logger.h"
 
 class FriendManager {
+public:
+    // 好友记录，用户名和昵称存放在所属列表的字符串池中
+    struct FriendRecord {
+        int64_t userId;
+        uint32_t usernameOffset;
+        uint32_t usernameLength;
+        uint32_t nicknameOffset;
+        uint32_t nicknameLength;
+    };
+
+    // 好友列表快照：连续的记录数组加一个字符串池。
+    // version由内容计算，与记录顺序无关，重新加载或重启后内容不变则版本不变
+    struct FriendList {
+        std::vector<FriendRecord> records;
+        std::string names;
+        uint64_t version = 0;
+
+        void add(int64_t userId, const std::string& username, const std::string& nickname);
+        bool contains(int64_t userId) const;
+        void updateVersion();
+
+        std::string_view username(const FriendRecord& record) const {
+            return std::string_view(names).substr(record.usernameOffset, record.usernameLength);
+        }
+        std::string_view nickname(const FriendRecord& record) const {
+            return std::string_view(names).substr(record.nicknameOffset, record.nicknameLength);
+        }
+    };
+    using FriendListPtr = std::shared_ptr<const FriendList>;
+
 private:
     static FriendManager instance_;
-    std::mutex friendsMutex_;
-    
-    // 用户ID到好友列表的映射
-    std::unordered_map<int64_t, std::vector<std::shared_ptr<User>>> friendsMap_;
+
+    static constexpr size_t SHARD_COUNT = 16;
+    static constexpr size_t MAX_ENTRIES_PER_SHARD = 1024;  // 每个分片最多缓存的用户数
+    static constexpr int CACHE_TTL_SECONDS = 300;          // 缓存有效期
+
+    struct CacheEntry {
+        FriendListPtr friends;  // 不可变快照，增量更新时整体替换
+        std::chrono::steady_clock::time_point loadedAt;
+        std::list<int64_t>::iterator lruPos;
+    };
+
+    // 好友列表缓存按用户ID分片，每个分片独立加锁
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<int64_t, CacheEntry> entries;
+        std::list<int64_t> lru;  // 头部为最近使用
+
+        // 正在从数据库加载的用户，并发未命中时共享同一次查询
+        std::unordered_map<int64_t, std::shared_future<FriendListPtr>> loading;
+        // 加载期间好友关系发生变化的用户，加载结果不写入缓存
+        std::unordered_set<int64_t> staleLoads;
+    };
+
+    std::array<Shard, SHARD_COUNT> shards_;
 
     FriendManager() {}
 
@@ -24,28 +81,37 @@ public:
         return instance;
     }
 
-    // 获取好友列表
-    std::vector<std::shared_ptr<User>> getFriendList(int64_t userId);
-    
+    // 获取好友列表快照，不会返回空指针
+    FriendListPtr getFriendList(int64_t userId);
+
+    // 只查缓存，未缓存或已过期时返回空指针，不访问数据库
+    FriendListPtr getCachedFriendList(int64_t userId);
+
     // 添加好友请求
     bool sendFriendRequest(int64_t fromUserId, int64_t toUserId);
-    
+
     // 处理好友请求
     bool handleFriendRequest(int64_t fromUserId, int64_t toUserId, bool accept);
-    
+
     // 检查是否是好友
     bool areFriends(int64_t userId1, int64_t userId2);
-    
+
     // 删除好友
     bool removeFriend(int64_t userId1, int64_t userId2);
-    
+
     // 获取好友请求列表
     std::vector<std::shared_ptr<User>> getFriendRequests(int64_t userId);
 
 private:
+    Shard& shardFor(int64_t userId) { return shards_[static_cast<uint64_t>(userId) % SHARD_COUNT]; }
+
     // 从数据库加载好友列表
-    void loadFriendList(int64_t userId);
-    
-    // 更新好友关系缓存
-    void updateFriendCache(int64_t userId);
-}; 
\ No newline at end of file
+    FriendListPtr loadFriendList(int64_t userId);
+
+    // 写入缓存并按容量淘汰最久未使用的条目（调用方持有分片锁）
+    void insertEntry(Shard& shard, int64_t userId, FriendListPtr friends);
+
+    // 增量更新已缓存的好友列表
+    void addToCache(int64_t userId, const User& friend_);
+    void removeFromCache(int64_t userId, int64_t friendId);
+};
@@ -0,0 +1,193 @@
+#include "GroupManager.h"
+#include "Frame.h"
+#include "Server.h"
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+
+std::shared_ptr<const std::vector<int64_t>> GroupManager::getMembers(int64_t groupId) {
+    std::time_t now = std::time(nullptr);
+    {
+        std::lock_guard<std::mutex> lock(groupsMutex_);
+        auto it = membersMap_.find(groupId);
+        if (it != membersMap_.end() && now - it->second.loadedAt < MEMBERS_TTL) {
+            return it->second.members;
+        }
+    }
+
+    // 查询数据库时不持有锁
+    auto members = loadMembers(groupId);
+    if (!members) {
+        return std::make_shared<const std::vector<int64_t>>();
+    }
+
+    std::lock_guard<std::mutex> lock(groupsMutex_);
+    if (membersMap_.size() >= MAX_CACHED_GROUPS && membersMap_.find(groupId) == membersMap_.end()) {
+        membersMap_.clear();  // 成员列表随时可以从数据库重新读取
+    }
+    membersMap_[groupId] = CachedMembers{members, now};
+    return members;
+}
+
+bool GroupManager::isMember(int64_t groupId, int64_t userId) {
+    auto members = getMembers(groupId);
+    return std::binary_search(members->begin(), members->end(), userId);
+}
+
+void GroupManager::invalidate(int64_t groupId) {
+    std::lock_guard<std::mutex> lock(groupsMutex_);
+    membersMap_.erase(groupId);
+}
+
+std::shared_ptr<const std::vector<int64_t>> GroupManager::loadMembers(int64_t groupId) {
+    LOG_INFO("加载群 " + std::to_string(groupId) + " 的成员列表");
+
+    std::stringstream ss;
+    ss << "SELECT user_id FROM group_members WHERE group_id = " << groupId
+       << " ORDER BY user_id";
+
+    MYSQL_RES* result = DatabaseManager::getInstance().executeQueryWithResult(ss.str());
+    if (!result) {
+        LOG_ERROR("加载群成员失败");
+        return nullptr;
+    }
+
+    auto members = std::make_shared<std::vector<int64_t>>();
+    MYSQL_ROW row;
+    while ((row = mysql_fetch_row(result))) {
+        members->push_back(std::stoll(row[0]));
+    }
+    mysql_free_result(result);
+
+    LOG_INFO("群 " + std::to_string(groupId) + " 共有 " + std::to_string(members->size()) + " 名成员");
+    return members;
+}
+
+bool GroupManager::storeGroupMessage(Message& msg) {
+    auto& db = DatabaseManager::getInstance();
+
+    std::stringstream ss;
+    ss << "INSERT INTO group_messages (group_id, sender_id, content, msg_type, send_time) VALUES ("
+       << msg.getReceiverId() << ", "
+       << msg.getSenderId() << ", '"
+       << db.escapeString(msg.getContent()) << "', "
+       << static_cast<int>(msg.getType()) << ", NOW())";
+
+    if (!db.executeQuery(ss.str())) {
+        LOG_ERROR("群消息存储失败");
+        return false;
+    }
+
+    msg.setMessageId(db.getLastInsertId());
+    return true;
+}
+
+void GroupManager::fanOut(const Message& msg) {
+    auto start = std::chrono::steady_clock::now();
+    auto members = getMembers(msg.getReceiverId());
+
+    // 所有接收者都先登记离线记录，客户端确认后才删除；
+    // 在线成员的帧在连接中断时丢失也能在下次登录时重发
+    std::vector<int64_t> recipients;
+    recipients.reserve(members->size());
+    for (int64_t memberId : *members) {
+        if (memberId != msg.getSenderId()) {
+            recipients.push_back(memberId);
+        }
+    }
+    if (recipients.empty()) {
+        return;
+    }
+    if (!addOfflineMessages(recipients, msg.getMessageId())) {
+        LOG_WARNING("群消息 " + std::to_string(msg.getMessageId()) + " 的送达记录登记失败，仅尝试在线投递");
+    }
+
+    // 只序列化一次，所有在线成员共享同一个编码帧
+    FramePtr frame = Frame::encode(msg);
+
+    std::vector<std::shared_ptr<Session>> sessions;
+    Server::getInstance().getSessions(*members, sessions);
+
+    size_t delivered = 0;
+    for (size_t i = 0; i < members->size(); ++i) {
+        if ((*members)[i] == msg.getSenderId()) {
+            continue;
+        }
+        if (sessions[i] && sessions[i]->isAlive()) {
+            sessions[i]->sendFrame(frame);
+            ++delivered;
+        }
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    LOG_INFO("群消息 " + std::to_string(msg.getMessageId()) + " 已发送给 " +
+             std::to_string(delivered) + " 名在线成员，" +
+             std::to_string(recipients.size() - delivered) + " 名离线成员，耗时 " +
+             std::to_string(elapsed) + " 微秒");
+}
+
+bool GroupManager::addOfflineMessages(const std::vector<int64_t>& userIds, int64_t messageId) {
+    std::stringstream ss;
+    ss << "INSERT INTO group_offline_messages (user_id, msg_id) VALUES ";
+    for (size_t i = 0; i < userIds.size(); ++i) {
+        if (i > 0) ss << ", ";
+        ss << "(" << userIds[i] << ", " << messageId << ")";
+    }
+
+    if (!DatabaseManager::getInstance().executeQuery(ss.str())) {
+        LOG_ERROR("群离线消息登记失败");
+        return false;
+    }
+    return true;
+}
+
+std::vector<Message> GroupManager::getOfflineMessages(int64_t userId) {
+    std::vector<Message> messages;
+
+    std::stringstream ss;
+    ss << "SELECT m.msg_id, m.sender_id, m.group_id, m.content, m.msg_type, UNIX_TIMESTAMP(m.send_time) "
+       << "FROM group_offline_messages o INNER JOIN group_messages m ON o.msg_id = m.msg_id "
+       << "WHERE o.user_id = " << userId << " ORDER BY m.msg_id ASC";
+
+    MYSQL_RES* result = DatabaseManager::getInstance().executeQueryWithResult(ss.str());
+    if (!result) {
+        LOG_ERROR("获取群离线消息失败");
+        return messages;
+    }
+
+    MYSQL_ROW row;
+    while ((row = mysql_fetch_row(result))) {
+        Message msg(
+            std::stoll(row[1]),  // sender_id
+            std::stoll(row[2]),  // group_id
+            row[3] ? row[3] : "",  // content
+            static_cast<MessageType>(std::stoi(row[4]))  // msg_type
+        );
+        msg.setMessageId(std::stoll(row[0]));
+        if (row[5]) {
+            msg.setTimestamp(static_cast<std::time_t>(std::stoll(row[5])));
+        }
+        messages.push_back(msg);
+    }
+    mysql_free_result(result);
+
+    LOG_INFO("获取 " + std::to_string(messages.size()) +
+             " 条群离线消息 - 用户" + std::to_string(userId));
+    return messages;
+}
+
+void GroupManager::ackOfflineMessages(int64_t userId, const std::vector<int64_t>& messageIds) {
+    if (messageIds.empty()) {
+        return;
+    }
+
+    std::stringstream ss;
+    ss << "DELETE FROM group_offline_messages WHERE user_id = " << userId << " AND msg_id IN (";
+    for (size_t i = 0; i < messageIds.size(); ++i) {
+        if (i > 0) ss << ", ";
+        ss << messageIds[i];
+    }
+    ss << ")";
+    DatabaseManager::getInstance().executeQuery(ss.str());
+}
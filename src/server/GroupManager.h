@@ -0,0 +1,60 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <ctime>
+#include "../core/Message.h"
+#include "DatabaseManager.h"
+#include "Logger.h"
+
+class GroupManager {
+private:
+    std::mutex groupsMutex_;
+
+    // 群ID到成员列表的缓存，成员ID有序，扇出时按快照遍历无需持锁；
+    // 成员可能在数据库中直接修改，缓存超过MEMBERS_TTL后重新加载
+    struct CachedMembers {
+        std::shared_ptr<const std::vector<int64_t>> members;
+        std::time_t loadedAt;
+    };
+    std::unordered_map<int64_t, CachedMembers> membersMap_;
+
+    static constexpr long MEMBERS_TTL = 60;            // 秒
+    static constexpr size_t MAX_CACHED_GROUPS = 4096;  // 缓存上限，满时整体清空
+
+    GroupManager() {}
+
+public:
+    static GroupManager& getInstance() {
+        static GroupManager instance;
+        return instance;
+    }
+
+    // 获取群成员列表（缓存未命中时从数据库加载）
+    std::shared_ptr<const std::vector<int64_t>> getMembers(int64_t groupId);
+
+    // 检查用户是否是群成员
+    bool isMember(int64_t groupId, int64_t userId);
+
+    // 成员变动后使缓存失效
+    void invalidate(int64_t groupId);
+
+    // 存储群消息，成功后写回消息ID
+    bool storeGroupMessage(Message& msg);
+
+    // 将群消息扇出给除发送者外的所有成员，每个接收者都登记离线记录直到确认
+    void fanOut(const Message& msg);
+
+    // 获取用户的群离线消息，客户端逐条确认后再删除
+    std::vector<Message> getOfflineMessages(int64_t userId);
+    void ackOfflineMessages(int64_t userId, const std::vector<int64_t>& messageIds);
+
+private:
+    // 从数据库加载群成员
+    std::shared_ptr<const std::vector<int64_t>> loadMembers(int64_t groupId);
+
+    // 为一批成员登记同一条待确认的群消息（单条INSERT语句）
+    bool addOfflineMessages(const std::vector<int64_t>& userIds, int64_t messageId);
+};
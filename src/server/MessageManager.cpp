@@ -1,6 +1,7 @@
 #include "MessageManager.h"
+#include "AsyncDbWriter.h"
 
-bool MessageManager::storeMessage(const Message& msg) {
+bool MessageManager::storeMessage(Message& msg) {
     LOG_INFO("存储消息 - 从用户" + std::to_string(msg.getSenderId()) + 
              "到用户" + std::to_string(msg.getReceiverId()));
     
@@ -8,7 +9,7 @@ bool MessageManager::storeMessage(const Message& msg) {
     ss << "INSERT INTO messages (sender_id, receiver_id, content, msg_type, send_time) VALUES ("
        << msg.getSenderId() << ", "
        << msg.getReceiverId() << ", '"
-       << msg.getContent() << "', "
+       << DatabaseManager::getInstance().escapeString(msg.getContent()) << "', "
        << static_cast<int>(msg.getType()) << ", "
        << "NOW())";
        
@@ -18,7 +19,13 @@ bool MessageManager::storeMessage(const Message& msg) {
         return false;
     }
     
-    LOG_INFO("消息存储成功");
+    msg.setMessageId(DatabaseManager::getInstance().getLastInsertId());
+    LOG_INFO("消息存储成功，消息ID: " + std::to_string(msg.getMessageId()));
+
+    // 检索表由后台写线程分词后批量写入，不占用转发消息的时间；文件消息的正文是JSON描述，不参与检索
+    if (msg.getType() == MessageType::CHAT) {
+        AsyncDbWriter::getInstance().indexMessage(msg);
+    }
     return true;
 }
 
@@ -48,6 +55,7 @@ std::vector<Message> MessageManager::getChatHistory(int64_t userId1, int64_t use
             row[3],              // content
             static_cast<MessageType>(std::stoi(row[4]))  // msg_type
         );
+        msg.setMessageId(std::stoll(row[0]));
         messages.push_back(msg);
     }
     
@@ -57,6 +65,40 @@ std::vector<Message> MessageManager::getChatHistory(int64_t userId1, int64_t use
     return messages;
 }
 
+std::vector<Message> MessageManager::getChatHistorySince(int64_t userId1, int64_t userId2, int64_t afterId, int limit) {
+    std::stringstream ss;
+    ss << "SELECT msg_id, sender_id, receiver_id, content, msg_type, UNIX_TIMESTAMP(send_time) "
+       << "FROM messages WHERE msg_id > " << afterId << " AND "
+       << "((sender_id = " << userId1 << " AND receiver_id = " << userId2 << ") OR "
+       << "(sender_id = " << userId2 << " AND receiver_id = " << userId1 << ")) "
+       << "ORDER BY msg_id ASC LIMIT " << limit;
+
+    MYSQL_RES* result = DatabaseManager::getInstance().executeQueryWithResult(ss.str());
+    if (!result) {
+        LOG_ERROR("增量获取聊天历史失败");
+        return std::vector<Message>();
+    }
+
+    std::vector<Message> messages;
+    MYSQL_ROW row;
+    while ((row = mysql_fetch_row(result))) {
+        Message msg(
+            std::stoll(row[1]),  // sender_id
+            std::stoll(row[2]),  // receiver_id
+            row[3] ? row[3] : "",  // content
+            static_cast<MessageType>(std::stoi(row[4]))  // msg_type
+        );
+        msg.setMessageId(std::stoll(row[0]));
+        if (row[5]) {
+            msg.setTimestamp(static_cast<std::time_t>(std::stoll(row[5])));
+        }
+        messages.push_back(msg);
+    }
+
+    mysql_free_result(result);
+    return messages;
+}
+
 void MessageManager::addOfflineMessage(int64_t userId, const Message& msg) {
     std::lock_guard<std::mutex> lock(messageMutex_);
     offlineMessages_[userId].push(msg);
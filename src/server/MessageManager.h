@@ -25,11 +25,14 @@ public:
         return instance;
     }
 
-    // 存储消息
-    bool storeMessage(const Message& msg);
+    // 存储消息，成功后写回数据库分配的消息ID
+    bool storeMessage(Message& msg);
     
     // 获取聊天历史
     std::vector<Message> getChatHistory(int64_t userId1, int64_t userId2, int limit = 50);
+
+    // 获取消息ID大于afterId的聊天记录（按ID升序），客户端据此增量同步本地消息库
+    std::vector<Message> getChatHistorySince(int64_t userId1, int64_t userId2, int64_t afterId, int limit);
     
     // 获取离线消息
     std::vector<Message> getOfflineMessages(int64_t userId);
@@ -0,0 +1,116 @@
+#include "PasswordHasher.h"
+#include "Logger.h"
+#include "../core/HexCodec.h"
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/crypto.h>
+#include <sstream>
+#include <vector>
+
+namespace {
+    // 存储记录中允许的参数上限，防止异常记录占用过多内存
+    constexpr uint64_t MAX_SCRYPT_N = 1 << 20;
+    constexpr uint64_t MAX_SCRYPT_R = 32;
+    constexpr uint64_t MAX_SCRYPT_P = 16;
+    constexpr uint64_t MAX_SCRYPT_MEMORY = 256ULL * 1024 * 1024;
+}
+
+const std::string& PasswordHasher::dummyHash() {
+    // 首次使用时在工作线程上计算一次，之后所有线程共享
+    static const std::string dummy = hash("unknown-user");
+    return dummy;
+}
+
+std::string PasswordHasher::hash(const std::string& password) {
+    std::string salt(SALT_BYTES, '\0');
+    if (RAND_bytes(reinterpret_cast<unsigned char*>(&salt[0]), SALT_BYTES) != 1) {
+        LOG_ERROR("生成密码盐失败");
+        return "";
+    }
+
+    std::string key;
+    if (!derive(password, salt, SCRYPT_N, SCRYPT_R, SCRYPT_P, key)) {
+        return "";
+    }
+
+    std::stringstream ss;
+    ss << "scrypt$" << SCRYPT_N << "$" << SCRYPT_R << "$" << SCRYPT_P << "$"
+       << HexCodec::encode(salt) << "$" << HexCodec::encode(key);
+    return ss.str();
+}
+
+bool PasswordHasher::verify(const std::string& password, const std::string& stored, bool& needsRehash) {
+    needsRehash = false;
+
+    if (stored.compare(0, 7, "scrypt$") != 0) {
+        // 旧版记录：无盐SHA-256的十六进制串
+        needsRehash = true;
+        return verifyLegacy(password, stored);
+    }
+
+    std::vector<std::string> fields;
+    std::stringstream ss(stored);
+    std::string field;
+    while (std::getline(ss, field, '$')) {
+        fields.push_back(field);
+    }
+    if (fields.size() != 6) {
+        LOG_ERROR("密码哈希格式错误");
+        return false;
+    }
+
+    uint64_t n, r, p;
+    std::string salt, expected;
+    try {
+        n = std::stoull(fields[1]);
+        r = std::stoull(fields[2]);
+        p = std::stoull(fields[3]);
+    } catch (const std::exception&) {
+        LOG_ERROR("密码哈希参数错误");
+        return false;
+    }
+    if (n > MAX_SCRYPT_N || r > MAX_SCRYPT_R || p > MAX_SCRYPT_P ||
+        !HexCodec::decode(fields[4], salt) || !HexCodec::decode(fields[5], expected) || expected.empty()) {
+        LOG_ERROR("密码哈希参数错误");
+        return false;
+    }
+
+    std::string key;
+    if (!derive(password, salt, n, r, p, key) || key.size() != expected.size()) {
+        return false;
+    }
+    if (CRYPTO_memcmp(key.data(), expected.data(), key.size()) != 0) {
+        return false;
+    }
+
+    needsRehash = (n != SCRYPT_N || r != SCRYPT_R || p != SCRYPT_P || salt.size() != SALT_BYTES);
+    return true;
+}
+
+bool PasswordHasher::derive(const std::string& password, const std::string& salt,
+                            uint64_t n, uint64_t r, uint64_t p, std::string& key) {
+    key.assign(KEY_BYTES, '\0');
+    if (EVP_PBE_scrypt(password.data(), password.size(),
+                       reinterpret_cast<const unsigned char*>(salt.data()), salt.size(),
+                       n, r, p, MAX_SCRYPT_MEMORY,
+                       reinterpret_cast<unsigned char*>(&key[0]), key.size()) != 1) {
+        LOG_ERROR("scrypt计算失败");
+        return false;
+    }
+    return true;
+}
+
+bool PasswordHasher::verifyLegacy(const std::string& password, const std::string& stored) {
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digestLen = 0;
+    if (EVP_Digest(password.data(), password.size(), digest, &digestLen, EVP_sha256(), nullptr) != 1) {
+        LOG_ERROR("计算SHA256失败");
+        return false;
+    }
+
+    std::string expected;
+    if (!HexCodec::decode(stored, expected) || expected.size() != digestLen) {
+        return false;
+    }
+    return CRYPTO_memcmp(digest, expected.data(), digestLen) == 0;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+// 密码哈希（scrypt）
+// 存储格式: scrypt$N$r$p$盐(hex)$哈希(hex)，参数随每条记录保存，调整参数后旧记录在登录时重新哈希。
+// 计算代价较高，只应在CryptoWorkerPool的工作线程中调用
+class PasswordHasher {
+public:
+    // 当前参数：N=2^14, r=8, p=1，每次计算约16MB内存
+    static constexpr uint64_t SCRYPT_N = 1 << 14;
+    static constexpr uint64_t SCRYPT_R = 8;
+    static constexpr uint64_t SCRYPT_P = 1;
+
+    // 使用随机盐生成密码哈希，失败时返回空串
+    static std::string hash(const std::string& password);
+
+    // 校验密码；存储的是旧版无盐SHA-256或参数与当前不同时needsRehash为true
+    static bool verify(const std::string& password, const std::string& stored, bool& needsRehash);
+
+    // 按当前参数生成的固定哈希，用户不存在时拿来校验以保持相同的耗时
+    static const std::string& dummyHash();
+
+private:
+    static constexpr size_t SALT_BYTES = 16;
+    static constexpr size_t KEY_BYTES = 32;
+
+    static bool derive(const std::string& password, const std::string& salt,
+                       uint64_t n, uint64_t r, uint64_t p, std::string& key);
+    static bool verifyLegacy(const std::string& password, const std::string& stored);
+};
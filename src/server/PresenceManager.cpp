@@ -0,0 +1,101 @@
+#include "PresenceManager.h"
+#include "AsyncDbWriter.h"
+#include "FriendManager.h"
+#include "FriendGraph.h"
+#include "Server.h"
+#include "Logger.h"
+
+void PresenceManager::start(boost::asio::io_context& io_context) {
+    flushTimer_ = std::make_unique<boost::asio::steady_timer>(io_context);
+}
+
+void PresenceManager::setOnline(int64_t userId, bool online) {
+    {
+        std::lock_guard<std::mutex> lock(presenceMutex_);
+        if (online) {
+            onlineUsers_.insert(userId);
+        } else {
+            onlineUsers_.erase(userId);
+        }
+        pendingChanges_[userId] = online;
+    }
+
+    // 数据库中的状态列由后台线程写入，不阻塞登录流程
+    AsyncDbWriter::getInstance().updateUserStatus(userId, online);
+
+    LOG_INFO("用户 " + std::to_string(userId) + " 状态更新为: " + (online ? "在线" : "离线"));
+    scheduleFlush();
+}
+
+bool PresenceManager::isOnline(int64_t userId) {
+    std::lock_guard<std::mutex> lock(presenceMutex_);
+    return onlineUsers_.count(userId) > 0;
+}
+
+void PresenceManager::scheduleFlush() {
+    {
+        std::lock_guard<std::mutex> lock(presenceMutex_);
+        if (flushScheduled_ || !flushTimer_) {
+            return;
+        }
+        flushScheduled_ = true;
+    }
+
+    flushTimer_->expires_after(std::chrono::milliseconds(COALESCE_WINDOW_MS));
+    flushTimer_->async_wait([this](const boost::system::error_code& error) {
+        if (!error) {
+            flush();
+        }
+    });
+}
+
+void PresenceManager::flush() {
+    std::unordered_map<int64_t, bool> changes;
+    {
+        std::lock_guard<std::mutex> lock(presenceMutex_);
+        changes.swap(pendingChanges_);
+        flushScheduled_ = false;
+    }
+
+    // 按接收方聚合：每个在线好友收到的所有状态变化放进同一条消息。
+    // 好友只从关系图或缓存中取，推送不访问数据库；都取不到时跳过，好友刷新列表时会看到最新状态
+    std::unordered_map<int64_t, Json::Value> updates;
+    std::vector<int64_t> friendIds;
+    for (const auto& change : changes) {
+        Json::Value update;
+        update["userId"] = Json::Value::Int64(change.first);
+        update["online"] = change.second;
+
+        friendIds.clear();
+        if (!FriendGraph::getInstance().friendsOf(change.first, friendIds)) {
+            auto cached = FriendManager::getInstance().getCachedFriendList(change.first);
+            if (!cached) {
+                continue;
+            }
+            for (const auto& record : cached->records) {
+                friendIds.push_back(record.userId);
+            }
+        }
+        for (int64_t friendId : friendIds) {
+            if (isOnline(friendId)) {
+                updates[friendId].append(update);
+            }
+        }
+    }
+
+    Json::FastWriter writer;
+    for (auto& pair : updates) {
+        auto session = Server::getInstance().getSession(pair.first);
+        if (!session || !session->isAlive()) {
+            continue;
+        }
+
+        Json::Value content;
+        content["updates"] = pair.second;
+        Message msg(0, pair.first, writer.write(content), MessageType::PRESENCE);
+        session->sendMessage(msg);
+    }
+
+    LOG_INFO("推送 " + std::to_string(changes.size()) + " 个状态变化给 " +
+             std::to_string(updates.size()) + " 个在线好友");
+}
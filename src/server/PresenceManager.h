@@ -0,0 +1,44 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <memory>
+#include <mutex>
+
+// 在线状态服务
+// 内存中的在线表是在线状态的唯一依据，状态变化在短时间窗口内合并，
+// 再按好友分组，每个在线好友只收到一条批量的PRESENCE消息
+class PresenceManager {
+private:
+    static PresenceManager instance_;
+    std::mutex presenceMutex_;
+
+    std::unordered_set<int64_t> onlineUsers_;
+    std::unordered_map<int64_t, bool> pendingChanges_;  // 窗口内的状态变化，只保留最后一次
+
+    std::unique_ptr<boost::asio::steady_timer> flushTimer_;
+    bool flushScheduled_;
+
+    static constexpr int COALESCE_WINDOW_MS = 200;  // 状态变化合并窗口
+
+    PresenceManager() : flushScheduled_(false) {}
+
+public:
+    static PresenceManager& getInstance() {
+        static PresenceManager instance;
+        return instance;
+    }
+
+    void start(boost::asio::io_context& io_context);
+
+    // 更新用户在线状态
+    void setOnline(int64_t userId, bool online);
+
+    bool isOnline(int64_t userId);
+
+private:
+    void scheduleFlush();
+    void flush();
+};
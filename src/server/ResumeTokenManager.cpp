@@ -0,0 +1,79 @@
+#include "ResumeTokenManager.h"
+#include "Config.h"
+#include "Logger.h"
+#include "../core/HexCodec.h"
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#include <openssl/crypto.h>
+#include <ctime>
+
+ResumeTokenManager::ResumeTokenManager()
+    : ttl_(Config::getInstance().getResumeTokenTtl()) {
+    std::string secret = Config::getInstance().getResumeSecret();
+    if (!secret.empty()) {
+        key_ = secret;
+        return;
+    }
+
+    // 未配置密钥时随机生成，服务器重启后之前签发的令牌全部失效
+    key_.resize(KEY_BYTES);
+    if (RAND_bytes(reinterpret_cast<unsigned char*>(&key_[0]), KEY_BYTES) != 1) {
+        LOG_ERROR("生成会话恢复密钥失败，会话恢复不可用");
+        key_.clear();
+        return;
+    }
+    LOG_WARNING("未配置security.resume_secret，会话恢复令牌在服务器重启后失效");
+}
+
+std::string ResumeTokenManager::issue(int64_t userId) {
+    if (key_.empty()) {
+        return "";
+    }
+
+    std::string body(BODY_BYTES, '\0');
+    uint64_t id = static_cast<uint64_t>(userId);
+    uint64_t expiresAt = static_cast<uint64_t>(std::time(nullptr) + ttl_);
+    for (size_t i = 0; i < 8; ++i) {
+        body[7 - i] = static_cast<char>(id >> (8 * i));
+        body[15 - i] = static_cast<char>(expiresAt >> (8 * i));
+    }
+
+    unsigned char mac[MAC_BYTES];
+    if (!sign(body, mac)) {
+        return "";
+    }
+    return HexCodec::encode(body + std::string(reinterpret_cast<char*>(mac), MAC_BYTES));
+}
+
+bool ResumeTokenManager::verify(const std::string& token, int64_t& userId) {
+    std::string bytes;
+    if (key_.empty() || !HexCodec::decode(token, bytes) || bytes.size() != BODY_BYTES + MAC_BYTES) {
+        return false;
+    }
+
+    std::string body = bytes.substr(0, BODY_BYTES);
+    unsigned char mac[MAC_BYTES];
+    if (!sign(body, mac) || CRYPTO_memcmp(mac, bytes.data() + BODY_BYTES, MAC_BYTES) != 0) {
+        return false;
+    }
+
+    uint64_t id = 0;
+    uint64_t expiresAt = 0;
+    for (size_t i = 0; i < 8; ++i) {
+        id = (id << 8) | static_cast<unsigned char>(body[i]);
+        expiresAt = (expiresAt << 8) | static_cast<unsigned char>(body[8 + i]);
+    }
+    if (expiresAt < static_cast<uint64_t>(std::time(nullptr))) {
+        return false;
+    }
+
+    userId = static_cast<int64_t>(id);
+    return true;
+}
+
+bool ResumeTokenManager::sign(const std::string& body, unsigned char* mac) {
+    unsigned int length = 0;
+    return HMAC(EVP_sha256(), key_.data(), static_cast<int>(key_.size()),
+                reinterpret_cast<const unsigned char*>(body.data()), body.size(),
+                mac, &length) != nullptr && length == MAC_BYTES;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+// 会话恢复令牌
+// 登录成功后下发，断线重连时客户端凭令牌直接恢复登录状态，不再计算密码哈希。
+// 令牌 = 用户ID(8字节) + 过期时间(8字节) + HMAC-SHA256，服务器不保存状态，
+// 配置了security.resume_secret时服务器重启后令牌仍然有效
+class ResumeTokenManager {
+private:
+    static constexpr size_t KEY_BYTES = 32;
+    static constexpr size_t BODY_BYTES = 16;
+    static constexpr size_t MAC_BYTES = 32;
+
+    std::string key_;
+    long ttl_;  // 秒
+
+    ResumeTokenManager();
+
+public:
+    static ResumeTokenManager& getInstance() {
+        static ResumeTokenManager instance;
+        return instance;
+    }
+
+    // 为用户签发令牌（十六进制），失败时返回空串
+    std::string issue(int64_t userId);
+
+    // 校验令牌，有效时返回true并取出用户ID
+    bool verify(const std::string& token, int64_t& userId);
+
+private:
+    bool sign(const std::string& body, unsigned char* mac);
+
+    static ResumeTokenManager instance_;
+};
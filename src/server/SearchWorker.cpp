@@ -0,0 +1,174 @@
+#include "SearchWorker.h"
+#include "Logger.h"
+#include "../core/TextTokenizer.h"
+#include <algorithm>
+#include <limits>
+#include <sstream>
+
+SearchWorker::~SearchWorker() {
+    stop();
+}
+
+bool SearchWorker::start(const std::string& host,
+                         const std::string& database,
+                         const std::string& user,
+                         const std::string& password) {
+    conn_ = mysql_init(nullptr);
+    if (!conn_) {
+        LOG_ERROR("搜索连接初始化失败");
+        return false;
+    }
+
+    if (!mysql_real_connect(conn_, host.c_str(), user.c_str(),
+                           password.c_str(), database.c_str(), 0, nullptr, 0)) {
+        LOG_ERROR("搜索连接失败: " + std::string(mysql_error(conn_)));
+        mysql_close(conn_);
+        conn_ = nullptr;
+        return false;
+    }
+
+    stopping_ = false;
+    worker_ = std::thread([this]() { run(); });
+    LOG_INFO("聊天记录搜索线程已启动");
+    return true;
+}
+
+void SearchWorker::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+
+    if (conn_) {
+        mysql_close(conn_);
+        conn_ = nullptr;
+    }
+}
+
+bool SearchWorker::submit(int64_t userId, const std::string& query, int64_t beforeId, int limit,
+                          Callback done) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_ || !conn_ || jobs_.size() >= MAX_PENDING_SEARCHES) {
+            LOG_WARNING("搜索队列已满，拒绝请求");
+            return false;
+        }
+        jobs_.push_back(Job{userId, query, beforeId, limit, std::move(done)});
+    }
+    cv_.notify_one();
+    return true;
+}
+
+void SearchWorker::run() {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+            // 停止时丢弃未执行的搜索，IO线程已经不再运行
+            if (stopping_) {
+                break;
+            }
+            job = std::move(jobs_.front());
+            jobs_.pop_front();
+        }
+
+        std::vector<Message> results;
+        int64_t nextCursor = 0;
+        bool success = search(job, results, nextCursor);
+        job.done(success, std::move(results), nextCursor);
+    }
+
+    mysql_thread_end();
+    LOG_INFO("聊天记录搜索线程已退出");
+}
+
+bool SearchWorker::search(const Job& job, std::vector<Message>& results, int64_t& nextCursor) {
+    nextCursor = 0;
+
+    std::vector<uint64_t> tokens;
+    TextTokenizer::tokenize(job.query, true, tokens);
+    std::sort(tokens.begin(), tokens.end());
+    tokens.erase(std::unique(tokens.begin(), tokens.end()), tokens.end());
+    if (tokens.empty() || job.limit <= 0) {
+        return true;
+    }
+    if (tokens.size() > MAX_QUERY_TOKENS) {
+        tokens.resize(MAX_QUERY_TOKENS);
+    }
+    std::vector<std::string> terms = TextTokenizer::splitTerms(job.query);
+
+    // 每个词一份检索表，按(token, user_id, msg_id)主键连接，再取出消息回到原文核对
+    int batch = job.limit * 2;
+    int64_t cursor = job.beforeId > 0 ? job.beforeId : std::numeric_limits<int64_t>::max();
+    bool exhausted = false;
+    for (int round = 0; round < MAX_SEARCH_ROUNDS && !exhausted &&
+                        results.size() < static_cast<size_t>(job.limit); ++round) {
+        std::stringstream ss;
+        ss << "SELECT m.msg_id, m.sender_id, m.receiver_id, m.content, m.msg_type, UNIX_TIMESTAMP(m.send_time) "
+           << "FROM message_tokens t0";
+        for (size_t i = 1; i < tokens.size(); ++i) {
+            ss << " JOIN message_tokens t" << i << " ON t" << i << ".token = " << tokens[i]
+               << " AND t" << i << ".user_id = t0.user_id AND t" << i << ".msg_id = t0.msg_id";
+        }
+        ss << " JOIN messages m ON m.msg_id = t0.msg_id"
+           << " WHERE t0.token = " << tokens[0] << " AND t0.user_id = " << job.userId
+           << " AND t0.msg_id < " << cursor
+           << " ORDER BY t0.msg_id DESC LIMIT " << batch;
+
+        MYSQL_RES* result = query(ss.str());
+        if (!result) {
+            results.clear();
+            return false;
+        }
+
+        int rows = 0;
+        MYSQL_ROW row;
+        while (results.size() < static_cast<size_t>(job.limit) && (row = mysql_fetch_row(result))) {
+            ++rows;
+            cursor = std::stoll(row[0]);
+            std::string content = row[3] ? row[3] : "";
+            if (!TextTokenizer::containsTerms(content, terms)) {
+                continue;
+            }
+
+            Message msg(
+                std::stoll(row[1]),  // sender_id
+                std::stoll(row[2]),  // receiver_id
+                content,
+                static_cast<MessageType>(std::stoi(row[4]))  // msg_type
+            );
+            msg.setMessageId(cursor);
+            if (row[5]) {
+                msg.setTimestamp(static_cast<std::time_t>(std::stoll(row[5])));
+            }
+            results.push_back(msg);
+        }
+        mysql_free_result(result);
+        exhausted = rows < batch && results.size() < static_cast<size_t>(job.limit);
+    }
+
+    // 下一页从最后检查过的候选之后继续
+    if (!exhausted) {
+        nextCursor = cursor;
+    }
+    return true;
+}
+
+MYSQL_RES* SearchWorker::query(const std::string& sql) {
+    if (mysql_ping(conn_) != 0) {
+        LOG_ERROR("搜索连接已断开: " + std::string(mysql_error(conn_)));
+        return nullptr;
+    }
+
+    if (mysql_query(conn_, sql.c_str()) != 0) {
+        LOG_ERROR("搜索聊天记录失败: " + std::string(mysql_error(conn_)));
+        return nullptr;
+    }
+    return mysql_store_result(conn_);
+}
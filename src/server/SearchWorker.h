@@ -0,0 +1,69 @@
+#pragma once
+
+#ifdef __linux__
+    #include <mysql/mysql.h>
+#else
+    #include <mysql.h>
+#endif
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include "../core/Message.h"
+
+// 聊天记录搜索线程
+// 检索表连接和原文核对可能要几批查询，使用独立的数据库连接执行，不阻塞IO线程；
+// 结果通过回调交回，回调在搜索线程上执行，调用方自行投递回IO线程
+class SearchWorker {
+public:
+    // success为false表示查询失败，此时messages为空
+    using Callback = std::function<void(bool success, std::vector<Message> messages, int64_t nextCursor)>;
+
+private:
+    struct Job {
+        int64_t userId;
+        std::string query;
+        int64_t beforeId;
+        int limit;
+        Callback done;
+    };
+
+    MYSQL* conn_;
+    std::thread worker_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Job> jobs_;
+    bool stopping_;
+
+    static constexpr size_t MAX_PENDING_SEARCHES = 64;  // 等待队列上限
+    static constexpr size_t MAX_QUERY_TOKENS = 8;       // 参与连接的词数上限，其余的靠原文核对
+    static constexpr int MAX_SEARCH_ROUNDS = 4;         // 候选被核对淘汰时最多再取几批
+
+    SearchWorker() : conn_(nullptr), stopping_(false) {}
+    ~SearchWorker();
+
+public:
+    static SearchWorker& getInstance() {
+        static SearchWorker instance;
+        return instance;
+    }
+
+    bool start(const std::string& host,
+               const std::string& database,
+               const std::string& user,
+               const std::string& password);
+    void stop();
+
+    // 在userId参与的私聊中搜索msg_id小于beforeId（0表示从最新开始）的最多limit条，
+    // 按ID从新到旧；nextCursor为下一页的beforeId，0表示没有更多。队列已满时返回false
+    bool submit(int64_t userId, const std::string& query, int64_t beforeId, int limit, Callback done);
+
+private:
+    void run();
+    bool search(const Job& job, std::vector<Message>& results, int64_t& nextCursor);
+    MYSQL_RES* query(const std::string& sql);
+};
@@ -1,5 +1,6 @@
 #include "Server.h"
 #include "Logger.h"
+#include "Config.h"
 #include <iostream>
 
 Server* Server::instance_ = nullptr;
@@ -8,6 +9,48 @@ Server::Server(boost::asio::io_context& io_context, uint16_t port)
     : io_context_(io_context)
     , acceptor_(io_context, boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), port)) {
     instance_ = this;
+
+    if (Config::getInstance().getTlsEnabled() && !configureTls()) {
+        throw std::runtime_error("TLS配置失败");
+    }
+}
+
+bool Server::configureTls() {
+    try {
+        auto context = std::make_unique<boost::asio::ssl::context>(boost::asio::ssl::context::tls_server);
+        context->set_options(boost::asio::ssl::context::default_workarounds |
+                             boost::asio::ssl::context::no_sslv2 |
+                             boost::asio::ssl::context::no_sslv3 |
+                             boost::asio::ssl::context::no_tlsv1 |
+                             boost::asio::ssl::context::no_tlsv1_1 |
+                             boost::asio::ssl::context::single_dh_use);
+        context->use_certificate_chain_file(Config::getInstance().getTlsCertFile());
+        context->use_private_key_file(Config::getInstance().getTlsKeyFile(), boost::asio::ssl::context::pem);
+
+        SSL_CTX* ctx = context->native_handle();
+
+        // 优先AES-GCM（有AES-NI时最快），ChaCha20作为没有硬件加速的客户端的备选
+        SSL_CTX_set_ciphersuites(ctx, "TLS_AES_128_GCM_SHA256:TLS_AES_256_GCM_SHA384:TLS_CHACHA20_POLY1305_SHA256");
+        SSL_CTX_set_cipher_list(ctx, "ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-RSA-AES128-GCM-SHA256:"
+                                     "ECDHE-ECDSA-AES256-GCM-SHA384:ECDHE-RSA-AES256-GCM-SHA384:"
+                                     "ECDHE-ECDSA-CHACHA20-POLY1305:ECDHE-RSA-CHACHA20-POLY1305");
+        SSL_CTX_set_options(ctx, SSL_OP_CIPHER_SERVER_PREFERENCE);
+
+        // 会话恢复：服务端会话缓存（TLS 1.2会话ID）和会话票据（TLS 1.3）
+        static const unsigned char sessionIdContext[] = "qq_server";
+        SSL_CTX_set_session_id_context(ctx, sessionIdContext, sizeof(sessionIdContext) - 1);
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+        SSL_CTX_sess_set_cache_size(ctx, Config::getInstance().getTlsSessionCacheSize());
+        SSL_CTX_set_timeout(ctx, Config::getInstance().getTlsSessionTimeout());
+        SSL_CTX_set_num_tickets(ctx, 2);
+
+        tlsContext_ = std::move(context);
+        LOG_INFO("TLS已启用，证书: " + Config::getInstance().getTlsCertFile());
+        return true;
+    } catch (const boost::system::system_error& e) {
+        LOG_ERROR("加载TLS证书失败: " + std::string(e.what()));
+        return false;
+    }
 }
 
 void Server::start() {
@@ -26,7 +69,7 @@ void Server::start() {
 
 void Server::startAccept() {
     auto socket = std::make_shared<boost::asio::ip::tcp::socket>(io_context_);
-    auto session = std::make_shared<Session>(std::move(*socket));
+    auto session = std::make_shared<Session>(std::move(*socket), tlsContext_.get());
     
     acceptor_.async_accept(session->socket_,
         [this, session](const boost::system::error_code& error) {
@@ -41,11 +84,7 @@ void Server::handleAccept(std::shared_ptr<Session> session,
                  session->socket_.remote_endpoint().address().to_string() + ":" +
                  std::to_string(session->socket_.remote_endpoint().port()));
         
-        // 保存会话
-        std::lock_guard<std::mutex> lock(sessionsMutex_);
-        sessions_[session->getUserId()] = session;
-        
-        // 启动会话
+        // 启动会话，登录成功后再按用户ID登记
         session->start();
         
         // 开始等待下一个连接
@@ -56,16 +95,53 @@ void Server::handleAccept(std::shared_ptr<Session> session,
 }
 
 void Server::broadcastMessage(const Message& msg) {
-    std::lock_guard<std::mutex> lock(sessionsMutex_);
-    for (const auto& pair : sessions_) {
-        if (pair.second && pair.second->isAlive()) {
-            pair.second->sendMessage(msg);
+    // 先复制会话列表再发送，发送失败关闭会话时会回调removeSession
+    std::vector<std::shared_ptr<Session>> sessions;
+    {
+        std::lock_guard<std::mutex> lock(sessionsMutex_);
+        sessions.reserve(sessions_.size());
+        for (const auto& pair : sessions_) {
+            sessions.push_back(pair.second);
+        }
+    }
+
+    // 只编码一次，所有会话的发送队列共享同一帧
+    FramePtr frame = Frame::encode(msg);
+    for (const auto& session : sessions) {
+        if (session && session->isAlive()) {
+            session->sendFrame(frame);
         }
     }
 }
 
-void Server::removeSession(int64_t userId) {
+void Server::getSessions(const std::vector<int64_t>& userIds,
+                         std::vector<std::shared_ptr<Session>>& out) {
+    out.clear();
+    out.reserve(userIds.size());
+
     std::lock_guard<std::mutex> lock(sessionsMutex_);
-    sessions_.erase(userId);
+    for (int64_t userId : userIds) {
+        auto it = sessions_.find(userId);
+        out.push_back(it != sessions_.end() ? it->second : nullptr);
+    }
+}
+
+void Server::addSession(int64_t userId, std::shared_ptr<Session> session) {
+    std::lock_guard<std::mutex> lock(sessionsMutex_);
+    sessions_[userId] = session;
+    LOG_INFO("登记用户会话: " + std::to_string(userId));
+}
+
+bool Server::removeSession(int64_t userId, const Session* session) {
+    std::lock_guard<std::mutex> lock(sessionsMutex_);
+    auto it = sessions_.find(userId);
+    if (it == sessions_.end()) {
+        return false;
+    }
+    if (session && it->second.get() != session) {
+        return false;
+    }
+    sessions_.erase(it);
     LOG_INFO("移除用户会话: " + std::to_string(userId));
+    return true;
 } 
\ No newline at end of file
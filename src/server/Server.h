@@ -1,6 +1,7 @@
 #pragma once
 
 #include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
 #include <unordered_map>
 #include <memory>
 #include "Session.h"
@@ -12,6 +13,9 @@ private:
     boost::asio::ip::tcp::acceptor acceptor_;
     std::unordered_map<int64_t, std::shared_ptr<Session>> sessions_;
     std::mutex sessionsMutex_;
+
+    // 配置启用TLS时所有连接共用的上下文
+    std::unique_ptr<boost::asio::ssl::context> tlsContext_;
     
     static Server* instance_;
 
@@ -33,10 +37,21 @@ public:
         return (it != sessions_.end()) ? it->second : nullptr;
     }
 
+    // 批量查找会话，只加一次锁；out与userIds一一对应，不在线的为nullptr
+    void getSessions(const std::vector<int64_t>& userIds,
+                     std::vector<std::shared_ptr<Session>>& out);
+
     void broadcastMessage(const Message& msg);
-    void removeSession(int64_t userId);
+
+    // 登录成功后按用户ID登记会话，同一用户的旧会话会被替换
+    void addSession(int64_t userId, std::shared_ptr<Session> session);
+
+    // 仅当登记的会话就是session时才移除，避免旧连接关闭时误删新连接
+    // 返回是否确实移除了会话
+    bool removeSession(int64_t userId, const Session* session = nullptr);
 
 private:
+    bool configureTls();
     void startAccept();
     void handleAccept(std::shared_ptr<Session> session,
                      const boost::system::error_code& error);
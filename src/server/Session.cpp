@@ -3,23 +3,67 @@
 #include "UserManager.h"
 #include "DatabaseManager.h"
 #include "MessageManager.h"
+#include "GroupManager.h"
+#include "PresenceManager.h"
+#include "FriendManager.h"
 #include "Server.h"
+#include "AsyncDbWriter.h"
+#include "CryptoWorkerPool.h"
+#include "SearchWorker.h"
+#include "PasswordHasher.h"
+#include "Config.h"
+#include "ResumeTokenManager.h"
+#include "FileTransferManager.h"
+#include "BlobStore.h"
+#include "../core/HexCodec.h"
+#include <openssl/rand.h>
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 
-Session::Session(boost::asio::ip::tcp::socket socket)
+Session::Session(boost::asio::ip::tcp::socket socket, boost::asio::ssl::context* tlsContext)
     : socket_(std::move(socket))
+    , frameCompressed_(false)
+    , lastHeartbeat_(std::time(nullptr))
+    , heartbeatTimer_(socket_.get_executor())
+    , compressionEnabled_(false)
     , authenticated_(false)
-    , lastHeartbeat_(std::time(nullptr)) {
+    , userId_(0)
+    , deliveryBacklog_(false)
+    , authPending_(false) {
+    if (tlsContext) {
+        tls_ = std::make_unique<boost::asio::ssl::stream<boost::asio::ip::tcp::socket&>>(socket_, *tlsContext);
+    }
 }
 
 void Session::start() {
-    startRead();
+    if (tls_) {
+        // 先完成TLS握手，客户端带有会话票据时走简化握手
+        auto self(shared_from_this());
+        tls_->async_handshake(boost::asio::ssl::stream_base::server,
+            [this, self](const boost::system::error_code& error) {
+                if (error) {
+                    LOG_ERROR("TLS握手失败: " + error.message());
+                    close();
+                    return;
+                }
+                SSL* ssl = tls_->native_handle();
+                LOG_INFO(std::string("TLS握手完成: ") + SSL_get_version(ssl) + " " +
+                         SSL_get_cipher_name(ssl) + (SSL_session_reused(ssl) ? "（会话恢复）" : ""));
+                startRead();
+            });
+    } else {
+        startRead();
+    }
     // 启动心跳检测
+    scheduleHeartbeatCheck();
+}
+
+void Session::scheduleHeartbeatCheck() {
     auto self(shared_from_this());
-    boost::asio::steady_timer timer(socket_.get_executor());
-    timer.expires_after(std::chrono::seconds(HEARTBEAT_INTERVAL));
-    timer.async_wait([this, self](const boost::system::error_code& error) {
-        if (!error) {
+    heartbeatTimer_.expires_after(std::chrono::seconds(HEARTBEAT_INTERVAL));
+    heartbeatTimer_.async_wait([this, self](const boost::system::error_code& error) {
+        if (!error && socket_.is_open()) {
             checkHeartbeat();
         }
     });
@@ -28,23 +72,30 @@ void Session::start() {
 void Session::startRead() {
     LOG_INFO("开始读取消息");
     
-    // 先读取消息长度
-    boost::asio::async_read(socket_,
-        boost::asio::buffer(&messageLength_, sizeof(messageLength_)),
-        [this](const boost::system::error_code& error, size_t bytes_transferred) {
+    // 先读取消息长度，回调持有会话的引用，保证未登记的会话在读取期间存活
+    auto self(shared_from_this());
+    asyncRead(boost::asio::buffer(&messageLength_, sizeof(messageLength_)),
+        [this, self](const boost::system::error_code& error, size_t bytes_transferred) {
             if (!error) {
+                // 长度头最高位标记压缩帧
+                frameCompressed_ = (messageLength_ & FrameCompressor::COMPRESSED_FLAG) != 0;
+                messageLength_ &= ~FrameCompressor::COMPRESSED_FLAG;
+                if (messageLength_ > FrameCompressor::MAX_FRAME_SIZE) {
+                    LOG_ERROR("消息长度超出限制: " + std::to_string(messageLength_));
+                    close();
+                    return;
+                }
                 LOG_INFO("收到消息头，长度: " + std::to_string(messageLength_));
                 messageBuffer_.resize(messageLength_);
                 
                 // 读取消息内容
-                boost::asio::async_read(socket_,
-                    boost::asio::buffer(messageBuffer_),
-                    [this](const boost::system::error_code& error, size_t bytes_transferred) {
+                asyncRead(boost::asio::buffer(messageBuffer_),
+                    [this, self](const boost::system::error_code& error, size_t bytes_transferred) {
                         handleRead(error, bytes_transferred);
                     });
             } else {
                 LOG_ERROR("读取消息长度失败: " + error.message());
-                socket_.close();
+                close();
             }
         });
 }
@@ -52,8 +103,31 @@ void Session::startRead() {
 void Session::handleRead(const boost::system::error_code& error,
                         size_t bytes_transferred) {
     if (!error) {
+        // 已协商加密时先原地解密，认证失败说明数据被篡改，直接断开
+        if (cipher_.isActive()) {
+            if (!cipher_.open(reinterpret_cast<unsigned char*>(messageBuffer_.data()), messageBuffer_.size())) {
+                LOG_ERROR("消息解密失败，关闭连接");
+                close();
+                return;
+            }
+            messageBuffer_.resize(messageBuffer_.size() - TransportCipher::TAG_SIZE);
+        }
+
         // 解析消息
-        std::string jsonStr(messageBuffer_.begin(), messageBuffer_.end());
+        std::string jsonStr;
+        if (frameCompressed_) {
+            if (!compressor_.decompress(messageBuffer_.data(), messageBuffer_.size(), inflateBuffer_)) {
+                LOG_ERROR("消息解压失败，关闭连接");
+                close();
+                return;
+            }
+            jsonStr = inflateBuffer_;
+        } else {
+            jsonStr.assign(messageBuffer_.begin(), messageBuffer_.end());
+        }
+        // 任何完整收到的帧都说明对端存活
+        lastHeartbeat_ = std::time(nullptr);
+
         Json::Value root;
         Json::Reader reader;
         if (reader.parse(jsonStr, root)) {
@@ -67,7 +141,30 @@ void Session::handleRead(const boost::system::error_code& error,
         startRead();
     } else {
         LOG_ERROR("读取消息失败: " + error.message());
-        socket_.close();
+        close();
+    }
+}
+
+void Session::close() {
+    heartbeatTimer_.cancel();
+    if (socket_.is_open()) {
+        boost::system::error_code ec;
+        socket_.close(ec);
+        logCompressionStats();
+    }
+
+    if (authenticated_) {
+        // 窗口中未确认的消息在数据库里仍是未送达状态，重新登录后会重传
+        if (!deliveryWindow_.empty()) {
+            LOG_INFO("连接关闭，" + std::to_string(deliveryWindow_.inFlight()) +
+                     " 条消息未确认，等待重连后重传");
+        }
+        authenticated_ = false;
+
+        // 同一用户在别处重新登录时旧会话已被替换，此时不能标记为离线
+        if (Server::getInstance().removeSession(userId_, this)) {
+            PresenceManager::getInstance().setOnline(userId_, false);
+        }
     }
 }
 
@@ -78,8 +175,11 @@ void Session::checkHeartbeat() {
     }
     
     if (now - lastHeartbeat_ > RECONNECT_TIMEOUT) {
-        socket_.close();
+        LOG_WARNING("心跳超时，关闭连接");
+        close();
+        return;
     }
+    scheduleHeartbeatCheck();
 }
 
 void Session::sendHeartbeat() {
@@ -87,77 +187,215 @@ void Session::sendHeartbeat() {
 }
 
 void Session::processMessage(const Message& msg) {
+    if (!tls_ && !cipher_.isActive() && msg.getType() != MessageType::KEY_EXCHANGE &&
+        Config::getInstance().getRequireEncryption()) {
+        LOG_WARNING("未加密的连接，关闭");
+        close();
+        return;
+    }
+
+    if (msg.getType() == MessageType::HEARTBEAT) {
+        return;  // 收到帧时已刷新存活时间，心跳包无需应答
+    }
     LOG_INFO("收到消息，类型: " + std::to_string(static_cast<int>(msg.getType())));
     
     switch (msg.getType()) {
+        case MessageType::KEY_EXCHANGE: {
+            handleKeyExchange(msg);
+            break;
+        }
         case MessageType::LOGIN: {
             LOG_INFO("处理登录请求");
             Json::Value loginData;
             Json::Reader reader;
             if (!reader.parse(msg.getContent(), loginData)) {
-                LOG_ERROR("解析登录信息失败: " + msg.getContent());
-                sendLoginResponse(false, "无效的登录数据", 0);
+                LOG_ERROR("解析登录信息失败");
+                sendLoginResponse(false, "无效的登录数据", 0, msg.getRequestId());
                 return;
             }
 
             std::string username = loginData["username"].asString();
             std::string password = loginData["password"].asString();
+            bool compression = loginData["compression"].asString() == FrameCompressor::NAME;
+            uint64_t requestId = msg.getRequestId();
             LOG_INFO("登录尝试 - 用户名: " + username);
 
-            try {
-                int64_t userId;
-                // 验证用户名和密码
-                if (DatabaseManager::getInstance().authenticateUser(username, password, userId)) {
-                    LOG_INFO("用户登录成功: " + username + " (ID: " + std::to_string(userId) + ")");
-                    authenticated_ = true;
-                    userId_ = userId;
-                    
-                    // 更新用户状态
-                    DatabaseManager::getInstance().updateUserStatus(userId, true);
-                    
-                    // 发送成功响应
-                    sendLoginResponse(true, "", userId);
-                    
-                    // 发送离线消息
-                    auto offlineMessages = MessageManager::getInstance().getOfflineMessages(userId);
-                    for (const auto& msg : offlineMessages) {
-                        sendMessage(msg);
-                    }
-                    MessageManager::getInstance().clearOfflineMessages(userId);
-                } else {
-                    LOG_WARNING("用户登录失败: " + username);
-                    sendLoginResponse(false, "用户名或密码错误", 0);
-                }
-            } catch (const std::exception& e) {
-                LOG_ERROR("登录过程发生错误: " + std::string(e.what()));
-                sendLoginResponse(false, "登录过程发生错误", 0);
+            if (authenticated_ || authPending_) {
+                sendLoginResponse(false, "重复的登录请求", 0, msg.getRequestId());
+                return;
+            }
+
+            // 用户不存在时同样对一个固定哈希做完整校验并从工作线程应答，
+            // 应答时间与密码错误一致，不能据此判断用户名是否已注册
+            int64_t userId = 0;
+            std::string storedHash;
+            bool knownUser = DatabaseManager::getInstance().getPasswordHash(username, userId, storedHash);
+
+            // 密码校验在工作线程中进行，结果回到IO线程完成登录
+            auto self(shared_from_this());
+            authPending_ = true;
+            bool accepted = CryptoWorkerPool::getInstance().submit(
+                [this, self, username, password, storedHash, knownUser, userId, compression, requestId]() {
+                    bool needsRehash = false;
+                    bool verified = PasswordHasher::verify(
+                        password, knownUser ? storedHash : PasswordHasher::dummyHash(), needsRehash) && knownUser;
+                    // 旧格式或参数过时的记录顺便用当前参数重新哈希
+                    std::string newHash = (verified && needsRehash) ? PasswordHasher::hash(password) : "";
+                    boost::asio::post(socket_.get_executor(),
+                        [this, self, username, userId, verified, newHash, compression, requestId]() {
+                        authPending_ = false;
+                        completeLogin(username, userId, verified, newHash, compression, requestId);
+                    });
+                });
+            if (!accepted) {
+                authPending_ = false;
+                sendLoginResponse(false, "服务器繁忙，请稍后重试", 0, msg.getRequestId());
+            }
+            break;
+        }
+        case MessageType::RESUME: {
+            // 断线重连：凭登录时下发的令牌恢复，不再校验密码
+            Json::Value data;
+            Json::Reader reader;
+            if (!reader.parse(msg.getContent(), data)) {
+                sendLoginResponse(false, "无效的恢复请求", 0, msg.getRequestId());
+                return;
+            }
+            if (authenticated_ || authPending_) {
+                sendLoginResponse(false, "重复的登录请求", 0, msg.getRequestId());
+                return;
+            }
+
+            int64_t userId = 0;
+            if (!ResumeTokenManager::getInstance().verify(data["token"].asString(), userId)) {
+                LOG_WARNING("会话恢复令牌无效或已过期");
+                sendLoginResponse(false, "会话已过期，请重新登录", 0, msg.getRequestId());
+                return;
+            }
+
+            // 客户端已收到的消息直接标记为已送达，只补发更新的消息
+            int64_t lastMessageId = data["lastMessageId"].asInt64();
+            if (lastMessageId > 0) {
+                DatabaseManager::getInstance().markMessagesDeliveredUpTo(userId, lastMessageId);
+            }
+
+            LOG_INFO("用户会话恢复: " + std::to_string(userId) +
+                     "，最后收到的消息: " + std::to_string(lastMessageId));
+            startSession(userId, data["compression"].asString() == FrameCompressor::NAME,
+                         msg.getRequestId());
+            break;
+        }
+        case MessageType::REGISTER: {
+            LOG_INFO("处理注册请求");
+            Json::Value registerData;
+            Json::Reader reader;
+            if (!reader.parse(msg.getContent(), registerData)) {
+                sendRegistrationResponse(false, "无效的注册数据", msg.getRequestId());
+                return;
+            }
+
+            std::string username = registerData["username"].asString();
+            std::string password = registerData["password"].asString();
+            std::string nickname = registerData["nickname"].asString();
+            if (username.empty() || password.empty()) {
+                sendRegistrationResponse(false, "用户名或密码不能为空", msg.getRequestId());
+                return;
+            }
+            if (authPending_) {
+                sendRegistrationResponse(false, "重复的注册请求", msg.getRequestId());
+                return;
+            }
+
+            auto self(shared_from_this());
+            uint64_t requestId = msg.getRequestId();
+            authPending_ = true;
+            bool accepted = CryptoWorkerPool::getInstance().submit(
+                [this, self, username, password, nickname, requestId]() {
+                    std::string passwordHash = PasswordHasher::hash(password);
+                    boost::asio::post(socket_.get_executor(),
+                        [this, self, username, nickname, passwordHash, requestId]() {
+                        authPending_ = false;
+                        if (!socket_.is_open()) {
+                            return;
+                        }
+                        bool success = !passwordHash.empty() &&
+                            UserManager::getInstance().registerUser(username, passwordHash, nickname);
+                        sendRegistrationResponse(success, success ? "" : "注册失败，用户名可能已存在", requestId);
+                    });
+                });
+            if (!accepted) {
+                authPending_ = false;
+                sendRegistrationResponse(false, "服务器繁忙，请稍后重试", msg.getRequestId());
             }
             break;
         }
         case MessageType::CHAT: {
             LOG_INFO("收到聊天消息");
-            
-            // 存储消息
-            if (!MessageManager::getInstance().storeMessage(msg)) {
+            if (!authenticated_) {
+                LOG_WARNING("未登录的会话发送了聊天消息");
+                return;
+            }
+
+            // 只转发给好友，检查走内存中的好友关系图
+            if (!FriendManager::getInstance().areFriends(userId_, msg.getReceiverId())) {
+                LOG_WARNING("用户 " + std::to_string(userId_) + " 与 " +
+                            std::to_string(msg.getReceiverId()) + " 不是好友");
+                sendChatRejected(msg.getReceiverId(), "对方不是好友", msg.getRequestId());
+                return;
+            }
+
+            // 存储消息，存储后消息带有数据库分配的ID；发送者以会话中登录的用户为准
+            Message chatMsg(userId_, msg.getReceiverId(), msg.getContent(), MessageType::CHAT);
+            if (!MessageManager::getInstance().storeMessage(chatMsg)) {
                 LOG_ERROR("消息存储失败");
                 return;
             }
+
+            // 通知发送方消息已被服务器接收
+            sendChatAck(chatMsg, msg.getRequestId());
             
             // 获取接收者的会话
-            int64_t receiverId = msg.getReceiverId();
+            int64_t receiverId = chatMsg.getReceiverId();
             auto receiverSession = Server::getInstance().getSession(receiverId);
             
             if (receiverSession && receiverSession->isAlive()) {
-                // 如果接收者在线，直接转发消息
-                receiverSession->sendMessage(msg);
+                // 如果接收者在线，直接转发消息，等待接收方确认
+                receiverSession->deliverChat(chatMsg);
                 LOG_INFO("消息已转发给在线用户");
             } else {
-                // 如果接收者离线，存储为离线消息
-                MessageManager::getInstance().addOfflineMessage(receiverId, msg);
+                // 接收者离线，消息在数据库中保持未送达状态，登录时补发
                 LOG_INFO("消息已存储为离线消息");
             }
             break;
         }
+        case MessageType::DELIVERY_ACK: {
+            handleDeliveryAck(msg);
+            break;
+        }
+        case MessageType::GROUP_CHAT: {
+            LOG_INFO("收到群聊消息");
+            if (!authenticated_) {
+                LOG_WARNING("未登录的会话发送了群聊消息");
+                return;
+            }
+
+            int64_t groupId = msg.getReceiverId();
+            if (!GroupManager::getInstance().isMember(groupId, userId_)) {
+                LOG_WARNING("用户 " + std::to_string(userId_) + " 不是群 " +
+                            std::to_string(groupId) + " 的成员");
+                return;
+            }
+
+            // 发送者以会话中登录的用户为准
+            Message groupMsg(userId_, groupId, msg.getContent(), MessageType::GROUP_CHAT);
+            if (!GroupManager::getInstance().storeGroupMessage(groupMsg)) {
+                return;
+            }
+
+            sendChatAck(groupMsg, msg.getRequestId());
+            GroupManager::getInstance().fanOut(groupMsg);
+            break;
+        }
         case MessageType::GET_CHAT_HISTORY: {
             LOG_INFO("收到获取聊天历史请求");
             
@@ -169,18 +407,124 @@ void Session::processMessage(const Message& msg) {
             }
             
             int64_t otherUserId = data["otherUserId"].asInt64();
-            auto messages = MessageManager::getInstance().getChatHistory(userId_, otherUserId);
+            Json::Value response;
+            std::vector<Message> messages;
+            if (data.isMember("afterId")) {
+                // 增量同步：客户端本地已有afterId及之前的消息，只返回之后的一页
+                int limit = data.get("limit", MAX_HISTORY_PAGE).asInt();
+                limit = std::max(1, std::min(limit, MAX_HISTORY_PAGE));
+                messages = MessageManager::getInstance().getChatHistorySince(
+                    userId_, otherUserId, data["afterId"].asInt64(), limit + 1);
+                response["hasMore"] = messages.size() > static_cast<size_t>(limit);
+                if (messages.size() > static_cast<size_t>(limit)) {
+                    messages.pop_back();
+                }
+            } else {
+                messages = MessageManager::getInstance().getChatHistory(userId_, otherUserId);
+            }
             
             // 发送聊天历史
-            Json::Value response;
             Json::Value messageArray(Json::arrayValue);
             for (const auto& msg : messages) {
                 messageArray.append(msg.toJson());
             }
+            response["otherUserId"] = Json::Value::Int64(otherUserId);
             response["messages"] = messageArray;
             
-            Message responseMsg(0, userId_, response.toStyledString(), 
+            Json::FastWriter writer;
+            Message responseMsg(0, userId_, writer.write(response), 
                               MessageType::CHAT_HISTORY_RESPONSE);
+            responseMsg.setRequestId(msg.getRequestId());
+            sendMessage(responseMsg);
+            break;
+        }
+        case MessageType::SEARCH_MESSAGES: {
+            LOG_INFO("收到搜索聊天记录请求");
+            uint64_t requestId = msg.getRequestId();
+            if (!authenticated_) {
+                sendSearchResults(false, "未登录", "", {}, 0, requestId);
+                return;
+            }
+
+            Json::Value data;
+            Json::Reader reader;
+            if (!reader.parse(msg.getContent(), data)) {
+                LOG_ERROR("解析请求数据失败");
+                sendSearchResults(false, "无效的搜索请求", "", {}, 0, requestId);
+                return;
+            }
+
+            std::string query = data["query"].asString();
+            if (query.size() > MAX_QUERY_LENGTH) {
+                LOG_WARNING("搜索关键字过长");
+                sendSearchResults(false, "搜索关键字过长", query, {}, 0, requestId);
+                return;
+            }
+            int limit = data.get("limit", MAX_SEARCH_PAGE).asInt();
+            limit = std::max(1, std::min(limit, MAX_SEARCH_PAGE));
+
+            // 查询在搜索线程上执行，结果回到IO线程发出
+            auto self(shared_from_this());
+            bool accepted = SearchWorker::getInstance().submit(
+                userId_, query, data["beforeId"].asInt64(), limit,
+                [this, self, query, requestId](bool success, std::vector<Message> messages, int64_t nextCursor) {
+                    boost::asio::post(socket_.get_executor(),
+                        [this, self, query, requestId, success, messages = std::move(messages), nextCursor]() {
+                        if (!socket_.is_open()) {
+                            return;
+                        }
+                        sendSearchResults(success, success ? "" : "搜索失败，请稍后重试", query,
+                                          messages, nextCursor, requestId);
+                    });
+                });
+            if (!accepted) {
+                sendSearchResults(false, "服务器繁忙，请稍后重试", query, {}, 0, requestId);
+            }
+            break;
+        }
+        case MessageType::MARK_READ:
+            handleMarkRead(msg);
+            break;
+        case MessageType::FILE_UPLOAD_REQUEST:
+            handleFileUploadRequest(msg);
+            break;
+        case MessageType::FILE_DOWNLOAD_REQUEST:
+            handleFileDownloadRequest(msg);
+            break;
+        case MessageType::GET_FRIEND_LIST: {
+            LOG_INFO("收到获取好友列表请求");
+            if (!authenticated_) {
+                return;
+            }
+
+            Json::Value request;
+            Json::Reader reader;
+            reader.parse(msg.getContent(), request);
+
+            auto friends = FriendManager::getInstance().getFriendList(userId_);
+
+            // 客户端持有的版本未变化时只回复版本号
+            Json::Value response;
+            response["version"] = Json::Value::UInt64(friends->version);
+            if (!request.isMember("version") || request["version"].asUInt64() != friends->version) {
+                auto unread = DatabaseManager::getInstance().getUnreadCounts(userId_);
+                Json::Value list(Json::arrayValue);
+                for (const auto& record : friends->records) {
+                    Json::Value item;
+                    item["id"] = Json::Value::Int64(record.userId);
+                    item["username"] = std::string(friends->username(record));
+                    item["nickname"] = std::string(friends->nickname(record));
+                    item["online"] = PresenceManager::getInstance().isOnline(record.userId);
+                    auto count = unread.find(record.userId);
+                    item["unread"] = count != unread.end() ? count->second : 0;
+                    list.append(item);
+                }
+                response["friends"] = list;
+            }
+
+            Json::FastWriter writer;
+            Message responseMsg(0, userId_, writer.write(response), MessageType::FRIEND_LIST_RESPONSE);
+            responseMsg.setRequestId(msg.getRequestId());
             sendMessage(responseMsg);
             break;
         }
@@ -193,14 +537,25 @@ void Session::processMessage(const Message& msg) {
                 return;
             }
 
-            int64_t fromUserId = requestData["from_user_id"].asInt64();
+            // 请求方以会话中登录的用户为准
+            if (!authenticated_) {
+                return;
+            }
+            int64_t fromUserId = userId_;
             std::string toUsername = requestData["to_username"].asString();
             
-            // 获取目标用户ID
+            // 获取目标用户ID（不存在的用户名会被短时间缓存）
+            auto fromUser = UserManager::getInstance().getUser(fromUserId);
             auto toUser = UserManager::getInstance().getUserByUsername(toUsername);
-            if (!toUser) {
+            if (!fromUser || !toUser) {
                 LOG_WARNING("目标用户不存在: " + toUsername);
-                sendFriendRequestResponse(false, "用户不存在", fromUserId);
+                sendFriendRequestResponse(false, "用户不存在", fromUserId, msg.getRequestId());
+                return;
+            }
+
+            // 记录待处理的好友请求
+            if (!FriendManager::getInstance().sendFriendRequest(fromUserId, toUser->getUserId())) {
+                sendFriendRequestResponse(false, "好友请求发送失败", fromUserId, msg.getRequestId());
                 return;
             }
 
@@ -208,7 +563,7 @@ void Session::processMessage(const Message& msg) {
             Json::Value notification;
             notification["type"] = "friend_request";
             notification["from_user_id"] = fromUserId;
-            notification["from_username"] = UserManager::getInstance().getUser(fromUserId)->getUsername();
+            notification["from_username"] = fromUser->getUsername();
             
             Message notifyMsg(fromUserId, toUser->getUserId(), 
                             notification.toStyledString(), 
@@ -226,14 +581,135 @@ void Session::processMessage(const Message& msg) {
             }
 
             // 发送响应给请求方
-            sendFriendRequestResponse(true, "", fromUserId);
+            sendFriendRequestResponse(true, "", fromUserId, msg.getRequestId());
+            break;
+        }
+        case MessageType::FRIEND_RESPONSE: {
+            LOG_INFO("收到好友请求处理结果");
+            if (!authenticated_) {
+                return;
+            }
+
+            Json::Value responseData;
+            Json::Reader reader;
+            if (!reader.parse(msg.getContent(), responseData)) {
+                LOG_ERROR("解析好友请求处理结果失败");
+                return;
+            }
+
+            // 请求方是to_user_id，处理方是当前登录用户
+            int64_t requesterId = responseData["to_user_id"].asInt64();
+            bool accepted = responseData["accepted"].asBool();
+            if (!FriendManager::getInstance().handleFriendRequest(requesterId, userId_, accepted)) {
+                sendFriendRequestResponse(false, "好友请求不存在或已处理", userId_, msg.getRequestId());
+            }
             break;
         }
         // ... 其他消息处理 ...
     }
 }
 
-void Session::sendRegistrationResponse(bool success, const std::string& error) {
+void Session::completeLogin(const std::string& username, int64_t userId,
+                            bool verified, const std::string& newHash, bool compression,
+                            uint64_t requestId) {
+    if (!socket_.is_open()) {
+        return;  // 校验期间连接已断开
+    }
+    if (!verified) {
+        LOG_WARNING("用户登录失败: " + username);
+        sendLoginResponse(false, "用户名或密码错误", 0, requestId);
+        return;
+    }
+
+    if (!newHash.empty()) {
+        AsyncDbWriter::getInstance().enqueue(
+            "UPDATE users SET password_hash = '" + newHash +
+            "' WHERE user_id = " + std::to_string(userId));
+        LOG_INFO("用户 " + std::to_string(userId) + " 的密码哈希已升级");
+    }
+
+    LOG_INFO("用户登录成功: " + username + " (ID: " + std::to_string(userId) + ")");
+    startSession(userId, compression, requestId);
+}
+
+void Session::startSession(int64_t userId, bool compression, uint64_t requestId) {
+    authenticated_ = true;
+    userId_ = userId;
+    Server::getInstance().addSession(userId, shared_from_this());
+
+    // 客户端支持压缩时从登录响应开始压缩发出的帧
+    compressionEnabled_ = compression;
+
+    // 更新在线状态，数据库由后台线程异步写入
+    PresenceManager::getInstance().setOnline(userId, true);
+
+    // 发送成功响应
+    sendLoginResponse(true, "", userId, requestId);
+
+    // 发送离线通知
+    auto offlineMessages = MessageManager::getInstance().getOfflineMessages(userId);
+    for (const auto& msg : offlineMessages) {
+        sendMessage(msg);
+    }
+    MessageManager::getInstance().clearOfflineMessages(userId);
+
+    // 发送群离线消息，客户端确认后才从离线表中删除，未送达的下次登录重发
+    auto groupMessages = GroupManager::getInstance().getOfflineMessages(userId);
+    for (const auto& msg : groupMessages) {
+        sendMessage(msg);
+    }
+
+    // 重传所有未确认送达的聊天消息（包括上次连接中断时在途的消息）
+    deliveryWindow_.clear();
+    deliverPending();
+}
+
+void Session::handleKeyExchange(const Message& msg) {
+    // 只能在新的明文连接上、登录之前协商一次，TLS连接不需要
+    if (tls_ || cipher_.isActive() || authenticated_ || authPending_ ||
+        !outbox_.empty() || !writingFrames_.empty()) {
+        LOG_WARNING("忽略无效的密钥交换请求");
+        return;
+    }
+
+    Json::Value request;
+    Json::Reader reader;
+    if (!reader.parse(msg.getContent(), request)) {
+        LOG_ERROR("解析密钥交换请求失败");
+        close();
+        return;
+    }
+
+    std::string publicKey = cipher_.generateKeyPair();
+    if (publicKey.empty() || !cipher_.deriveKeys(request["publicKey"].asString(), true)) {
+        LOG_ERROR("密钥交换失败");
+        close();
+        return;
+    }
+
+    Json::Value response;
+    response["publicKey"] = publicKey;
+    Json::FastWriter writer;
+    handshakeFrame_ = Frame::encode(Message(0, 0, writer.write(response), MessageType::KEY_EXCHANGE));
+    sendFrame(handshakeFrame_);
+    LOG_INFO("传输加密已启用");
+}
+
+void Session::logCompressionStats() {
+    if (compressor_.bytesIn() == 0) {
+        return;
+    }
+
+    double in = static_cast<double>(compressor_.bytesIn());
+    double saved = 100.0 * (in - compressor_.bytesOut()) / in;
+    double msPerMb = compressor_.compressMicros() / 1000.0 / (in / (1024 * 1024));
+    LOG_INFO("用户 " + std::to_string(userId_) + " 压缩统计: " +
+             std::to_string(compressor_.bytesIn()) + " -> " + std::to_string(compressor_.bytesOut()) +
+             " 字节，节省 " + std::to_string(static_cast<int>(saved)) + "%，耗时 " +
+             std::to_string(msPerMb) + " ms/MB");
+}
+
+void Session::sendRegistrationResponse(bool success, const std::string& error, uint64_t requestId) {
     Json::Value response;
     response["success"] = success;
     if (!success && !error.empty()) {
@@ -241,47 +717,447 @@ void Session::sendRegistrationResponse(bool success, const std::string& error) {
     }
 
     Message responseMsg(0, 0, response.toStyledString(), MessageType::REGISTER_RESPONSE);
+    responseMsg.setRequestId(requestId);
     LOG_INFO("发送注册响应: " + (success ? "成功" : "失败 - " + error));
     sendMessage(responseMsg);
 }
 
-void Session::sendLoginResponse(bool success, const std::string& error, int64_t userId) {
+void Session::sendLoginResponse(bool success, const std::string& error, int64_t userId,
+                                uint64_t requestId) {
     LOG_INFO("发送登录响应 - " + std::string(success ? "成功" : "失败"));
     
     Json::Value response;
     response["success"] = success;
     if (success) {
         response["userId"] = Json::Value::Int64(userId);
+        response["resumeToken"] = ResumeTokenManager::getInstance().issue(userId);
+        if (compressionEnabled_) {
+            response["compression"] = FrameCompressor::NAME;
+        }
     } else {
         response["error"] = error;
     }
 
     Message responseMsg(0, 0, response.toStyledString(), MessageType::LOGIN_RESPONSE);
+    responseMsg.setRequestId(requestId);
     sendMessage(responseMsg);
 }
 
 void Session::sendMessage(const Message& msg) {
-    try {
-        // 序列化消息
-        Json::Value jsonMsg = msg.toJson();
-        Json::FastWriter writer;
-        std::string message = writer.write(jsonMsg);
-
-        // 发送消息长度
-        uint32_t messageLength = message.length();
-        boost::asio::write(socket_, boost::asio::buffer(&messageLength, sizeof(messageLength)));
-
-        // 发送消息内容
-        boost::asio::write(socket_, boost::asio::buffer(message));
-        
-        LOG_INFO("消息发送成功，长度: " + std::to_string(messageLength));
-    } catch (const boost::system::system_error& e) {
-        LOG_ERROR("发送消息失败: " + std::string(e.what()));
-        socket_.close();
+    sendFrame(Frame::encode(msg));
+}
+
+void Session::sendFrame(const FramePtr& frame) {
+    // 在会话所在的IO线程上入队，已在该线程时直接执行
+    auto self(shared_from_this());
+    boost::asio::dispatch(socket_.get_executor(), [this, self, frame]() {
+        if (!socket_.is_open()) {
+            return;
+        }
+
+        if (outbox_.size() >= MAX_OUTBOX_FRAMES) {
+            LOG_WARNING("发送队列积压过多，关闭慢连接: " + std::to_string(userId_));
+            close();
+            return;
+        }
+
+        outbox_.push_back(frame);
+        if (writingFrames_.empty()) {
+            doWrite();
+        }
+    });
+}
+
+void Session::doWrite() {
+    // 把队列中的多个帧合并成一次写操作
+    while (!outbox_.empty() && writingFrames_.size() < MAX_WRITE_BATCH) {
+        writingFrames_.push_back(std::move(outbox_.front()));
+        outbox_.pop_front();
+    }
+
+    writeBuffers_.clear();
+    if (cipher_.isActive() || compressionEnabled_) {
+        // 帧由多个会话共享，先压缩或复制到本会话的发送缓冲区，再在缓冲区中原地加密
+        size_t tagSize = cipher_.isActive() ? TransportCipher::TAG_SIZE : 0;
+        size_t capacity = 0;
+        for (const auto& frame : writingFrames_) {
+            size_t body = compressionEnabled_ ? std::max(frame->payloadSize(), compressor_.bound(frame->payloadSize()))
+                                              : frame->payloadSize();
+            capacity += sizeof(uint32_t) + body + tagSize;
+        }
+        sealBuffer_.resize(capacity);
+
+        char* out = sealBuffer_.data();
+        for (const auto& frame : writingFrames_) {
+            if (frame == handshakeFrame_) {
+                std::memcpy(out, frame->data().data(), frame->size());
+                out += frame->size();
+                handshakeFrame_.reset();
+                continue;
+            }
+
+            const char* payload = frame->data().data() + sizeof(uint32_t);
+            char* body = out + sizeof(uint32_t);
+            uint32_t flag = 0;
+            size_t bodyLength = compressionEnabled_ ? compressor_.compress(payload, frame->payloadSize(), body) : 0;
+            if (bodyLength > 0) {
+                flag = FrameCompressor::COMPRESSED_FLAG;
+            } else {
+                bodyLength = frame->payloadSize();
+                std::memcpy(body, payload, bodyLength);
+            }
+            if (tagSize > 0) {
+                cipher_.seal(reinterpret_cast<unsigned char*>(body), bodyLength);
+            }
+
+            uint32_t length = static_cast<uint32_t>(bodyLength + tagSize) | flag;
+            std::memcpy(out, &length, sizeof(length));
+            out += sizeof(uint32_t) + bodyLength + tagSize;
+        }
+        sealBuffer_.resize(out - sealBuffer_.data());
+        writeBuffers_.push_back(boost::asio::buffer(sealBuffer_));
+    } else {
+        for (const auto& frame : writingFrames_) {
+            writeBuffers_.push_back(boost::asio::buffer(frame->data()));
+        }
+    }
+
+    auto self(shared_from_this());
+    asyncWrite(writeBuffers_,
+        [this, self](const boost::system::error_code& error, size_t bytes_transferred) {
+            handleWrite(error);
+        });
+}
+
+void Session::handleWrite(const boost::system::error_code& error) {
+    if (error) {
+        LOG_ERROR("发送消息失败: " + error.message());
+        writingFrames_.clear();
+        outbox_.clear();
+        close();
+        return;
+    }
+
+    LOG_INFO("消息发送成功，帧数: " + std::to_string(writingFrames_.size()));
+    writingFrames_.clear();
+    if (!outbox_.empty()) {
+        doWrite();
+    }
+}
+
+void Session::deliverChat(const Message& msg) {
+    // 有积压或窗口已满时不直接发送，消息留在数据库中按顺序补发
+    if (deliveryBacklog_ || !deliveryWindow_.track(msg.getMessageId())) {
+        deliveryBacklog_ = true;
+        LOG_INFO("发送窗口已满，消息 " + std::to_string(msg.getMessageId()) + " 稍后补发");
+        return;
+    }
+    sendMessage(msg);
+}
+
+void Session::deliverPending() {
+    // 从数据库续取未确认的消息，最多填满发送窗口
+    auto pending = DatabaseManager::getInstance().getOfflineMessages(
+        userId_, deliveryWindow_.lastTrackedId(), deliveryWindow_.available());
+
+    deliveryBacklog_ = false;
+    for (const auto& msg : pending) {
+        deliverChat(msg);
+    }
+
+    // 恰好取满窗口时数据库中可能还有积压
+    if (deliveryWindow_.full()) {
+        deliveryBacklog_ = true;
+    }
+}
+
+void Session::sendChatAck(const Message& msg, uint64_t requestId) {
+    Json::Value ack;
+    ack["messageId"] = Json::Value::Int64(msg.getMessageId());
+    // 群消息的ID和接收方（群ID）与私聊不在同一个编号空间，用单独的字段
+    if (msg.getType() == MessageType::GROUP_CHAT) {
+        ack["groupId"] = Json::Value::Int64(msg.getReceiverId());
+    } else {
+        ack["receiverId"] = Json::Value::Int64(msg.getReceiverId());
+    }
+    ack["timestamp"] = Json::Value::Int64(msg.getTimestamp());
+
+    Message ackMsg(0, msg.getSenderId(), ack.toStyledString(), MessageType::CHAT_ACK);
+    ackMsg.setRequestId(requestId);
+    sendMessage(ackMsg);
+}
+
+void Session::sendChatRejected(int64_t receiverId, const std::string& error, uint64_t requestId) {
+    Json::Value ack;
+    ack["success"] = false;
+    ack["error"] = error;
+    ack["receiverId"] = Json::Value::Int64(receiverId);
+
+    Message ackMsg(0, userId_, ack.toStyledString(), MessageType::CHAT_ACK);
+    ackMsg.setRequestId(requestId);
+    sendMessage(ackMsg);
+}
+
+void Session::handleDeliveryAck(const Message& msg) {
+    if (!authenticated_) {
+        LOG_WARNING("未登录的会话发送了送达确认");
+        return;
+    }
+
+    Json::Value data;
+    Json::Reader reader;
+    if (!reader.parse(msg.getContent(), data)) {
+        LOG_ERROR("解析送达确认失败");
+        return;
+    }
+
+    std::vector<int64_t> messageIds;
+    for (const auto& id : data["messageIds"]) {
+        int64_t messageId = id.asInt64();
+        deliveryWindow_.ack(messageId);
+        messageIds.push_back(messageId);
     }
+
+    DatabaseManager::getInstance().markMessagesDelivered(userId_, messageIds);
+
+    std::vector<int64_t> groupMessageIds;
+    for (const auto& id : data["groupMessageIds"]) {
+        groupMessageIds.push_back(id.asInt64());
+    }
+    GroupManager::getInstance().ackOfflineMessages(userId_, groupMessageIds);
+
+    // 窗口腾出一半空间后再补发积压，避免每条确认都查询数据库
+    if (deliveryBacklog_ && deliveryWindow_.available() >= DeliveryWindow::CAPACITY / 2) {
+        deliverPending();
+    }
+}
+
+void Session::handleMarkRead(const Message& msg) {
+    if (!authenticated_) {
+        return;
+    }
+
+    Json::Value data;
+    Json::Reader reader;
+    if (!reader.parse(msg.getContent(), data)) {
+        LOG_ERROR("解析已读标记失败");
+        return;
+    }
+
+    int64_t peerId = data["peerId"].asInt64();
+    int64_t lastReadId = data["lastReadId"].asInt64();
+    if (peerId <= 0 || lastReadId <= 0) {
+        return;
+    }
+
+    // 标记只前进不后退，多个设备先后上报时取较大值
+    AsyncDbWriter::getInstance().enqueue(
+        "INSERT INTO read_markers (user_id, peer_id, last_read_msg_id) VALUES (" +
+        std::to_string(userId_) + ", " + std::to_string(peerId) + ", " + std::to_string(lastReadId) +
+        ") ON DUPLICATE KEY UPDATE last_read_msg_id = GREATEST(last_read_msg_id, VALUES(last_read_msg_id))");
+}
+
+void Session::handleFileUploadRequest(const Message& msg) {
+    if (!authenticated_) {
+        return;
+    }
+
+    Json::Value data;
+    Json::Reader reader;
+    if (!reader.parse(msg.getContent(), data)) {
+        LOG_ERROR("解析请求数据失败");
+        return;
+    }
+
+    FileTransferManager::FileInfo info;
+    std::string error;
+    if (data.isMember("fileId")) {
+        // 续传：沿用已登记的文件，只有上传者本人可以继续写入
+        if (!FileTransferManager::getInstance().getFile(data["fileId"].asInt64(), info) ||
+            info.uploaderId != userId_) {
+            error = "文件不存在";
+        }
+    } else {
+        info.uploaderId = userId_;
+        info.receiverId = data["receiverId"].asInt64();
+        info.fileSize = data["fileSize"].asUInt64();
+        info.type = data["image"].asBool() ? MessageType::IMAGE : MessageType::FILE;
+
+        // 只保留文件名部分，不接受路径
+        std::string fileName = data["fileName"].asString();
+        size_t slash = fileName.find_last_of("/\\");
+        info.fileName = (slash == std::string::npos) ? fileName : fileName.substr(slash + 1);
+
+        if (info.fileName.empty() || info.fileName.size() > MAX_FILE_NAME_LENGTH) {
+            error = "文件名无效";
+        } else if (info.fileSize > Config::getInstance().getMaxFileSize()) {
+            error = "文件过大";
+        } else if (!FriendManager::getInstance().areFriends(userId_, info.receiverId)) {
+            error = "对方不是好友";
+        } else if (tryDeduplicate(info, data, msg.getRequestId())) {
+            return;
+        } else if (!FileTransferManager::getInstance().createFile(info)) {
+            error = "服务器错误";
+        }
+    }
+
+    sendFileTransferResponse(info, error, FileTransfer::UPLOAD, msg.getRequestId());
+}
+
+bool Session::tryDeduplicate(FileTransferManager::FileInfo& info, const Json::Value& data, uint64_t requestId) {
+    std::string hash = data["sha256"].asString();
+    if (info.fileSize == 0 || !ContentStore::isValidHash(hash)) {
+        return false;
+    }
+
+    BlobStore& blobs = BlobStore::getInstance();
+    Json::Value response;
+    Json::FastWriter writer;
+    if (!data.isMember("proof")) {
+        // 不论内容是否存在都发出挑战，客户端在回答之前无法判断服务器上有没有这份内容；
+        // 内容不存在时挑战只是诱饵，没有正确答案。只知道哈希不能取得文件，位置和随机数每次都不同
+        unsigned char random[24];
+        if (RAND_bytes(random, sizeof(random)) != 1) {
+            return false;
+        }
+        uint64_t length = std::min<uint64_t>(info.fileSize, MAX_PROOF_LENGTH);
+        uint64_t offset = 0;
+        std::memcpy(&offset, random + 16, sizeof(offset));
+        offset %= info.fileSize - length + 1;
+
+        std::string nonce = HexCodec::encode(random, 16);
+
+        uploadChallenge_ = UploadChallenge();
+        uploadChallenge_.hash = hash;
+        uploadChallenge_.expires = std::time(nullptr) + CHALLENGE_TTL;
+        if (blobs.exists(hash, info.fileSize)) {
+            uploadChallenge_.proof = ContentStore::hashRange(blobs.pathFor(hash), nonce, offset, length);
+        }
+
+        response["success"] = true;
+        response["challenge"]["nonce"] = nonce;
+        response["challenge"]["offset"] = Json::Value::UInt64(offset);
+        response["challenge"]["length"] = Json::Value::UInt64(length);
+    } else {
+        // 每个挑战只能回答一次；回答不对、挑战已过期或是诱饵时都按普通上传处理，不透露是哪一种
+        bool verified = !uploadChallenge_.proof.empty() && uploadChallenge_.hash == hash &&
+                        uploadChallenge_.expires >= std::time(nullptr) &&
+                        data["proof"].asString() == uploadChallenge_.proof;
+        uploadChallenge_ = UploadChallenge();
+        if (!verified) {
+            return false;
+        }
+
+        // 内容可能刚被回收，取不到引用时按普通上传处理
+        if (!blobs.addRef(hash)) {
+            return false;
+        }
+        info.blobHash = hash;
+        info.complete = true;
+        int64_t messageId = 0;
+        if (!FileTransferManager::getInstance().createFile(info)) {
+            blobs.release(hash);
+        } else {
+            messageId = FileTransferManager::getInstance().publishFile(info);
+        }
+        if (messageId == 0) {
+            sendFileTransferResponse(info, "服务器错误", FileTransfer::UPLOAD, requestId);
+            return true;
+        }
+
+        blobs.recordSkippedUpload(info.fileSize);
+        LOG_INFO("文件 " + std::to_string(info.fileId) + " 秒传，跳过" +
+                 std::to_string(info.fileSize) + "字节上传");
+        response["success"] = true;
+        response["deduplicated"] = true;
+        response["fileId"] = Json::Value::Int64(info.fileId);
+        response["fileName"] = info.fileName;
+        response["fileSize"] = Json::Value::UInt64(info.fileSize);
+        response["messageId"] = Json::Value::Int64(messageId);
+    }
+
+    Message responseMsg(0, userId_, writer.write(response), MessageType::FILE_TRANSFER_RESPONSE);
+    responseMsg.setRequestId(requestId);
+    sendMessage(responseMsg);
+    return true;
+}
+
+void Session::handleFileDownloadRequest(const Message& msg) {
+    if (!authenticated_) {
+        return;
+    }
+
+    Json::Value data;
+    Json::Reader reader;
+    if (!reader.parse(msg.getContent(), data)) {
+        LOG_ERROR("解析请求数据失败");
+        return;
+    }
+
+    FileTransferManager::FileInfo info;
+    std::string error;
+    if (!FileTransferManager::getInstance().getFile(data["fileId"].asInt64(), info) ||
+        (info.receiverId != userId_ && info.uploaderId != userId_)) {
+        error = "文件不存在";
+    } else if (!info.complete) {
+        error = "文件尚未上传完成";
+    }
+
+    sendFileTransferResponse(info, error, FileTransfer::DOWNLOAD, msg.getRequestId());
+}
+
+void Session::sendFileTransferResponse(const FileTransferManager::FileInfo& info, const std::string& error,
+                                       FileTransfer::Direction direction, uint64_t requestId) {
+    Json::Value response;
+    std::string ticket;
+    if (error.empty()) {
+        ticket = FileTransferManager::getInstance().issueTicket(info.fileId, userId_, direction);
+    }
+
+    response["success"] = !ticket.empty();
+    if (ticket.empty()) {
+        response["error"] = error.empty() ? "服务器错误" : error;
+    } else {
+        response["fileId"] = Json::Value::Int64(info.fileId);
+        response["fileName"] = info.fileName;
+        response["fileSize"] = Json::Value::UInt64(info.fileSize);
+        response["ticket"] = ticket;
+        response["port"] = Config::getInstance().getFileTransferPort();
+        if (direction == FileTransfer::UPLOAD) {
+            response["offset"] = Json::Value::UInt64(FileTransferManager::getInstance().confirmedOffset(info));
+        }
+    }
+
+    Json::FastWriter writer;
+    Message responseMsg(0, userId_, writer.write(response), MessageType::FILE_TRANSFER_RESPONSE);
+    responseMsg.setRequestId(requestId);
+    sendMessage(responseMsg);
+}
+
+void Session::sendSearchResults(bool success, const std::string& error, const std::string& query,
+                                const std::vector<Message>& messages, int64_t nextCursor,
+                                uint64_t requestId) {
+    Json::Value response;
+    Json::Value messageArray(Json::arrayValue);
+    for (const auto& found : messages) {
+        messageArray.append(found.toJson());
+    }
+    response["success"] = success;
+    if (!success) {
+        response["error"] = error;
+    }
+    response["query"] = query;
+    response["messages"] = messageArray;
+    response["nextCursor"] = Json::Value::Int64(nextCursor);
+
+    Json::FastWriter writer;
+    Message responseMsg(0, userId_, writer.write(response), MessageType::SEARCH_RESULTS);
+    responseMsg.setRequestId(requestId);
+    sendMessage(responseMsg);
 }
 
-void Session::sendFriendRequestResponse(bool success, const std::string& error, int64_t userId) {
+void Session::sendFriendRequestResponse(bool success, const std::string& error, int64_t userId,
+                                        uint64_t requestId) {
     Json::Value response;
     response["success"] = success;
     if (!success) {
@@ -290,6 +1166,7 @@ void Session::sendFriendRequestResponse(bool success, const std::string& error,
 
     Message responseMsg(0, userId, response.toStyledString(), 
                        MessageType::FRIEND_REQUEST_RESPONSE);
+    responseMsg.setRequestId(requestId);
     sendMessage(responseMsg);
 }
 
@@ -1,44 +1,142 @@
 #pragma once
 
 #include <boost/asio.hpp>
-#include <queue>
+#include <boost/asio/ssl.hpp>
+#include <deque>
+#include <vector>
 #include <memory>
 #include "../core/Message.h"
-#include "Encryption.h"
+#include "../core/TransportCipher.h"
+#include "../core/FrameCompressor.h"
+#include "DeliveryWindow.h"
+#include "FileTransferManager.h"
+#include "Frame.h"
 
 class Session : public std::enable_shared_from_this<Session> {
 public:
     boost::asio::ip::tcp::socket socket_;
 
 private:
-    std::queue<Message> messageQueue_;
-    std::mutex queueMutex_;
+    // TLS连接时包装socket_，为空表示明文TCP
+    std::unique_ptr<boost::asio::ssl::stream<boost::asio::ip::tcp::socket&>> tls_;
+
+    // 待发送的帧队列，只保存共享帧的指针
+    std::deque<FramePtr> outbox_;
+    std::vector<FramePtr> writingFrames_;  // 正在异步写出的一批帧
+    std::vector<boost::asio::const_buffer> writeBuffers_;
     uint32_t messageLength_;
     std::vector<char> messageBuffer_;
-    std::time_t lastHeartbeat_;
-    Encryption encryption_;
+    bool frameCompressed_;            // 当前读取的帧是否经过压缩
+    std::time_t lastHeartbeat_;       // 最近一次收到任意帧的时间
+    boost::asio::steady_timer heartbeatTimer_;
+    // 传输加密，密钥交换完成后所有帧都经过加密
+    TransportCipher cipher_;
+    FramePtr handshakeFrame_;       // 密钥交换应答，需以明文发出
+    std::vector<char> sealBuffer_;  // 本批压缩、加密后的待写数据，容量复用
+    // 帧压缩，登录时协商，接收方向始终支持
+    FrameCompressor compressor_;
+    bool compressionEnabled_;
+    std::string inflateBuffer_;
     bool authenticated_;
     int64_t userId_;
 
+    // 发往本会话的聊天消息的未确认窗口
+    DeliveryWindow deliveryWindow_;
+    bool deliveryBacklog_;  // 数据库中还有因窗口已满而未发出的消息
+    bool authPending_;      // 登录或注册的密码哈希正在工作线程中计算
+
+    // 秒传前的持有证明：带哈希的上传请求都要回答文件中随机一段的哈希；
+    // 服务器没有该内容时proof为空（诱饵挑战），任何回答都按普通上传处理
+    struct UploadChallenge {
+        std::string hash;
+        std::string proof;  // 期望的回答
+        std::time_t expires = 0;
+    };
+    UploadChallenge uploadChallenge_;
+
     static constexpr int HEARTBEAT_INTERVAL = 30; // 30秒
     static constexpr int RECONNECT_TIMEOUT = 60; // 60秒
+    static constexpr size_t MAX_OUTBOX_FRAMES = 4096;  // 发送队列上限，超过视为慢连接
+    static constexpr size_t MAX_WRITE_BATCH = 64;      // 单次写出合并的最大帧数
+    static constexpr int MAX_HISTORY_PAGE = 500;       // 增量同步聊天历史的单页上限
+    static constexpr int MAX_SEARCH_PAGE = 50;         // 消息搜索的单页上限
+    static constexpr size_t MAX_QUERY_LENGTH = 256;    // 搜索关键字的最大字节数
+    static constexpr size_t MAX_FILE_NAME_LENGTH = 255;
+    static constexpr uint64_t MAX_PROOF_LENGTH = 64 * 1024;  // 持有证明所读取内容的最大字节数
+    static constexpr int CHALLENGE_TTL = 60;                 // 秒
 
 public:
-    explicit Session(boost::asio::ip::tcp::socket socket);
+    // tlsContext不为空时在start中先完成TLS握手
+    explicit Session(boost::asio::ip::tcp::socket socket,
+                     boost::asio::ssl::context* tlsContext = nullptr);
 
     void start();
     void sendMessage(const Message& msg);
+
+    // 发送已编码的帧，多接收者场景下共享同一份编码结果
+    void sendFrame(const FramePtr& frame);
+
+    // 发送需要客户端确认的聊天消息（消息必须已存储并带有消息ID）
+    void deliverChat(const Message& msg);
+
     bool isAlive() const;
     int64_t getUserId() const { return userId_; }
 
 private:
+    template <typename Buffers, typename Handler>
+    void asyncRead(const Buffers& buffers, Handler&& handler) {
+        if (tls_) {
+            boost::asio::async_read(*tls_, buffers, std::forward<Handler>(handler));
+        } else {
+            boost::asio::async_read(socket_, buffers, std::forward<Handler>(handler));
+        }
+    }
+
+    template <typename Buffers, typename Handler>
+    void asyncWrite(const Buffers& buffers, Handler&& handler) {
+        if (tls_) {
+            boost::asio::async_write(*tls_, buffers, std::forward<Handler>(handler));
+        } else {
+            boost::asio::async_write(socket_, buffers, std::forward<Handler>(handler));
+        }
+    }
+
     void startRead();
     void handleRead(const boost::system::error_code& error, size_t bytes_transferred);
+    void doWrite();
     void handleWrite(const boost::system::error_code& error);
+    void close();
+    void scheduleHeartbeatCheck();
     void checkHeartbeat();
     void sendHeartbeat();
     void processMessage(const Message& msg);
-    void sendRegistrationResponse(bool success, const std::string& error);
-    void sendLoginResponse(bool success, const std::string& error, int64_t userId);
-    void sendFriendRequestResponse(bool success, const std::string& error, int64_t userId);
+    // 应答带回请求的requestId，客户端据此匹配请求
+    void sendRegistrationResponse(bool success, const std::string& error, uint64_t requestId);
+    void sendLoginResponse(bool success, const std::string& error, int64_t userId, uint64_t requestId);
+    void completeLogin(const std::string& username, int64_t userId, bool verified,
+                       const std::string& newHash, bool compression, uint64_t requestId);
+    // 登录或会话恢复成功后绑定用户，推送离线消息并补发未送达的聊天消息
+    void startSession(int64_t userId, bool compression, uint64_t requestId);
+    void sendFriendRequestResponse(bool success, const std::string& error, int64_t userId,
+                                   uint64_t requestId);
+    // 搜索请求无论成功与否都应答，失败时带上error，messages为空
+    void sendSearchResults(bool success, const std::string& error, const std::string& query,
+                           const std::vector<Message>& messages, int64_t nextCursor, uint64_t requestId);
+    void sendChatAck(const Message& msg, uint64_t requestId);
+    // 服务器拒收的聊天消息同样要应答，否则客户端会一直等待确认
+    void sendChatRejected(int64_t receiverId, const std::string& error, uint64_t requestId);
+    void handleDeliveryAck(const Message& msg);
+    // 客户端打开会话后上报已读位置，异步写入
+    void handleMarkRead(const Message& msg);
+    void handleKeyExchange(const Message& msg);
+    // 文件传输：检查权限、登记文件并签发传输端口的票据
+    void handleFileUploadRequest(const Message& msg);
+    void handleFileDownloadRequest(const Message& msg);
+    // 带哈希的上传先发挑战，回答正确且内容仍在时走秒传；返回true表示已经应答（挑战、秒传结果或错误），
+    // 返回false时按普通上传处理
+    bool tryDeduplicate(FileTransferManager::FileInfo& info, const Json::Value& data, uint64_t requestId);
+    void sendFileTransferResponse(const FileTransferManager::FileInfo& info, const std::string& error,
+                                  FileTransfer::Direction direction, uint64_t requestId);
+    void logCompressionStats();
+    void deliverPending();
 }; 
\ No newline at end of file
@@ -1,34 +1,14 @@
 #include "UserManager.h"
 #include "Logger.h"
-#include <openssl/evp.h>
 #include <sstream>
 #include <iomanip>
 
-std::string UserManager::hashPassword(const std::string& password) {
-    unsigned char hash[EVP_MAX_MD_SIZE];
-    unsigned int hashLen;
-
-    // 使用新的EVP接口
-    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
-    EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr);
-    EVP_DigestUpdate(ctx, password.c_str(), password.length());
-    EVP_DigestFinal_ex(ctx, hash, &hashLen);
-    EVP_MD_CTX_free(ctx);
-
-    // 转换为十六进制字符串
-    std::stringstream ss;
-    for(unsigned int i = 0; i < hashLen; i++) {
-        ss << std::hex << std::setw(2) << std::setfill('0') << (int)hash[i];
-    }
-    return ss.str();
-}
-
 bool UserManager::registerUser(const std::string& username,
-                             const std::string& password,
+                             const std::string& passwordHash,
                              const std::string& nickname) {
     LOG_INFO("开始注册用户: " + username);
     
-    if (username.empty() || password.empty()) {
+    if (username.empty() || passwordHash.empty()) {
         LOG_ERROR("用户名或密码为空");
         return false;
     }
@@ -41,7 +21,8 @@ bool UserManager::registerUser(const std::string& username,
 
     try {
         // 检查用户名是否已存在
-        std::string checkQuery = "SELECT COUNT(*) FROM users WHERE username = '" + username + "'";
+        std::string escapedUsername = DatabaseManager::getInstance().escapeString(username);
+        std::string checkQuery = "SELECT COUNT(*) FROM users WHERE username = '" + escapedUsername + "'";
         MYSQL_RES* result = DatabaseManager::getInstance().executeQueryWithResult(checkQuery);
         if (!result) {
             LOG_ERROR("检查用户名失败");
@@ -58,20 +39,14 @@ bool UserManager::registerUser(const std::string& username,
         }
         mysql_free_result(result);
 
-        // 对密码进行哈希处理
-        std::string passwordHash = hashPassword(password);
-        LOG_INFO("密码哈希值生成成功");
-
         // 构造插入SQL
         std::stringstream ss;
         ss << "INSERT INTO users (username, password_hash, nickname, created_at) VALUES ("
-           << "'" << username << "', "
-           << "'" << passwordHash << "', "
-           << "'" << (nickname.empty() ? username : nickname) << "', "
+           << "'" << escapedUsername << "', "
+           << "'" << DatabaseManager::getInstance().escapeString(passwordHash) << "', "
+           << "'" << DatabaseManager::getInstance().escapeString(nickname.empty() ? username : nickname) << "', "
            << "NOW())";
 
-        LOG_INFO("执行注册SQL: " + ss.str());
-
         // 执行插入
         if (!DatabaseManager::getInstance().executeQuery(ss.str())) {
             LOG_ERROR("执行插入失败");
@@ -86,6 +61,12 @@ bool UserManager::registerUser(const std::string& username,
             return false;
         }
 
+        // 该用户名之前可能被记录为不存在
+        {
+            std::unique_lock<std::shared_mutex> lock(cacheMutex_);
+            eraseMissingUsername(username);
+        }
+
         LOG_INFO("用户注册成功: " + username);
         return true;
     } catch (const std::exception& e) {
@@ -95,95 +76,144 @@ bool UserManager::registerUser(const std::string& username,
     }
 }
 
-bool UserManager::login(const std::string& username,
-                       const std::string& password,
-                       int64_t& userId) {
-    LOG_INFO("尝试登录用户: " + username);
-    
-    // 验证用户名和密码
-    std::string passwordHash = hashPassword(password);
-    if (!DatabaseManager::getInstance().authenticateUser(username, passwordHash, userId)) {
-        LOG_WARNING("用户登录失败：用户名或密码错误");
-        return false;
+std::shared_ptr<const User> UserManager::getUserByUsername(const std::string& username) {
+    auto now = std::chrono::steady_clock::now();
+    {
+        std::shared_lock<std::shared_mutex> lock(cacheMutex_);
+        auto missing = missingUsernames_.find(username);
+        if (missing != missingUsernames_.end() && missing->second.expiresAt > now) {
+            return nullptr;
+        }
+
+        auto id = idsByUsername_.find(username);
+        if (id != idsByUsername_.end()) {
+            auto it = usersById_.find(id->second);
+            if (it != usersById_.end() && it->second.expiresAt > now) {
+                return it->second.user;
+            }
+        }
     }
 
-    // 更新用户状态
+    auto user = loadUser("username = '" + DatabaseManager::getInstance().escapeString(username) + "'");
+
+    std::unique_lock<std::shared_mutex> lock(cacheMutex_);
+    if (user) {
+        cacheUser(user);
+    } else {
+        cacheMissingUsername(username);
+    }
+    return user;
+}
+
+std::shared_ptr<const User> UserManager::getUser(int64_t userId) {
     {
-        std::lock_guard<std::mutex> lock(usersMutex_);
-        auto user = std::make_shared<User>();
-        user->setUserId(userId);
-        user->setUsername(username);
-        user->setOnline(true);
-        user->setLastLoginTime(std::time(nullptr));
-        onlineUsers_[userId] = user;
+        std::shared_lock<std::shared_mutex> lock(cacheMutex_);
+        auto it = usersById_.find(userId);
+        if (it != usersById_.end() && it->second.expiresAt > std::chrono::steady_clock::now()) {
+            return it->second.user;
+        }
     }
 
-    // 更新数据库中的用户状态
-    DatabaseManager::getInstance().updateUserStatus(userId, true);
+    auto user = loadUser("user_id = " + std::to_string(userId));
+    if (user) {
+        std::unique_lock<std::shared_mutex> lock(cacheMutex_);
+        cacheUser(user);
+    }
+    return user;
+}
 
-    LOG_INFO("用户 " + username + " 登录成功");
-    return true;
+void UserManager::invalidate(int64_t userId) {
+    std::unique_lock<std::shared_mutex> lock(cacheMutex_);
+    eraseUser(userId);
 }
 
-std::shared_ptr<User> UserManager::getUserByUsername(const std::string& username) {
+bool UserManager::updateUserInfo(const User& user) {
+    DatabaseManager& db = DatabaseManager::getInstance();
     std::stringstream ss;
-    ss << "SELECT user_id, username, nickname, avatar_url, status, last_login "
-       << "FROM users WHERE username = '" << username << "'";
+    ss << "UPDATE users SET nickname = '" << db.escapeString(user.getNickname()) << "', "
+       << "avatar_url = '" << db.escapeString(user.getAvatarUrl()) << "' "
+       << "WHERE user_id = " << user.getUserId();
+    if (!db.executeQuery(ss.str())) {
+        LOG_ERROR("更新用户信息失败: " + std::to_string(user.getUserId()));
+        return false;
+    }
 
-    MYSQL_RES* result = DatabaseManager::getInstance().executeQueryWithResult(ss.str());
+    // 缓存中的资料已过时，下次查询重新加载
+    invalidate(user.getUserId());
+    return true;
+}
+
+std::shared_ptr<const User> UserManager::loadUser(const std::string& whereClause) {
+    // 在线状态以PresenceManager为准，这里只加载资料
+    std::string query = "SELECT user_id, username, nickname, avatar_url, UNIX_TIMESTAMP(last_login) "
+                        "FROM users WHERE " + whereClause;
+
+    MYSQL_RES* result = DatabaseManager::getInstance().executeQueryWithResult(query);
     if (!result) {
         LOG_ERROR("查询用户失败: " + DatabaseManager::getInstance().getLastError());
         return nullptr;
     }
 
+    std::shared_ptr<User> user;
     MYSQL_ROW row = mysql_fetch_row(result);
     if (row) {
-        auto user = std::make_shared<User>();
+        user = std::make_shared<User>();
         user->setUserId(std::stoll(row[0]));
         user->setUsername(row[1]);
-        user->setNickname(row[2] ? row[2] : "");
+        user->setNickname(row[2] ? row[2] : row[1]);
         user->setAvatarUrl(row[3] ? row[3] : "");
-        user->setOnline(std::stoi(row[4]) != 0);
-        mysql_free_result(result);
-        return user;
+        if (row[4]) {
+            user->setLastLoginTime(static_cast<std::time_t>(std::stoll(row[4])));
+        }
     }
 
     mysql_free_result(result);
-    return nullptr;
+    return user;
 }
 
-std::shared_ptr<User> UserManager::getUser(int64_t userId) {
-    // 先从在线用户缓存中查找
-    {
-        std::lock_guard<std::mutex> lock(usersMutex_);
-        auto it = onlineUsers_.find(userId);
-        if (it != onlineUsers_.end()) {
-            return it->second;
-        }
+void UserManager::cacheUser(const std::shared_ptr<const User>& user) {
+    auto now = std::chrono::steady_clock::now();
+
+    eraseUser(user->getUserId());
+    if (usersById_.size() >= MAX_CACHED_USERS) {
+        eraseUser(userExpiry_.front());
     }
 
-    // 如果不在缓存中，从数据库查询
-    std::stringstream ss;
-    ss << "SELECT user_id, username, nickname, status, last_login "
-       << "FROM users WHERE user_id = " << userId;
+    userExpiry_.push_back(user->getUserId());
+    usersById_[user->getUserId()] = CachedUser{user, now + std::chrono::seconds(USER_TTL_SECONDS),
+                                               std::prev(userExpiry_.end())};
+    idsByUsername_[user->getUsername()] = user->getUserId();
+    eraseMissingUsername(user->getUsername());
+}
 
-    MYSQL_RES* result = DatabaseManager::getInstance().executeQueryWithResult(ss.str());
-    if (!result) {
-        LOG_ERROR("查询用户失败: " + std::to_string(userId));
-        return nullptr;
+void UserManager::cacheMissingUsername(const std::string& username) {
+    auto now = std::chrono::steady_clock::now();
+
+    eraseMissingUsername(username);
+    if (missingUsernames_.size() >= MAX_MISSING_USERNAMES) {
+        eraseMissingUsername(missingExpiry_.front());
     }
 
-    MYSQL_ROW row = mysql_fetch_row(result);
-    if (row) {
-        auto user = std::make_shared<User>();
-        user->setUserId(std::stoll(row[0]));
-        user->setUsername(row[1]);
-        user->setNickname(row[2] ? row[2] : row[1]);
-        user->setOnline(std::stoi(row[3]) != 0);
-        mysql_free_result(result);
-        return user;
+    missingExpiry_.push_back(username);
+    missingUsernames_[username] = MissingUsername{now + std::chrono::seconds(MISSING_TTL_SECONDS),
+                                                  std::prev(missingExpiry_.end())};
+}
+
+void UserManager::eraseUser(int64_t userId) {
+    auto it = usersById_.find(userId);
+    if (it == usersById_.end()) {
+        return;
     }
+    idsByUsername_.erase(it->second.user->getUsername());
+    userExpiry_.erase(it->second.expiryPos);
+    usersById_.erase(it);
+}
 
-    mysql_free_result(result);
-    return nullptr;
-}
\ No newline at end of file
+void UserManager::eraseMissingUsername(const std::string& username) {
+    auto it = missingUsernames_.find(username);
+    if (it == missingUsernames_.end()) {
+        return;
+    }
+    missingExpiry_.erase(it->second.expiryPos);
+    missingUsernames_.erase(it);
+}
@@ -1,17 +1,43 @@
 #pragma once
 
 #include <unordered_map>
+#include <list>
 #include <memory>
-#include <mutex>
+#include <shared_mutex>
+#include <chrono>
 #include "../core/User.h"
 #include "DatabaseManager.h"
 
 class UserManager {
 private:
-    std::unordered_map<int64_t, std::shared_ptr<User>> onlineUsers_;
-    std::mutex usersMutex_;
     static UserManager instance_;
 
+    static constexpr size_t MAX_CACHED_USERS = 65536;      // 用户资料缓存上限
+    static constexpr size_t MAX_MISSING_USERNAMES = 16384; // 不存在用户名的缓存上限
+    static constexpr int USER_TTL_SECONDS = 600;
+    static constexpr int MISSING_TTL_SECONDS = 30;         // 不存在的用户名只短时间缓存
+
+    struct CachedUser {
+        std::shared_ptr<const User> user;
+        std::chrono::steady_clock::time_point expiresAt;
+        std::list<int64_t>::iterator expiryPos;
+    };
+
+    struct MissingUsername {
+        std::chrono::steady_clock::time_point expiresAt;
+        std::list<std::string>::iterator expiryPos;
+    };
+
+    // 用户资料缓存，按ID存放，用户名索引到ID；读多写少，查询只加共享锁
+    std::shared_mutex cacheMutex_;
+    std::unordered_map<int64_t, CachedUser> usersById_;
+    std::unordered_map<std::string, int64_t> idsByUsername_;
+    // 查询过但不存在的用户名（好友请求输错或枚举）
+    std::unordered_map<std::string, MissingUsername> missingUsernames_;
+    // 按写入顺序排列，TTL固定，队首就是最早过期的条目，缓存满时从队首淘汰
+    std::list<int64_t> userExpiry_;
+    std::list<std::string> missingExpiry_;
+
     UserManager() {}
 
 public:
@@ -20,22 +46,20 @@ public:
         return instance;
     }
 
-    // 用户注册
+    // 用户注册，passwordHash由PasswordHasher生成
     bool registerUser(const std::string& username, 
-                     const std::string& password,
+                     const std::string& passwordHash,
                      const std::string& nickname = "");
 
-    // 用户登录
-    bool login(const std::string& username, 
-              const std::string& password,
-              int64_t& userId);
-
     // 用户登出
     bool logout(int64_t userId);
 
-    // 获取用户信息
-    std::shared_ptr<User> getUser(int64_t userId);
-    std::shared_ptr<User> getUserByUsername(const std::string& username);
+    // 获取用户信息（优先读缓存），不存在时返回nullptr
+    std::shared_ptr<const User> getUser(int64_t userId);
+    std::shared_ptr<const User> getUserByUsername(const std::string& username);
+
+    // 用户资料变化后使缓存失效
+    void invalidate(int64_t userId);
 
     // 更新用户信息
     bool updateUserInfo(const User& user);
@@ -47,6 +71,12 @@ public:
     std::vector<std::shared_ptr<User>> getOnlineUsers();
 
 private:
-    std::string hashPassword(const std::string& password);
-    bool validatePassword(const std::string& password, const std::string& hash);
+    std::shared_ptr<const User> loadUser(const std::string& whereClause);
+
+    // 写入缓存（调用方持有写锁）
+    void cacheUser(const std::shared_ptr<const User>& user);
+    void cacheMissingUsername(const std::string& username);
+    void eraseUser(int64_t userId);
+    void eraseMissingUsername(const std::string& username);
+
 }; 
\ No newline at end of file
@@ -1,7 +1,14 @@
 #include <iostream>
 #include <boost/asio.hpp>
 #include "Server.h"
+#include "FileTransferServer.h"
 #include "DatabaseManager.h"
+#include "AsyncDbWriter.h"
+#include "SearchWorker.h"
+#include "BlobStore.h"
+#include "PresenceManager.h"
+#include "FriendGraph.h"
+#include "CryptoWorkerPool.h"
 #include "Config.h"
 #include "Logger.h"
 
@@ -34,18 +41,64 @@ int main(int argc, char* argv[]) {
         }
         LOG_INFO("数据库连接成功");
 
+        // 启动后台数据库写线程
+        if (!AsyncDbWriter::getInstance().start(
+                Config::getInstance().getDbHost(),
+                Config::getInstance().getDbName(),
+                Config::getInstance().getDbUser(),
+                Config::getInstance().getDbPassword())) {
+            LOG_ERROR("后台数据库写线程启动失败");
+            return 1;
+        }
+
+        // 启动聊天记录搜索线程，失败时搜索请求直接返回错误
+        if (!SearchWorker::getInstance().start(
+                Config::getInstance().getDbHost(),
+                Config::getInstance().getDbName(),
+                Config::getInstance().getDbUser(),
+                Config::getInstance().getDbPassword())) {
+            LOG_WARNING("聊天记录搜索线程启动失败");
+        }
+
+        // 启动内容库回收线程，失败时只是不回收，不影响收发文件
+        if (!BlobStore::getInstance().start(
+                Config::getInstance().getDbHost(),
+                Config::getInstance().getDbName(),
+                Config::getInstance().getDbUser(),
+                Config::getInstance().getDbPassword())) {
+            LOG_WARNING("内容库回收线程启动失败");
+        }
+
+        // 启动密码哈希线程池
+        CryptoWorkerPool::getInstance().start();
+
+        // 加载好友关系图，失败时好友检查回退到数据库查询
+        if (!FriendGraph::getInstance().load()) {
+            LOG_WARNING("好友关系图加载失败，好友检查将查询数据库");
+        }
+
         // 创建IO上下文和服务器
         boost::asio::io_context io_context;
         Server server(io_context, Config::getInstance().getServerPort());
+        PresenceManager::getInstance().start(io_context);
+
+        // 文件走单独的传输端口，与聊天共用IO线程
+        FileTransferServer fileServer(io_context, Config::getInstance().getFileTransferPort());
         
         LOG_INFO("服务器启动成功，监听端口: " + 
                  std::to_string(Config::getInstance().getServerPort()));
         
         // 启动服务器
         server.start();
+        fileServer.start();
         
         // 运行IO服务
         io_context.run();
+
+        CryptoWorkerPool::getInstance().stop();
+        SearchWorker::getInstance().stop();
+        BlobStore::getInstance().stop();
+        AsyncDbWriter::getInstance().stop();
     }
     catch (std::exception& e) {
         LOG_ERROR("服务器错误: " + std::string(e.what()));
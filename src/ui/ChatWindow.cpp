@@ -1,13 +1,48 @@
 #include "ChatWindow.h"
+#include "../core/FileTransferClient.h"
+#include "../core/ContentStore.h"
 #include <iostream>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <unordered_set>
+
+// 搜索时忽略英文大小写，中文按字节匹配
+static std::string toLowerAscii(const std::string& text) {
+    std::string lower(text);
+    for (char& c : lower) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return lower;
+}
+
+// 文件大小的显示文本
+static std::string formatSize(uint64_t bytes) {
+    char text[32];
+    if (bytes >= 1024 * 1024) {
+        std::snprintf(text, sizeof(text), "%.1fMB", bytes / (1024.0 * 1024.0));
+    } else {
+        std::snprintf(text, sizeof(text), "%.1fKB", bytes / 1024.0);
+    }
+    return text;
+}
 
 ChatWindow::ChatWindow(SDL_Renderer* renderer, int width, int height)
     : renderer_(renderer)
     , width_(width)
     , height_(height)
+    , friendListVersion_(0)
     , isInputFocused_(false)
+    , isSearchFocused_(false)
+    , isShowingSearch_(false)
+    , friendListFrame_(0)
     , messageScrollOffset_(0)
     , friendListScrollOffset_(0)
+    , dirtyRegions_(REGION_ALL)
+    , cursorVisible_(true)
+    , cursorBlinkTime_(0)
     , networkManager_(std::make_shared<NetworkManager>()) {
     
     // 加载字体
@@ -15,6 +50,7 @@ ChatWindow::ChatWindow(SDL_Renderer* renderer, int width, int height)
     if (!font_) {
         std::cerr << "无法加载字体: " << TTF_GetError() << std::endl;
     }
+    glyphAtlas_ = std::make_unique<GlyphAtlas>(renderer_);
 
     // 设置UI布局
     int topBarHeight = 50;
@@ -43,6 +79,9 @@ ChatWindow::ChatWindow(SDL_Renderer* renderer, int width, int height)
     sendButton_ = {width_ - 80, height_ - inputAreaHeight, 
                   80, inputAreaHeight};
 
+    // 好友列表内部的搜索框、列表和按钮
+    layoutFriendList();
+
     // 设置颜色
     bgColor_ = {240, 240, 240, 255};        // 浅灰色背景
     topBarColor_ = {30, 144, 255, 255};     // 道奇蓝
@@ -81,20 +120,65 @@ void ChatWindow::render() {
     sendButton_ = {width_ - sendButtonWidth, height_ - inputAreaHeight,
                   sendButtonWidth, inputAreaHeight};
     
-    // 添加好友按钮
-    int addFriendButtonHeight = static_cast<int>(40 * scale);
-    addFriendButton_ = {10, height_ - addFriendButtonHeight - 10,
-                       friendListWidth - 20, addFriendButtonHeight};
-
-    // 渲染各个区域
-    renderTopBar();
-    renderFriendList();
-    if (selectedFriend_) {
-        renderChatArea();
-        renderInputArea();
+    // 好友列表内部的搜索框、列表和添加好友按钮
+    layoutFriendList();
+
+    // 只渲染被标记的区域，其余区域沿用上一帧
+    SDL_Rect inputRow = {inputArea_.x, inputArea_.y,
+                         inputArea_.w + sendButton_.w, inputArea_.h};
+    if (dirtyRegions_ & REGION_TOP_BAR) {
+        renderRegion(topBar_, &ChatWindow::renderTopBar);
+    }
+    if (dirtyRegions_ & REGION_FRIEND_LIST) {
+        // 行纹理要切换渲染目标，需在设置裁剪区域之前准备好
+        updateFriendRows();
+        renderRegion(friendListArea_, &ChatWindow::renderFriendList);
+    }
+    if (dirtyRegions_ & REGION_CHAT) {
+        renderRegion(chatArea_, (selectedFriend_ || isShowingSearch_) ? &ChatWindow::renderChatArea
+                                                : &ChatWindow::renderWelcomeMessage);
+    }
+    if (dirtyRegions_ & REGION_INPUT) {
+        renderRegion(inputRow, selectedFriend_ ? &ChatWindow::renderInputArea : nullptr);
+    }
+    dirtyRegions_ = 0;
+}
+
+void ChatWindow::renderRegion(const SDL_Rect& region, void (ChatWindow::*draw)()) {
+    // 裁剪到区域内，先铺底色再绘制，不影响相邻区域
+    SDL_RenderSetClipRect(renderer_, &region);
+    SDL_SetRenderDrawColor(renderer_, 255, 255, 255, 255);
+    SDL_RenderFillRect(renderer_, &region);
+    if (draw) {
+        (this->*draw)();
+    }
+    SDL_RenderSetClipRect(renderer_, nullptr);
+}
+
+int ChatWindow::updateAnimations(Uint32 now) {
+    int transferTimeout = pollTransfers();
+    if (!isInputFocused_ || !selectedFriend_) {
+        return transferTimeout;
+    }
+
+    int timeout;
+    Uint32 elapsed = now - cursorBlinkTime_;
+    if (elapsed >= CURSOR_BLINK_MS) {
+        cursorVisible_ = !cursorVisible_;
+        cursorBlinkTime_ = now;
+        invalidate(REGION_INPUT);
+        timeout = static_cast<int>(CURSOR_BLINK_MS);
     } else {
-        renderWelcomeMessage();
+        timeout = static_cast<int>(CURSOR_BLINK_MS - elapsed);
     }
+    return transferTimeout < 0 ? timeout : std::min(timeout, transferTimeout);
+}
+
+void ChatWindow::resetCursorBlink() {
+    // 输入时光标保持显示，重新开始计时
+    cursorVisible_ = true;
+    cursorBlinkTime_ = SDL_GetTicks();
+    invalidate(REGION_INPUT);
 }
 
 void ChatWindow::renderWelcomeMessage() {
@@ -156,6 +240,26 @@ void ChatWindow::renderTopBar() {
             " 聊天";
         
         renderText(chatWithText, chatWithRect, textColor);
+    } else if (isShowingSearch_) {
+        SDL_Rect searchRect = {
+            topBar_.x + topBar_.w / 2 - 100,
+            topBar_.y + (topBar_.h - 30) / 2,
+            topBar_.w / 2 - 20,
+            30
+        };
+        std::string searchText = "搜索\"" + searchQuery_ + "\"：" +
+            std::to_string(chatHistory_.size()) + "条结果";
+        renderText(searchText, searchRect, textColor);
+    }
+
+    if (!transferStatus_.empty()) {
+        SDL_Rect transferRect = {
+            topBar_.x + topBar_.w - 320,
+            topBar_.y + (topBar_.h - 30) / 2,
+            300,
+            30
+        };
+        renderText(transferStatus_, transferRect, textColor);
     }
 }
 
@@ -170,52 +274,46 @@ void ChatWindow::renderFriendList() {
                          friendListArea_.w - 20, 30};
     renderText("好友列表", titleRect, textColor_);
 
-    // 渲染好友列表
-    int y = friendListArea_.y + 40;
-    for (const auto& friend_ : friendList_) {
-        SDL_Rect friendRect = {friendListArea_.x + 5, y, 
-                              friendListArea_.w - 10, 50};
-        
-        // 如果是当前选中的好友，绘制高亮背景
-        if (selectedFriend_ && selectedFriend_->getUserId() == friend_->getUserId()) {
-            SDL_SetRenderDrawColor(renderer_, 200, 200, 255, 255);
-            SDL_RenderFillRect(renderer_, &friendRect);
-        }
-
-        // 渲染好友名称
-        SDL_Rect nameRect = {friendRect.x + 5, y + 5, 
-                            friendRect.w - 10, 20};
-        renderText(friend_->getNickname(), nameRect, textColor_);
+    // 渲染搜索框
+    const SDL_Color& searchBoxColor = isSearchFocused_ ? activeBoxColor_ : inputBoxColor_;
+    SDL_SetRenderDrawColor(renderer_, searchBoxColor.r, searchBoxColor.g, searchBoxColor.b, searchBoxColor.a);
+    SDL_RenderFillRect(renderer_, &friendSearchBox_);
+    SDL_SetRenderDrawColor(renderer_, 200, 200, 200, 255);
+    SDL_RenderDrawRect(renderer_, &friendSearchBox_);
+    SDL_Rect searchTextRect = {friendSearchBox_.x + 5, friendSearchBox_.y,
+                               friendSearchBox_.w - 10, friendSearchBox_.h};
+    if (friendFilter_.empty()) {
+        renderText("搜索好友或消息", searchTextRect, {160, 160, 160, 255});
+    } else {
+        renderText(friendFilter_, searchTextRect, textColor_);
+    }
 
-        // 渲染在线状态
-        SDL_Rect statusRect = {friendRect.x + 5, y + 25, 
-                              friendRect.w - 10, 20};
-        SDL_Color statusColor = friend_->isOnline() ? 
-            SDL_Color{0, 255, 0, 255} : SDL_Color{128, 128, 128, 255};
-        renderText(friend_->isOnline() ? "在线" : "离线", 
-                  statusRect, statusColor);
+    // 只绘制可见的行，行内容优先使用缓存的纹理
+    SDL_RenderSetClipRect(renderer_, &friendListView_);
+    size_t first = friendListScrollOffset_ / FRIEND_ROW_HEIGHT;
+    size_t last = std::min(visibleFriends_.size(),
+        static_cast<size_t>((friendListScrollOffset_ + friendListView_.h) / FRIEND_ROW_HEIGHT + 1));
+    for (size_t i = first; i < last; ++i) {
+        const auto& friend_ = friendList_[visibleFriends_[i]];
+        SDL_Rect rowRect = {
+            friendListView_.x + 5,
+            friendListView_.y + static_cast<int>(i) * FRIEND_ROW_HEIGHT - friendListScrollOffset_,
+            friendListView_.w - 10,
+            FRIEND_ROW_HEIGHT - 5
+        };
 
-        // 渲染未读消息数
-        if (unreadCounts_[friend_->getUserId()] > 0) {
-            SDL_Rect unreadRect = {friendRect.x + friendRect.w - 25, y + 5, 20, 20};
-            SDL_SetRenderDrawColor(renderer_, 255, 0, 0, 255);
-            SDL_RenderFillRect(renderer_, &unreadRect);
-            renderText(std::to_string(unreadCounts_[friend_->getUserId()]), 
-                      unreadRect, {255, 255, 255, 255});
+        auto row = friendRows_.find(friend_->getUserId());
+        if (row != friendRows_.end() && row->second.texture) {
+            SDL_RenderCopy(renderer_, row->second.texture, nullptr, &rowRect);
+        } else {
+            // 不支持目标纹理时直接绘制
+            bool selected = selectedFriend_ && selectedFriend_->getUserId() == friend_->getUserId();
+            drawFriendRow(*friend_, rowRect, selected, unreadCounts_[friend_->getUserId()]);
         }
-
-        y += 55;
     }
+    SDL_RenderSetClipRect(renderer_, &friendListArea_);
 
-    // 添加"添加好友"按钮
-    addFriendButton_ = {
-        friendListArea_.x + 10,
-        friendListArea_.y + friendListArea_.h - 40,
-        friendListArea_.w - 20,
-        30
-    };
-
-    // 渲染按钮
+    // 渲染"添加好友"按钮
     SDL_SetRenderDrawColor(renderer_, buttonColor_.r, buttonColor_.g, buttonColor_.b, buttonColor_.a);
     SDL_RenderFillRect(renderer_, &addFriendButton_);
     
@@ -230,39 +328,242 @@ void ChatWindow::renderFriendList() {
     renderText("添加好友", textRect, textColor);
 }
 
+void ChatWindow::layoutFriendList() {
+    friendSearchBox_ = {friendListArea_.x + 10, friendListArea_.y + 40,
+                        friendListArea_.w - 20, 28};
+
+    addFriendButton_ = {
+        friendListArea_.x + 10,
+        friendListArea_.y + friendListArea_.h - 40,
+        friendListArea_.w - 20,
+        30
+    };
+
+    int listTop = friendSearchBox_.y + friendSearchBox_.h + 7;
+    friendListView_ = {friendListArea_.x, listTop,
+                       friendListArea_.w, std::max(0, addFriendButton_.y - 10 - listTop)};
+}
+
+void ChatWindow::updateFriendRows() {
+    ++friendListFrame_;
+
+    size_t first = friendListScrollOffset_ / FRIEND_ROW_HEIGHT;
+    size_t last = std::min(visibleFriends_.size(),
+        static_cast<size_t>((friendListScrollOffset_ + friendListView_.h) / FRIEND_ROW_HEIGHT + 1));
+    int rowWidth = friendListView_.w - 10;
+    int rowHeight = FRIEND_ROW_HEIGHT - 5;
+    if (rowWidth <= 0) return;
+
+    SDL_Texture* previousTarget = SDL_GetRenderTarget(renderer_);
+    bool targetChanged = false;
+
+    for (size_t i = first; i < last; ++i) {
+        const auto& friend_ = friendList_[visibleFriends_[i]];
+        int64_t friendId = friend_->getUserId();
+        int unread = unreadCounts_[friendId];
+        bool selected = selectedFriend_ && selectedFriend_->getUserId() == friendId;
+
+        FriendRow& row = friendRows_[friendId];
+        row.lastUsed = friendListFrame_;
+        if (row.texture && row.width == rowWidth &&
+            row.nickname == friend_->getNickname() && row.online == friend_->isOnline() &&
+            row.unread == unread && row.selected == selected) {
+            continue;  // 行内容没变，沿用缓存的纹理
+        }
+
+        if (row.texture && row.width != rowWidth) {
+            SDL_DestroyTexture(row.texture);
+            row.texture = nullptr;
+        }
+        if (!row.texture) {
+            row.texture = SDL_CreateTexture(renderer_, SDL_PIXELFORMAT_ARGB8888,
+                                            SDL_TEXTUREACCESS_TARGET, rowWidth, rowHeight);
+            if (!row.texture) continue;
+        }
+
+        SDL_SetRenderTarget(renderer_, row.texture);
+        targetChanged = true;
+        drawFriendRow(*friend_, {0, 0, rowWidth, rowHeight}, selected, unread);
+
+        row.nickname = friend_->getNickname();
+        row.online = friend_->isOnline();
+        row.unread = unread;
+        row.selected = selected;
+        row.width = rowWidth;
+    }
+
+    if (targetChanged) {
+        SDL_SetRenderTarget(renderer_, previousTarget);
+    }
+
+    // 缓存超过上限时释放本帧没有显示的行
+    if (friendRows_.size() > MAX_CACHED_ROWS) {
+        for (auto it = friendRows_.begin(); it != friendRows_.end();) {
+            if (it->second.lastUsed != friendListFrame_) {
+                if (it->second.texture) {
+                    SDL_DestroyTexture(it->second.texture);
+                }
+                it = friendRows_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+}
+
+void ChatWindow::drawFriendRow(const User& friend_, const SDL_Rect& rect, bool selected, int unread) {
+    // 选中的好友使用高亮背景
+    SDL_Color background = selected ? SDL_Color{200, 200, 255, 255} : sidebarColor_;
+    SDL_SetRenderDrawColor(renderer_, background.r, background.g, background.b, background.a);
+    SDL_RenderFillRect(renderer_, &rect);
+
+    // 渲染好友名称
+    SDL_Rect nameRect = {rect.x + 5, rect.y + 5, rect.w - 10, 20};
+    renderText(friend_.getNickname(), nameRect, textColor_);
+
+    // 渲染在线状态
+    SDL_Rect statusRect = {rect.x + 5, rect.y + 25, rect.w - 10, 20};
+    SDL_Color statusColor = friend_.isOnline() ? 
+        SDL_Color{0, 255, 0, 255} : SDL_Color{128, 128, 128, 255};
+    renderText(friend_.isOnline() ? "在线" : "离线", statusRect, statusColor);
+
+    // 渲染未读消息数
+    if (unread > 0) {
+        SDL_Rect unreadRect = {rect.x + rect.w - 25, rect.y + 5, 20, 20};
+        SDL_SetRenderDrawColor(renderer_, 255, 0, 0, 255);
+        SDL_RenderFillRect(renderer_, &unreadRect);
+        renderText(std::to_string(unread), unreadRect, {255, 255, 255, 255});
+    }
+}
+
+void ChatWindow::clearFriendRows() {
+    for (auto& entry : friendRows_) {
+        if (entry.second.texture) {
+            SDL_DestroyTexture(entry.second.texture);
+        }
+    }
+    friendRows_.clear();
+}
+
+void ChatWindow::resetRenderTargets() {
+    clearFriendRows();
+    invalidate(REGION_ALL);
+}
+
+void ChatWindow::rebuildFriendIndex() {
+    friendIndex_.clear();
+    friendSearchKeys_.clear();
+    friendSearchKeys_.reserve(friendList_.size());
+    for (size_t i = 0; i < friendList_.size(); ++i) {
+        friendIndex_[friendList_[i]->getUserId()] = i;
+        friendSearchKeys_.push_back(toLowerAscii(friendList_[i]->getNickname()) + "\n" +
+                                    toLowerAscii(friendList_[i]->getUsername()));
+    }
+    applyFriendFilter(false);
+}
+
+void ChatWindow::applyFriendFilter(bool narrowing) {
+    std::string needle = toLowerAscii(friendFilter_);
+    std::vector<size_t> matched;
+
+    if (narrowing) {
+        // 过滤条件只是变长了，结果只会变少，在上次的结果里继续筛选
+        for (size_t index : visibleFriends_) {
+            if (friendSearchKeys_[index].find(needle) != std::string::npos) {
+                matched.push_back(index);
+            }
+        }
+    } else {
+        matched.reserve(friendList_.size());
+        for (size_t index = 0; index < friendList_.size(); ++index) {
+            if (needle.empty() || friendSearchKeys_[index].find(needle) != std::string::npos) {
+                matched.push_back(index);
+            }
+        }
+    }
+
+    visibleFriends_.swap(matched);
+    friendListScrollOffset_ = std::min(friendListScrollOffset_, maxFriendListScroll());
+    invalidate(REGION_FRIEND_LIST);
+}
+
+int ChatWindow::maxFriendListScroll() const {
+    int contentHeight = static_cast<int>(visibleFriends_.size()) * FRIEND_ROW_HEIGHT;
+    return std::max(0, contentHeight - friendListView_.h);
+}
+
 void ChatWindow::renderChatArea() {
     // 绘制聊天区域背景
     SDL_SetRenderDrawColor(renderer_, 255, 255, 255, 255);
     SDL_RenderFillRect(renderer_, &chatArea_);
 
-    // 渲染消息历史
-    int y = chatArea_.y + chatArea_.h - 30;
-    for (auto it = chatHistory_.rbegin(); it != chatHistory_.rend(); ++it) {
-        const Message& msg = *it;
+    if (chatHistory_.empty()) return;
+
+    // 最新一条消息的底部对齐到baseline，向上滚动messageScrollOffset_像素
+    int baseline = chatArea_.y + chatArea_.h - 30;
+    int contentHeight = messageOffsets_.back();
+    int origin = baseline - contentHeight + messageScrollOffset_;  // 内容坐标0对应的屏幕位置
+    int viewTop = chatArea_.y - origin;
+    int viewBottom = viewTop + chatArea_.h;
+
+    // 二分查找第一条与可见区域相交的消息，只渲染可见的气泡
+    auto first = std::upper_bound(messageOffsets_.begin(), messageOffsets_.end(), viewTop);
+    size_t index = (first == messageOffsets_.begin()) ? 0 : (first - messageOffsets_.begin()) - 1;
+
+    for (; index < chatHistory_.size() && messageOffsets_[index] < viewBottom; ++index) {
+        const Message& msg = chatHistory_[index];
         bool isSentByMe = (msg.getSenderId() == currentUser_->getUserId());
-        
-        // 计算消息气泡的大小
-        int textWidth, textHeight;
-        TTF_SizeText(font_, msg.getContent().c_str(), &textWidth, &textHeight);
-        int bubbleWidth = std::min(textWidth + 20, chatArea_.w - 100);
-        int bubbleHeight = textHeight + 20;
+
+        // 气泡大小取自预先计算的布局
+        int bubbleWidth = std::min(messageWidths_[index] + 20, chatArea_.w - 100);
+        int bubbleHeight = messageOffsets_[index + 1] - messageOffsets_[index] - MESSAGE_SPACING;
+        int bubbleY = origin + messageOffsets_[index] + MESSAGE_SPACING;
 
         // 计算气泡位置
         SDL_Rect bubbleRect;
         if (isSentByMe) {
-            bubbleRect = {chatArea_.x + chatArea_.w - bubbleWidth - 20, 
-                         y - bubbleHeight, bubbleWidth, bubbleHeight};
+            bubbleRect = {chatArea_.x + chatArea_.w - bubbleWidth - 20,
+                         bubbleY, bubbleWidth, bubbleHeight};
         } else {
-            bubbleRect = {chatArea_.x + 20, y - bubbleHeight, 
+            bubbleRect = {chatArea_.x + 20, bubbleY,
                          bubbleWidth, bubbleHeight};
         }
 
         // 渲染消息气泡
         renderMessageBubble(msg, bubbleRect);
+    }
+}
 
-        y -= bubbleHeight + 10;
-        if (y < chatArea_.y) break;
+void ChatWindow::addMessage(const Message& msg) {
+    if (messageOffsets_.empty()) {
+        messageOffsets_.push_back(0);
     }
+
+    // 新消息只追加自己的布局，前面的前缀和不变
+    int height = GlyphAtlas::CELL_HEIGHT + 20 + MESSAGE_SPACING;
+    chatHistory_.push_back(msg);
+    messageWidths_.push_back(glyphAtlas_->measure(font_, messageText(msg)));
+    messageOffsets_.push_back(messageOffsets_.back() + height);
+
+    // 正在查看更早的消息时保持视图不动，否则停留在底部
+    if (messageScrollOffset_ > 0) {
+        messageScrollOffset_ += height;
+    }
+    invalidate(REGION_CHAT);
+}
+
+void ChatWindow::clearChatHistory() {
+    chatHistory_.clear();
+    messageWidths_.clear();
+    messageOffsets_.assign(1, 0);
+    messageScrollOffset_ = 0;
+    invalidate(REGION_CHAT);
+}
+
+int ChatWindow::maxMessageScroll() const {
+    // 最早一条消息的顶部到达聊天区域顶部时不能再向上滚动
+    int contentHeight = messageOffsets_.empty() ? 0 : messageOffsets_.back();
+    return std::max(0, contentHeight - (chatArea_.h - 30));
 }
 
 void ChatWindow::renderMessageBubble(const Message& msg, const SDL_Rect& rect) {
@@ -285,7 +586,7 @@ void ChatWindow::renderMessageBubble(const Message& msg, const SDL_Rect& rect) {
         rect.w - 20,
         rect.h - 20
     };
-    renderText(msg.getContent(), textRect, textColor_);
+    renderText(messageText(msg), textRect, textColor_);
 
     // 渲染消息状态（已发送/已读）
     if (isSentByMe) {
@@ -295,6 +596,10 @@ void ChatWindow::renderMessageBubble(const Message& msg, const SDL_Rect& rect) {
             15,
             10
         };
+        if (msg.getMessageId() < 0) {
+            renderText("!", statusRect, SDL_Color{255, 0, 0, 255});  // 发送失败
+            return;
+        }
         SDL_Color statusColor = messageRead_[msg.getMessageId()] ? 
             SDL_Color{0, 255, 0, 255} : 
             (messageDelivered_[msg.getMessageId()] ? 
@@ -323,18 +628,9 @@ void ChatWindow::renderInputArea() {
         renderText(inputText_, textRect, textColor_);
     }
 
-    // 渲染光标
+    // 渲染光标，闪烁由updateAnimations驱动
     if (isInputFocused_) {
-        static Uint32 lastTime = 0;
-        static bool showCursor = true;
-        Uint32 currentTime = SDL_GetTicks();
-        
-        if (currentTime - lastTime > 500) {
-            showCursor = !showCursor;
-            lastTime = currentTime;
-        }
-        
-        if (showCursor) {
+        if (cursorVisible_) {
             // 计算光标位置
             int cursorX = inputArea_.x + 10 + (inputText_.length() * 20); // 每个字符20像素宽
             SDL_Rect cursor = {
@@ -355,12 +651,13 @@ void ChatWindow::handleEvent(SDL_Event& event) {
             int mouseX = event.button.x;
             int mouseY = event.button.y;
             
-            // 检查好友列���点击
-            if (isMouseOver(friendListArea_, mouseX, mouseY)) {
-                int itemHeight = 55; // 每个好友项的高度
-                int index = (mouseY - friendListArea_.y - 40) / itemHeight;
-                if (index >= 0 && index < friendList_.size()) {
-                    selectedFriend_ = friendList_[index];
+            // 检查好友列表点击，行号要算上滚动偏移并映射回过滤前的下标
+            if (isMouseOver(friendListView_, mouseX, mouseY)) {
+                int index = (mouseY - friendListView_.y + friendListScrollOffset_) / FRIEND_ROW_HEIGHT;
+                if (index >= 0 && index < visibleFriends_.size()) {
+                    selectedFriend_ = friendList_[visibleFriends_[index]];
+                    isShowingSearch_ = false;
+                    invalidate(REGION_ALL);
                     // 清除未读消息计数
                     unreadCounts_[selectedFriend_->getUserId()] = 0;
                     // 加载聊天历史
@@ -368,8 +665,19 @@ void ChatWindow::handleEvent(SDL_Event& event) {
                 }
             }
             
+            // 检查搜索框焦点
+            bool searchFocused = isMouseOver(friendSearchBox_, mouseX, mouseY);
+            if (searchFocused != isSearchFocused_) {
+                isSearchFocused_ = searchFocused;
+                invalidate(REGION_FRIEND_LIST);
+            }
+
             // 检查输入框焦点
-            isInputFocused_ = isMouseOver(inputArea_, mouseX, mouseY);
+            bool focused = isMouseOver(inputArea_, mouseX, mouseY);
+            if (focused != isInputFocused_) {
+                isInputFocused_ = focused;
+                resetCursorBlink();
+            }
             
             // 检查发送按钮
             if (isMouseOver(sendButton_, mouseX, mouseY)) {
@@ -382,24 +690,64 @@ void ChatWindow::handleEvent(SDL_Event& event) {
             break;
         }
         case SDL_MOUSEWHEEL: {
-            // 处理滚轮事件
-            if (isMouseOver(messageArea_, event.wheel.x, event.wheel.y)) {
-                messageScrollOffset_ -= event.wheel.y * 20;
-                messageScrollOffset_ = std::max(0, messageScrollOffset_);
-            } else if (isMouseOver(friendListArea_, event.wheel.x, event.wheel.y)) {
+            // 处理滚轮事件，wheel中是滚动量，指针位置需要另外获取
+            int mouseX, mouseY;
+            SDL_GetMouseState(&mouseX, &mouseY);
+            if (isMouseOver(messageArea_, mouseX, mouseY)) {
+                // 向上滚动查看更早的消息
+                messageScrollOffset_ += event.wheel.y * 20;
+                messageScrollOffset_ = std::max(0, std::min(messageScrollOffset_, maxMessageScroll()));
+                invalidate(REGION_CHAT);
+            } else if (isMouseOver(friendListArea_, mouseX, mouseY)) {
                 friendListScrollOffset_ -= event.wheel.y * 20;
-                friendListScrollOffset_ = std::max(0, friendListScrollOffset_);
+                friendListScrollOffset_ = std::max(0, std::min(friendListScrollOffset_, maxFriendListScroll()));
+                invalidate(REGION_FRIEND_LIST);
             }
             break;
         }
         case SDL_TEXTINPUT:
             if (isInputFocused_) {
                 handleTextInput(event.text.text);
+            } else if (isSearchFocused_) {
+                // 输入只会让过滤条件变长，增量筛选
+                friendFilter_ += event.text.text;
+                applyFriendFilter(true);
             }
             break;
         case SDL_KEYDOWN:
             if (isInputFocused_) {
                 handleKeyPress(event.key.keysym.sym);
+            } else if (isSearchFocused_) {
+                if (event.key.keysym.sym == SDLK_BACKSPACE && !friendFilter_.empty()) {
+                    // 按UTF-8字符删除，避免留下半个中文
+                    size_t pos = friendFilter_.size() - 1;
+                    while (pos > 0 && (static_cast<unsigned char>(friendFilter_[pos]) & 0xC0) == 0x80) {
+                        --pos;
+                    }
+                    friendFilter_.erase(pos);
+                    applyFriendFilter(false);
+                } else if (event.key.keysym.sym == SDLK_RETURN && !friendFilter_.empty()) {
+                    searchMessages(friendFilter_);
+                } else if (event.key.keysym.sym == SDLK_ESCAPE) {
+                    friendFilter_.clear();
+                    applyFriendFilter(false);
+                    if (isShowingSearch_) {
+                        isShowingSearch_ = false;
+                        clearChatHistory();
+                        invalidate(REGION_ALL);
+                    }
+                }
+            }
+            break;
+        case SDL_DROPFILE:
+            // 拖入窗口的文件发给当前好友
+            if (event.drop.file) {
+                if (selectedFriend_) {
+                    startUpload(event.drop.file);
+                } else {
+                    std::cout << "请先选择要发送文件的好友" << std::endl;
+                }
+                SDL_free(event.drop.file);
             }
             break;
     }
@@ -413,22 +761,26 @@ void ChatWindow::sendMessage() {
     // 创建消息
     Message msg(currentUser_->getUserId(), 
                selectedFriend_->getUserId(),
-               inputText_);
+               inputText_, MessageType::CHAT);
     
     // 发送消息
     networkManager_->sendMessage(msg);
     
     // 添加到本地聊天记录
-    chatHistory_.push_back(msg);
+    addMessage(msg);
     
     // 清空输入框
     inputText_.clear();
+    invalidate(REGION_CHAT | REGION_INPUT);
 }
 
 void ChatWindow::loadFriendList() {
-    // 发送获取好友列表请求
+    // 发送获取好友列表请求，带上已有版本，列表未变化时服务器只回复版本号
     Json::Value request;
     request["userId"] = currentUser_->getUserId();
+    if (friendListVersion_ != 0) {
+        request["version"] = Json::Value::UInt64(friendListVersion_);
+    }
     
     Message msg(currentUser_->getUserId(), 0, 
                request.toStyledString(), MessageType::GET_FRIEND_LIST);
@@ -438,16 +790,136 @@ void ChatWindow::loadFriendList() {
 void ChatWindow::loadChatHistory() {
     if (!selectedFriend_) return;
     
-    // TODO: 从服务器获取聊天记录
-    chatHistory_.clear();
-    // 临时添加测试消息
-    Message msg(currentUser_->getUserId(), selectedFriend_->getUserId(), 
-               "这是一条测试消息");
-    chatHistory_.push_back(msg);
+    // 先直接显示本地已有的消息，再向服务器请求上次同步之后的部分
+    clearChatHistory();
+    int64_t friendId = selectedFriend_->getUserId();
+    int64_t afterId = 0;
+    if (messageStore_ && messageStore_->isOpen()) {
+        auto start = std::chrono::steady_clock::now();
+        for (const auto& msg : messageStore_->load(friendId, MAX_LOADED_MESSAGES)) {
+            addMessage(msg);
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        std::cout << "从本地载入" << chatHistory_.size() << "条聊天记录，耗时"
+                  << elapsed << "微秒" << std::endl;
+        afterId = messageStore_->syncedId(friendId);
+    }
+    markConversationRead();
+    requestChatHistory(friendId, afterId);
+}
+
+void ChatWindow::requestChatHistory(int64_t friendId, int64_t afterId) {
+    Json::Value request;
+    request["otherUserId"] = Json::Value::Int64(friendId);
+    request["afterId"] = Json::Value::Int64(afterId);
+    request["limit"] = HISTORY_PAGE_SIZE;
+
+    Json::FastWriter writer;
+    Message msg(currentUser_->getUserId(), 0, writer.write(request), MessageType::GET_CHAT_HISTORY);
+    networkManager_->sendMessage(msg);
+}
+
+void ChatWindow::markConversationRead() {
+    if (!selectedFriend_ || !networkManager_) {
+        return;
+    }
+    int64_t peerId = selectedFriend_->getUserId();
+    int64_t lastReadId = 0;
+    for (const auto& msg : chatHistory_) {
+        if (msg.getSenderId() == peerId) {
+            lastReadId = std::max(lastReadId, msg.getMessageId());
+        }
+    }
+    if (lastReadId <= readMarkers_[peerId]) {
+        return;
+    }
+    readMarkers_[peerId] = lastReadId;
+
+    Json::Value request;
+    request["peerId"] = Json::Value::Int64(peerId);
+    request["lastReadId"] = Json::Value::Int64(lastReadId);
+    Json::FastWriter writer;
+    networkManager_->sendMessage(Message(currentUser_->getUserId(), 0, writer.write(request),
+                                         MessageType::MARK_READ));
+}
+
+bool ChatWindow::storeMessage(const Message& msg) {
+    if (!messageStore_ || !messageStore_->isOpen()) {
+        return false;
+    }
+    int64_t peerId = msg.getSenderId() == currentUser_->getUserId() ? msg.getReceiverId() : msg.getSenderId();
+    if (!messageStore_->append(msg, peerId)) {
+        return false;
+    }
+
+    // 新写入的记录立即进入全文索引
+    if (searchIndex_) {
+        searchIndex_->update(*messageStore_);
+    }
+    return true;
+}
+
+void ChatWindow::searchMessages(const std::string& query) {
+    // 本机没有的记录（其他设备上收发的）由服务器搜索补充
+    Json::Value request;
+    request["query"] = query;
+    request["limit"] = static_cast<int>(MAX_SEARCH_RESULTS);
+    Json::FastWriter writer;
+    networkManager_->sendMessage(Message(currentUser_->getUserId(), 0, writer.write(request),
+                                         MessageType::SEARCH_MESSAGES));
+
+    selectedFriend_ = nullptr;
+    isShowingSearch_ = true;
+    searchQuery_ = query;
+    clearChatHistory();
+    invalidate(REGION_ALL);
+    if (!searchIndex_ || !messageStore_ || !messageStore_->isOpen()) {
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto offsets = searchIndex_->search(query, MAX_SEARCH_RESULTS, *messageStore_);
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    std::cout << "搜索\"" << query << "\"：" << offsets.size() << "条结果，耗时"
+              << elapsed << "微秒" << std::endl;
+
+    // 结果按时间顺序显示在聊天区域，最新的在底部
+    Message msg;
+    int64_t peerId = 0;
+    for (auto it = offsets.rbegin(); it != offsets.rend(); ++it) {
+        if (messageStore_->read(*it, msg, peerId) != 0) {
+            addMessage(msg);
+        }
+    }
+    invalidate(REGION_ALL);
 }
 
 void ChatWindow::setUser(std::shared_ptr<User> user) {
     currentUser_ = user;
+    invalidate(REGION_ALL);
+
+    // 每个账号一份本地消息库
+    auto start = std::chrono::steady_clock::now();
+    messageStore_.reset(new MessageStore());
+    std::string dataDir = "data/" + std::to_string(currentUser_->getUserId());
+    if (messageStore_->open(dataDir)) {
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        std::cout << "本地消息库已打开：" << messageStore_->messageCount() << "条消息，"
+                  << messageStore_->conversationCount() << "个会话，耗时" << elapsed << "毫秒" << std::endl;
+
+        // 载入全文索引并补上上次保存之后写入的消息
+        start = std::chrono::steady_clock::now();
+        searchIndex_.reset(new SearchIndex());
+        searchIndex_->open(dataDir + "/search.idx", *messageStore_);
+        elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        std::cout << "消息索引已载入：" << searchIndex_->tokenCount() << "个词，耗时"
+                  << elapsed << "毫秒" << std::endl;
+    }
+
     // 加载好友列表
     loadFriendList();
 }
@@ -455,43 +927,8 @@ void ChatWindow::setUser(std::shared_ptr<User> user) {
 void ChatWindow::renderText(const std::string& text, const SDL_Rect& rect, const SDL_Color& color) {
     if (!font_) return;
 
-    // 量定义移到类的私有成员中
-    static const int kCharWidth = 16;     // 英文字符宽度
-    static const int kWideCharWidth = 24; // 中文字符宽度
-    static const int kCharHeight = 24;    // 字符高度
-
-    int x = rect.x;
-    int y = rect.y + (rect.h - kCharHeight) / 2;  // 垂直居中
-
-    std::string::const_iterator it = text.begin();
-    while (it != text.end()) {
-        int charLen = 1;
-        if ((*it & 0x80) != 0) {  // UTF-8多字节字符
-            if ((*it & 0xE0) == 0xC0) charLen = 2;
-            else if ((*it & 0xF0) == 0xE0) charLen = 3;
-            else if ((*it & 0xF8) == 0xF0) charLen = 4;
-        }
-
-        // 检查是否超出显示区域
-        int charWidth = (charLen > 1) ? kWideCharWidth : kCharWidth;
-        if (x + charWidth > rect.x + rect.w) break;
-
-        // 渲染当前字符
-        std::string currentChar(it, it + charLen);
-        SDL_Surface* surface = TTF_RenderUTF8_Blended(font_, currentChar.c_str(), color);
-        if (surface) {
-            SDL_Texture* texture = SDL_CreateTextureFromSurface(renderer_, surface);
-            if (texture) {
-                SDL_Rect charRect = {x, y, charWidth, kCharHeight};
-                SDL_RenderCopy(renderer_, texture, nullptr, &charRect);
-                SDL_DestroyTexture(texture);
-            }
-            SDL_FreeSurface(surface);
-        }
-
-        x += charWidth;
-        it += charLen;
-    }
+    // 字形和排版结果都有缓存，稳定状态下每页纹理只提交一次几何
+    glyphAtlas_->drawText(font_, text, rect, color);
 }
 
 void ChatWindow::renderButton(const SDL_Rect& button, const std::string& text, bool isHovered) {
@@ -504,8 +941,8 @@ void ChatWindow::renderButton(const SDL_Rect& button, const std::string& text, b
     SDL_RenderFillRect(renderer_, &button);
 
     // 计算文本位置（居中）
-    int textWidth, textHeight;
-    TTF_SizeText(font_, text.c_str(), &textWidth, &textHeight);
+    int textWidth = glyphAtlas_->measure(font_, text);
+    int textHeight = GlyphAtlas::CELL_HEIGHT;
     SDL_Rect textRect = {
         button.x + (button.w - textWidth) / 2,
         button.y + (button.h - textHeight) / 2,
@@ -526,6 +963,7 @@ bool ChatWindow::isMouseOver(const SDL_Rect& rect, int x, int y) {
 void ChatWindow::handleTextInput(const std::string& text) {
     if (isInputFocused_ && inputText_.length() < 1000) { // 限制输入长度
         inputText_ += text;
+        resetCursorBlink();
     }
 }
 
@@ -536,6 +974,7 @@ void ChatWindow::handleKeyPress(SDL_Keycode key) {
         case SDLK_BACKSPACE:
             if (!inputText_.empty()) {
                 inputText_.pop_back();
+                resetCursorBlink();
             }
             break;
         case SDLK_RETURN:
@@ -545,39 +984,100 @@ void ChatWindow::handleKeyPress(SDL_Keycode key) {
 }
 
 ChatWindow::~ChatWindow() {
+    // 取消未完成的传输，已传的部分保留，下次可以续传
+    for (auto& task : transfers_) {
+        task->cancel = true;
+    }
+    for (auto& task : transfers_) {
+        if (task->worker.joinable()) {
+            task->worker.join();
+        }
+    }
+
+    // 保存全文索引和会话索引，下次启动不必回放整个日志
+    if (searchIndex_) {
+        searchIndex_->save();
+        searchIndex_.reset();
+    }
+    messageStore_.reset();
+
+    // 图集里的纹理和缓存的字形引用字体，先于字体释放
+    clearFriendRows();
+    glyphAtlas_.reset();
     if (font_) {
         TTF_CloseFont(font_);
     }
 }
 
 void ChatWindow::handleNewMessage(const Message& msg) {
-    chatHistory_.push_back(msg);
-    
-    // 如果消息不是当前选中的好友发送的，增加未读计数
-    if (!selectedFriend_ || msg.getSenderId() != selectedFriend_->getUserId()) {
-        unreadCounts_[msg.getSenderId()]++;
+    // 重连后服务器可能重发已收到的消息，本地库里已有的不再显示
+    if (msg.getMessageId() > 0 && messageStore_ && messageStore_->isOpen() && !storeMessage(msg)) {
+        return;
+    }
+
+    // 只显示当前会话的消息，其他好友的消息增加未读计数；自己发出的文件消息也会由服务器推送回来
+    bool sentByMe = msg.getSenderId() == currentUser_->getUserId();
+    int64_t peerId = sentByMe ? msg.getReceiverId() : msg.getSenderId();
+    if (selectedFriend_ && peerId == selectedFriend_->getUserId()) {
+        addMessage(msg);
+        if (!sentByMe) {
+            markConversationRead();
+        }
+    } else if (!sentByMe) {
+        unreadCounts_[peerId]++;
+    }
+
+    // 收到的文件自动下载
+    if (!sentByMe && (msg.getType() == MessageType::FILE || msg.getType() == MessageType::IMAGE)) {
+        startDownload(msg);
     }
     
     // 标记消息为已送达
     messageDelivered_[msg.getMessageId()] = true;
+    invalidate(REGION_CHAT | REGION_FRIEND_LIST);
 }
 
 void ChatWindow::refreshFriendList() {
-    // 发送获取好友列表请求
-    Json::Value request;
-    request["userId"] = currentUser_->getUserId();
-    
-    Message msg(currentUser_->getUserId(), 0, 
-               request.toStyledString(), MessageType::GET_FRIEND_LIST);
-    networkManager_->sendMessage(msg);
+    loadFriendList();
 }
 
-void ChatWindow::updateFriendStatus(int64_t friendId, bool online) {
-    for (auto& friend_ : friendList_) {
-        if (friend_->getUserId() == friendId) {
-            friend_->setOnline(online);
-            break;
+void ChatWindow::handleFriendListResponse(const Message& msg) {
+    Json::Value response;
+    Json::Reader reader;
+    if (!reader.parse(msg.getContent(), response)) {
+        return;
+    }
+
+    friendListVersion_ = response["version"].asUInt64();
+    if (!response.isMember("friends")) {
+        return;  // 列表未变化
+    }
+
+    std::vector<std::shared_ptr<User>> friends;
+    for (const auto& item : response["friends"]) {
+        auto friend_ = std::make_shared<User>();
+        friend_->setUserId(item["id"].asInt64());
+        friend_->setUsername(item["username"].asString());
+        friend_->setNickname(item["nickname"].asString());
+        friend_->setOnline(item["online"].asBool());
+        unreadCounts_[friend_->getUserId()] = item["unread"].asInt();
+
+        // 保持当前选中的好友
+        if (selectedFriend_ && selectedFriend_->getUserId() == friend_->getUserId()) {
+            selectedFriend_ = friend_;
         }
+        friends.push_back(friend_);
+    }
+    friendList_.swap(friends);
+    rebuildFriendIndex();
+    invalidate(REGION_FRIEND_LIST | REGION_TOP_BAR);
+}
+
+void ChatWindow::updateFriendStatus(int64_t friendId, bool online) {
+    auto it = friendIndex_.find(friendId);
+    if (it != friendIndex_.end()) {
+        friendList_[it->second]->setOnline(online);
+        invalidate(REGION_FRIEND_LIST);
     }
 }
 
@@ -586,14 +1086,19 @@ void ChatWindow::showAddFriendDialog() {
     std::string username;
     bool running = true;
     bool confirmed = false;
+    std::vector<SDL_Event> deferred;  // 对话框不处理的事件（退出、网络通知），关闭后放回队列
     SDL_StartTextInput();
 
     while (running) {
         SDL_Event event;
         while (SDL_PollEvent(&event)) {
             if (event.type == SDL_QUIT) {
+                deferred.push_back(event);
                 running = false;
             }
+            else if (event.type >= SDL_USEREVENT) {
+                deferred.push_back(event);
+            }
             else if (event.type == SDL_KEYDOWN) {
                 if (event.key.keysym.sym == SDLK_RETURN) {
                     confirmed = true;
@@ -640,10 +1145,14 @@ void ChatWindow::showAddFriendDialog() {
         renderText("输入要添加的好友用户名，按Enter确认", hintRect, {128, 128, 128, 255});
 
         SDL_RenderPresent(renderer_);
-        SDL_Delay(16);  // 限制帧率
+        SDL_WaitEventTimeout(nullptr, 500);  // 有输入时才重绘，不再按固定帧率空转
     }
 
     SDL_StopTextInput();
+    for (SDL_Event& event : deferred) {
+        SDL_PushEvent(&event);
+    }
+    invalidate(REGION_ALL);  // 对话框覆盖了整个窗口
 
     if (confirmed && !username.empty()) {
         // 发送添加好友请求
@@ -661,8 +1170,54 @@ void ChatWindow::showAddFriendDialog() {
     }
 }
 
+void ChatWindow::setNetworkManager(std::shared_ptr<NetworkManager> networkManager) {
+    networkManager_ = networkManager;
+
+    const MessageType types[] = {
+        MessageType::CHAT,
+        MessageType::FILE,
+        MessageType::IMAGE,
+        MessageType::CHAT_ACK,
+        MessageType::CHAT_HISTORY_RESPONSE,
+        MessageType::SEARCH_RESULTS,
+        MessageType::FRIEND_LIST_RESPONSE,
+        MessageType::PRESENCE,
+        MessageType::FRIEND_REQUEST_NOTIFICATION,
+    };
+    for (MessageType type : types) {
+        networkManager_->subscribe(type, [this](const Message& msg) { handleMessage(msg); });
+    }
+}
+
 void ChatWindow::handleMessage(const Message& msg) {
     switch (msg.getType()) {
+        case MessageType::CHAT:
+        case MessageType::FILE:
+        case MessageType::IMAGE:
+            handleNewMessage(msg);
+            break;
+        case MessageType::CHAT_ACK:
+            handleChatAck(msg);
+            break;
+        case MessageType::CHAT_HISTORY_RESPONSE:
+            handleChatHistoryResponse(msg);
+            break;
+        case MessageType::SEARCH_RESULTS:
+            handleSearchResults(msg);
+            break;
+        case MessageType::FRIEND_LIST_RESPONSE:
+            handleFriendListResponse(msg);
+            break;
+        case MessageType::PRESENCE: {
+            Json::Value presence;
+            Json::Reader reader;
+            if (reader.parse(msg.getContent(), presence)) {
+                for (const auto& update : presence["updates"]) {
+                    updateFriendStatus(update["userId"].asInt64(), update["online"].asBool());
+                }
+            }
+            break;
+        }
         case MessageType::FRIEND_REQUEST_NOTIFICATION: {
             Json::Value notification;
             Json::Reader reader;
@@ -679,6 +1234,147 @@ void ChatWindow::handleMessage(const Message& msg) {
     }
 }
 
+void ChatWindow::handleChatAck(const Message& msg) {
+    Json::Value ack;
+    Json::Reader reader;
+    if (!reader.parse(msg.getContent(), ack)) {
+        return;
+    }
+
+    if (ack.isMember("groupId")) {
+        return;  // 群消息不在私聊记录中
+    }
+
+    int64_t messageId = ack["messageId"].asInt64();
+    int64_t receiverId = ack["receiverId"].asInt64();
+
+    if (!ack.get("success", true).asBool()) {
+        // 服务器拒收，最早一条未确认的消息标记为发送失败（消息ID为-1），不再等待确认
+        std::cerr << "消息发送失败: " << ack["error"].asString() << std::endl;
+        for (auto& sent : chatHistory_) {
+            if (sent.getMessageId() == 0 &&
+                sent.getSenderId() == currentUser_->getUserId() &&
+                sent.getReceiverId() == receiverId) {
+                sent.setMessageId(-1);
+                break;
+            }
+        }
+        invalidate(REGION_CHAT);
+        return;
+    }
+
+    // 同一连接上的确认按发送顺序到达，对应最早一条尚未分配ID的已发送消息
+    for (auto& sent : chatHistory_) {
+        if (sent.getMessageId() == 0 &&
+            sent.getSenderId() == currentUser_->getUserId() &&
+            sent.getReceiverId() == receiverId) {
+            sent.setMessageId(messageId);
+            sent.setTimestamp(static_cast<std::time_t>(ack["timestamp"].asInt64()));
+            storeMessage(sent);
+            break;
+        }
+    }
+    messageDelivered_[messageId] = true;
+    invalidate(REGION_CHAT);
+}
+
+void ChatWindow::handleChatHistoryResponse(const Message& msg) {
+    Json::Value response;
+    Json::Reader reader;
+    if (!reader.parse(msg.getContent(), response)) {
+        return;
+    }
+
+    int64_t friendId = response["otherUserId"].asInt64();
+    bool isOpenConversation = selectedFriend_ && selectedFriend_->getUserId() == friendId;
+    int64_t lastShownId = chatHistory_.empty() ? 0 : chatHistory_.back().getMessageId();
+
+    // 写入本地库，重复的消息会被跳过
+    std::vector<Message> inserted;
+    int64_t lastId = messageStore_ ? messageStore_->syncedId(friendId) : 0;
+    for (const auto& item : response["messages"]) {
+        Message history = Message::fromJson(item);
+        lastId = std::max(lastId, history.getMessageId());
+        if (storeMessage(history) || !messageStore_ || !messageStore_->isOpen()) {
+            inserted.push_back(history);
+        }
+    }
+
+    bool hasMore = response["hasMore"].asBool();
+    if (messageStore_ && messageStore_->isOpen()) {
+        messageStore_->markSynced(friendId, lastId, !hasMore);
+        if (!hasMore) {
+            messageStore_->flush();
+        }
+    }
+
+    if (isOpenConversation && !inserted.empty()) {
+        if (inserted.front().getMessageId() > lastShownId) {
+            // 补拉到的都比已显示的新，直接追加
+            for (const auto& history : inserted) {
+                addMessage(history);
+            }
+        } else if (messageStore_ && messageStore_->isOpen()) {
+            // 插在已显示的消息中间，按本地库重新载入当前会话
+            int scrollOffset = messageScrollOffset_;
+            clearChatHistory();
+            for (const auto& stored : messageStore_->load(friendId, MAX_LOADED_MESSAGES)) {
+                addMessage(stored);
+            }
+            messageScrollOffset_ = std::min(scrollOffset, maxMessageScroll());
+        }
+        markConversationRead();
+    }
+
+    if (hasMore) {
+        requestChatHistory(friendId, lastId);
+    }
+}
+
+void ChatWindow::handleSearchResults(const Message& msg) {
+    Json::Value response;
+    Json::Reader reader;
+    if (!reader.parse(msg.getContent(), response)) {
+        return;
+    }
+
+    // 用户已离开搜索或换了关键字，丢弃过时的结果
+    if (!isShowingSearch_ || response["query"].asString() != searchQuery_) {
+        return;
+    }
+
+    // 服务器搜索失败时只显示本机的结果
+    if (!response.get("success", true).asBool()) {
+        std::cerr << "服务器搜索失败: " << response["error"].asString() << std::endl;
+        return;
+    }
+
+    // 合并本地没有的结果，按消息ID重新排序
+    std::unordered_set<int64_t> shown;
+    for (const auto& existing : chatHistory_) {
+        shown.insert(existing.getMessageId());
+    }
+    std::vector<Message> merged = chatHistory_;
+    for (const auto& item : response["messages"]) {
+        Message found = Message::fromJson(item);
+        if (shown.insert(found.getMessageId()).second) {
+            merged.push_back(found);
+        }
+    }
+    if (merged.size() == chatHistory_.size()) {
+        return;
+    }
+
+    std::stable_sort(merged.begin(), merged.end(), [](const Message& a, const Message& b) {
+        return a.getMessageId() < b.getMessageId();
+    });
+    clearChatHistory();
+    for (const auto& found : merged) {
+        addMessage(found);
+    }
+    invalidate(REGION_ALL);
+}
+
 void ChatWindow::showFriendRequestDialog(int64_t fromUserId, const std::string& fromUsername) {
     // 创建好友请求对话框
     SDL_Rect dialogRect = {width_/2 - 200, height_/2 - 100, 400, 200};
@@ -687,13 +1383,18 @@ void ChatWindow::showFriendRequestDialog(int64_t fromUserId, const std::string&
     
     bool running = true;
     bool accepted = false;
+    std::vector<SDL_Event> deferred;
     
     while (running) {
         SDL_Event event;
         while (SDL_PollEvent(&event)) {
             if (event.type == SDL_QUIT) {
+                deferred.push_back(event);
                 running = false;
             }
+            else if (event.type >= SDL_USEREVENT) {
+                deferred.push_back(event);
+            }
             else if (event.type == SDL_MOUSEBUTTONDOWN) {
                 int mouseX = event.button.x;
                 int mouseY = event.button.y;
@@ -724,7 +1425,12 @@ void ChatWindow::showFriendRequestDialog(int64_t fromUserId, const std::string&
         renderButton(rejectButton, "拒绝", false);
 
         SDL_RenderPresent(renderer_);
+        SDL_WaitEventTimeout(nullptr, 500);  // 原先这里没有任何等待，会占满一个核
+    }
+    for (SDL_Event& event : deferred) {
+        SDL_PushEvent(&event);
     }
+    invalidate(REGION_ALL);
 
     if (accepted) {
         // 发送接受好友请求的消息
@@ -740,4 +1446,247 @@ void ChatWindow::showFriendRequestDialog(int64_t fromUserId, const std::string&
     }
 }
 
+std::string ChatWindow::messageText(const Message& msg) {
+    if (msg.getType() != MessageType::FILE && msg.getType() != MessageType::IMAGE) {
+        return msg.getContent();
+    }
+
+    // 文件消息的正文是文件描述
+    Json::Value content;
+    Json::Reader reader;
+    if (!reader.parse(msg.getContent(), content)) {
+        return "[文件]";
+    }
+    return std::string(msg.getType() == MessageType::IMAGE ? "[图片] " : "[文件] ") +
+           content["fileName"].asString() + " (" + formatSize(content["fileSize"].asUInt64()) + ")";
+}
+
+void ChatWindow::startUpload(const std::string& path) {
+    std::error_code error;
+    if (!std::filesystem::is_regular_file(path, error)) {
+        std::cerr << "只能发送普通文件: " << path << std::endl;
+        return;
+    }
+
+    std::string extension = toLowerAscii(std::filesystem::path(path).extension().string());
+    bool image = extension == ".png" || extension == ".jpg" || extension == ".jpeg" ||
+                 extension == ".gif" || extension == ".bmp";
+
+    auto task = std::make_unique<TransferTask>();
+    task->fileName = std::filesystem::path(path).filename().string();
+    task->upload = true;
+    task->worker = std::thread(&ChatWindow::runUpload, networkManager_, task.get(),
+                               currentUser_->getUserId(), selectedFriend_->getUserId(), path, image);
+    transfers_.push_back(std::move(task));
+    pollTransfers();
+}
+
+void ChatWindow::startDownload(const Message& msg) {
+    Json::Value content;
+    Json::Reader reader;
+    if (!reader.parse(msg.getContent(), content)) {
+        return;
+    }
+
+    // 文件名前加上文件ID，同名文件不会互相覆盖，中断后也能找到续传的.part
+    int64_t fileId = content["fileId"].asInt64();
+    std::string fileName = std::filesystem::path(content["fileName"].asString()).filename().string();
+    if (fileName.empty() || fileName == "." || fileName == "..") {
+        fileName = "file";
+    }
+    std::error_code error;
+    std::filesystem::create_directories("downloads", error);
+    std::string path = "downloads/" + std::to_string(fileId) + "_" + fileName;
+    if (std::filesystem::exists(path, error)) {
+        return;  // 已经下载过
+    }
+
+    auto task = std::make_unique<TransferTask>();
+    task->fileName = fileName;
+    task->upload = false;
+    task->worker = std::thread(&ChatWindow::runDownload, networkManager_, task.get(),
+                               currentUser_->getUserId(), fileId, path);
+    transfers_.push_back(std::move(task));
+    pollTransfers();
+}
+
+int ChatWindow::pollTransfers() {
+    if (transfers_.empty()) {
+        return -1;
+    }
+
+    std::string status;
+    for (auto it = transfers_.begin(); it != transfers_.end();) {
+        TransferTask& task = **it;
+        if (task.finished) {
+            task.worker.join();
+            std::cout << task.result << std::endl;
+            transferStatus_ = task.result;
+            it = transfers_.erase(it);
+            continue;
+        }
+
+        uint64_t total = task.total;
+        int percent = total > 0 ? static_cast<int>(task.done * 100 / total) : 0;
+        if (task.hashing) {
+            status = "正在校验 " + task.fileName + " " + std::to_string(percent) + "%";
+        } else {
+            status = (task.upload ? "正在发送 " : "正在接收 ") + task.fileName + " " + std::to_string(percent) + "%";
+        }
+        if (transfers_.size() > 1) {
+            status += "（共" + std::to_string(transfers_.size()) + "个）";
+        }
+        ++it;
+    }
+
+    if (!status.empty() && status != transferStatus_) {
+        transferStatus_ = status;
+    }
+    invalidate(REGION_TOP_BAR);
+    return transfers_.empty() ? -1 : static_cast<int>(TRANSFER_POLL_MS);
+}
+
+void ChatWindow::runUpload(std::shared_ptr<NetworkManager> networkManager, TransferTask* task,
+                           int64_t userId, int64_t receiverId, const std::string& path, bool image) {
+    std::error_code error;
+    Json::Value request;
+    request["receiverId"] = Json::Value::Int64(receiverId);
+    request["fileName"] = task->fileName;
+    request["fileSize"] = Json::Value::UInt64(std::filesystem::file_size(path, error));
+    request["image"] = image;
+    task->total = request["fileSize"].asUInt64();
+
+    auto progress = [task](uint64_t done, uint64_t total) {
+        task->done = done;
+        task->total = total;
+        return !task->cancel;
+    };
+
+    // 先计算内容哈希，服务器已有相同内容时不再传输（秒传）；大文件要读一段时间，期间可以取消
+    task->hashing = true;
+    std::string hash = ContentStore::hashFile(path, [task](uint64_t hashed) {
+        task->done = hashed;
+        return !task->cancel;
+    });
+    task->hashing = false;
+    task->done = 0;
+    if (task->cancel) {
+        task->result = "发送" + task->fileName + "失败: 已取消";
+        task->finished = true;
+        return;
+    }
+    if (!hash.empty()) {
+        request["sha256"] = hash;
+    }
+
+    Json::FastWriter writer;
+    auto send = [&](Json::Value& response) {
+        try {
+            Message reply = networkManager->request(
+                Message(userId, 0, writer.write(request), MessageType::FILE_UPLOAD_REQUEST),
+                std::chrono::seconds(10)).get();
+            Json::Reader reader;
+            reader.parse(reply.getContent(), response);
+            return true;
+        } catch (const std::exception& e) {
+            task->result = "发送" + task->fileName + "失败: " + e.what();
+            return false;
+        }
+    };
+
+    for (int attempt = 0; attempt < MAX_TRANSFER_ATTEMPTS && !task->cancel; ++attempt) {
+        if (attempt > 0) {
+            std::this_thread::sleep_for(std::chrono::seconds(attempt));
+        }
+
+        // 第一次登记文件，之后凭fileId续传，服务器回复已收到的位置
+        Json::Value response;
+        if (!send(response)) {
+            continue;
+        }
+        if (response["success"].asBool() && response.isMember("challenge")) {
+            // 服务器已有相同内容，回答文件中指定一段的哈希以证明本地持有该文件
+            const Json::Value& challenge = response["challenge"];
+            request["proof"] = ContentStore::hashRange(path, challenge["nonce"].asString(),
+                                                       challenge["offset"].asUInt64(),
+                                                       challenge["length"].asUInt64());
+            response = Json::Value();
+            if (!send(response)) {
+                continue;
+            }
+        }
+        if (!response["success"].asBool() || response.isMember("challenge")) {
+            task->result = "发送" + task->fileName + "失败: " + response.get("error", "服务器校验未通过").asString();
+            break;
+        }
+        if (response["deduplicated"].asBool()) {
+            task->done = task->total.load();
+            task->result = "已秒传 " + task->fileName + "，节省上传" + formatSize(task->total);
+            break;
+        }
+        request = Json::Value();
+        request["fileId"] = response["fileId"];
+
+        FileTransferClient client(networkManager->getHost(), response["port"].asInt());
+        if (client.upload(response["fileId"].asInt64(), response["ticket"].asString(), path, progress)) {
+            double seconds = client.elapsedSeconds();
+            task->result = "已发送 " + task->fileName + "，" + formatSize(client.transferredBytes()) +
+                           (seconds > 0 ? "，" + formatSize(static_cast<uint64_t>(client.transferredBytes() / seconds)) + "/s" : "");
+            break;
+        }
+        task->result = "发送" + task->fileName + "失败: " + client.lastError();
+        if (client.cancelled()) {
+            break;
+        }
+    }
+    task->finished = true;
+}
+
+void ChatWindow::runDownload(std::shared_ptr<NetworkManager> networkManager, TransferTask* task,
+                             int64_t userId, int64_t fileId, const std::string& path) {
+    Json::Value request;
+    request["fileId"] = Json::Value::Int64(fileId);
+
+    auto progress = [task](uint64_t done, uint64_t total) {
+        task->done = done;
+        task->total = total;
+        return !task->cancel;
+    };
+
+    Json::FastWriter writer;
+    for (int attempt = 0; attempt < MAX_TRANSFER_ATTEMPTS && !task->cancel; ++attempt) {
+        if (attempt > 0) {
+            std::this_thread::sleep_for(std::chrono::seconds(attempt));
+        }
+
+        Json::Value response;
+        try {
+            Message reply = networkManager->request(
+                Message(userId, 0, writer.write(request), MessageType::FILE_DOWNLOAD_REQUEST),
+                std::chrono::seconds(10)).get();
+            Json::Reader reader;
+            reader.parse(reply.getContent(), response);
+        } catch (const std::exception& e) {
+            task->result = "接收" + task->fileName + "失败: " + e.what();
+            continue;
+        }
+        if (!response["success"].asBool()) {
+            task->result = "接收" + task->fileName + "失败: " + response["error"].asString();
+            break;
+        }
+
+        // 中断后path.part中已有的完整块不再重新下载
+        FileTransferClient client(networkManager->getHost(), response["port"].asInt());
+        if (client.download(fileId, response["ticket"].asString(), path, progress)) {
+            task->result = "已保存 " + path;
+            break;
+        }
+        task->result = "接收" + task->fileName + "失败: " + client.lastError();
+        if (client.cancelled()) {
+            break;
+        }
+    }
+    task->finished = true;
+}
+
 // ... 继续实现其他方法 ...
\ No newline at end of file
@@ -6,14 +6,23 @@
 #include <vector>
 #include <memory>
 #include <chrono>
+#include <atomic>
+#include <thread>
+#include <unordered_map>
 #include "../core/User.h"
 #include "../core/Message.h"
 #include "../core/NetworkManager.h"
+#include "../core/MessageStore.h"
+#include "../core/SearchIndex.h"
+#include "GlyphAtlas.h"
 
 class ChatWindow {
 private:
     SDL_Renderer* renderer_;
     TTF_Font* font_;
+    std::unique_ptr<GlyphAtlas> glyphAtlas_;  // 字形图集，文本绘制都经过它
+    std::unique_ptr<MessageStore> messageStore_;  // 本地消息库，打开会话时直接从磁盘读取
+    std::unique_ptr<SearchIndex> searchIndex_;    // 本地消息库的全文索引
     int width_;
     int height_;
     
@@ -30,16 +39,53 @@ private:
     std::shared_ptr<User> currentUser_;
     std::shared_ptr<User> selectedFriend_;
     std::vector<std::shared_ptr<User>> friendList_;
+    uint64_t friendListVersion_;  // 服务器返回的好友列表版本，0表示尚未加载
     
     // 消息相关
     std::string inputText_;
     std::vector<Message> chatHistory_;
     bool isInputFocused_;
+
+    // 消息列表的虚拟化布局，与chatHistory_一一对应
+    // messageOffsets_[i]是第i条消息（含上方间距）在内容中的起始位置，最后一个元素是内容总高度
+    std::vector<int> messageOffsets_;
+    std::vector<int> messageWidths_;  // 每条消息的文本宽度
+
+    // 好友列表虚拟化：过滤后的好友下标，只处理可见的行
+    std::vector<size_t> visibleFriends_;
+    std::vector<std::string> friendSearchKeys_;        // 与friendList_对应的小写昵称和用户名
+    std::unordered_map<int64_t, size_t> friendIndex_;  // 好友ID到friendList_下标
+    std::string friendFilter_;
+    bool isSearchFocused_;
+    SDL_Rect friendSearchBox_;  // 好友搜索框
+    SDL_Rect friendListView_;   // 好友行的可见区域
+
+    // 消息搜索：在搜索框中按回车，聊天区域显示所有会话中的匹配消息
+    bool isShowingSearch_;
+    std::string searchQuery_;
+
+    // 好友行纹理缓存，名称、在线状态、未读数或选中状态变化时才重新绘制
+    struct FriendRow {
+        SDL_Texture* texture;
+        std::string nickname;
+        bool online;
+        int unread;
+        bool selected;
+        int width;
+        uint64_t lastUsed;  // 最近一次显示时的帧号
+    };
+    std::unordered_map<int64_t, FriendRow> friendRows_;
+    uint64_t friendListFrame_;
     
     // 滚动相关
     int messageScrollOffset_;
     int friendListScrollOffset_;
 
+    // 重绘相关
+    unsigned dirtyRegions_;    // 需要重绘的区域（Region位掩码）
+    bool cursorVisible_;       // 输入框光标当前是否显示
+    Uint32 cursorBlinkTime_;   // 光标上次切换的时间
+
     // UI颜色
     SDL_Color bgColor_;
     SDL_Color topBarColor_;
@@ -65,17 +111,62 @@ private:
     
     // 未读消息提醒
     std::unordered_map<int64_t, int> unreadCounts_;
+    // 已向服务器上报的各会话已读位置，只在前进时上报
+    std::unordered_map<int64_t, int64_t> readMarkers_;
     
     // 消息状态
     std::unordered_map<int64_t, bool> messageDelivered_;
     std::unordered_map<int64_t, bool> messageRead_;
 
+    // 后台文件传输，工作线程只更新原子计数，界面在updateAnimations中轮询进度
+    struct TransferTask {
+        std::string fileName;
+        bool upload;
+        std::atomic<bool> hashing{false};  // 上传前正在计算内容哈希
+        std::atomic<uint64_t> done{0};
+        std::atomic<uint64_t> total{0};
+        std::atomic<bool> cancel{false};
+        std::atomic<bool> finished{false};
+        std::string result;  // 结束时的提示，finished为true之后才读取
+        std::thread worker;
+    };
+    std::vector<std::unique_ptr<TransferTask>> transfers_;
+    std::string transferStatus_;  // 顶部栏显示的传输状态
+
 public:
+    // 界面分区，按区域标记需要重绘的部分
+    enum Region : unsigned {
+        REGION_TOP_BAR     = 1 << 0,
+        REGION_FRIEND_LIST = 1 << 1,
+        REGION_CHAT        = 1 << 2,
+        REGION_INPUT       = 1 << 3,
+        REGION_ALL         = 0xF
+    };
+
+    static constexpr Uint32 CURSOR_BLINK_MS = 500;  // 光标闪烁间隔
+    static constexpr int MESSAGE_SPACING = 10;      // 相邻消息气泡的间距
+    static constexpr int FRIEND_ROW_HEIGHT = 55;    // 好友行的间隔（含5像素间距）
+    static constexpr size_t MAX_CACHED_ROWS = 256;  // 行纹理缓存上限
+    static constexpr size_t MAX_LOADED_MESSAGES = 10000;  // 打开会话时从本地读取的消息数
+    static constexpr int HISTORY_PAGE_SIZE = 500;   // 增量同步每页请求的消息数
+    static constexpr size_t MAX_SEARCH_RESULTS = 200;  // 消息搜索最多显示的条数
+    static constexpr Uint32 TRANSFER_POLL_MS = 200;    // 有文件传输时刷新进度的间隔
+    static constexpr int MAX_TRANSFER_ATTEMPTS = 5;    // 传输中断后自动续传的次数
+
     ChatWindow(SDL_Renderer* renderer, int width, int height);
     ~ChatWindow();
 
     void handleEvent(SDL_Event& event);
+
+    // 只重绘被标记的区域，其余区域保留上一帧的内容
     void render();
+    void invalidate(unsigned regions) { dirtyRegions_ |= regions; }
+    bool needsRedraw() const { return dirtyRegions_ != 0; }
+    // 驱动丢弃了目标纹理的内容（SDL_RENDER_TARGETS_RESET），缓存的好友行需要重画
+    void resetRenderTargets();
+
+    // 推进动画（光标闪烁），返回距下一次动画的毫秒数，-1表示没有动画
+    int updateAnimations(Uint32 now);
     void setUser(std::shared_ptr<User> user);
     void addMessage(const Message& msg);
 
@@ -85,9 +176,11 @@ public:
     void updateFriendStatus(int64_t friendId, bool online);
     void refreshFriendList();
 
-    void setNetworkManager(std::shared_ptr<NetworkManager> networkManager) {
-        networkManager_ = networkManager;
-    }
+    // 处理从服务器收到的消息
+    void handleMessage(const Message& msg);
+
+    // 设置网络连接并订阅聊天窗口处理的消息类型
+    void setNetworkManager(std::shared_ptr<NetworkManager> networkManager);
 
 private:
     void renderTopBar();
@@ -97,12 +190,30 @@ private:
     void renderButton(const SDL_Rect& button, const std::string& text, bool isHovered);
     void renderText(const std::string& text, const SDL_Rect& rect, const SDL_Color& color);
     void renderWelcomeMessage();
+    void renderRegion(const SDL_Rect& region, void (ChatWindow::*draw)());
+    void resetCursorBlink();
     bool isMouseOver(const SDL_Rect& rect, int x, int y);
     void handleTextInput(const std::string& text);
     void handleKeyPress(SDL_Keycode key);
     void sendMessage();
     void loadFriendList();
     void loadChatHistory();
+    void requestChatHistory(int64_t friendId, int64_t afterId);
+    // 当前会话中对方发来的消息都已显示，把已读位置上报给服务器
+    void markConversationRead();
+    bool storeMessage(const Message& msg);
+    void searchMessages(const std::string& query);
+    void clearChatHistory();
+    int maxMessageScroll() const;
+
+    // 好友列表
+    void layoutFriendList();
+    void updateFriendRows();
+    void drawFriendRow(const User& friend_, const SDL_Rect& rect, bool selected, int unread);
+    void clearFriendRows();
+    void rebuildFriendIndex();
+    void applyFriendFilter(bool narrowing);
+    int maxFriendListScroll() const;
 
     // 添加新的私有方法
     void renderMessageBubble(const Message& msg, const SDL_Rect& rect);
@@ -110,9 +221,21 @@ private:
     void renderEmojiPanel();
     void handleEmojiSelection(int x, int y);
     void handleFileSelection();
+    // 文件传输：拖入窗口的文件发给当前好友，收到的文件自动下载到downloads/
+    void startUpload(const std::string& path);
+    void startDownload(const Message& msg);
+    int pollTransfers();
+    static void runUpload(std::shared_ptr<NetworkManager> networkManager, TransferTask* task,
+                          int64_t userId, int64_t receiverId, const std::string& path, bool image);
+    static void runDownload(std::shared_ptr<NetworkManager> networkManager, TransferTask* task,
+                            int64_t userId, int64_t fileId, const std::string& path);
+    static std::string messageText(const Message& msg);
     void showUserProfile();
     void showAddFriendDialog();
     void handleAddFriend(const std::string& username);
-    void handleMessage(const Message& msg);
+    void handleChatAck(const Message& msg);
+    void handleFriendListResponse(const Message& msg);
+    void handleChatHistoryResponse(const Message& msg);
+    void handleSearchResults(const Message& msg);
     void showFriendRequestDialog(int64_t fromUserId, const std::string& fromUsername);
 }; 
\ No newline at end of file
@@ -0,0 +1,224 @@
+#include "GlyphAtlas.h"
+#include <algorithm>
+#include <iostream>
+
+GlyphAtlas::GlyphAtlas(SDL_Renderer* renderer)
+    : renderer_(renderer)
+    , uploads_(0)
+    , drawCalls_(0) {
+}
+
+GlyphAtlas::~GlyphAtlas() {
+    for (auto& page : pages_) {
+        SDL_DestroyTexture(page.texture);
+    }
+}
+
+void GlyphAtlas::drawText(TTF_Font* font, const std::string& text, const SDL_Rect& rect, const SDL_Color& color) {
+    if (!font || text.empty()) return;
+
+    const Layout& laidOut = layout(font, text, rect.w);
+    float x = static_cast<float>(rect.x);
+    float y = static_cast<float>(rect.y + (rect.h - CELL_HEIGHT) / 2);  // 垂直居中
+
+    for (const auto& batch : laidOut.batches) {
+        scratch_.assign(batch.vertices.begin(), batch.vertices.end());
+        for (auto& vertex : scratch_) {
+            vertex.position.x += x;
+            vertex.position.y += y;
+            vertex.color = color;
+        }
+        SDL_RenderGeometry(renderer_, pages_[batch.page].texture,
+                           scratch_.data(), static_cast<int>(scratch_.size()),
+                           batch.indices.data(), static_cast<int>(batch.indices.size()));
+        ++drawCalls_;
+    }
+}
+
+int GlyphAtlas::measure(TTF_Font* font, const std::string& text) const {
+    if (!font) return 0;
+
+    int width = 0;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        int charLen = charLength(text[pos]);
+        width += (charLen > 1) ? WIDE_CELL_WIDTH : CELL_WIDTH;
+        pos += charLen;
+    }
+    return width;
+}
+
+const GlyphAtlas::Layout& GlyphAtlas::layout(TTF_Font* font, const std::string& text, int maxWidth) {
+    LayoutKey key{font, maxWidth, text};
+    auto it = layouts_.find(key);
+    if (it != layouts_.end()) {
+        return it->second;
+    }
+
+    // 显示的内容有限，缓存满了直接清空，下一帧重新排版可见的字符串
+    if (layouts_.size() >= MAX_LAYOUTS) {
+        layouts_.clear();
+    }
+
+    Layout result;
+    result.width = 0;
+
+    int x = 0;
+    std::string::const_iterator pos = text.begin();
+    while (pos != text.end()) {
+        int charLen = std::min<int>(charLength(*pos), text.end() - pos);
+
+        // 检查是否超出显示区域
+        int charWidth = (charLen > 1) ? WIDE_CELL_WIDTH : CELL_WIDTH;
+        if (maxWidth >= 0 && x + charWidth > maxWidth) break;
+
+        const Glyph& cached = glyph(font, std::string(pos, pos + charLen));
+        if (cached.page >= 0) {
+            Batch* batch = nullptr;
+            for (auto& existing : result.batches) {
+                if (existing.page == cached.page) {
+                    batch = &existing;
+                    break;
+                }
+            }
+            if (!batch) {
+                result.batches.push_back(Batch{cached.page, {}, {}});
+                batch = &result.batches.back();
+            }
+
+            // 字形拉伸到固定大小的字符格内，与原先的SDL_RenderCopy效果一致
+            const float scale = 1.0f / PAGE_SIZE;
+            float left = static_cast<float>(x);
+            float right = static_cast<float>(x + charWidth);
+            float u0 = cached.source.x * scale;
+            float v0 = cached.source.y * scale;
+            float u1 = (cached.source.x + cached.source.w) * scale;
+            float v1 = (cached.source.y + cached.source.h) * scale;
+            SDL_Color white = {255, 255, 255, 255};
+
+            int base = static_cast<int>(batch->vertices.size());
+            batch->vertices.push_back(SDL_Vertex{{left, 0.0f}, white, {u0, v0}});
+            batch->vertices.push_back(SDL_Vertex{{right, 0.0f}, white, {u1, v0}});
+            batch->vertices.push_back(SDL_Vertex{{right, static_cast<float>(CELL_HEIGHT)}, white, {u1, v1}});
+            batch->vertices.push_back(SDL_Vertex{{left, static_cast<float>(CELL_HEIGHT)}, white, {u0, v1}});
+            const int quad[] = {0, 1, 2, 2, 3, 0};
+            for (int index : quad) {
+                batch->indices.push_back(base + index);
+            }
+        }
+
+        x += charWidth;
+        pos += charLen;
+    }
+    result.width = x;
+
+    return layouts_.emplace(std::move(key), std::move(result)).first->second;
+}
+
+const GlyphAtlas::Glyph& GlyphAtlas::glyph(TTF_Font* font, const std::string& utf8) {
+    GlyphKey key{font, decode(utf8)};
+    auto it = glyphs_.find(key);
+    if (it != glyphs_.end()) {
+        return it->second;
+    }
+
+    // 渲染失败的字符也记下来，避免每次排版都重试
+    Glyph result{-1, {0, 0, 0, 0}};
+    SDL_Surface* rendered = TTF_RenderUTF8_Blended(font, utf8.c_str(), SDL_Color{255, 255, 255, 255});
+    if (rendered) {
+        SDL_Surface* converted = SDL_ConvertSurfaceFormat(rendered, SDL_PIXELFORMAT_ARGB8888, 0);
+        SDL_FreeSurface(rendered);
+        if (converted) {
+            if (allocate(converted->w, converted->h, result.page, result.source)) {
+                SDL_UpdateTexture(pages_[result.page].texture, &result.source,
+                                  converted->pixels, converted->pitch);
+                ++uploads_;
+            }
+            SDL_FreeSurface(converted);
+        }
+    }
+
+    return glyphs_.emplace(key, result).first->second;
+}
+
+bool GlyphAtlas::allocate(int width, int height, int& page, SDL_Rect& rect) {
+    if (width <= 0 || height <= 0 ||
+        width + PADDING > PAGE_SIZE || height + PADDING > PAGE_SIZE) {
+        return false;
+    }
+    if (pages_.empty() && !addPage()) {
+        return false;
+    }
+
+    // 按行（shelf）摆放：当前行放不下就换行，整页放不下就开新页
+    Page* current = &pages_.back();
+    if (current->cursorX + width + PADDING > PAGE_SIZE) {
+        current->cursorX = 0;
+        current->cursorY += current->rowHeight;
+        current->rowHeight = 0;
+    }
+    if (current->cursorY + height + PADDING > PAGE_SIZE) {
+        if (!addPage()) {
+            return false;
+        }
+        current = &pages_.back();
+    }
+
+    rect = {current->cursorX, current->cursorY, width, height};
+    current->cursorX += width + PADDING;
+    current->rowHeight = std::max(current->rowHeight, height + PADDING);
+    page = static_cast<int>(pages_.size()) - 1;
+    return true;
+}
+
+bool GlyphAtlas::addPage() {
+    SDL_Texture* texture = SDL_CreateTexture(renderer_, SDL_PIXELFORMAT_ARGB8888,
+                                             SDL_TEXTUREACCESS_STATIC, PAGE_SIZE, PAGE_SIZE);
+    if (!texture) {
+        std::cerr << "无法创建字形纹理: " << SDL_GetError() << std::endl;
+        return false;
+    }
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+
+    // 新纹理内容未定义，先清成全透明，字形边缘的留空处才不会采样到杂色
+    std::vector<Uint32> clear(PAGE_SIZE * PAGE_SIZE, 0);
+    SDL_UpdateTexture(texture, nullptr, clear.data(), PAGE_SIZE * sizeof(Uint32));
+
+    pages_.push_back(Page{texture, 0, 0, 0});
+    return true;
+}
+
+int GlyphAtlas::charLength(char lead) {
+    if ((lead & 0x80) == 0) return 1;       // ASCII
+    if ((lead & 0xE0) == 0xC0) return 2;    // UTF-8多字节字符
+    if ((lead & 0xF0) == 0xE0) return 3;
+    if ((lead & 0xF8) == 0xF0) return 4;
+    return 1;
+}
+
+uint32_t GlyphAtlas::decode(const std::string& utf8) {
+    if (utf8.empty()) return 0;
+
+    unsigned char lead = static_cast<unsigned char>(utf8[0]);
+    uint32_t codepoint;
+    size_t length;
+    if (lead < 0x80) {
+        return lead;
+    } else if ((lead & 0xE0) == 0xC0) {
+        codepoint = lead & 0x1F;
+        length = 2;
+    } else if ((lead & 0xF0) == 0xE0) {
+        codepoint = lead & 0x0F;
+        length = 3;
+    } else if ((lead & 0xF8) == 0xF0) {
+        codepoint = lead & 0x07;
+        length = 4;
+    } else {
+        return 0xFFFD;  // 非法首字节
+    }
+
+    for (size_t i = 1; i < length && i < utf8.size(); ++i) {
+        codepoint = (codepoint << 6) | (static_cast<unsigned char>(utf8[i]) & 0x3F);
+    }
+    return codepoint;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include <functional>
+
+// 字形图集与文本排版缓存
+// 字形按(字体, 码点)懒加载到GPU上的大纹理页里，统一用白色渲染，绘制时通过顶点颜色着色，
+// 所以不同颜色的同一字符共用一份字形。排好的字符串按(字体, 文本, 最大宽度)缓存，
+// 每帧只需平移顶点并按纹理页各提交一次SDL_RenderGeometry
+class GlyphAtlas {
+public:
+    static constexpr int PAGE_SIZE = 1024;    // 纹理页边长
+    static constexpr int PADDING = 1;         // 字形之间留空，避免采样串色
+    static constexpr size_t MAX_LAYOUTS = 4096; // 排版缓存条目上限，超过后整体清空
+
+    // 固定宽度排版，与原先逐字渲染的效果保持一致
+    static constexpr int CELL_WIDTH = 16;      // 英文字符宽度
+    static constexpr int WIDE_CELL_WIDTH = 24; // 中文字符宽度
+    static constexpr int CELL_HEIGHT = 24;     // 字符高度
+
+    explicit GlyphAtlas(SDL_Renderer* renderer);
+    ~GlyphAtlas();
+
+    GlyphAtlas(const GlyphAtlas&) = delete;
+    GlyphAtlas& operator=(const GlyphAtlas&) = delete;
+
+    // 在rect内垂直居中绘制文本，超出rect宽度的部分截断
+    void drawText(TTF_Font* font, const std::string& text, const SDL_Rect& rect, const SDL_Color& color);
+
+    // 文本不截断时的排版宽度，固定字宽下只需按字符累加，不生成排版缓存
+    int measure(TTF_Font* font, const std::string& text) const;
+
+    // 统计：已缓存字形数、纹理上传次数、几何提交次数
+    size_t glyphCount() const { return glyphs_.size(); }
+    uint64_t uploads() const { return uploads_; }
+    uint64_t drawCalls() const { return drawCalls_; }
+
+private:
+    struct Glyph {
+        int page;         // -1表示该字符无法渲染
+        SDL_Rect source;  // 在纹理页中的位置
+    };
+
+    struct GlyphKey {
+        TTF_Font* font;
+        uint32_t codepoint;
+        bool operator==(const GlyphKey& other) const {
+            return font == other.font && codepoint == other.codepoint;
+        }
+    };
+
+    struct GlyphKeyHash {
+        size_t operator()(const GlyphKey& key) const {
+            return std::hash<const void*>()(key.font) ^ (std::hash<uint32_t>()(key.codepoint) << 1);
+        }
+    };
+
+    struct Page {
+        SDL_Texture* texture;
+        int cursorX;    // 当前行的下一个空位
+        int cursorY;    // 当前行的顶部
+        int rowHeight;  // 当前行的高度
+    };
+
+    // 同一纹理页上的顶点，坐标相对文本左上角
+    struct Batch {
+        int page;
+        std::vector<SDL_Vertex> vertices;
+        std::vector<int> indices;
+    };
+
+    struct Layout {
+        int width;
+        std::vector<Batch> batches;
+    };
+
+    struct LayoutKey {
+        TTF_Font* font;
+        int maxWidth;  // -1表示不截断
+        std::string text;
+        bool operator==(const LayoutKey& other) const {
+            return font == other.font && maxWidth == other.maxWidth && text == other.text;
+        }
+    };
+
+    struct LayoutKeyHash {
+        size_t operator()(const LayoutKey& key) const {
+            return std::hash<std::string>()(key.text) ^
+                   (std::hash<const void*>()(key.font) << 1) ^
+                   (std::hash<int>()(key.maxWidth) << 2);
+        }
+    };
+
+    SDL_Renderer* renderer_;
+    std::vector<Page> pages_;
+    std::unordered_map<GlyphKey, Glyph, GlyphKeyHash> glyphs_;
+    std::unordered_map<LayoutKey, Layout, LayoutKeyHash> layouts_;
+    std::vector<SDL_Vertex> scratch_;  // 绘制时平移和着色用的临时顶点
+
+    uint64_t uploads_;
+    uint64_t drawCalls_;
+
+    const Layout& layout(TTF_Font* font, const std::string& text, int maxWidth);
+    const Glyph& glyph(TTF_Font* font, const std::string& utf8);
+    bool allocate(int width, int height, int& page, SDL_Rect& rect);
+    bool addPage();
+
+    static int charLength(char lead);
+    static uint32_t decode(const std::string& utf8);
+};
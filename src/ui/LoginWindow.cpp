@@ -12,7 +12,12 @@ LoginWindow::LoginWindow(SDL_Renderer* renderer, int width, int height)
     , isPasswordFocused_(false)
     , loginSuccess_(false)
     , showRegister_(false)
-    , networkManager_(std::make_shared<NetworkManager>()) {
+    , networkManager_(std::make_shared<NetworkManager>())
+    , loginHovered_(false)
+    , registerHovered_(false)
+    , dirty_(true)
+    , cursorVisible_(true)
+    , cursorBlinkTime_(0) {
     
     // 加载菜单图片
     SDL_Surface* surface = IMG_Load("resources/images/menu.jpg");
@@ -124,14 +129,8 @@ void LoginWindow::render() {
     renderTextBox(passwordBox_, password_, true, isPasswordFocused_);
 
     // 渲染按钮
-    int mouseX, mouseY;
-    SDL_GetMouseState(&mouseX, &mouseY);
-    
-    bool loginHovered = isMouseOver(loginButton_, mouseX, mouseY);
-    bool registerHovered = isMouseOver(registerButton_, mouseX, mouseY);
-    
-    renderButton(loginButton_, "登录", loginHovered);
-    renderButton(registerButton_, "注册", registerHovered);
+    renderButton(loginButton_, "登录", loginHovered_);
+    renderButton(registerButton_, "注册", registerHovered_);
 
     // 渲染错误消息（在密码框右边）
     if (!errorMessage_.empty()) {
@@ -143,6 +142,30 @@ void LoginWindow::render() {
         };
         renderText(errorMessage_, errorRect, errorColor_);
     }
+
+    dirty_ = false;
+}
+
+int LoginWindow::updateAnimations(Uint32 now) {
+    if (!isUsernameFocused_ && !isPasswordFocused_) {
+        return -1;
+    }
+
+    Uint32 elapsed = now - cursorBlinkTime_;
+    if (elapsed >= CURSOR_BLINK_MS) {
+        cursorVisible_ = !cursorVisible_;
+        cursorBlinkTime_ = now;
+        dirty_ = true;
+        return static_cast<int>(CURSOR_BLINK_MS);
+    }
+    return static_cast<int>(CURSOR_BLINK_MS - elapsed);
+}
+
+void LoginWindow::resetCursorBlink() {
+    // 输入时光标保持显示，重新开始计时
+    cursorVisible_ = true;
+    cursorBlinkTime_ = SDL_GetTicks();
+    dirty_ = true;
 }
 
 void LoginWindow::renderText(const std::string& text, const SDL_Rect& rect, const SDL_Color& color) {
@@ -210,17 +233,8 @@ void LoginWindow::renderTextBox(const SDL_Rect& box, const std::string& text, bo
             cursorX += textWidth;
         }
         
-        // 闪烁效果
-        static Uint32 lastTime = 0;
-        static bool showCursor = true;
-        Uint32 currentTime = SDL_GetTicks();
-        
-        if (currentTime - lastTime > 500) { // 每500ms切换一次
-            showCursor = !showCursor;
-            lastTime = currentTime;
-        }
-        
-        if (showCursor) {
+        // 闪烁效果，由updateAnimations驱动
+        if (cursorVisible_) {
             SDL_Rect cursor = {cursorX, box.y + 5, 2, box.h - 10};
             SDL_SetRenderDrawColor(renderer_, 0, 0, 0, 255);
             SDL_RenderFillRect(renderer_, &cursor);
@@ -256,6 +270,16 @@ void LoginWindow::renderButton(const SDL_Rect& button, const std::string& text,
 
 void LoginWindow::handleEvent(SDL_Event& event) {
     switch (event.type) {
+        case SDL_MOUSEMOTION: {
+            bool loginHovered = isMouseOver(loginButton_, event.motion.x, event.motion.y);
+            bool registerHovered = isMouseOver(registerButton_, event.motion.x, event.motion.y);
+            if (loginHovered != loginHovered_ || registerHovered != registerHovered_) {
+                loginHovered_ = loginHovered;
+                registerHovered_ = registerHovered;
+                dirty_ = true;
+            }
+            return;
+        }
         case SDL_MOUSEBUTTONDOWN: {
             int mouseX = event.button.x;
             int mouseY = event.button.y;
@@ -280,7 +304,12 @@ void LoginWindow::handleEvent(SDL_Event& event) {
         case SDL_KEYDOWN:
             handleKeyPress(event.key.keysym.sym);
             break;
+        default:
+            return;
     }
+
+    // 点击和键盘输入都可能改变焦点、内容或错误提示
+    resetCursorBlink();
 }
 
 bool LoginWindow::isMouseOver(const SDL_Rect& rect, int x, int y) {
@@ -339,61 +368,39 @@ bool LoginWindow::attemptLogin() {
         Json::Value loginData;
         loginData["username"] = username_;
         loginData["password"] = password_;
+        loginData["compression"] = FrameCompressor::NAME;  // 声明支持的帧压缩算法
         
         Message loginMsg(0, 0, loginData.toStyledString(), MessageType::LOGIN);
-        networkManager_->sendMessage(loginMsg);
+        std::future<Message> reply = networkManager_->request(loginMsg, std::chrono::seconds(5));
         std::cout << "已发送登录请求" << std::endl;
         
-        // 等待服务器响应
-        bool receivedResponse = false;
+        // 等待服务器响应，按requestId匹配，期间到达的其他消息留在接收队列中；
+        // 超时或连接断开时抛出异常
+        Message response = reply.get();
         bool loginSuccess = false;
-        
-        // 设置超时时间
-        auto startTime = std::chrono::steady_clock::now();
-        const auto timeout = std::chrono::seconds(5);
-        
-        while (!receivedResponse) {
-            // 检查是否超时
-            auto now = std::chrono::steady_clock::now();
-            if (now - startTime > timeout) {
-                std::cout << "登录超时" << std::endl;
-                return false;
+        Json::Value responseData;
+        Json::Reader reader;
+        if (reader.parse(response.getContent(), responseData)) {
+            loginSuccess = responseData["success"].asBool();
+            if (loginSuccess) {
+                // 创建用户对象并保存更多信息
+                loggedInUser_ = std::make_shared<User>();
+                loggedInUser_->setUserId(responseData["userId"].asInt64());
+                loggedInUser_->setUsername(username_);  // 使用输入的用户名
+                loggedInUser_->setNickname(username_);  // 暂时使用用户名作为昵称
+                loggedInUser_->setOnline(true);
+                loginSuccess_ = true;
+                std::cout << "登录成功: " << username_ << ", userId: " 
+                         << loggedInUser_->getUserId() << std::endl;
+            } else {
+                errorMessage_ = responseData["error"].asString();
             }
-
-            // 处理服务器响应
-            if (networkManager_->hasMessage()) {
-                Message response = networkManager_->getNextMessage();
-                std::cout << "收到服务器响应，类型: " << static_cast<int>(response.getType()) << std::endl;
-                
-                if (response.getType() == MessageType::LOGIN_RESPONSE) {
-                    Json::Value responseData;
-                    Json::Reader reader;
-                    if (reader.parse(response.getContent(), responseData)) {
-                        receivedResponse = true;
-                        loginSuccess = responseData["success"].asBool();
-                        if (loginSuccess) {
-                            // 创建用户对象并保存更多信息
-                            loggedInUser_ = std::make_shared<User>();
-                            loggedInUser_->setUserId(responseData["userId"].asInt64());
-                            loggedInUser_->setUsername(username_);  // 使用输入的用户名
-                            loggedInUser_->setNickname(username_);  // 暂时使用用户名作为昵称
-                            loggedInUser_->setOnline(true);
-                            loginSuccess_ = true;
-                            std::cout << "登录成功: " << username_ << ", userId: " 
-                                     << loggedInUser_->getUserId() << std::endl;
-                        } else {
-                            errorMessage_ = responseData["error"].asString();
-                        }
-                    }
-                }
-            }
-            
-            SDL_Delay(100);  // 避免过度占用CPU
         }
         
         return loginSuccess;
     } catch (const std::exception& e) {
         std::cout << "登录过程发生异常: " << e.what() << std::endl;
+        errorMessage_ = e.what();
         return false;
     }
 } 
\ No newline at end of file
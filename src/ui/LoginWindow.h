@@ -50,12 +50,28 @@ private:
     std::string errorMessage_;
     SDL_Color errorColor_;
 
+    // 按钮悬停状态，鼠标移动时只有状态变化才重绘
+    bool loginHovered_;
+    bool registerHovered_;
+
+    // 重绘相关：整个窗口作为一个区域
+    bool dirty_;               // 是否需要重绘
+    bool cursorVisible_;       // 输入框光标当前是否显示
+    Uint32 cursorBlinkTime_;   // 光标上次切换的时间
+
 public:
+    static constexpr Uint32 CURSOR_BLINK_MS = 500;  // 光标闪烁间隔
+
     LoginWindow(SDL_Renderer* renderer, int width, int height);
     ~LoginWindow();
 
     void handleEvent(SDL_Event& event);
     void render();
+    bool needsRedraw() const { return dirty_; }
+    void invalidate() { dirty_ = true; }
+
+    // 推进动画（光标闪烁），返回距下一次动画的毫秒数，-1表示没有动画
+    int updateAnimations(Uint32 now);
     bool isLoginSuccessful() const { return loginSuccess_; }
     std::shared_ptr<User> getLoggedInUser() const { return loggedInUser_; }
     bool shouldShowRegister() const { return showRegister_; }
@@ -63,6 +79,7 @@ public:
     void reset() {
         showRegister_ = false;
         loginSuccess_ = false;
+        dirty_ = true;
     }
 
     std::shared_ptr<NetworkManager> getNetworkManager() { return networkManager_; }
@@ -75,4 +92,5 @@ private:
     void handleTextInput(const std::string& text);
     void handleKeyPress(SDL_Keycode key);
     bool isMouseOver(const SDL_Rect& rect, int x, int y);
+    void resetCursorBlink();
 }; 
\ No newline at end of file
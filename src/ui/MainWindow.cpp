@@ -1,14 +1,24 @@
 #include "MainWindow.h"
 #include <iostream>
+#include <sstream>
+#include <iomanip>
 
 MainWindow::MainWindow(const std::string& title, int width, int height)
     : window_(nullptr)
     , renderer_(nullptr)
+    , networkManager_(std::make_shared<NetworkManager>())
     , isLoggedIn_(false)
     , isRegistering_(false)
+    , sessionExpired_(false)
     , width_(width)
     , height_(height)
-    , networkManager_(std::make_shared<NetworkManager>()) {
+    , networkEventType_(static_cast<Uint32>(-1))
+    , frameTexture_(nullptr)
+    , presentPending_(true)
+    , showOverlay_(false)
+    , overlayFont_(nullptr)
+    , lastFrameMillis_(0)
+    , framesPresented_(0) {
     
     if (!init()) {
         throw std::runtime_error("Failed to initialize MainWindow");
@@ -23,6 +33,37 @@ bool MainWindow::init() {
     if (!initSDL()) {
         return false;
     }
+
+    networkEventType_ = SDL_RegisterEvents(1);
+    if (networkEventType_ == static_cast<Uint32>(-1)) {
+        std::cerr << "注册网络事件失败: " << SDL_GetError() << std::endl;
+        return false;
+    }
+
+    // 目标纹理创建失败时仍可运行，只是每帧整屏重绘
+    createFrameTexture();
+
+    overlayFont_ = TTF_OpenFont("resources/fonts/simple.ttf", 16);
+    overlayAtlas_ = std::make_unique<GlyphAtlas>(renderer_);
+    return true;
+}
+
+bool MainWindow::createFrameTexture() {
+    if (frameTexture_) {
+        SDL_DestroyTexture(frameTexture_);
+    }
+    frameTexture_ = SDL_CreateTexture(renderer_, SDL_PIXELFORMAT_ARGB8888,
+                                      SDL_TEXTUREACCESS_TARGET, width_, height_);
+    if (!frameTexture_) {
+        std::cerr << "创建画布纹理失败: " << SDL_GetError() << std::endl;
+        return false;
+    }
+
+    // 新纹理内容未定义，先清成背景色
+    SDL_SetRenderTarget(renderer_, frameTexture_);
+    SDL_SetRenderDrawColor(renderer_, 255, 255, 255, 255);
+    SDL_RenderClear(renderer_);
+    SDL_SetRenderTarget(renderer_, nullptr);
     return true;
 }
 
@@ -44,7 +85,9 @@ bool MainWindow::initSDL() {
         return false;
     }
 
-    renderer_ = SDL_CreateRenderer(window_, -1, SDL_RENDERER_ACCELERATED);
+    // 垂直同步限制提交频率，目标纹理用于保留未变化的区域
+    renderer_ = SDL_CreateRenderer(window_, -1,
+        SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC | SDL_RENDERER_TARGETTEXTURE);
     if (!renderer_) {
         std::cerr << "渲染器创建失败: " << SDL_GetError() << std::endl;
         return false;
@@ -71,24 +114,82 @@ void MainWindow::run() {
     SDL_Event event;
 
     while (!quit) {
-        while (SDL_PollEvent(&event)) {
+        // 推进到期的动画，只有存在失效区域时render才真正绘制
+        int timeout = updateAnimations();
+        render();
+
+        // 阻塞到有输入、网络消息或下一次动画；超时为-1时一直等待
+        if (!SDL_WaitEventTimeout(&event, timeout)) {
+            continue;
+        }
+
+        // 一次唤醒内积压的事件合并为一帧
+        do {
             if (event.type == SDL_QUIT) {
                 quit = true;
+            } else if (event.type == networkEventType_) {
+                // 将收到的服务器消息分发给订阅者（聊天窗口），由订阅者标记失效区域
+                if (isLoggedIn_ && networkManager_) {
+                    dispatchNetworkMessages();
+                }
+            } else {
+                handleEvent(event);
             }
-            handleEvent(event);
+        } while (!quit && SDL_PollEvent(&event));
+
+        // 通知事件可能被模态对话框取走或因事件队列已满而丢失，每次唤醒后都检查队列
+        if (!quit && isLoggedIn_ && networkManager_ && networkManager_->hasMessage()) {
+            dispatchNetworkMessages();
         }
+    }
+}
 
-        render();
+int MainWindow::updateAnimations() {
+    Uint32 now = SDL_GetTicks();
+    if (isLoggedIn_) {
+        return chatWindow_->updateAnimations(now);
+    } else if (isRegistering_) {
+        return registerWindow_->updateAnimations(now);
     }
+    return loginWindow_->updateAnimations(now);
+}
+
+bool MainWindow::needsRedraw() const {
+    if (isLoggedIn_) {
+        return chatWindow_->needsRedraw();
+    } else if (isRegistering_) {
+        return registerWindow_->needsRedraw();
+    }
+    return loginWindow_->needsRedraw();
+}
+
+void MainWindow::invalidateAll() {
+    loginWindow_->invalidate();
+    registerWindow_->invalidate();
+    chatWindow_->invalidate(ChatWindow::REGION_ALL);
 }
 
 void MainWindow::handleEvent(SDL_Event& event) {
     if (event.type == SDL_WINDOWEVENT) {
         if (event.window.event == SDL_WINDOWEVENT_RESIZED) {
-            // 获取新的窗口大小
+            // 获取新的窗口大小，画布随之重建，内容全部重绘
             SDL_GetWindowSize(window_, &width_, &height_);
+            createFrameTexture();
+            invalidateAll();
+        } else if (event.window.event == SDL_WINDOWEVENT_EXPOSED) {
+            // 内容没有变化，重新提交画布即可
+            presentPending_ = true;
         }
+    } else if (event.type == SDL_RENDER_TARGETS_RESET) {
+        // 驱动丢弃了目标纹理的内容，包括画布和聊天窗口缓存的好友行
+        chatWindow_->resetRenderTargets();
+        invalidateAll();
     } else if (event.type == SDL_KEYDOWN) {
+        // 按F3切换帧耗时叠加层
+        if (event.key.keysym.sym == SDLK_F3) {
+            showOverlay_ = !showOverlay_;
+            presentPending_ = true;
+        }
         // 按F11切换全屏
         if (event.key.keysym.sym == SDLK_F11) {
             static bool isFullscreen = false;
@@ -118,18 +219,68 @@ void MainWindow::handleEvent(SDL_Event& event) {
 }
 
 void MainWindow::render() {
-    SDL_SetRenderDrawColor(renderer_, 255, 255, 255, 255);
-    SDL_RenderClear(renderer_);
+    bool redraw = needsRedraw() || !frameTexture_;
+    if (!redraw && !presentPending_) {
+        return;  // 画面没有变化，不提交新帧
+    }
 
-    if (isLoggedIn_) {
-        chatWindow_->render();
-    } else if (isRegistering_) {
-        registerWindow_->render();
-    } else {
-        loginWindow_->render();
+    Uint64 begin = SDL_GetPerformanceCounter();
+
+    if (redraw) {
+        if (frameTexture_) {
+            SDL_SetRenderTarget(renderer_, frameTexture_);
+        } else {
+            // 没有画布时退化为整屏重绘
+            invalidateAll();
+            SDL_SetRenderDrawColor(renderer_, 255, 255, 255, 255);
+            SDL_RenderClear(renderer_);
+        }
+
+        if (isLoggedIn_) {
+            chatWindow_->render();
+        } else if (isRegistering_) {
+            registerWindow_->render();
+        } else {
+            loginWindow_->render();
+        }
+
+        SDL_SetRenderTarget(renderer_, nullptr);
+    }
+
+    if (frameTexture_) {
+        SDL_SetRenderDrawColor(renderer_, 255, 255, 255, 255);
+        SDL_RenderClear(renderer_);
+        SDL_RenderCopy(renderer_, frameTexture_, nullptr, nullptr);
+    }
+    if (showOverlay_) {
+        renderOverlay();
     }
 
+    lastFrameMillis_ = (SDL_GetPerformanceCounter() - begin) * 1000.0 /
+                       SDL_GetPerformanceFrequency();
+    ++framesPresented_;
+
+    // 渲染器开启了垂直同步，提交频率不会超过刷新率
     SDL_RenderPresent(renderer_);
+    presentPending_ = false;
+}
+
+void MainWindow::renderOverlay() {
+    if (!overlayFont_) return;
+
+    // 显示上一帧的绘制耗时和累计提交的帧数，空闲时帧数不再增长
+    std::stringstream ss;
+    ss << "帧耗时 " << std::fixed << std::setprecision(2) << lastFrameMillis_
+       << " ms  帧数 " << framesPresented_;
+
+    SDL_Rect background = {5, 5, 420, 30};
+    SDL_SetRenderDrawBlendMode(renderer_, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(renderer_, 0, 0, 0, 160);
+    SDL_RenderFillRect(renderer_, &background);
+    SDL_SetRenderDrawBlendMode(renderer_, SDL_BLENDMODE_NONE);
+
+    SDL_Rect textRect = {background.x + 5, background.y, background.w - 10, background.h};
+    overlayAtlas_->drawText(overlayFont_, ss.str(), textRect, {255, 255, 0, 255});
 }
 
 void MainWindow::switchToChat() {
@@ -143,6 +294,42 @@ void MainWindow::switchToChat() {
     // 设置聊天窗口的NetworkManager和用户信息
     chatWindow_->setNetworkManager(networkManager_);
     chatWindow_->setUser(user);
+
+    // 登录之后只会收到会话恢复失败时网络层生成的登录应答
+    networkManager_->subscribe(MessageType::LOGIN_RESPONSE, [this](const Message& msg) {
+        Json::Value response;
+        Json::Reader reader;
+        if (reader.parse(msg.getContent(), response) && response["sessionExpired"].asBool()) {
+            sessionExpired_ = true;
+        }
+    });
+
+    // 收到消息时由网络线程投递事件唤醒界面，SDL_PushEvent是线程安全的
+    Uint32 eventType = networkEventType_;
+    networkManager_->setMessageCallback([eventType]() {
+        SDL_Event event = {};
+        event.type = eventType;
+        SDL_PushEvent(&event);
+    });
+}
+
+void MainWindow::dispatchNetworkMessages() {
+    networkManager_->dispatchMessages();
+    if (sessionExpired_) {
+        handleSessionExpired();
+    }
+}
+
+void MainWindow::handleSessionExpired() {
+    sessionExpired_ = false;
+    std::cerr << "会话已失效，请重新登录" << std::endl;
+
+    // 断开连接并清空订阅，重新登录时建立新连接；聊天窗口换成新的，不保留上个会话的状态
+    networkManager_->disconnect();
+    networkManager_->unsubscribeAll();
+    chatWindow_ = std::make_shared<ChatWindow>(renderer_, width_, height_);
+    switchToLogin();
+    invalidateAll();
 }
 
 void MainWindow::switchToRegister() {
@@ -158,6 +345,13 @@ void MainWindow::switchToLogin() {
 }
 
 void MainWindow::cleanup() {
+    overlayAtlas_.reset();
+    if (overlayFont_) {
+        TTF_CloseFont(overlayFont_);
+    }
+    if (frameTexture_) {
+        SDL_DestroyTexture(frameTexture_);
+    }
     if (renderer_) {
         SDL_DestroyRenderer(renderer_);
     }
@@ -8,6 +8,7 @@
 #include "LoginWindow.h"
 #include "ChatWindow.h"
 #include "RegisterWindow.h"
+#include "GlyphAtlas.h"
 #include "../core/NetworkManager.h"
 
 class MainWindow {
@@ -20,8 +21,21 @@ private:
     std::shared_ptr<NetworkManager> networkManager_;
     bool isLoggedIn_;
     bool isRegistering_;
+    bool sessionExpired_;      // 断线重连后会话恢复失败，需要回到登录页
     int width_;
     int height_;
+    Uint32 networkEventType_;  // 网络线程收到消息后投递的SDL用户事件
+
+    // 按需渲染：界面画在常驻的目标纹理上，只有失效的区域重绘，再整张拷贝到屏幕
+    SDL_Texture* frameTexture_;
+    bool presentPending_;      // 画面未变但需要重新提交（窗口被遮挡后恢复、叠加层切换等）
+
+    // F3切换的帧耗时叠加层
+    bool showOverlay_;
+    TTF_Font* overlayFont_;
+    std::unique_ptr<GlyphAtlas> overlayAtlas_;
+    double lastFrameMillis_;   // 上一帧的绘制耗时（不含等待垂直同步）
+    uint64_t framesPresented_;
 
 public:
     MainWindow(const std::string& title, int width, int height);
@@ -34,8 +48,16 @@ public:
 
 private:
     bool initSDL();
+    bool createFrameTexture();
+    bool needsRedraw() const;
+    void invalidateAll();
+    int updateAnimations();
+    void renderOverlay();
     void cleanup();
     void switchToChat();
     void switchToRegister();
     void switchToLogin();
+    // 分发网络消息，会话失效时在分发结束后退回登录页
+    void dispatchNetworkMessages();
+    void handleSessionExpired();
 }; 
\ No newline at end of file
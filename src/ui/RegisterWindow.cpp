@@ -10,7 +10,13 @@ RegisterWindow::RegisterWindow(SDL_Renderer* renderer, int width, int height)
     , isConfirmPasswordFocused_(false)
     , isNicknameFocused_(false)
     , registerSuccess_(false)
-    , networkManager_(std::make_shared<NetworkManager>()) {
+    , networkManager_(std::make_shared<NetworkManager>())
+    , backToLogin_(false)
+    , registerHovered_(false)
+    , backHovered_(false)
+    , dirty_(true)
+    , cursorVisible_(true)
+    , cursorBlinkTime_(0) {
     
     // 加载字体
     font_ = TTF_OpenFont("resources/fonts/simple.ttf", 24);
@@ -97,23 +103,52 @@ void RegisterWindow::render() {
     renderTextBox(nicknameBox_, nickname_, false, isNicknameFocused_);
 
     // 渲染按钮
-    int mouseX, mouseY;
-    SDL_GetMouseState(&mouseX, &mouseY);
-    
-    bool registerHovered = isMouseOver(registerButton_, mouseX, mouseY);
-    bool backHovered = isMouseOver(backButton_, mouseX, mouseY);
-    
-    renderButton(registerButton_, "注册", registerHovered);
-    renderButton(backButton_, "返回", backHovered);
+    renderButton(registerButton_, "注册", registerHovered_);
+    renderButton(backButton_, "返回", backHovered_);
 
     // 渲染错误信息
     if (!errorMessage_.empty()) {
         renderErrorMessage();
     }
+
+    dirty_ = false;
+}
+
+int RegisterWindow::updateAnimations(Uint32 now) {
+    if (!isUsernameFocused_ && !isPasswordFocused_ &&
+        !isConfirmPasswordFocused_ && !isNicknameFocused_) {
+        return -1;
+    }
+
+    Uint32 elapsed = now - cursorBlinkTime_;
+    if (elapsed >= CURSOR_BLINK_MS) {
+        cursorVisible_ = !cursorVisible_;
+        cursorBlinkTime_ = now;
+        dirty_ = true;
+        return static_cast<int>(CURSOR_BLINK_MS);
+    }
+    return static_cast<int>(CURSOR_BLINK_MS - elapsed);
+}
+
+void RegisterWindow::resetCursorBlink() {
+    // 输入时光标保持显示，重新开始计时
+    cursorVisible_ = true;
+    cursorBlinkTime_ = SDL_GetTicks();
+    dirty_ = true;
 }
 
 void RegisterWindow::handleEvent(SDL_Event& event) {
     switch (event.type) {
+        case SDL_MOUSEMOTION: {
+            bool registerHovered = isMouseOver(registerButton_, event.motion.x, event.motion.y);
+            bool backHovered = isMouseOver(backButton_, event.motion.x, event.motion.y);
+            if (registerHovered != registerHovered_ || backHovered != backHovered_) {
+                registerHovered_ = registerHovered;
+                backHovered_ = backHovered;
+                dirty_ = true;
+            }
+            return;
+        }
         case SDL_MOUSEBUTTONDOWN: {
             int mouseX = event.button.x;
             int mouseY = event.button.y;
@@ -144,7 +179,12 @@ void RegisterWindow::handleEvent(SDL_Event& event) {
         case SDL_KEYDOWN:
             handleKeyPress(event.key.keysym.sym);
             break;
+        default:
+            return;
     }
+
+    // 点击和键盘输入都可能改变焦点、内容或错误提示
+    resetCursorBlink();
 }
 
 void RegisterWindow::validateInput() {
@@ -206,41 +246,25 @@ bool RegisterWindow::attemptRegister() {
     registerData["nickname"] = nickname_;
     
     Message registerMsg(0, 0, registerData.toStyledString(), MessageType::REGISTER);
-    networkManager_->sendMessage(registerMsg);
+    std::future<Message> reply = networkManager_->request(registerMsg, std::chrono::seconds(5));
     
-    // 等待服务器响应
-    bool receivedResponse = false;
-    bool registrationSuccess = false;
-    
-    // 设置超时时间
-    auto startTime = std::chrono::steady_clock::now();
-    const auto timeout = std::chrono::seconds(5);
-    
-    while (!receivedResponse) {
-        // 检查是否超时
-        auto now = std::chrono::steady_clock::now();
-        if (now - startTime > timeout) {
-            errorMessage_ = "服务器响应超时";
-            return false;
-        }
+    // 等待服务器响应，按requestId匹配
+    Message response;
+    try {
+        response = reply.get();
+    } catch (const std::exception& e) {
+        errorMessage_ = e.what();  // 服务器响应超时或连接断开
+        return false;
+    }
 
-        // 处理服务器响应
-        if (networkManager_->hasMessage()) {
-            Message response = networkManager_->getNextMessage();
-            if (response.getType() == MessageType::REGISTER_RESPONSE) {
-                Json::Value responseData;
-                Json::Reader reader;
-                if (reader.parse(response.getContent(), responseData)) {
-                    receivedResponse = true;
-                    registrationSuccess = responseData["success"].asBool();
-                    if (!registrationSuccess) {
-                        errorMessage_ = responseData["error"].asString();
-                    }
-                }
-            }
+    bool registrationSuccess = false;
+    Json::Value responseData;
+    Json::Reader reader;
+    if (reader.parse(response.getContent(), responseData)) {
+        registrationSuccess = responseData["success"].asBool();
+        if (!registrationSuccess) {
+            errorMessage_ = responseData["error"].asString();
         }
-        
-        SDL_Delay(100);  // 避免过度占用CPU
     }
     
     if (registrationSuccess) {
@@ -405,17 +429,8 @@ void RegisterWindow::renderTextBox(const SDL_Rect& box, const std::string& text,
             cursorX += textWidth;
         }
         
-        // 闪烁效果
-        static Uint32 lastTime = 0;
-        static bool showCursor = true;
-        Uint32 currentTime = SDL_GetTicks();
-        
-        if (currentTime - lastTime > 500) { // 每500ms切换一次
-            showCursor = !showCursor;
-            lastTime = currentTime;
-        }
-        
-        if (showCursor) {
+        // 闪烁效果，由updateAnimations驱动
+        if (cursorVisible_) {
             SDL_Rect cursor = {cursorX, box.y + 5, 2, box.h - 10};
             SDL_SetRenderDrawColor(renderer_, 0, 0, 0, 255);
             SDL_RenderFillRect(renderer_, &cursor);
@@ -48,17 +48,33 @@ private:
     std::string errorMessage_;
 
     bool backToLogin_;
+
+    // 按钮悬停状态，鼠标移动时只有状态变化才重绘
+    bool registerHovered_;
+    bool backHovered_;
+
+    // 重绘相关：整个窗口作为一个区域
+    bool dirty_;               // 是否需要重绘
+    bool cursorVisible_;       // 输入框光标当前是否显示
+    Uint32 cursorBlinkTime_;   // 光标上次切换的时间
     SDL_Rect usernameLabel_;
     SDL_Rect passwordLabel_;
     SDL_Rect confirmPasswordLabel_;
     SDL_Rect nicknameLabel_;
 
 public:
+    static constexpr Uint32 CURSOR_BLINK_MS = 500;  // 光标闪烁间隔
+
     RegisterWindow(SDL_Renderer* renderer, int width, int height);
     ~RegisterWindow();
 
     void handleEvent(SDL_Event& event);
     void render();
+    bool needsRedraw() const { return dirty_; }
+    void invalidate() { dirty_ = true; }
+
+    // 推进动画（光标闪烁），返回距下一次动画的毫秒数，-1表示没有动画
+    int updateAnimations(Uint32 now);
     bool isRegistrationSuccessful() const { return registerSuccess_; }
     bool shouldBackToLogin() const { return backToLogin_; }
     void reset() {
@@ -73,6 +89,7 @@ public:
         isPasswordFocused_ = false;
         isConfirmPasswordFocused_ = false;
         isNicknameFocused_ = false;
+        dirty_ = true;
     }
 
 private:
@@ -84,6 +101,7 @@ private:
     void handleTextInput(const std::string& text);
     void handleKeyPress(SDL_Keycode key);
     bool isMouseOver(const SDL_Rect& rect, int x, int y);
+    void resetCursorBlink();
     void renderText(const std::string& text, const SDL_Rect& rect, const SDL_Color& color);
     void showSuccessAnimation();
 }; 
\ No newline at end of file